@@ -0,0 +1,282 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_BATCHED_SORTED_IDS_H
+#define PXR_IMAGING_HD_BATCHED_SORTED_IDS_H
+
+#include "pxr/pxr.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/base/work/sort.h"
+#include "pxr/base/work/threadLimits.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_BatchedSortedIds
+///
+/// Sorted multiset of prim ids with the same observable behavior as
+/// Hd_SortedIds, but designed for large batches of edits.
+///
+/// Inserts and removes are queued until the next GetIds() call.  Queued
+/// edits are sorted once and merged into the sorted id list in a single
+/// pass, which is split into independent chunks and run in parallel when
+/// the batch is big enough.  Switching between inserting and removing
+/// flushes the queue so edits are applied in the order they were issued.
+///
+class Hd_BatchedSortedIds {
+public:
+    /// Below this many ids the merge runs serially.
+    static constexpr size_t ParallelGrainSize = 16384;
+
+    Hd_BatchedSortedIds() = default;
+
+    /// Replaces the contents with \p ids, sorting them in parallel.
+    void Populate(SdfPathVector ids) {
+        _pending.clear();
+        _mode = _Mode::None;
+        _ids = std::move(ids);
+        WorkParallelSort(&_ids);
+    }
+
+    /// Returns the sorted ids, applying any queued edits first.
+    const SdfPathVector& GetIds() {
+        _Sync();
+        return _ids;
+    }
+
+    void Insert(const SdfPath& id) {
+        _Queue(_Mode::Insert);
+        _pending.push_back(id);
+    }
+
+    template <class Iter>
+    void Insert(Iter first, Iter last) {
+        _Queue(_Mode::Insert);
+        _pending.insert(_pending.end(), first, last);
+    }
+
+    /// Removes one instance of \p id.  Removing an id that is not present
+    /// has no effect.
+    void Remove(const SdfPath& id) {
+        _Queue(_Mode::Remove);
+        _pending.push_back(id);
+    }
+
+    template <class Iter>
+    void Remove(Iter first, Iter last) {
+        _Queue(_Mode::Remove);
+        _pending.insert(_pending.end(), first, last);
+    }
+
+    /// Removes \p prefix and all of its descendants.
+    ///
+    /// The subtree occupies a contiguous range of the sorted ids, which is
+    /// located with two binary searches.  Erasing it still moves every id
+    /// after the range down, so the cost is O(log n + k) to find and destroy
+    /// the k ids of the subtree plus a memmove-bound O(n) shift: the sorted
+    /// ids are kept in one contiguous vector because GetIds() returns it.
+    /// Subtrees near the end of the list are the cheapest to remove.
+    void RemoveSubtree(const SdfPath& prefix) {
+        _Sync();
+        const auto [first, last] = _FindSubtree(prefix);
+        _ids.erase(first, last);
+    }
+
+    /// Renames \p oldPrefix and all of its descendants to \p newPrefix.
+    ///
+    /// Replacing a common prefix keeps the relative order of the subtree, so
+    /// the ids are renamed in place, rotated as a block to where \p newPrefix
+    /// sorts, and merged with any ids already under \p newPrefix, without
+    /// re-sorting the whole list.  The rotation moves every id between the
+    /// old and the new position, so the cost is O(log n + k + d), where d is
+    /// that distance, and O(n) when the subtree moves across the list.
+    void RenameSubtree(const SdfPath& oldPrefix, const SdfPath& newPrefix) {
+        _Sync();
+        const auto [first, last] = _FindSubtree(oldPrefix);
+        if (first == last || oldPrefix == newPrefix) {
+            return;
+        }
+        for (auto it = first; it != last; ++it) {
+            *it = it->ReplacePrefix(oldPrefix, newPrefix);
+        }
+
+        const size_t numRenamed = last - first;
+        const auto isUnderNewPrefix = [&newPrefix](const SdfPath& id) { return id.HasPrefix(newPrefix); };
+        const auto before = std::lower_bound(_ids.begin(), first, newPrefix);
+        if (before != first) {
+            // The block sorts before some of the ids in front of it.
+            std::rotate(before, first, last);
+            const auto mergeLast = std::partition_point(before + numRenamed, _ids.end(), isUnderNewPrefix);
+            std::inplace_merge(before, before + numRenamed, mergeLast);
+        } else {
+            const auto after = std::lower_bound(last, _ids.end(), newPrefix);
+            std::rotate(first, last, after);
+            const auto mergeLast = std::partition_point(after, _ids.end(), isUnderNewPrefix);
+            std::inplace_merge(after - numRenamed, after, mergeLast);
+        }
+    }
+
+    void Clear() {
+        _ids.clear();
+        _pending.clear();
+        _mode = _Mode::None;
+    }
+
+private:
+    enum class _Mode { None, Insert, Remove };
+
+    // A chunk of _ids together with the range of the (sorted) pending
+    // edits that fall into it.
+    struct _Chunk {
+        size_t idsBegin, idsEnd;
+        size_t pendingBegin, pendingEnd;
+    };
+
+    // Returns the range of ids that have \p prefix as a prefix.
+    std::pair<SdfPathVector::iterator, SdfPathVector::iterator> _FindSubtree(const SdfPath& prefix) {
+        const auto first = std::lower_bound(_ids.begin(), _ids.end(), prefix);
+        const auto last = std::partition_point(first, _ids.end(), [&prefix](const SdfPath& id) {
+            return id.HasPrefix(prefix);
+        });
+        return {first, last};
+    }
+
+    void _Queue(_Mode mode) {
+        if (_mode != mode) {
+            _Sync();
+            _mode = mode;
+        }
+    }
+
+    // Splits _ids into roughly equal chunks and finds the matching pending
+    // range for each one.  Chunk boundaries never split a run of equal ids
+    // so that duplicate removal stays correct.
+    std::vector<_Chunk> _ComputeChunks() const {
+        const size_t numIds = _ids.size();
+        const size_t numChunks = std::max<size_t>(
+                1, std::min<size_t>(WorkGetConcurrencyLimit() * 4, (numIds + _pending.size()) / ParallelGrainSize));
+
+        std::vector<size_t> bounds{0};
+        for (size_t i = 1; i < numChunks; ++i) {
+            size_t b = std::max(bounds.back(), numIds * i / numChunks);
+            while (b > 0 && b < numIds && _ids[b] == _ids[b - 1]) {
+                ++b;
+            }
+            if (b > bounds.back() && b < numIds) {
+                bounds.push_back(b);
+            }
+        }
+        bounds.push_back(numIds);
+
+        std::vector<_Chunk> chunks;
+        chunks.reserve(bounds.size() - 1);
+        size_t pendingBegin = 0;
+        for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+            const size_t pendingEnd =
+                    bounds[i + 1] == numIds
+                            ? _pending.size()
+                            : std::lower_bound(_pending.begin(), _pending.end(), _ids[bounds[i + 1]]) -
+                                      _pending.begin();
+            chunks.push_back({bounds[i], bounds[i + 1], pendingBegin, pendingEnd});
+            pendingBegin = pendingEnd;
+        }
+        return chunks;
+    }
+
+    void _MergeInserts() {
+        if (_ids.empty()) {
+            _ids.swap(_pending);
+            return;
+        }
+
+        const std::vector<_Chunk> chunks = _ComputeChunks();
+        SdfPathVector result(_ids.size() + _pending.size());
+        WorkParallelForN(chunks.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                const _Chunk& c = chunks[i];
+                std::merge(std::make_move_iterator(_ids.begin() + c.idsBegin),
+                           std::make_move_iterator(_ids.begin() + c.idsEnd),
+                           std::make_move_iterator(_pending.begin() + c.pendingBegin),
+                           std::make_move_iterator(_pending.begin() + c.pendingEnd),
+                           result.begin() + c.idsBegin + c.pendingBegin);
+            }
+        });
+        _ids.swap(result);
+    }
+
+    void _MergeRemoves() {
+        const std::vector<_Chunk> chunks = _ComputeChunks();
+        if (chunks.size() == 1) {
+            SdfPathVector result;
+            result.reserve(_ids.size());
+            std::set_difference(std::make_move_iterator(_ids.begin()), std::make_move_iterator(_ids.end()),
+                                _pending.begin(), _pending.end(), std::back_inserter(result));
+            _ids.swap(result);
+            return;
+        }
+
+        // Each chunk keeps its survivors separately; they are then moved
+        // into place at their prefix-summed offsets.
+        std::vector<SdfPathVector> kept(chunks.size());
+        WorkParallelForN(chunks.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                const _Chunk& c = chunks[i];
+                kept[i].reserve(c.idsEnd - c.idsBegin);
+                std::set_difference(std::make_move_iterator(_ids.begin() + c.idsBegin),
+                                    std::make_move_iterator(_ids.begin() + c.idsEnd),
+                                    _pending.begin() + c.pendingBegin, _pending.begin() + c.pendingEnd,
+                                    std::back_inserter(kept[i]));
+            }
+        });
+
+        std::vector<size_t> offsets(kept.size() + 1, 0);
+        for (size_t i = 0; i != kept.size(); ++i) {
+            offsets[i + 1] = offsets[i] + kept[i].size();
+        }
+        SdfPathVector result(offsets.back());
+        WorkParallelForN(kept.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                std::move(kept[i].begin(), kept[i].end(), result.begin() + offsets[i]);
+            }
+        });
+        _ids.swap(result);
+    }
+
+    void _Sync() {
+        if (_pending.empty()) {
+            _mode = _Mode::None;
+            return;
+        }
+
+        if (_pending.size() < ParallelGrainSize) {
+            std::sort(_pending.begin(), _pending.end());
+        } else {
+            WorkParallelSort(&_pending);
+        }
+
+        if (_mode == _Mode::Insert) {
+            _MergeInserts();
+        } else {
+            _MergeRemoves();
+        }
+
+        _pending.clear();
+        _mode = _Mode::None;
+    }
+
+    SdfPathVector _ids;
+    SdfPathVector _pending;
+    _Mode _mode = _Mode::None;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_BATCHED_SORTED_IDS_H
@@ -0,0 +1,583 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_BOUNDED_DEPENDENCY_FORWARDING_SCENE_INDEX_H
+#define PXR_IMAGING_HD_BOUNDED_DEPENDENCY_FORWARDING_SCENE_INDEX_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/dependenciesSchema.h"
+#include "pxr/imaging/hd/dependencySchema.h"
+#include "pxr/imaging/hd/filteringSceneIndex.h"
+#include "pxr/imaging/hd/sceneIndexObserver.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/usd/sdf/pathTable.h"
+#include "pxr/base/arch/align.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DECLARE_REF_PTRS(Hd_BoundedDependencyForwardingSceneIndex);
+
+/// \class Hd_BoundedDependencyForwardingSceneIndex
+///
+/// Dependency forwarding scene index whose cache of discovered dependencies
+/// is kept within a memory budget.
+///
+/// As with HdDependencyForwardingSceneIndex, the __dependencies of a prim
+/// are read when the prim is pulled, and dirties of a depended-on prim are
+/// forwarded to the affected prims found so far.  The dependency records of
+/// HdDependencyForwardingSceneIndex are only dropped when prims are removed,
+/// so they grow with every prim ever pulled.  Here, once the estimated size
+/// of the records exceeds the budget, records are evicted with the clock
+/// algorithm: pulls and forwarded dirties mark a record as referenced, and
+/// the clock hand evicts the first record it finds unmarked, clearing the
+/// marks it passes.
+///
+/// Consumers pull a prim once and then rely on its dirties, so eviction
+/// must not lose dependents.  An evicted prim keeps one reverse edge per
+/// prim it depends on, without the locators, and a dirty of any of those
+/// prims dirties all of the evicted prim.  Pulling the prim again reads its
+/// dependencies again and restores precise forwarding.  The budget bounds
+/// the records, not these edges, which live until the prim is removed.
+///
+/// The cache is split into shards by prim path, each with its own lock,
+/// clock and tables, and dependencies are read from the input without
+/// holding any lock, so concurrent pulls rarely contend.  The budget is
+/// shared: a shard that grows past it evicts from its own records first,
+/// then from the other shards.
+///
+/// Byte counts are estimates of the heap used by the records and the
+/// reverse lookup, not exact allocator usage.
+///
+class Hd_BoundedDependencyForwardingSceneIndex : public HdSingleInputFilteringSceneIndexBase {
+public:
+    struct Stats {
+        /// Number of prims with dependency records.
+        size_t numEntries = 0;
+        /// Estimated bytes used by the records.
+        size_t numBytes = 0;
+        /// Number of evicted prims that still have reverse edges.
+        size_t numEvictedEntries = 0;
+        /// Estimated bytes used by the edges of evicted prims.
+        size_t numEvictedBytes = 0;
+        /// Number of records evicted to stay within the budget.
+        size_t numEvictions = 0;
+        /// Number of times the dependencies of a pulled prim were read.
+        size_t numDiscoveries = 0;
+    };
+
+    static Hd_BoundedDependencyForwardingSceneIndexRefPtr New(
+            HdSceneIndexBaseRefPtr const& inputSceneIndex,
+            size_t memoryBudget = std::numeric_limits<size_t>::max()) {
+        return TfCreateRefPtr(new Hd_BoundedDependencyForwardingSceneIndex(inputSceneIndex, memoryBudget));
+    }
+
+    HdSceneIndexPrim GetPrim(SdfPath const& primPath) const override {
+        HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+        bool evicted = false;
+        {
+            _Shard& shard = _shards[_GetShardIndex(primPath)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const uint32_t slot = _Find(shard, primPath);
+            if (slot != _invalid) {
+                _Entry& entry = shard.entries[slot];
+                if (entry.state == _Live) {
+                    entry.referenced = true;
+                    return prim;
+                }
+                evicted = true;
+            }
+        }
+        _Discover(primPath, prim, evicted);
+        return prim;
+    }
+
+    SdfPathVector GetChildPrimPaths(SdfPath const& primPath) const override {
+        return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+    }
+
+    /// Sets the budget for the dependency records, evicting records right
+    /// away if needed.
+    void SetMemoryBudget(size_t memoryBudget) {
+        _memoryBudget = memoryBudget;
+        _EvictToBudget(0, _invalid);
+    }
+
+    size_t GetMemoryBudget() const { return _memoryBudget; }
+
+    Stats GetStats() const {
+        Stats stats;
+        for (_Shard const& shard : _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            stats.numEntries += shard.stats.numEntries;
+            stats.numBytes += shard.stats.numBytes;
+            stats.numEvictedEntries += shard.stats.numEvictedEntries;
+            stats.numEvictedBytes += shard.stats.numEvictedBytes;
+            stats.numEvictions += shard.stats.numEvictions;
+            stats.numDiscoveries += shard.stats.numDiscoveries;
+        }
+        return stats;
+    }
+
+protected:
+    Hd_BoundedDependencyForwardingSceneIndex(HdSceneIndexBaseRefPtr const& inputSceneIndex, size_t memoryBudget)
+        : HdSingleInputFilteringSceneIndexBase(inputSceneIndex), _memoryBudget(memoryBudget) {}
+
+    void _PrimsAdded(HdSceneIndexBase const& sender, HdSceneIndexObserver::AddedPrimEntries const& entries) override {
+        // Re-added prims are read again when they are pulled.
+        for (HdSceneIndexObserver::AddedPrimEntry const& entry : entries) {
+            _Shard& shard = _shards[_GetShardIndex(entry.primPath)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const uint32_t slot = _Find(shard, entry.primPath);
+            if (slot != _invalid) {
+                _Drop(shard, slot);
+            }
+        }
+        HdSceneIndexObserver::DirtiedPrimEntries seeds;
+        for (HdSceneIndexObserver::AddedPrimEntry const& entry : entries) {
+            seeds.emplace_back(entry.primPath, HdDataSourceLocatorSet::UniversalSet());
+        }
+        HdSceneIndexObserver::DirtiedPrimEntries dirtied;
+        _CollectDependentsDirtied(seeds, &dirtied);
+
+        _SendPrimsAdded(entries);
+        if (!dirtied.empty()) {
+            _SendPrimsDirtied(dirtied);
+        }
+    }
+
+    void _PrimsRemoved(HdSceneIndexBase const& sender,
+                       HdSceneIndexObserver::RemovedPrimEntries const& entries) override {
+        // Dirty whatever depends on a removed prim.
+        HdSceneIndexObserver::DirtiedPrimEntries seeds;
+        for (_Shard& shard : _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (HdSceneIndexObserver::RemovedPrimEntry const& entry : entries) {
+                const auto range = shard.dependents.FindSubtreeRange(entry.primPath);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (it->second.numLive != 0) {
+                        seeds.emplace_back(it->first, HdDataSourceLocatorSet::UniversalSet());
+                    }
+                }
+            }
+        }
+        HdSceneIndexObserver::DirtiedPrimEntries dirtied;
+        _CollectDependentsDirtied(seeds, &dirtied);
+
+        // Then drop the records and edges of the removed prims.  The lists
+        // of prims depending on them stay, in case they are added back.
+        for (_Shard& shard : _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (HdSceneIndexObserver::RemovedPrimEntry const& entry : entries) {
+                const auto range = shard.entryIndices.FindSubtreeRange(entry.primPath);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (it->second.index != _invalid) {
+                        _Drop(shard, it->second.index, false);
+                    }
+                }
+                if (range.first != range.second) {
+                    shard.entryIndices.erase(range.first);
+                }
+            }
+        }
+
+        _SendPrimsRemoved(entries);
+        if (!dirtied.empty()) {
+            _SendPrimsDirtied(dirtied);
+        }
+    }
+
+    void _PrimsDirtied(HdSceneIndexBase const& sender,
+                       HdSceneIndexObserver::DirtiedPrimEntries const& entries) override {
+        static const HdDataSourceLocator dependenciesLocator = HdDependenciesSchema::GetDefaultLocator();
+        for (HdSceneIndexObserver::DirtiedPrimEntry const& entry : entries) {
+            if (!entry.dirtyLocators.Intersects(dependenciesLocator)) {
+                continue;
+            }
+            bool known = false;
+            {
+                _Shard& shard = _shards[_GetShardIndex(entry.primPath)];
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                known = _Find(shard, entry.primPath) != _invalid;
+            }
+            if (known) {
+                _Discover(entry.primPath, _GetInputSceneIndex()->GetPrim(entry.primPath), true);
+            }
+        }
+        HdSceneIndexObserver::DirtiedPrimEntries dirtied;
+        _CollectDependentsDirtied(entries, &dirtied);
+
+        _SendPrimsDirtied(entries);
+        if (!dirtied.empty()) {
+            _SendPrimsDirtied(dirtied);
+        }
+    }
+
+private:
+    static constexpr uint32_t _invalid = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t _numShards = 16;
+
+    struct _Dependency {
+        SdfPath dependedOnPrimPath;
+        HdDataSourceLocator dependedOnLocator;
+        HdDataSourceLocator affectedLocator;
+    };
+
+    enum _State : uint8_t { _Free, _Live, _Evicted };
+
+    struct _Entry {
+        SdfPath primPath;
+        // Empty once the entry is evicted.
+        std::vector<_Dependency> dependencies;
+        // The distinct prims the entry depends on, one reverse edge each.
+        SdfPathVector dependedOnPrimPaths;
+        size_t bytes = 0;
+        // Bumped when the slot is freed, which invalidates references to it
+        // from _DependentList.
+        uint32_t generation = 0;
+        _State state = _Free;
+        bool referenced = false;
+    };
+
+    // Slots of the live and evicted entries of a shard that depend on a
+    // prim.  Freed entries are only removed once they make up half of the
+    // list.
+    struct _DependentList {
+        std::vector<std::pair<uint32_t, uint32_t>> slots;
+        size_t numLive = 0;
+    };
+
+    // Table nodes are also created for the ancestors of the inserted paths.
+    struct _Slot {
+        uint32_t index = _invalid;
+    };
+
+    struct alignas(ARCH_CACHE_LINE_SIZE) _Shard {
+        mutable std::mutex mutex;
+        std::vector<_Entry> entries;
+        std::vector<uint32_t> freeSlots;
+        SdfPathTable<_Slot> entryIndices;
+        SdfPathTable<_DependentList> dependents;
+        uint32_t clockHand = 0;
+        Stats stats;
+    };
+
+    // Rough heap cost of a path table node, beyond its value.
+    static constexpr size_t _nodeOverhead = 4 * sizeof(void*);
+
+    // The tables of a shard hash the same paths, so the shard is picked from
+    // the high bits of the hash.
+    static size_t _GetShardIndex(SdfPath const& primPath) {
+        return (SdfPath::Hash()(primPath) >> (std::numeric_limits<size_t>::digits - 8)) % _numShards;
+    }
+
+    static uint32_t _Find(_Shard const& shard, SdfPath const& primPath) {
+        const auto it = shard.entryIndices.find(primPath);
+        return it == shard.entryIndices.end() ? _invalid : it->second.index;
+    }
+
+    static bool _IsCurrent(_Shard const& shard, std::pair<uint32_t, uint32_t> const& ref) {
+        _Entry const& entry = shard.entries[ref.first];
+        return entry.state != _Free && entry.generation == ref.second;
+    }
+
+    // Erases the node at it unless other paths of the table are below it.
+    template <class Table>
+    static void _EraseIfLeaf(Table& table, typename Table::iterator it) {
+        const auto range = table.FindSubtreeRange(it->first);
+        if (std::next(range.first) == range.second) {
+            table.erase(range.first);
+        }
+    }
+
+    // Returns false if the prim has no __dependencies.
+    static bool _ReadDependencies(SdfPath const& primPath,
+                                  HdSceneIndexPrim const& prim,
+                                  std::vector<_Dependency>* result) {
+        HdDependenciesSchema dependencies = HdDependenciesSchema::GetFromParent(prim.dataSource);
+        if (!dependencies) {
+            return false;
+        }
+        HdContainerDataSourceHandle const& container = dependencies.GetContainer();
+        for (TfToken const& name : container->GetNames()) {
+            HdDependencySchema dependency(HdContainerDataSource::Cast(container->Get(name)));
+            _Dependency record;
+            if (HdPathDataSourceHandle ds = dependency.GetDependedOnPrimPath()) {
+                record.dependedOnPrimPath = ds->GetTypedValue(0.0f);
+            }
+            if (record.dependedOnPrimPath.IsEmpty()) {
+                record.dependedOnPrimPath = primPath;
+            }
+            if (HdLocatorDataSourceHandle ds = dependency.GetDependedOnDataSourceLocator()) {
+                record.dependedOnLocator = ds->GetTypedValue(0.0f);
+            }
+            if (HdLocatorDataSourceHandle ds = dependency.GetAffectedDataSourceLocator()) {
+                record.affectedLocator = ds->GetTypedValue(0.0f);
+            }
+            result->push_back(std::move(record));
+        }
+        return true;
+    }
+
+    // Reads the dependencies of prim and records them, replacing the
+    // previous record or evicted edges of the prim if replace is set.
+    // Otherwise a record added meanwhile by another thread is kept.
+    void _Discover(SdfPath const& primPath, HdSceneIndexPrim const& prim, bool replace) const {
+        std::vector<_Dependency> dependencies;
+        const bool hasDependencies = _ReadDependencies(primPath, prim, &dependencies);
+        if (!hasDependencies && !replace) {
+            return;
+        }
+
+        const size_t shardIndex = _GetShardIndex(primPath);
+        _Shard& shard = _shards[shardIndex];
+        uint32_t slot = _invalid;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const uint32_t previous = _Find(shard, primPath);
+            if (previous != _invalid) {
+                if (!replace && shard.entries[previous].state == _Live) {
+                    shard.entries[previous].referenced = true;
+                    return;
+                }
+                _Drop(shard, previous);
+            }
+            if (!hasDependencies) {
+                return;
+            }
+            slot = _Insert(shard, primPath, std::move(dependencies));
+        }
+        _EvictToBudget(shardIndex, slot);
+    }
+
+    uint32_t _Insert(_Shard& shard, SdfPath const& primPath, std::vector<_Dependency> dependencies) const {
+        ++shard.stats.numDiscoveries;
+
+        uint32_t slot;
+        if (!shard.freeSlots.empty()) {
+            slot = shard.freeSlots.back();
+            shard.freeSlots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(shard.entries.size());
+            shard.entries.emplace_back();
+        }
+        _Entry& entry = shard.entries[slot];
+        entry.primPath = primPath;
+        entry.dependencies = std::move(dependencies);
+        entry.state = _Live;
+        entry.referenced = true;
+
+        for (_Dependency const& dependency : entry.dependencies) {
+            if (std::find(entry.dependedOnPrimPaths.begin(), entry.dependedOnPrimPaths.end(),
+                          dependency.dependedOnPrimPath) == entry.dependedOnPrimPaths.end()) {
+                entry.dependedOnPrimPaths.push_back(dependency.dependedOnPrimPath);
+            }
+        }
+        for (SdfPath const& dependedOnPrimPath : entry.dependedOnPrimPaths) {
+            _DependentList& list = shard.dependents[dependedOnPrimPath];
+            list.slots.emplace_back(slot, entry.generation);
+            ++list.numLive;
+        }
+
+        entry.bytes = _GetEdgeBytes(entry) + entry.dependencies.capacity() * sizeof(_Dependency);
+        shard.entryIndices[primPath].index = slot;
+        ++shard.stats.numEntries;
+        shard.stats.numBytes += entry.bytes;
+        _numBytes += entry.bytes;
+        return slot;
+    }
+
+    // Bytes an entry keeps once evicted.
+    static size_t _GetEdgeBytes(_Entry const& entry) {
+        return sizeof(_Entry) + sizeof(std::pair<const SdfPath, _Slot>) + _nodeOverhead +
+               entry.dependedOnPrimPaths.capacity() * (sizeof(SdfPath) + sizeof(std::pair<uint32_t, uint32_t>));
+    }
+
+    // Drops the record of a live entry, keeping its reverse edges.
+    void _Evict(_Shard& shard, uint32_t slot) const {
+        _Entry& entry = shard.entries[slot];
+        --shard.stats.numEntries;
+        shard.stats.numBytes -= entry.bytes;
+        _numBytes -= entry.bytes;
+
+        entry.dependencies = std::vector<_Dependency>();
+        entry.bytes = _GetEdgeBytes(entry);
+        entry.state = _Evicted;
+        entry.referenced = false;
+        ++shard.stats.numEvictedEntries;
+        shard.stats.numEvictedBytes += entry.bytes;
+        ++shard.stats.numEvictions;
+    }
+
+    // Frees the entry in slot, live or evicted.  Its node in entryIndices is
+    // erased too unless eraseNode is false, e.g. when the caller erases the
+    // whole subtree.
+    void _Drop(_Shard& shard, uint32_t slot, bool eraseNode = true) const {
+        _Entry& entry = shard.entries[slot];
+        for (SdfPath const& dependedOnPrimPath : entry.dependedOnPrimPaths) {
+            const auto it = shard.dependents.find(dependedOnPrimPath);
+            _DependentList& list = it->second;
+            if (--list.numLive == 0) {
+                list.slots = std::vector<std::pair<uint32_t, uint32_t>>();
+                _EraseIfLeaf(shard.dependents, it);
+            } else if (list.numLive * 2 < list.slots.size()) {
+                // The entry is still current here, so compact without it.
+                const std::pair<uint32_t, uint32_t> self(slot, entry.generation);
+                list.slots.erase(std::remove_if(list.slots.begin(), list.slots.end(),
+                                                [&](std::pair<uint32_t, uint32_t> const& ref) {
+                                                    return ref == self || !_IsCurrent(shard, ref);
+                                                }),
+                                 list.slots.end());
+            }
+        }
+
+        if (entry.state == _Live) {
+            --shard.stats.numEntries;
+            shard.stats.numBytes -= entry.bytes;
+            _numBytes -= entry.bytes;
+        } else {
+            --shard.stats.numEvictedEntries;
+            shard.stats.numEvictedBytes -= entry.bytes;
+        }
+        if (eraseNode) {
+            const auto it = shard.entryIndices.find(entry.primPath);
+            it->second.index = _invalid;
+            _EraseIfLeaf(shard.entryIndices, it);
+        }
+
+        entry.primPath = SdfPath();
+        entry.dependencies = std::vector<_Dependency>();
+        entry.dependedOnPrimPaths = SdfPathVector();
+        entry.bytes = 0;
+        ++entry.generation;
+        entry.state = _Free;
+        entry.referenced = false;
+        shard.freeSlots.push_back(slot);
+    }
+
+    // Runs the clock of each shard in turn, starting with firstShard, until
+    // the records fit the budget.  Never evicts keep from firstShard.  Only
+    // one shard is locked at a time.
+    void _EvictToBudget(size_t firstShard, uint32_t keep) const {
+        for (size_t i = 0; i != _numShards && _numBytes > _memoryBudget; ++i) {
+            _Shard& shard = _shards[(firstShard + i) % _numShards];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const uint32_t shardKeep = i == 0 ? keep : _invalid;
+            const size_t numSlots = shard.entries.size();
+            // Two turns of the clock clear every mark.
+            size_t remainingSteps = numSlots == 0 ? 0 : 2 * numSlots + 1;
+            while (_numBytes > _memoryBudget && remainingSteps-- != 0) {
+                if (shard.clockHand >= numSlots) {
+                    shard.clockHand = 0;
+                }
+                const uint32_t slot = shard.clockHand++;
+                _Entry& entry = shard.entries[slot];
+                if (entry.state != _Live || slot == shardKeep) {
+                    continue;
+                }
+                if (entry.referenced) {
+                    entry.referenced = false;
+                    continue;
+                }
+                _Evict(shard, slot);
+            }
+        }
+    }
+
+    // Returns true if one of locators has locator as a prefix.
+    static bool _Covers(HdDataSourceLocatorSet const& locators, HdDataSourceLocator const& locator) {
+        for (HdDataSourceLocator const& covering : locators) {
+            if (locator.HasPrefix(covering)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Appends the dirties forwarded from seeds to the prims known to depend
+    // on them, following dependencies transitively, one level at a time so
+    // that each shard is locked once per level.
+    void _CollectDependentsDirtied(HdSceneIndexObserver::DirtiedPrimEntries const& seeds,
+                                   HdSceneIndexObserver::DirtiedPrimEntries* dirtied) const {
+        std::unordered_map<SdfPath, HdDataSourceLocatorSet, SdfPath::Hash> visited;
+        std::vector<std::pair<SdfPath, HdDataSourceLocatorSet>> level;
+        for (HdSceneIndexObserver::DirtiedPrimEntry const& seed : seeds) {
+            visited[seed.primPath].insert(seed.dirtyLocators);
+            level.emplace_back(seed.primPath, seed.dirtyLocators);
+        }
+
+        std::vector<std::pair<SdfPath, HdDataSourceLocatorSet>> nextLevel;
+        while (!level.empty()) {
+            for (_Shard& shard : _shards) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                if (shard.dependents.empty()) {
+                    continue;
+                }
+                for (auto const& dirty : level) {
+                    const auto it = shard.dependents.find(dirty.first);
+                    if (it == shard.dependents.end()) {
+                        continue;
+                    }
+                    for (std::pair<uint32_t, uint32_t> const& ref : it->second.slots) {
+                        if (!_IsCurrent(shard, ref)) {
+                            continue;
+                        }
+                        _Entry& entry = shard.entries[ref.first];
+                        HdDataSourceLocatorSet affected;
+                        if (entry.state == _Evicted) {
+                            // Which locators are affected was evicted.
+                            affected = HdDataSourceLocatorSet::UniversalSet();
+                        } else {
+                            entry.referenced = true;
+                            for (_Dependency const& dependency : entry.dependencies) {
+                                if (dependency.dependedOnPrimPath == dirty.first &&
+                                    dirty.second.Intersects(dependency.dependedOnLocator)) {
+                                    affected.insert(dependency.affectedLocator);
+                                }
+                            }
+                        }
+                        HdDataSourceLocatorSet added;
+                        HdDataSourceLocatorSet& seen = visited[entry.primPath];
+                        for (HdDataSourceLocator const& locator : affected) {
+                            if (!_Covers(seen, locator)) {
+                                added.insert(locator);
+                            }
+                        }
+                        if (added.IsEmpty()) {
+                            continue;
+                        }
+                        seen.insert(added);
+                        dirtied->emplace_back(entry.primPath, added);
+                        nextLevel.emplace_back(entry.primPath, added);
+                    }
+                }
+            }
+            level.swap(nextLevel);
+            nextLevel.clear();
+        }
+    }
+
+    // Pulls update the shards, so each is guarded by its own mutex.
+    // Notices are sent without holding any, since observers may pull.
+    mutable std::array<_Shard, _numShards> _shards;
+    // Bytes of the records of all shards.
+    mutable std::atomic<size_t> _numBytes{0};
+    std::atomic<size_t> _memoryBudget;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_BOUNDED_DEPENDENCY_FORWARDING_SCENE_INDEX_H
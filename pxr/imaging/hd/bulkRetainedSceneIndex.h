@@ -0,0 +1,286 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_BULK_RETAINED_SCENE_INDEX_H
+#define PXR_IMAGING_HD_BULK_RETAINED_SCENE_INDEX_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/retainedSceneIndex.h"
+#include "pxr/imaging/hd/sceneIndex.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/base/work/sort.h"
+#include "pxr/base/work/threadLimits.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DECLARE_REF_PTRS(Hd_BulkRetainedSceneIndex);
+
+/// \class Hd_BulkRetainedSceneIndex
+///
+/// Retained scene index that is populated in bulk, in parallel.
+///
+/// HdRetainedSceneIndex inserts prims into an SdfPathTable one at a time.
+/// This scene index instead keeps its prims in a flat array sorted by
+/// SdfPath::FastLessThan, with each prim's children stored as a range of a
+/// second array, and rebuilds both from pre-partitioned entry batches using
+/// parallel copies and sorts.  Ancestors that were not added explicitly
+/// exist with an empty type and data source, as with HdRetainedSceneIndex,
+/// and every AddPrims call sends a single PrimsAdded notice.
+///
+/// Each AddPrims call costs time linear in the total number of prims, so
+/// this is meant for populating large scenes in few calls rather than for
+/// incremental edits.
+///
+class Hd_BulkRetainedSceneIndex : public HdSceneIndexBase {
+public:
+    using AddedPrimEntries = HdRetainedSceneIndex::AddedPrimEntries;
+
+    static Hd_BulkRetainedSceneIndexRefPtr New() { return TfCreateRefPtr(new Hd_BulkRetainedSceneIndex()); }
+
+    /// Adds the entries of all \p batches, which are copied in parallel.
+    /// As with HdRetainedSceneIndex::AddPrims, a later entry for an existing
+    /// path replaces it, where later means later in the same batch or in a
+    /// later batch.
+    void AddPrims(std::vector<AddedPrimEntries> const& batches) {
+        std::vector<size_t> offsets(batches.size() + 1, 0);
+        for (size_t b = 0; b != batches.size(); ++b) {
+            offsets[b + 1] = offsets[b] + batches[b].size();
+        }
+        if (offsets.back() == 0) {
+            return;
+        }
+
+        // Existing prims come first so that new entries replace them.
+        const size_t numExisting = _nodes.size();
+        std::vector<_Node> nodes(numExisting + offsets.back());
+        std::move(_nodes.begin(), _nodes.end(), nodes.begin());
+        WorkParallelForN(
+                batches.size(),
+                [&](size_t begin, size_t end) {
+                    for (size_t b = begin; b != end; ++b) {
+                        _Node* out = nodes.data() + numExisting + offsets[b];
+                        for (HdRetainedSceneIndex::AddedPrimEntry const& entry : batches[b]) {
+                            out->path = entry.primPath;
+                            out->primType = entry.primType;
+                            out->dataSource = entry.dataSource;
+                            ++out;
+                        }
+                    }
+                },
+                1);
+
+        _nodes = _SortUnique(std::move(nodes));
+        _AddMissingAncestors();
+        _BuildChildren();
+
+        if (_IsObserved()) {
+            HdSceneIndexObserver::AddedPrimEntries added;
+            added.reserve(offsets.back());
+            for (AddedPrimEntries const& batch : batches) {
+                for (HdRetainedSceneIndex::AddedPrimEntry const& entry : batch) {
+                    added.emplace_back(entry.primPath, entry.primType);
+                }
+            }
+            _SendPrimsAdded(added);
+        }
+    }
+
+    void DirtyPrims(HdSceneIndexObserver::DirtiedPrimEntries const& entries) { _SendPrimsDirtied(entries); }
+
+    /// Returns the number of prims, including implicitly added ancestors
+    /// and the absolute root.
+    size_t GetNumPrims() const { return _nodes.size(); }
+
+    HdSceneIndexPrim GetPrim(SdfPath const& primPath) const override {
+        const size_t i = _Find(_nodes, primPath);
+        return i == _npos ? HdSceneIndexPrim() : HdSceneIndexPrim{_nodes[i].primType, _nodes[i].dataSource};
+    }
+
+    SdfPathVector GetChildPrimPaths(SdfPath const& primPath) const override {
+        SdfPathVector result;
+        const size_t i = _Find(_nodes, primPath);
+        if (i != _npos) {
+            result.reserve(_nodes[i].childEnd - _nodes[i].childBegin);
+            for (size_t c = _nodes[i].childBegin; c != _nodes[i].childEnd; ++c) {
+                result.push_back(_nodes[_children[c].second].path);
+            }
+        }
+        return result;
+    }
+
+protected:
+    Hd_BulkRetainedSceneIndex() = default;
+
+private:
+    static constexpr size_t _npos = ~size_t(0);
+
+    struct _Node {
+        SdfPath path;
+        TfToken primType;
+        HdContainerDataSourceHandle dataSource;
+        // Range of _children.
+        size_t childBegin = 0;
+        size_t childEnd = 0;
+    };
+
+    static size_t _Find(std::vector<_Node> const& nodes, SdfPath const& path) {
+        const auto it = std::lower_bound(nodes.begin(), nodes.end(), path, [](_Node const& node, SdfPath const& p) {
+            return SdfPath::FastLessThan()(node.path, p);
+        });
+        return it != nodes.end() && it->path == path ? static_cast<size_t>(it - nodes.begin()) : _npos;
+    }
+
+    // Sorts nodes by path, keeping the last of several nodes with the same
+    // path.
+    static std::vector<_Node> _SortUnique(std::vector<_Node> nodes) {
+        // Sorting pointers keeps the sort cheap, and breaks ties by position.
+        std::vector<_Node*> order(nodes.size());
+        WorkParallelForN(order.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                order[i] = &nodes[i];
+            }
+        });
+        WorkParallelSort(&order, [](_Node const* a, _Node const* b) {
+            if (a->path != b->path) {
+                return SdfPath::FastLessThan()(a->path, b->path);
+            }
+            return a < b;
+        });
+
+        auto isKept = [&order](size_t i) {
+            return i + 1 == order.size() || order[i + 1]->path != order[i]->path;
+        };
+
+        // Count the kept nodes per chunk, then move them into place.
+        const size_t numChunks =
+                std::max<size_t>(1, std::min<size_t>(order.size() / 4096, WorkGetConcurrencyLimit() * 4));
+        const size_t chunkSize = (order.size() + numChunks - 1) / numChunks;
+        std::vector<size_t> chunkOffsets(numChunks + 1, 0);
+        WorkParallelForN(
+                numChunks,
+                [&](size_t begin, size_t end) {
+                    for (size_t c = begin; c != end; ++c) {
+                        for (size_t i = c * chunkSize; i < std::min(order.size(), (c + 1) * chunkSize); ++i) {
+                            chunkOffsets[c + 1] += isKept(i);
+                        }
+                    }
+                },
+                1);
+        for (size_t c = 0; c != numChunks; ++c) {
+            chunkOffsets[c + 1] += chunkOffsets[c];
+        }
+
+        std::vector<_Node> result(chunkOffsets.back());
+        WorkParallelForN(
+                numChunks,
+                [&](size_t begin, size_t end) {
+                    for (size_t c = begin; c != end; ++c) {
+                        _Node* out = result.data() + chunkOffsets[c];
+                        for (size_t i = c * chunkSize; i < std::min(order.size(), (c + 1) * chunkSize); ++i) {
+                            if (isKept(i)) {
+                                *out++ = std::move(*order[i]);
+                            }
+                        }
+                    }
+                },
+                1);
+        return result;
+    }
+
+    // Adds a node without a type or data source for every ancestor that is
+    // missing, up to the absolute root.  Each pass only needs to look at the
+    // nodes added by the previous one.
+    void _AddMissingAncestors() {
+        std::vector<_Node> added;
+        for (bool first = true;; first = false) {
+            tbb::enumerable_thread_specific<SdfPathVector> missing;
+            auto check = [&](SdfPath const& path) {
+                const SdfPath parent = path.GetParentPath();
+                if (!parent.IsEmpty() && _Find(_nodes, parent) == _npos) {
+                    missing.local().push_back(parent);
+                }
+            };
+            if (first) {
+                WorkParallelForN(_nodes.size(), [&](size_t b, size_t e) {
+                    for (size_t i = b; i != e; ++i) {
+                        check(_nodes[i].path);
+                    }
+                });
+            } else {
+                WorkParallelForN(added.size(), [&](size_t b, size_t e) {
+                    for (size_t i = b; i != e; ++i) {
+                        check(added[i].path);
+                    }
+                });
+            }
+
+            SdfPathVector parents;
+            for (SdfPathVector const& local : missing) {
+                parents.insert(parents.end(), local.begin(), local.end());
+            }
+            if (parents.empty()) {
+                return;
+            }
+            WorkParallelSort(&parents, SdfPath::FastLessThan());
+            parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+
+            added.assign(parents.size(), _Node());
+            for (size_t i = 0; i != parents.size(); ++i) {
+                added[i].path = parents[i];
+            }
+            const size_t mid = _nodes.size();
+            _nodes.insert(_nodes.end(), added.begin(), added.end());
+            std::inplace_merge(_nodes.begin(), _nodes.begin() + mid, _nodes.end(), [](_Node const& a, _Node const& b) {
+                return SdfPath::FastLessThan()(a.path, b.path);
+            });
+        }
+    }
+
+    // Groups (parent, child) index pairs by parent, so that each node's
+    // children are a range of _children.
+    void _BuildChildren() {
+        _children.assign(_nodes.size(), {_npos, _npos});
+        WorkParallelForN(_nodes.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                _nodes[i].childBegin = _nodes[i].childEnd = 0;
+                const SdfPath parent = _nodes[i].path.GetParentPath();
+                _children[i] = {parent.IsEmpty() ? _npos : _Find(_nodes, parent), i};
+            }
+        });
+        // The absolute root has no parent and sorts last.
+        WorkParallelSort(&_children);
+        while (!_children.empty() && _children.back().first == _npos) {
+            _children.pop_back();
+        }
+
+        WorkParallelForN(_children.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                const size_t parent = _children[i].first;
+                if (i == 0 || _children[i - 1].first != parent) {
+                    _nodes[parent].childBegin = i;
+                }
+                if (i + 1 == _children.size() || _children[i + 1].first != parent) {
+                    _nodes[parent].childEnd = i + 1;
+                }
+            }
+        });
+    }
+
+    std::vector<_Node> _nodes;
+    // (parent index, child index), sorted.
+    std::vector<std::pair<size_t, size_t>> _children;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_BULK_RETAINED_SCENE_INDEX_H
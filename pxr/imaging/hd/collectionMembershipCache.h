@@ -0,0 +1,314 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_COLLECTION_MEMBERSHIP_CACHE_H
+#define PXR_IMAGING_HD_COLLECTION_MEMBERSHIP_CACHE_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/dataSourceLocator.h"
+#include "pxr/imaging/hd/materialBindingsSchema.h"
+#include "pxr/imaging/hd/primvarsSchema.h"
+#include "pxr/imaging/hd/purposeSchema.h"
+#include "pxr/imaging/hd/sceneIndexObserver.h"
+#include "pxr/imaging/hd/visibilitySchema.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/usd/sdf/path.h"
+#include "compiledCollectionExpressionEvaluator.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_CollectionMembershipCache
+///
+/// Keeps the members of a collection up to date as its scene index
+/// changes.
+///
+/// HdCollectionExpressionEvaluator::PopulateAllMatches computes membership
+/// from scratch, so a client that wants to track a collection has to
+/// traverse the whole scene after every edit.  This cache computes the
+/// members once and then observes the scene index: added prims are matched
+/// again, removed subtrees leave the collection, and dirtied prims are only
+/// matched again if their dirty locators intersect the locators that the
+/// expression's predicates read, e.g. visibility for hdVisible.  Prim type
+/// only changes through PrimsAdded, so hdType never needs dirty notices.
+///
+/// Predicates are assumed to read only the prim they are called on.  When a
+/// predicate applies to a path component other than the last one, e.g.
+/// "/World{hdVisible}//Lights", an edit to a prim can change the membership
+/// of its descendants and the whole subtree is matched again.  Predicates
+/// the cache does not know about depend on every locator unless their
+/// dependencies are given to the constructor.
+///
+/// The paths that entered or left the collection accumulate until
+/// TakeDelta() is called; a path that enters and leaves in between is in
+/// neither list.
+///
+class Hd_CollectionMembershipCache {
+public:
+    /// Locators read by predicates, by predicate name.
+    using PredicateDependencies = std::map<std::string, HdDataSourceLocatorSet>;
+
+    struct Delta {
+        SdfPathVector entered;
+        SdfPathVector left;
+    };
+
+    Hd_CollectionMembershipCache(HdSceneIndexBaseRefPtr const& sceneIndex,
+                                 SdfPathExpression const& expr,
+                                 HdCollectionPredicateLibrary const& predicateLib = HdGetCollectionPredicateLibrary(),
+                                 PredicateDependencies const& predicateDependencies = {})
+        : _eval(sceneIndex, expr, predicateLib), _observer(this) {
+        if (_eval.IsEmpty()) {
+            return;
+        }
+        _ComputeDependencies(expr, predicateDependencies);
+
+        SdfPathVector members;
+        _eval.PopulateAllMatches(SdfPath::AbsoluteRootPath(), &members, &_numEvaluated);
+        _members.insert(members.begin(), members.end());
+
+        sceneIndex->AddObserver(HdSceneIndexObserverPtr(&_observer));
+    }
+
+    ~Hd_CollectionMembershipCache() {
+        if (!_eval.IsEmpty()) {
+            _eval.GetSceneIndex()->RemoveObserver(HdSceneIndexObserverPtr(&_observer));
+        }
+    }
+
+    Hd_CollectionMembershipCache(Hd_CollectionMembershipCache const&) = delete;
+    Hd_CollectionMembershipCache& operator=(Hd_CollectionMembershipCache const&) = delete;
+
+    SdfPathSet const& GetMembers() const { return _members; }
+
+    bool Contains(SdfPath const& path) const { return _members.count(path) != 0; }
+
+    /// Returns the locators whose dirtying makes the cache match a prim
+    /// again.
+    HdDataSourceLocatorSet const& GetDependencies() const { return _dependencies; }
+
+    /// Returns whether an edit to a prim can change the membership of its
+    /// descendants.
+    bool GetDependsOnAncestors() const { return _dependsOnAncestors; }
+
+    /// Returns the sorted paths that entered and left the collection since
+    /// the last call, and starts a new delta.
+    Delta TakeDelta() {
+        Delta delta;
+        delta.entered.assign(_entered.begin(), _entered.end());
+        delta.left.assign(_left.begin(), _left.end());
+        _entered.clear();
+        _left.clear();
+        return delta;
+    }
+
+    /// Returns the number of prims matched against the expression so far,
+    /// including the initial population.
+    size_t GetNumEvaluatedPrims() const { return _numEvaluated; }
+
+private:
+    class _Observer : public HdSceneIndexObserver {
+    public:
+        explicit _Observer(Hd_CollectionMembershipCache* owner) : _owner(owner) {}
+
+        void PrimsAdded(HdSceneIndexBase const& sender, AddedPrimEntries const& entries) override {
+            SdfPathVector paths;
+            paths.reserve(entries.size());
+            for (AddedPrimEntry const& entry : entries) {
+                paths.push_back(entry.primPath);
+            }
+            _owner->_Update(&paths);
+        }
+        void PrimsRemoved(HdSceneIndexBase const& sender, RemovedPrimEntries const& entries) override {
+            for (RemovedPrimEntry const& entry : entries) {
+                _owner->_RemoveSubtree(entry.primPath);
+            }
+        }
+        void PrimsDirtied(HdSceneIndexBase const& sender, DirtiedPrimEntries const& entries) override {
+            SdfPathVector paths;
+            for (DirtiedPrimEntry const& entry : entries) {
+                if (entry.dirtyLocators.Intersects(_owner->_dependencies)) {
+                    paths.push_back(entry.primPath);
+                }
+            }
+            _owner->_Update(&paths);
+        }
+        void PrimsRenamed(HdSceneIndexBase const& sender, RenamedPrimEntries const& entries) override {
+            ConvertPrimsRenamedToRemovedAndAdded(sender, entries, this);
+        }
+
+    private:
+        Hd_CollectionMembershipCache* const _owner;
+    };
+
+    // Locators read by the predicates of the hd predicate library.
+    static PredicateDependencies const& _GetLibraryDependencies() {
+        static const PredicateDependencies dependencies = [] {
+            PredicateDependencies result;
+            for (const char* name : {"hdType", "type"}) {
+                result[name] = HdDataSourceLocatorSet();
+            }
+            for (const char* name : {"hdVisible", "visible"}) {
+                result[name] = HdDataSourceLocatorSet{HdVisibilitySchema::GetDefaultLocator()};
+            }
+            for (const char* name : {"hdPurpose", "purpose"}) {
+                result[name] = HdDataSourceLocatorSet{HdPurposeSchema::GetDefaultLocator()};
+            }
+            for (const char* name : {"hdHasPrimvar", "hasPrimvar"}) {
+                result[name] = HdDataSourceLocatorSet{HdPrimvarsSchema::GetDefaultLocator()};
+            }
+            for (const char* name : {"hdHasMaterialBinding", "hasMaterialBinding"}) {
+                result[name] = HdDataSourceLocatorSet{HdMaterialBindingsSchema::GetDefaultLocator()};
+            }
+            return result;
+        }();
+        return dependencies;
+    }
+
+    // Returns the locators read by a call to a predicate.
+    static HdDataSourceLocatorSet _GetCallDependencies(SdfPredicateExpression::FnCall const& call,
+                                                       PredicateDependencies const& predicateDependencies) {
+        auto it = predicateDependencies.find(call.funcName);
+        if (it != predicateDependencies.end()) {
+            return it->second;
+        }
+        it = _GetLibraryDependencies().find(call.funcName);
+        if (it != _GetLibraryDependencies().end()) {
+            return it->second;
+        }
+        // hdHasDataSource takes the locator as a dot-separated string.
+        if ((call.funcName == "hdHasDataSource" || call.funcName == "hasDataSource") && !call.args.empty() &&
+            call.args[0].value.IsHolding<std::string>()) {
+            TfTokenVector elements;
+            for (std::string const& element : TfStringSplit(call.args[0].value.UncheckedGet<std::string>(), ".")) {
+                elements.emplace_back(element);
+            }
+            return HdDataSourceLocatorSet{HdDataSourceLocator(elements.size(), elements.data())};
+        }
+        return HdDataSourceLocatorSet::UniversalSet();
+    }
+
+    void _ComputeDependencies(SdfPathExpression const& expr, PredicateDependencies const& predicateDependencies) {
+        expr.Walk([](SdfPathExpression::Op, int) {},
+                  [this](SdfPathExpression::ExpressionReference const&) {
+                      _dependencies = HdDataSourceLocatorSet::UniversalSet();
+                      _dependsOnAncestors = true;
+                  },
+                  [this, &predicateDependencies](SdfPathExpression::PathPattern const& pattern) {
+                      std::vector<SdfPathPattern::Component> const& components = pattern.GetComponents();
+                      for (size_t i = 0; i != components.size(); ++i) {
+                          if (components[i].predicateIndex >= 0 && i + 1 != components.size()) {
+                              _dependsOnAncestors = true;
+                          }
+                      }
+                      for (SdfPredicateExpression const& predicate : pattern.GetPredicateExprs()) {
+                          predicate.Walk([](SdfPredicateExpression::Op, int) {},
+                                         [&](SdfPredicateExpression::FnCall const& call) {
+                                             _dependencies.insert(_GetCallDependencies(call, predicateDependencies));
+                                         });
+                      }
+                  });
+    }
+
+    // Matches paths again, or the subtrees at them if membership depends on
+    // ancestors.
+    void _Update(SdfPathVector* paths) {
+        if (paths->empty()) {
+            return;
+        }
+        if (_dependsOnAncestors) {
+            std::sort(paths->begin(), paths->end());
+            SdfPath lastRoot;
+            for (SdfPath const& path : *paths) {
+                if (lastRoot.IsEmpty() || !path.HasPrefix(lastRoot)) {
+                    _UpdateSubtree(path);
+                    lastRoot = path;
+                }
+            }
+            return;
+        }
+
+        std::vector<char> matches(paths->size());
+        WorkParallelForN(paths->size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                matches[i] = bool(_eval.Match((*paths)[i]));
+            }
+        });
+        _numEvaluated += paths->size();
+
+        for (size_t i = 0; i != paths->size(); ++i) {
+            if (matches[i]) {
+                _Enter((*paths)[i]);
+            } else {
+                const auto it = _members.find((*paths)[i]);
+                if (it != _members.end()) {
+                    _Leave(it);
+                }
+            }
+        }
+    }
+
+    void _UpdateSubtree(SdfPath const& root) {
+        SdfPathVector matches;
+        size_t numEvaluated = 0;
+        _eval.PopulateAllMatches(root, &matches, &numEvaluated);
+        _numEvaluated += numEvaluated;
+        std::sort(matches.begin(), matches.end());
+
+        auto it = _members.lower_bound(root);
+        for (SdfPath const& match : matches) {
+            while (it != _members.end() && *it < match) {
+                it = _Leave(it);
+            }
+            if (it != _members.end() && *it == match) {
+                ++it;
+            } else {
+                _Enter(match);
+            }
+        }
+        while (it != _members.end() && it->HasPrefix(root)) {
+            it = _Leave(it);
+        }
+    }
+
+    void _RemoveSubtree(SdfPath const& root) {
+        auto it = _members.lower_bound(root);
+        while (it != _members.end() && it->HasPrefix(root)) {
+            it = _Leave(it);
+        }
+    }
+
+    void _Enter(SdfPath const& path) {
+        if (_members.insert(path).second && !_left.erase(path)) {
+            _entered.insert(path);
+        }
+    }
+
+    SdfPathSet::iterator _Leave(SdfPathSet::iterator it) {
+        if (!_entered.erase(*it)) {
+            _left.insert(*it);
+        }
+        return _members.erase(it);
+    }
+
+    Hd_CompiledCollectionExpressionEvaluator _eval;
+    HdDataSourceLocatorSet _dependencies;
+    bool _dependsOnAncestors = false;
+    SdfPathSet _members;
+    SdfPathSet _entered;
+    SdfPathSet _left;
+    size_t _numEvaluated = 0;
+    _Observer _observer;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_COLLECTION_MEMBERSHIP_CACHE_H
@@ -0,0 +1,309 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_COMPILED_COLLECTION_EXPRESSION_EVALUATOR_H
+#define PXR_IMAGING_HD_COMPILED_COLLECTION_EXPRESSION_EVALUATOR_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/collectionExpressionEvaluator.h"
+#include "pxr/imaging/hd/collectionPredicateLibrary.h"
+#include "pxr/imaging/hd/sceneIndex.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/base/work/threadLimits.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/usd/sdf/pathExpression.h"
+#include "pxr/usd/sdf/pathExpressionEval.h"
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_CompiledCollectionExpressionEvaluator
+///
+/// Collection expression evaluator for large scenes.
+///
+/// HdCollectionExpressionEvaluator::PopulateMatches visits every prim under
+/// the root on one thread and matches each of them against the expression.
+/// This evaluator compiles the expression once, when it is constructed:
+/// besides the predicate program, it finds the literal path prefixes of the
+/// expression's patterns, which bound the namespace that can match at all.
+/// PopulateMatches then only traverses the subtrees at those prefixes, and
+/// matches them with incremental searchers, so a result that is constant
+/// over descendants either skips a whole subtree or matches it without
+/// evaluating the predicates of its prims.
+///
+/// The traversal expands the namespace breadth first, in parallel, until
+/// there are enough subtrees to keep all threads busy, and then matches
+/// each subtree depth first as a separate task.  The scene index must
+/// support concurrent reads.  Matches are returned in no particular order.
+///
+class Hd_CompiledCollectionExpressionEvaluator {
+public:
+    using MatchKind = HdCollectionExpressionEvaluator::MatchKind;
+
+    Hd_CompiledCollectionExpressionEvaluator() = default;
+
+    Hd_CompiledCollectionExpressionEvaluator(
+            HdSceneIndexBaseRefPtr const& sceneIndex,
+            SdfPathExpression const& expr,
+            HdCollectionPredicateLibrary const& predicateLib = HdGetCollectionPredicateLibrary())
+        : _sceneIndex(sceneIndex) {
+        if (!_sceneIndex || expr.IsEmpty()) {
+            return;
+        }
+        _eval = SdfMakePathExpressionEval(expr, predicateLib);
+        _roots = _ComputeRoots(expr);
+    }
+
+    bool IsEmpty() const { return !_sceneIndex || _eval.IsEmpty(); }
+
+    HdSceneIndexBaseRefPtr const& GetSceneIndex() const { return _sceneIndex; }
+
+    /// Returns the paths the traversal starts from: the outermost literal
+    /// prefixes of the expression's patterns, or the absolute root path if
+    /// the expression cannot be bounded that way.
+    SdfPathVector const& GetTraversalRoots() const { return _roots; }
+
+    SdfPredicateFunctionResult Match(SdfPath const& path) const {
+        if (IsEmpty()) {
+            return SdfPredicateFunctionResult::MakeConstant(false);
+        }
+        return _eval.Match(path, _PathToPrim{get_pointer(_sceneIndex)});
+    }
+
+    /// Appends the paths of all prims at or under \p rootPath that match
+    /// the expression to \p result.
+    void PopulateAllMatches(SdfPath const& rootPath,
+                            SdfPathVector* result,
+                            size_t* numEvaluatedPrims = nullptr) const {
+        PopulateMatches(rootPath, HdCollectionExpressionEvaluator::MatchAll, result, numEvaluatedPrims);
+    }
+
+    /// Appends the paths of the prims at or under \p rootPath selected by
+    /// \p matchKind, as HdCollectionExpressionEvaluator::PopulateMatches
+    /// does, to \p result.
+    ///
+    /// If \p numEvaluatedPrims is given, it is set to the number of prims
+    /// matched against the expression.  Prims in pruned subtrees, and
+    /// descendants of constant matches, are not counted.
+    void PopulateMatches(SdfPath const& rootPath,
+                         MatchKind matchKind,
+                         SdfPathVector* result,
+                         size_t* numEvaluatedPrims = nullptr) const {
+        if (numEvaluatedPrims) {
+            *numEvaluatedPrims = 0;
+        }
+        if (IsEmpty() || !result) {
+            return;
+        }
+
+        // Each thread collects its matches and counts its evaluations.
+        tbb::enumerable_thread_specific<_Local> locals;
+        std::vector<_Subtree> frontier;
+        for (SdfPath const& root : _GetTraversalRoots(rootPath)) {
+            _Subtree subtree{root, _MakeSearcher(root), false};
+            if (_Visit(root, matchKind, &subtree.searcher, &subtree.matchDescendants, &locals.local())) {
+                frontier.push_back(std::move(subtree));
+            }
+        }
+
+        // Expand the namespace a level at a time until there are enough
+        // subtrees for every thread.
+        const size_t minSubtrees = 8 * WorkGetConcurrencyLimit();
+        while (!frontier.empty() && frontier.size() < minSubtrees) {
+            tbb::enumerable_thread_specific<std::vector<_Subtree>> children;
+            WorkParallelForN(frontier.size(), [&](size_t begin, size_t end) {
+                std::vector<_Subtree>& localChildren = children.local();
+                _Local& local = locals.local();
+                for (size_t i = begin; i != end; ++i) {
+                    for (SdfPath const& childPath : _sceneIndex->GetChildPrimPaths(frontier[i].path)) {
+                        _Subtree child{childPath, frontier[i].searcher, frontier[i].matchDescendants};
+                        if (_Visit(childPath, matchKind, &child.searcher, &child.matchDescendants, &local)) {
+                            localChildren.push_back(std::move(child));
+                        }
+                    }
+                }
+            });
+            frontier.clear();
+            for (std::vector<_Subtree>& local : children) {
+                std::move(local.begin(), local.end(), std::back_inserter(frontier));
+            }
+        }
+
+        WorkParallelForN(
+                frontier.size(),
+                [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i != end; ++i) {
+                        _PopulateSubtree(&frontier[i], matchKind, &locals.local());
+                    }
+                },
+                1);
+
+        for (_Local const& local : locals) {
+            result->insert(result->end(), local.matches.begin(), local.matches.end());
+            if (numEvaluatedPrims) {
+                *numEvaluatedPrims += local.numEvaluated;
+            }
+        }
+    }
+
+private:
+    struct _PathToPrim {
+        HdSceneIndexBase const* sceneIndex;
+        HdSceneIndexPrim operator()(SdfPath const& path) const { return sceneIndex->GetPrim(path); }
+    };
+
+    using _Eval = SdfPathExpressionEval<HdSceneIndexPrim const&>;
+    using _Searcher = _Eval::IncrementalSearcher<_PathToPrim>;
+
+    // A prim whose children are still to be visited, with the searcher
+    // state after visiting it.
+    struct _Subtree {
+        SdfPath path;
+        _Searcher searcher;
+        // All descendants match without evaluating them.
+        bool matchDescendants;
+    };
+
+    // Results of one thread.
+    struct _Local {
+        SdfPathVector matches;
+        size_t numEvaluated = 0;
+    };
+
+    static SdfPathVector _ComputeRoots(SdfPathExpression const& expr) {
+        // Only unions keep every match under the prefix of some pattern;
+        // complements, differences and unresolved references do not.
+        bool bounded = expr.IsAbsolute();
+        SdfPathVector prefixes;
+        expr.Walk(
+                [&bounded](SdfPathExpression::Op op, int) {
+                    if (op == SdfPathExpression::Complement || op == SdfPathExpression::Intersection ||
+                        op == SdfPathExpression::Difference) {
+                        bounded = false;
+                    }
+                },
+                [&bounded](SdfPathExpression::ExpressionReference const&) { bounded = false; },
+                [&prefixes](SdfPathExpression::PathPattern const& pattern) {
+                    prefixes.push_back(pattern.GetPrefix());
+                });
+        if (!bounded || prefixes.empty()) {
+            return {SdfPath::AbsoluteRootPath()};
+        }
+
+        // Descendants sort right after their ancestors.
+        std::sort(prefixes.begin(), prefixes.end());
+        SdfPathVector roots;
+        for (SdfPath const& prefix : prefixes) {
+            if (!prefix.IsAbsolutePath()) {
+                return {SdfPath::AbsoluteRootPath()};
+            }
+            if (roots.empty() || !prefix.HasPrefix(roots.back())) {
+                roots.push_back(prefix);
+            }
+        }
+        return roots;
+    }
+
+    // Returns the traversal roots under rootPath that exist in the scene
+    // index.
+    SdfPathVector _GetTraversalRoots(SdfPath const& rootPath) const {
+        SdfPathVector roots;
+        for (SdfPath const& root : _roots) {
+            if (rootPath.HasPrefix(root)) {
+                return {rootPath};
+            }
+            if (root.HasPrefix(rootPath) && _Exists(rootPath, root)) {
+                roots.push_back(root);
+            }
+        }
+        return roots;
+    }
+
+    // Returns whether the scene index has a prim at path, given that it has
+    // one at ancestor.
+    bool _Exists(SdfPath const& ancestor, SdfPath const& path) const {
+        const SdfPathVector prefixes = path.GetPrefixes();
+        for (size_t i = ancestor.GetPathElementCount(); i != prefixes.size(); ++i) {
+            const SdfPath& parent = i == 0 ? SdfPath::AbsoluteRootPath() : prefixes[i - 1];
+            const SdfPathVector children = _sceneIndex->GetChildPrimPaths(parent);
+            if (std::find(children.begin(), children.end(), prefixes[i]) == children.end()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Returns a searcher that has seen the ancestors of root, so that
+    // patterns whose components match above root still apply below it.
+    _Searcher _MakeSearcher(SdfPath const& root) const {
+        _Searcher searcher = _eval.MakeIncrementalSearcher(_PathToPrim{get_pointer(_sceneIndex)});
+        for (SdfPath const& ancestor : root.GetParentPath().GetPrefixes()) {
+            searcher.Next(ancestor);
+        }
+        return searcher;
+    }
+
+    // Matches path, appending it to the local matches if selected, and
+    // returns whether its children need visiting.  The searcher must have
+    // seen path's ancestors in depth-first order.
+    bool _Visit(SdfPath const& path,
+                MatchKind matchKind,
+                _Searcher* searcher,
+                bool* matchDescendants,
+                _Local* local) const {
+        if (*matchDescendants) {
+            local->matches.push_back(path);
+            return true;
+        }
+
+        ++local->numEvaluated;
+        const SdfPredicateFunctionResult match = searcher->Next(path);
+        if (!match) {
+            // A constant miss prunes the subtree.
+            return !match.IsConstant();
+        }
+
+        local->matches.push_back(path);
+        if (matchKind == HdCollectionExpressionEvaluator::ShallowestMatches) {
+            return false;
+        }
+        *matchDescendants =
+                matchKind == HdCollectionExpressionEvaluator::ShallowestMatchesAndAllDescendants || match.IsConstant();
+        return true;
+    }
+
+    // Visits the descendants of subtree depth first, so that its searcher
+    // can carry its state from each prim to the next.
+    void _PopulateSubtree(_Subtree* subtree, MatchKind matchKind, _Local* local) const {
+        std::vector<std::pair<SdfPath, bool>> stack;
+        for (SdfPath const& childPath : _sceneIndex->GetChildPrimPaths(subtree->path)) {
+            stack.emplace_back(childPath, subtree->matchDescendants);
+        }
+        while (!stack.empty()) {
+            std::pair<SdfPath, bool> entry = std::move(stack.back());
+            stack.pop_back();
+            if (_Visit(entry.first, matchKind, &subtree->searcher, &entry.second, local)) {
+                for (SdfPath const& childPath : _sceneIndex->GetChildPrimPaths(entry.first)) {
+                    stack.emplace_back(childPath, entry.second);
+                }
+            }
+        }
+    }
+
+    HdSceneIndexBaseRefPtr _sceneIndex;
+    _Eval _eval;
+    SdfPathVector _roots;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_COMPILED_COLLECTION_EXPRESSION_EVALUATOR_H
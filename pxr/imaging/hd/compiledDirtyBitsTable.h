@@ -0,0 +1,155 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_COMPILED_DIRTY_BITS_TABLE_H
+#define PXR_IMAGING_HD_COMPILED_DIRTY_BITS_TABLE_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/dataSourceLocator.h"
+#include "pxr/imaging/hd/types.h"
+#include "pxr/base/tf/token.h"
+
+#include <initializer_list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_CompiledDirtyBitsTable
+///
+/// Locator to dirty bits mapping for a prim type, compiled into a lookup
+/// table.
+///
+/// Translators registered with HdDirtyBitsTranslator usually test every
+/// locator they know about against the dirty set, one Intersects call per
+/// entry.  This compiles the entries into a two-level table keyed by the
+/// first and second locator elements, where each level stores the union of
+/// the bits of all entries at or below it.  Translating a dirty locator is
+/// then at most two hash lookups; only entries with more than two elements
+/// are still compared one by one, and only against locators that share
+/// their first two elements.
+///
+class Hd_CompiledDirtyBitsTable {
+public:
+    using Entry = std::pair<HdDataSourceLocator, HdDirtyBits>;
+
+    Hd_CompiledDirtyBitsTable() = default;
+
+    Hd_CompiledDirtyBitsTable(std::initializer_list<Entry> entries)
+        : Hd_CompiledDirtyBitsTable(std::vector<Entry>(entries)) {}
+
+    explicit Hd_CompiledDirtyBitsTable(std::vector<Entry> entries) : _entries(std::move(entries)) {
+        for (Entry const& entry : _entries) {
+            HdDataSourceLocator const& locator = entry.first;
+            const HdDirtyBits bits = entry.second;
+            _allBits |= bits;
+
+            if (locator.IsEmpty()) {
+                _universalBits |= bits;
+                continue;
+            }
+            _FirstLevel& first = _firstLevels[locator.GetElement(0)];
+            first.bitsBelow |= bits;
+            if (locator.GetElementCount() == 1) {
+                first.bits |= bits;
+                continue;
+            }
+            _SecondLevel& second = first.secondLevels[locator.GetElement(1)];
+            second.bitsBelow |= bits;
+            if (locator.GetElementCount() == 2) {
+                second.bits |= bits;
+            } else {
+                second.deeperEntries.push_back(entry);
+            }
+        }
+    }
+
+    /// Returns the union of the bits of all entries.
+    HdDirtyBits GetAllBits() const { return _allBits; }
+
+    /// Returns the bits of all entries that intersect \p locator.
+    HdDirtyBits Translate(HdDataSourceLocator const& locator) const {
+        if (locator.IsEmpty()) {
+            return _allBits;
+        }
+        HdDirtyBits bits = _universalBits;
+
+        const auto firstIt = _firstLevels.find(locator.GetElement(0));
+        if (firstIt == _firstLevels.end()) {
+            return bits;
+        }
+        _FirstLevel const& first = firstIt->second;
+        if (locator.GetElementCount() == 1) {
+            return bits | first.bitsBelow;
+        }
+        bits |= first.bits;
+
+        const auto secondIt = first.secondLevels.find(locator.GetElement(1));
+        if (secondIt == first.secondLevels.end()) {
+            return bits;
+        }
+        _SecondLevel const& second = secondIt->second;
+        if (locator.GetElementCount() == 2) {
+            return bits | second.bitsBelow;
+        }
+        bits |= second.bits;
+
+        for (Entry const& entry : second.deeperEntries) {
+            if (locator.Intersects(entry.first)) {
+                bits |= entry.second;
+            }
+        }
+        return bits;
+    }
+
+    /// Returns the bits of all entries that intersect \p locators, stopping
+    /// early once every bit in the table is set.
+    HdDirtyBits Translate(HdDataSourceLocatorSet const& locators) const {
+        HdDirtyBits bits = 0;
+        for (HdDataSourceLocator const& locator : locators) {
+            bits |= Translate(locator);
+            if (bits == _allBits) {
+                break;
+            }
+        }
+        return bits;
+    }
+
+    /// Inserts the locators of all entries that share a bit with \p bits.
+    void ToLocatorSet(HdDirtyBits bits, HdDataSourceLocatorSet* locators) const {
+        for (Entry const& entry : _entries) {
+            if (bits & entry.second) {
+                locators->insert(entry.first);
+            }
+        }
+    }
+
+private:
+    struct _SecondLevel {
+        // Entries with exactly two elements.
+        HdDirtyBits bits = 0;
+        // All entries with these two elements as a prefix.
+        HdDirtyBits bitsBelow = 0;
+        std::vector<Entry> deeperEntries;
+    };
+
+    struct _FirstLevel {
+        HdDirtyBits bits = 0;
+        HdDirtyBits bitsBelow = 0;
+        std::unordered_map<TfToken, _SecondLevel, TfToken::HashFunctor> secondLevels;
+    };
+
+    std::vector<Entry> _entries;
+    HdDirtyBits _allBits = 0;
+    // Entries for the empty locator, which intersect everything.
+    HdDirtyBits _universalBits = 0;
+    std::unordered_map<TfToken, _FirstLevel, TfToken::HashFunctor> _firstLevels;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_COMPILED_DIRTY_BITS_TABLE_H
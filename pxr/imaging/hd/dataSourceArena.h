@@ -0,0 +1,195 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_DATA_SOURCE_ARENA_H
+#define PXR_IMAGING_HD_DATA_SOURCE_ARENA_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/retainedDataSource.h"
+#include "flatContainerDataSource.h"
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_DataSourceArena
+///
+/// Block allocator for the retained data sources of a scene index.
+///
+/// Populating a retained scene index with millions of prims makes one heap
+/// allocation per data source, and the allocator becomes the bottleneck
+/// once several threads build prims.  The arena hands out memory from
+/// large blocks owned by the allocating thread, so an allocation is a
+/// pointer bump and an uncontended atomic increment.
+///
+/// Each block counts its live allocations and is freed when the last one
+/// is released and the arena has moved past it, so data sources may
+/// outlive the arena, e.g. when held by downstream scene indices.  Memory
+/// is only reclaimed a whole block at a time, so an arena suits data that
+/// is created together and dropped together, like a retained scene.
+///
+class Hd_DataSourceArena {
+    struct alignas(std::max_align_t) _Block {
+        explicit _Block(size_t size) : cursor(reinterpret_cast<char*>(this) + sizeof(_Block)), end(cursor + size) {}
+
+        // Live allocations plus one while the block is current.
+        std::atomic<size_t> refCount{1};
+        char* cursor;
+        char* const end;
+    };
+
+    struct alignas(std::max_align_t) _Header {
+        _Block* block;
+    };
+
+public:
+    static constexpr size_t DefaultBlockSize = size_t(1) << 20;
+
+    /// Standard allocator that allocates from an arena, e.g. for
+    /// std::allocate_shared.  Deallocation does not need the arena.
+    template <class T>
+    struct Allocator {
+        using value_type = T;
+
+        explicit Allocator(Hd_DataSourceArena* arena_) : arena(arena_) {}
+
+        template <class U>
+        Allocator(Allocator<U> const& other) : arena(other.arena) {}
+
+        T* allocate(size_t n) {
+            static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+            return static_cast<T*>(arena->Allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, size_t) { Hd_DataSourceArena::Deallocate(p); }
+
+        template <class U>
+        bool operator==(Allocator<U> const& other) const {
+            return arena == other.arena;
+        }
+        template <class U>
+        bool operator!=(Allocator<U> const& other) const {
+            return arena != other.arena;
+        }
+
+        Hd_DataSourceArena* arena;
+    };
+
+    struct Stats {
+        size_t numAllocations = 0;
+        size_t numBlocks = 0;
+        size_t bytesAllocated = 0;
+        size_t bytesReserved = 0;
+    };
+
+    explicit Hd_DataSourceArena(size_t blockSize = DefaultBlockSize) : _blockSize(blockSize) {}
+
+    ~Hd_DataSourceArena() {
+        for (_ThreadState& state : _threads) {
+            if (state.block) {
+                _Release(state.block);
+            }
+        }
+    }
+
+    Hd_DataSourceArena(Hd_DataSourceArena const&) = delete;
+    Hd_DataSourceArena& operator=(Hd_DataSourceArena const&) = delete;
+
+    /// Returns \p size bytes aligned for any scalar type.
+    void* Allocate(size_t size) {
+        const size_t total = _AlignUp(sizeof(_Header) + size);
+        _ThreadState& state = _threads.local();
+        _Block* block = state.block;
+        if (!block || static_cast<size_t>(block->end - block->cursor) < total) {
+            if (block) {
+                _Release(block);
+            }
+            const size_t blockSize = std::max(_blockSize, total);
+            block = state.block = new (::operator new(sizeof(_Block) + blockSize)) _Block(blockSize);
+            ++state.stats.numBlocks;
+            state.stats.bytesReserved += sizeof(_Block) + blockSize;
+        }
+
+        char* p = block->cursor;
+        block->cursor += total;
+        block->refCount.fetch_add(1, std::memory_order_relaxed);
+        reinterpret_cast<_Header*>(p)->block = block;
+
+        ++state.stats.numAllocations;
+        state.stats.bytesAllocated += total;
+        return p + sizeof(_Header);
+    }
+
+    /// Releases memory returned by Allocate() on any arena.  May be called
+    /// after the arena is gone.
+    static void Deallocate(void* p) {
+        _Release(reinterpret_cast<_Header*>(static_cast<char*>(p) - sizeof(_Header))->block);
+    }
+
+    /// Returns a retained typed data source allocated in the arena.
+    template <class T>
+    typename HdRetainedTypedSampledDataSource<T>::Handle NewTyped(T const& value) {
+        if constexpr (std::is_same<T, bool>::value) {
+            // Shares the static true and false instances.
+            return HdRetainedTypedSampledDataSource<bool>::New(value);
+        } else {
+            using _DataSource = HdRetainedTypedSampledDataSource<T>;
+            return std::allocate_shared<_DataSource>(Allocator<_DataSource>(this), value);
+        }
+    }
+
+    /// Returns a flat container data source allocated in the arena.
+    Hd_FlatContainerDataSourceHandle NewContainer(size_t count,
+                                                  TfToken const* names,
+                                                  HdDataSourceBaseHandle const* values) {
+        return Hd_FlatContainerDataSource::New(count, names, values, Allocator<char>(this));
+    }
+
+    /// Returns the totals over all threads.  Must not be called while other
+    /// threads allocate from the arena for the first time.
+    Stats GetStats() const {
+        Stats total;
+        for (_ThreadState const& state : _threads) {
+            total.numAllocations += state.stats.numAllocations;
+            total.numBlocks += state.stats.numBlocks;
+            total.bytesAllocated += state.stats.bytesAllocated;
+            total.bytesReserved += state.stats.bytesReserved;
+        }
+        return total;
+    }
+
+private:
+    struct _ThreadState {
+        _Block* block = nullptr;
+        Stats stats;
+    };
+
+    static size_t _AlignUp(size_t size) {
+        constexpr size_t align = alignof(std::max_align_t);
+        return (size + align - 1) / align * align;
+    }
+
+    static void _Release(_Block* block) {
+        if (block->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            block->~_Block();
+            ::operator delete(block);
+        }
+    }
+
+    const size_t _blockSize;
+    tbb::enumerable_thread_specific<_ThreadState> _threads;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_DATA_SOURCE_ARENA_H
@@ -0,0 +1,207 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_EXT_COMPUTATION_SCHEDULE_H
+#define PXR_IMAGING_HD_EXT_COMPUTATION_SCHEDULE_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/extComputation.h"
+#include "pxr/imaging/hd/extComputationUtils.h"
+#include "pxr/base/tf/span.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_ExtComputationSchedule
+///
+/// Topological order of an ext computation dependency map, grouped into
+/// levels that can run in parallel.
+///
+/// HdExtComputationUtils::DependencySort only returns an order, and only
+/// reports that there is a cycle.  This schedule sorts the computations
+/// with Kahn's algorithm, in time linear in the number of computations and
+/// dependencies, one wavefront at a time: the computations of a level only
+/// depend on computations of earlier levels, so each level can run
+/// concurrently once the previous ones are done.  The number of levels is
+/// the length of the critical path, the longest chain of dependencies,
+/// which is also available.
+///
+/// Computations that only appear as dependencies are scheduled as if they
+/// had none.  If the map has a cycle, the schedule is invalid, only holds
+/// the computations that do not depend on the cycle, and reports one cycle.
+///
+class Hd_ExtComputationSchedule {
+public:
+    Hd_ExtComputationSchedule() = default;
+
+    explicit Hd_ExtComputationSchedule(HdExtComputationUtils::ComputationDependencyMap const& dependencies) {
+        // Number the computations and count the dependencies of each.
+        std::unordered_map<HdExtComputation const*, size_t> indices;
+        indices.reserve(dependencies.size());
+        std::vector<HdExtComputation const*> comps;
+        std::vector<size_t> numDependencies;
+        auto indexOf = [&](HdExtComputation const* comp) {
+            const auto inserted = indices.emplace(comp, comps.size());
+            if (inserted.second) {
+                comps.push_back(comp);
+                numDependencies.push_back(0);
+            }
+            return inserted.first->second;
+        };
+        for (auto const& entry : dependencies) {
+            const size_t index = indexOf(entry.first);
+            numDependencies[index] = entry.second.size();
+            for (HdExtComputation const* dependency : entry.second) {
+                indexOf(dependency);
+            }
+        }
+        const size_t numComps = comps.size();
+
+        // Dependents of each computation, as offsets into one array.
+        std::vector<size_t> dependentOffsets(numComps + 1, 0);
+        for (auto const& entry : dependencies) {
+            for (HdExtComputation const* dependency : entry.second) {
+                ++dependentOffsets[indices[dependency] + 1];
+            }
+        }
+        for (size_t i = 0; i != numComps; ++i) {
+            dependentOffsets[i + 1] += dependentOffsets[i];
+        }
+        std::vector<size_t> dependents(dependentOffsets.back());
+        {
+            std::vector<size_t> cursors(dependentOffsets.begin(), dependentOffsets.end() - 1);
+            for (auto const& entry : dependencies) {
+                const size_t index = indices[entry.first];
+                for (HdExtComputation const* dependency : entry.second) {
+                    dependents[cursors[indices[dependency]]++] = index;
+                }
+            }
+        }
+
+        // Release a level at a time.  A computation is released by the
+        // last of its dependencies to be scheduled, which is on the level
+        // right above it and so precedes it on a longest chain.
+        std::vector<size_t> order;
+        order.reserve(numComps);
+        for (size_t i = 0; i != numComps; ++i) {
+            if (numDependencies[i] == 0) {
+                order.push_back(i);
+            }
+        }
+        std::vector<size_t> predecessors(numComps, numComps);
+        size_t levelBegin = 0;
+        while (levelBegin != order.size()) {
+            const size_t levelEnd = order.size();
+            _levelOffsets.push_back(levelEnd);
+            for (size_t i = levelBegin; i != levelEnd; ++i) {
+                const size_t index = order[i];
+                for (size_t d = dependentOffsets[index]; d != dependentOffsets[index + 1]; ++d) {
+                    if (--numDependencies[dependents[d]] == 0) {
+                        predecessors[dependents[d]] = index;
+                        order.push_back(dependents[d]);
+                    }
+                }
+            }
+            levelBegin = levelEnd;
+        }
+
+        _sortedComps.reserve(order.size());
+        for (size_t index : order) {
+            _sortedComps.push_back(comps[index]);
+        }
+        if (!order.empty()) {
+            for (size_t index = order.back(); index != numComps; index = predecessors[index]) {
+                _criticalPath.push_back(comps[index]);
+            }
+            std::reverse(_criticalPath.begin(), _criticalPath.end());
+        }
+
+        if (order.size() != numComps) {
+            _FindCycle(dependencies, comps, indices, numDependencies);
+        }
+    }
+
+    /// Returns whether the dependencies have no cycle.
+    bool IsValid() const { return _cycle.empty(); }
+
+    /// Returns the computations in dependency order, level by level.
+    HdExtComputationConstPtrVector const& GetSortedComputations() const { return _sortedComps; }
+
+    size_t GetNumLevels() const { return _levelOffsets.size() - 1; }
+
+    /// Returns the computations of \p level, which only depend on
+    /// computations of earlier levels.
+    TfSpan<HdExtComputation const* const> GetLevel(size_t level) const {
+        return TfSpan<HdExtComputation const* const>(_sortedComps.data() + _levelOffsets[level],
+                                                     _levelOffsets[level + 1] - _levelOffsets[level]);
+    }
+
+    /// Returns a longest chain of dependencies, dependencies first.  Its
+    /// length is the number of levels.
+    HdExtComputationConstPtrVector const& GetCriticalPath() const { return _criticalPath; }
+
+    size_t GetCriticalPathLength() const { return _criticalPath.size(); }
+
+    /// Returns a cycle if the dependencies have one: each computation
+    /// depends on the next, and the last one on the first.
+    HdExtComputationConstPtrVector const& GetCycle() const { return _cycle; }
+
+    /// Returns the cycle as "A -> B -> ... -> A", or an empty string.
+    std::string GetCycleDescription() const {
+        std::string description;
+        for (HdExtComputation const* comp : _cycle) {
+            description += comp->GetId().GetString() + " -> ";
+        }
+        if (!_cycle.empty()) {
+            description += _cycle.front()->GetId().GetString();
+        }
+        return description;
+    }
+
+private:
+    // Follows unscheduled dependencies from an unscheduled computation until
+    // one repeats.  Every unscheduled computation has one.
+    void _FindCycle(HdExtComputationUtils::ComputationDependencyMap const& dependencies,
+                    std::vector<HdExtComputation const*> const& comps,
+                    std::unordered_map<HdExtComputation const*, size_t> const& indices,
+                    std::vector<size_t> const& numDependencies) {
+        size_t index = 0;
+        while (numDependencies[index] == 0) {
+            ++index;
+        }
+
+        std::vector<size_t> positions(comps.size(), comps.size());
+        std::vector<size_t> walk;
+        while (positions[index] == comps.size()) {
+            positions[index] = walk.size();
+            walk.push_back(index);
+            for (HdExtComputation const* dependency : dependencies.at(comps[index])) {
+                const size_t next = indices.at(dependency);
+                if (numDependencies[next] != 0) {
+                    index = next;
+                    break;
+                }
+            }
+        }
+        for (size_t i = positions[index]; i != walk.size(); ++i) {
+            _cycle.push_back(comps[walk[i]]);
+        }
+    }
+
+    HdExtComputationConstPtrVector _sortedComps;
+    // Offset of each level into _sortedComps, followed by their size.
+    std::vector<size_t> _levelOffsets = {0};
+    HdExtComputationConstPtrVector _criticalPath;
+    HdExtComputationConstPtrVector _cycle;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_EXT_COMPUTATION_SCHEDULE_H
@@ -0,0 +1,219 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_FLAT_CONTAINER_DATA_SOURCE_H
+#define PXR_IMAGING_HD_FLAT_CONTAINER_DATA_SOURCE_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/dataSource.h"
+#include "pxr/base/tf/token.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_FlatContainerDataSource
+///
+/// Retained container data source for prims with many children, e.g.
+/// primvars containers with dozens of entries.
+///
+/// The names are sorted by token pointer and stored contiguously, followed
+/// by the children in the same order, and both arrays live in the same
+/// allocation as the data source and its shared_ptr control block.  Get()
+/// binary searches the names down to a window of a few entries and scans
+/// that linearly, so a lookup touches one or two cache lines of names
+/// instead of hash buckets or tree nodes.
+///
+/// Instances are immutable and are made with a Builder or New().  The
+/// Builder takes an optional allocator, e.g. to place many small
+/// containers in an arena.
+///
+class Hd_FlatContainerDataSource : public HdContainerDataSource {
+    struct _Key {};
+    using _Entry = std::pair<TfToken, HdDataSourceBaseHandle>;
+
+public:
+    HD_DECLARE_DATASOURCE_ABSTRACT(Hd_FlatContainerDataSource);
+
+    /// Collects children and builds the data source.  Setting the same name
+    /// again replaces the earlier child.
+    class Builder {
+    public:
+        Builder& Reserve(size_t count) {
+            _entries.reserve(count);
+            return *this;
+        }
+
+        Builder& Set(TfToken const& name, HdDataSourceBaseHandle const& value) {
+            _entries.emplace_back(name, value);
+            return *this;
+        }
+
+        /// Builds the data source.  Its storage is allocated with a copy of
+        /// \p allocator, rebound to char.
+        template <class Allocator = std::allocator<char>>
+        Handle Build(Allocator const& allocator = Allocator()) {
+            // Stable, so that the last of several entries with the same name
+            // ends up last and wins.
+            std::stable_sort(_entries.begin(), _entries.end(), [](_Entry const& a, _Entry const& b) {
+                return TfTokenFastArbitraryLessThan()(a.first, b.first);
+            });
+            size_t numUnique = 0;
+            for (size_t i = 0; i != _entries.size(); ++i) {
+                if (i + 1 != _entries.size() && _entries[i + 1].first == _entries[i].first) {
+                    continue;
+                }
+                if (numUnique != i) {
+                    _entries[numUnique] = std::move(_entries[i]);
+                }
+                ++numUnique;
+            }
+            _entries.resize(numUnique);
+
+            char* trailing = nullptr;
+            const _TrailingAllocator<Hd_FlatContainerDataSource, Allocator> trailingAllocator(
+                    allocator, _GetTrailingSize(_entries.size()), &trailing);
+            Handle result = std::allocate_shared<Hd_FlatContainerDataSource>(trailingAllocator, _Key(), &trailing,
+                                                                             &_entries);
+            _entries.clear();
+            return result;
+        }
+
+    private:
+        std::vector<_Entry> _entries;
+    };
+
+    template <class Allocator = std::allocator<char>>
+    static Handle New(size_t count,
+                      TfToken const* names,
+                      HdDataSourceBaseHandle const* values,
+                      Allocator const& allocator = Allocator()) {
+        Builder builder;
+        builder.Reserve(count);
+        for (size_t i = 0; i != count; ++i) {
+            builder.Set(names[i], values[i]);
+        }
+        return builder.Build(allocator);
+    }
+
+    // Public for allocate_shared; use the Builder.
+    Hd_FlatContainerDataSource(_Key, char* const* trailing, std::vector<_Entry>* entries)
+        : _size(entries->size()),
+          _names(reinterpret_cast<TfToken*>(*trailing)),
+          _values(reinterpret_cast<HdDataSourceBaseHandle*>(*trailing + _GetValuesOffset(_size))) {
+        for (size_t i = 0; i != _size; ++i) {
+            new (&_names[i]) TfToken(std::move((*entries)[i].first));
+            new (&_values[i]) HdDataSourceBaseHandle(std::move((*entries)[i].second));
+        }
+    }
+
+    ~Hd_FlatContainerDataSource() override {
+        for (size_t i = 0; i != _size; ++i) {
+            _names[i].~TfToken();
+            _values[i].~HdDataSourceBaseHandle();
+        }
+    }
+
+    size_t GetSize() const { return _size; }
+
+    TfTokenVector GetNames() override { return TfTokenVector(_names, _names + _size); }
+
+    HdDataSourceBaseHandle Get(TfToken const& name) override {
+        // Narrow down the lower bound of name to [first, first + count] with
+        // a binary search, then scan that window.
+        const TfToken* first = _names;
+        size_t count = _size;
+        while (count > _linearScanSize) {
+            const size_t half = count / 2;
+            if (TfTokenFastArbitraryLessThan()(first[half], name)) {
+                first += half + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+        const TfToken* const last = std::min<const TfToken*>(first + count + 1, _names + _size);
+        for (const TfToken* it = first; it != last; ++it) {
+            if (*it == name) {
+                return _values[it - _names];
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    static constexpr size_t _linearScanSize = 8;
+
+    static size_t _GetValuesOffset(size_t count) {
+        static_assert(alignof(HdDataSourceBaseHandle) <= alignof(TfToken), "values must be aligned after the names");
+        return count * sizeof(TfToken);
+    }
+
+    static size_t _GetTrailingSize(size_t count) {
+        return _GetValuesOffset(count) + count * sizeof(HdDataSourceBaseHandle);
+    }
+
+    // Allocator for allocate_shared that over-allocates the control block
+    // by the size of the name and value arrays, and reports where they
+    // start through a pointer that is also passed to the constructor.  The
+    // copy kept in the control block only uses it for comparisons.
+    template <class T, class Upstream>
+    struct _TrailingAllocator {
+        using value_type = T;
+        using _CharAllocator = typename std::allocator_traits<Upstream>::template rebind_alloc<char>;
+
+        _TrailingAllocator(Upstream const& upstream_, size_t trailingSize_, char** trailing_)
+            : upstream(upstream_), trailingSize(trailingSize_), trailing(trailing_) {}
+
+        template <class U>
+        _TrailingAllocator(_TrailingAllocator<U, Upstream> const& other)
+            : upstream(other.upstream), trailingSize(other.trailingSize), trailing(other.trailing) {}
+
+        T* allocate(size_t n) {
+            const size_t offset = _AlignUp(n * sizeof(T));
+            char* p = _CharAllocator(upstream).allocate(offset + trailingSize);
+            *trailing = p + offset;
+            return reinterpret_cast<T*>(p);
+        }
+
+        void deallocate(T* p, size_t n) {
+            _CharAllocator(upstream).deallocate(reinterpret_cast<char*>(p), _AlignUp(n * sizeof(T)) + trailingSize);
+        }
+
+        template <class U>
+        bool operator==(_TrailingAllocator<U, Upstream> const& other) const {
+            return trailing == other.trailing && upstream == other.upstream;
+        }
+        template <class U>
+        bool operator!=(_TrailingAllocator<U, Upstream> const& other) const {
+            return !(*this == other);
+        }
+
+        static size_t _AlignUp(size_t size) {
+            constexpr size_t align = alignof(std::max_align_t);
+            return (size + align - 1) / align * align;
+        }
+
+        Upstream upstream;
+        size_t trailingSize;
+        char** trailing;
+    };
+
+    const size_t _size;
+    TfToken* const _names;
+    HdDataSourceBaseHandle* const _values;
+};
+
+HD_DECLARE_DATASOURCE_HANDLES(Hd_FlatContainerDataSource);
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_FLAT_CONTAINER_DATA_SOURCE_H
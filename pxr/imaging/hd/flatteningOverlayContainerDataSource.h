@@ -0,0 +1,208 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_FLATTENING_OVERLAY_CONTAINER_DATA_SOURCE_H
+#define PXR_IMAGING_HD_FLATTENING_OVERLAY_CONTAINER_DATA_SOURCE_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/dataSource.h"
+#include "pxr/imaging/hd/dataSourceLocator.h"
+#include "pxr/base/tf/token.h"
+
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_FlatteningOverlayContainerDataSource
+///
+/// Overlays containers like HdOverlayContainerDataSource, but memoizes what
+/// it resolves.
+///
+/// HdOverlayContainerDataSource asks every layer on each GetNames and Get,
+/// and overlays child containers again on each Get, so reading a value
+/// through a stack of overlays costs one lookup per layer per level.  This
+/// data source computes the union of the names and each resolved child the
+/// first time they are asked for and returns them from then on.  Child
+/// containers that need overlaying are themselves flattening overlays, so
+/// deep reads pay for resolution once per node.
+///
+/// Memoized results do not see later changes to the layers.  Invalidate()
+/// drops what the given locators cover: names and children at the last
+/// element of each locator are resolved again, as are the names of any
+/// level where a locator names a child that was not there, and nested
+/// flattening overlays keep the rest of their results as long as their
+/// layers are still the same data sources.
+///
+/// As with HdOverlayContainerDataSource, stronger layers come first, a
+/// value that is not a container masks weaker layers, and null layers are
+/// ignored.  Reads and Invalidate() may be called from several threads.
+///
+class Hd_FlatteningOverlayContainerDataSource : public HdContainerDataSource {
+public:
+    HD_DECLARE_DATASOURCE(Hd_FlatteningOverlayContainerDataSource);
+
+    TfTokenVector GetNames() override {
+        size_t generation;
+        {
+            std::shared_lock<std::shared_mutex> lock(_mutex);
+            if (_hasNames) {
+                return _names;
+            }
+            generation = _generation;
+        }
+
+        TfTokenVector names;
+        std::unordered_set<TfToken, TfToken::HashFunctor> seen;
+        for (HdContainerDataSourceHandle const& layer : _layers) {
+            for (TfToken const& name : layer->GetNames()) {
+                if (seen.insert(name).second) {
+                    names.push_back(name);
+                }
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        // Results that raced with Invalidate() are returned but not kept.
+        if (generation == _generation) {
+            _names = names;
+            _hasNames = true;
+        }
+        return names;
+    }
+
+    HdDataSourceBaseHandle Get(TfToken const& name) override {
+        size_t generation;
+        {
+            std::shared_lock<std::shared_mutex> lock(_mutex);
+            const auto it = _children.find(name);
+            if (it != _children.end()) {
+                return it->second;
+            }
+            generation = _generation;
+        }
+
+        HdDataSourceBaseHandle child = _Resolve(name);
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        if (generation != _generation) {
+            return child;
+        }
+        // Another thread may have resolved it meanwhile; keep the first.
+        return _children.emplace(name, std::move(child)).first->second;
+    }
+
+    /// Drops the memoized names and children covered by \p locators.
+    void Invalidate(HdDataSourceLocatorSet const& locators) {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        ++_generation;
+        for (HdDataSourceLocator const& locator : locators) {
+            if (locator.IsEmpty()) {
+                _names.clear();
+                _hasNames = false;
+                _children.clear();
+                return;
+            }
+
+            const TfToken& name = locator.GetFirstElement();
+            // A locator below a child that is not among the names means the
+            // child appeared.
+            if (_hasNames && std::find(_names.begin(), _names.end(), name) == _names.end()) {
+                _names.clear();
+                _hasNames = false;
+            }
+            const auto it = _children.find(name);
+            if (locator.GetElementCount() == 1) {
+                // The child may have appeared or disappeared.
+                _hasNames = false;
+                if (it != _children.end()) {
+                    _children.erase(it);
+                }
+                continue;
+            }
+            if (it == _children.end()) {
+                continue;
+            }
+
+            // Keep a nested overlay whose layers did not change.
+            Handle nested = Cast(it->second);
+            std::vector<HdContainerDataSourceHandle> childLayers;
+            if (nested && !_CollectChildLayers(name, &childLayers) && nested->_layers == childLayers) {
+                nested->Invalidate(HdDataSourceLocatorSet{locator.RemoveFirstElement()});
+            } else {
+                _children.erase(it);
+            }
+        }
+    }
+
+    /// Returns the number of memoized children, including null ones.
+    size_t GetNumMemoizedChildren() const {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _children.size();
+    }
+
+private:
+    Hd_FlatteningOverlayContainerDataSource(size_t count, HdContainerDataSourceHandle const* containers) {
+        for (size_t i = 0; i != count; ++i) {
+            if (containers[i]) {
+                _layers.push_back(containers[i]);
+            }
+        }
+    }
+
+    explicit Hd_FlatteningOverlayContainerDataSource(std::vector<HdContainerDataSourceHandle> const& containers)
+        : Hd_FlatteningOverlayContainerDataSource(containers.size(), containers.data()) {}
+
+    // Collects the layers' children called name that are containers, up to
+    // the first child that is not.  Returns that child if it masks all of
+    // them.
+    HdDataSourceBaseHandle _CollectChildLayers(TfToken const& name,
+                                               std::vector<HdContainerDataSourceHandle>* childLayers) const {
+        for (HdContainerDataSourceHandle const& layer : _layers) {
+            HdDataSourceBaseHandle child = layer->Get(name);
+            if (!child) {
+                continue;
+            }
+            HdContainerDataSourceHandle container = HdContainerDataSource::Cast(child);
+            if (!container) {
+                return childLayers->empty() ? child : nullptr;
+            }
+            childLayers->push_back(std::move(container));
+        }
+        return nullptr;
+    }
+
+    HdDataSourceBaseHandle _Resolve(TfToken const& name) const {
+        std::vector<HdContainerDataSourceHandle> childLayers;
+        if (HdDataSourceBaseHandle value = _CollectChildLayers(name, &childLayers)) {
+            return value;
+        }
+        if (childLayers.empty()) {
+            return nullptr;
+        }
+        if (childLayers.size() == 1) {
+            return childLayers[0];
+        }
+        return New(childLayers);
+    }
+
+    std::vector<HdContainerDataSourceHandle> _layers;
+    mutable std::shared_mutex _mutex;
+    // Incremented by Invalidate().
+    size_t _generation = 0;
+    bool _hasNames = false;
+    TfTokenVector _names;
+    std::unordered_map<TfToken, HdDataSourceBaseHandle, TfToken::HashFunctor> _children;
+};
+
+HD_DECLARE_DATASOURCE_HANDLES(Hd_FlatteningOverlayContainerDataSource);
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_FLATTENING_OVERLAY_CONTAINER_DATA_SOURCE_H
@@ -0,0 +1,412 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_INDEXED_MERGING_SCENE_INDEX_H
+#define PXR_IMAGING_HD_INDEXED_MERGING_SCENE_INDEX_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/filteringSceneIndex.h"
+#include "pxr/imaging/hd/overlayContainerDataSource.h"
+#include "pxr/imaging/hd/sceneIndexObserver.h"
+#include "pxr/base/tf/smallVector.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DECLARE_REF_PTRS(Hd_IndexedMergingSceneIndex);
+
+/// \class Hd_IndexedMergingSceneIndex
+///
+/// Merging scene index that only queries the inputs that contribute to a
+/// path.
+///
+/// HdMergingSceneIndex answers GetPrim and GetChildPrimPaths by asking
+/// every input whose active root is above the path and overlaying the
+/// results, so each lookup costs one query per input even when most inputs
+/// only populate a small part of the namespace, e.g. per-layer procedurals.
+/// This scene index keeps an ownership index from every path up to a fixed
+/// namespace depth to the inputs that have prims at or below it, and only
+/// queries those.  Paths deeper than the index use the entry of their
+/// ancestor at the index depth.
+///
+/// The index is built by traversing each input down to the index depth
+/// when it is added, and grows with PrimsAdded notices.  Removals leave it
+/// as is, so it may list inputs that no longer contribute, which only costs
+/// a query.  RebuildOwnershipIndex() makes it exact again.
+///
+/// When at least SetParallelFanOutThreshold() inputs contribute to a path,
+/// they are queried in parallel.  That only pays off for inputs whose
+/// queries are expensive, so it is off by default.
+///
+/// As with HdMergingSceneIndex, stronger inputs are added first: the type
+/// of a prim comes from the first input that has one, and data sources are
+/// overlaid in input order.
+///
+class Hd_IndexedMergingSceneIndex : public HdFilteringSceneIndexBase {
+public:
+    static constexpr size_t DefaultIndexDepth = 2;
+
+    static Hd_IndexedMergingSceneIndexRefPtr New(size_t indexDepth = DefaultIndexDepth) {
+        return TfCreateRefPtr(new Hd_IndexedMergingSceneIndex(indexDepth));
+    }
+
+    ~Hd_IndexedMergingSceneIndex() override {
+        for (_InputEntry const& entry : _inputs) {
+            entry.sceneIndex->RemoveObserver(HdSceneIndexObserverPtr(&_observer));
+        }
+    }
+
+    /// Adds an input that is weaker than those added before.  Only prims at
+    /// or below \p activeInputSceneRoot are taken from it.
+    void AddInputScene(HdSceneIndexBaseRefPtr const& inputScene, SdfPath const& activeInputSceneRoot) {
+        if (!inputScene) {
+            return;
+        }
+        _inputs.push_back({inputScene, activeInputSceneRoot});
+        _IndexInput(static_cast<uint32_t>(_inputs.size() - 1));
+        inputScene->AddObserver(HdSceneIndexObserverPtr(&_observer));
+
+        if (_IsObserved()) {
+            HdSceneIndexObserver::AddedPrimEntries added;
+            for (SdfPath const& path : _CollectPaths(_inputs.back())) {
+                added.emplace_back(path, GetPrim(path).primType);
+            }
+            _SendPrimsAdded(added);
+        }
+    }
+
+    void RemoveInputScene(HdSceneIndexBaseRefPtr const& inputScene) {
+        const auto it = std::find_if(_inputs.begin(), _inputs.end(),
+                                     [&](_InputEntry const& entry) { return entry.sceneIndex == inputScene; });
+        if (it == _inputs.end()) {
+            return;
+        }
+        const _InputEntry removedEntry = *it;
+        removedEntry.sceneIndex->RemoveObserver(HdSceneIndexObserverPtr(&_observer));
+        _inputs.erase(it);
+        RebuildOwnershipIndex();
+
+        if (_IsObserved()) {
+            // Prims only the removed input had are removed, and the others
+            // are added again since their type or data source may change.
+            HdSceneIndexObserver::RemovedPrimEntries removed;
+            HdSceneIndexObserver::AddedPrimEntries added;
+            for (SdfPath const& path : _CollectPaths(removedEntry)) {
+                if (_HasPrim(path)) {
+                    added.emplace_back(path, GetPrim(path).primType);
+                } else if (removed.empty() || !path.HasPrefix(removed.back().primPath)) {
+                    removed.emplace_back(path);
+                }
+            }
+            if (!removed.empty()) {
+                _SendPrimsRemoved(removed);
+            }
+            if (!added.empty()) {
+                _SendPrimsAdded(added);
+            }
+        }
+    }
+
+    std::vector<HdSceneIndexBaseRefPtr> GetInputScenes() const override {
+        std::vector<HdSceneIndexBaseRefPtr> result;
+        result.reserve(_inputs.size());
+        for (_InputEntry const& entry : _inputs) {
+            result.push_back(entry.sceneIndex);
+        }
+        return result;
+    }
+
+    /// Queries contributing inputs in parallel once there are at least
+    /// \p threshold of them.
+    void SetParallelFanOutThreshold(size_t threshold) { _parallelFanOutThreshold = threshold; }
+
+    /// Rebuilds the ownership index from a traversal of every input.
+    void RebuildOwnershipIndex() {
+        _owners.clear();
+        for (uint32_t i = 0; i != _inputs.size(); ++i) {
+            _IndexInput(i);
+        }
+    }
+
+    /// Returns the number of inputs that are queried for \p primPath.
+    size_t GetNumContributingInputs(SdfPath const& primPath) const {
+        _InputIndices const* owners = _FindOwners(primPath);
+        return owners ? owners->size() : 0;
+    }
+
+    HdSceneIndexPrim GetPrim(SdfPath const& primPath) const override {
+        _InputIndices const* owners = _FindOwners(primPath);
+        if (!owners) {
+            return {};
+        }
+        _InputIndices contributing;
+        for (uint32_t i : *owners) {
+            if (primPath.HasPrefix(_inputs[i].sceneRoot)) {
+                contributing.push_back(i);
+            }
+        }
+        if (contributing.size() == 1) {
+            return _inputs[contributing[0]].sceneIndex->GetPrim(primPath);
+        }
+
+        TfSmallVector<HdSceneIndexPrim, 8> prims(contributing.size());
+        _ForEach(contributing.size(),
+                 [&](size_t c) { prims[c] = _inputs[contributing[c]].sceneIndex->GetPrim(primPath); });
+
+        HdSceneIndexPrim result;
+        TfSmallVector<HdContainerDataSourceHandle, 8> dataSources;
+        for (HdSceneIndexPrim const& prim : prims) {
+            if (result.primType.IsEmpty()) {
+                result.primType = prim.primType;
+            }
+            if (prim.dataSource) {
+                dataSources.push_back(prim.dataSource);
+            }
+        }
+        if (dataSources.size() == 1) {
+            result.dataSource = dataSources[0];
+        } else if (dataSources.size() > 1) {
+            result.dataSource = HdOverlayContainerDataSource::New(dataSources.size(), dataSources.data());
+        }
+        return result;
+    }
+
+    SdfPathVector GetChildPrimPaths(SdfPath const& primPath) const override {
+        _InputIndices const* owners = _FindOwners(primPath);
+        if (!owners) {
+            return {};
+        }
+        TfSmallVector<SdfPathVector, 8> children(owners->size());
+        _ForEach(owners->size(), [&](size_t c) {
+            _InputEntry const& entry = _inputs[(*owners)[c]];
+            if (primPath.HasPrefix(entry.sceneRoot)) {
+                children[c] = entry.sceneIndex->GetChildPrimPaths(primPath);
+            } else if (entry.sceneRoot.HasPrefix(primPath)) {
+                // The active root is below primPath, so only the path
+                // towards it is a child.
+                SdfPath child = entry.sceneRoot;
+                while (child.GetPathElementCount() > primPath.GetPathElementCount() + 1) {
+                    child = child.GetParentPath();
+                }
+                children[c].push_back(child);
+            }
+        });
+        if (children.size() == 1) {
+            return children[0];
+        }
+
+        SdfPathVector result;
+        std::unordered_set<SdfPath, SdfPath::Hash> seen;
+        for (SdfPathVector const& paths : children) {
+            for (SdfPath const& path : paths) {
+                if (seen.insert(path).second) {
+                    result.push_back(path);
+                }
+            }
+        }
+        return result;
+    }
+
+protected:
+    explicit Hd_IndexedMergingSceneIndex(size_t indexDepth) : _indexDepth(indexDepth), _observer(this) {}
+
+private:
+    using _InputIndices = TfSmallVector<uint32_t, 4>;
+
+    struct _InputEntry {
+        HdSceneIndexBaseRefPtr sceneIndex;
+        SdfPath sceneRoot;
+    };
+
+    class _Observer : public HdSceneIndexObserver {
+    public:
+        explicit _Observer(Hd_IndexedMergingSceneIndex* owner) : _owner(owner) {}
+
+        void PrimsAdded(HdSceneIndexBase const& sender, AddedPrimEntries const& entries) override {
+            _owner->_PrimsAdded(sender, entries);
+        }
+        void PrimsRemoved(HdSceneIndexBase const& sender, RemovedPrimEntries const& entries) override {
+            _owner->_PrimsRemoved(sender, entries);
+        }
+        void PrimsDirtied(HdSceneIndexBase const& sender, DirtiedPrimEntries const& entries) override {
+            _owner->_SendPrimsDirtied(entries);
+        }
+        void PrimsRenamed(HdSceneIndexBase const& sender, RenamedPrimEntries const& entries) override {
+            ConvertPrimsRenamedToRemovedAndAdded(sender, entries, this);
+        }
+
+    private:
+        Hd_IndexedMergingSceneIndex* const _owner;
+    };
+
+    // Returns the ancestor of path at the index depth, or path itself if it
+    // is not deeper.
+    SdfPath _GetIndexedPath(SdfPath path) const {
+        while (path.GetPathElementCount() > _indexDepth) {
+            path = path.GetParentPath();
+        }
+        return path;
+    }
+
+    _InputIndices const* _FindOwners(SdfPath const& primPath) const {
+        const auto it = _owners.find(_GetIndexedPath(primPath));
+        return it == _owners.end() ? nullptr : &it->second;
+    }
+
+    void _AddOwner(SdfPath const& path, uint32_t input) {
+        _InputIndices& owners = _owners[path];
+        const auto it = std::lower_bound(owners.begin(), owners.end(), input);
+        if (it == owners.end() || *it != input) {
+            owners.insert(it, input);
+        }
+    }
+
+    // Records the input as an owner of its active root, the ancestors of
+    // the root and the prims below it, down to the index depth.
+    void _IndexInput(uint32_t input) {
+        _InputEntry const& entry = _inputs[input];
+        for (SdfPath path = _GetIndexedPath(entry.sceneRoot); !path.IsEmpty(); path = path.GetParentPath()) {
+            _AddOwner(path, input);
+        }
+        if (entry.sceneRoot.GetPathElementCount() >= _indexDepth) {
+            return;
+        }
+        SdfPathVector queue = {entry.sceneRoot};
+        while (!queue.empty()) {
+            const SdfPath path = queue.back();
+            queue.pop_back();
+            for (SdfPath const& child : entry.sceneIndex->GetChildPrimPaths(path)) {
+                _AddOwner(child, input);
+                if (child.GetPathElementCount() < _indexDepth) {
+                    queue.push_back(child);
+                }
+            }
+        }
+    }
+
+    // Returns the paths of the prims the input contributes, starting with
+    // the ancestors of its active root, in depth-first order.
+    static SdfPathVector _CollectPaths(_InputEntry const& entry) {
+        SdfPathVector result = entry.sceneRoot.GetPrefixes();
+        if (!result.empty()) {
+            result.pop_back();
+        }
+        SdfPathVector queue = {entry.sceneRoot};
+        while (!queue.empty()) {
+            result.push_back(queue.back());
+            queue.pop_back();
+            SdfPathVector children = entry.sceneIndex->GetChildPrimPaths(result.back());
+            queue.insert(queue.end(), children.rbegin(), children.rend());
+        }
+        return result;
+    }
+
+    // Returns true if any input still has a prim at primPath.
+    bool _HasPrim(SdfPath const& primPath) const {
+        if (primPath.IsAbsoluteRootPath()) {
+            return true;
+        }
+        const SdfPathVector siblings = GetChildPrimPaths(primPath.GetParentPath());
+        return std::find(siblings.begin(), siblings.end(), primPath) != siblings.end();
+    }
+
+    uint32_t _FindInput(HdSceneIndexBase const& sender) const {
+        for (uint32_t i = 0; i != _inputs.size(); ++i) {
+            if (get_pointer(_inputs[i].sceneIndex) == &sender) {
+                return i;
+            }
+        }
+        return std::numeric_limits<uint32_t>::max();
+    }
+
+    template <class Fn>
+    void _ForEach(size_t count, Fn const& fn) const {
+        if (count >= _parallelFanOutThreshold) {
+            WorkParallelForN(
+                    count,
+                    [&fn](size_t begin, size_t end) {
+                        for (size_t i = begin; i != end; ++i) {
+                            fn(i);
+                        }
+                    },
+                    1);
+        } else {
+            for (size_t i = 0; i != count; ++i) {
+                fn(i);
+            }
+        }
+    }
+
+    void _PrimsAdded(HdSceneIndexBase const& sender, HdSceneIndexObserver::AddedPrimEntries const& entries) {
+        const uint32_t input = _FindInput(sender);
+        if (input < _inputs.size()) {
+            for (HdSceneIndexObserver::AddedPrimEntry const& entry : entries) {
+                for (SdfPath path = _GetIndexedPath(entry.primPath); !path.IsEmpty(); path = path.GetParentPath()) {
+                    _AddOwner(path, input);
+                }
+            }
+        }
+        if (_inputs.size() < 2) {
+            _SendPrimsAdded(entries);
+            return;
+        }
+        // Report the merged type, which may come from a stronger input.
+        HdSceneIndexObserver::AddedPrimEntries merged;
+        merged.reserve(entries.size());
+        for (HdSceneIndexObserver::AddedPrimEntry const& entry : entries) {
+            merged.emplace_back(entry.primPath, GetPrim(entry.primPath).primType);
+        }
+        _SendPrimsAdded(merged);
+    }
+
+    void _PrimsRemoved(HdSceneIndexBase const& sender, HdSceneIndexObserver::RemovedPrimEntries const& entries) {
+        if (_inputs.size() < 2) {
+            _SendPrimsRemoved(entries);
+            return;
+        }
+        // A prim another input still has is removed and added again with
+        // what remains of its subtree, so that prims only the sender had do
+        // not linger downstream.
+        _SendPrimsRemoved(entries);
+        HdSceneIndexObserver::AddedPrimEntries added;
+        for (HdSceneIndexObserver::RemovedPrimEntry const& entry : entries) {
+            if (!_HasPrim(entry.primPath)) {
+                continue;
+            }
+            SdfPathVector queue = {entry.primPath};
+            while (!queue.empty()) {
+                const SdfPath path = queue.back();
+                queue.pop_back();
+                added.emplace_back(path, GetPrim(path).primType);
+                const SdfPathVector children = GetChildPrimPaths(path);
+                queue.insert(queue.end(), children.begin(), children.end());
+            }
+        }
+        if (!added.empty()) {
+            _SendPrimsAdded(added);
+        }
+    }
+
+    const size_t _indexDepth;
+    size_t _parallelFanOutThreshold = std::numeric_limits<size_t>::max();
+    std::vector<_InputEntry> _inputs;
+    // Inputs with prims at or below each path up to the index depth,
+    // sorted.
+    std::unordered_map<SdfPath, _InputIndices, SdfPath::Hash> _owners;
+    _Observer _observer;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_INDEXED_MERGING_SCENE_INDEX_H
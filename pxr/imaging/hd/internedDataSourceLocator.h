@@ -0,0 +1,214 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_INTERNED_DATA_SOURCE_LOCATOR_H
+#define PXR_IMAGING_HD_INTERNED_DATA_SOURCE_LOCATOR_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/dataSourceLocator.h"
+#include "pxr/base/tf/token.h"
+
+#include <tbb/concurrent_unordered_map.h>
+
+#include <functional>
+#include <initializer_list>
+#include <unordered_set>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_InternedLocator
+///
+/// Hash-consed representation of an HdDataSourceLocator.
+///
+/// Every distinct locator is interned once as a node in a process-wide
+/// prefix trie, and an Hd_InternedLocator is a pointer to its node.
+/// Equality and hashing are pointer operations.  Each node also stores
+/// pointers to all of its ancestors indexed by depth, so HasPrefix and
+/// Intersects are a depth comparison plus one pointer comparison instead of
+/// an element-wise token compare.
+///
+/// Interning takes one lock-free lookup per element and only allocates the
+/// first time a locator is seen.  Interned nodes are never freed, as with
+/// TfToken, so this is meant for the bounded vocabulary of schema and
+/// primvar locators.
+///
+class Hd_InternedLocator {
+    struct _Node {
+        _Node(TfToken const& element_, _Node const* parent) : element(element_) {
+            if (parent) {
+                ancestors = parent->ancestors;
+            }
+            ancestors.push_back(this);
+        }
+
+        TfToken element;
+        // ancestors[d] is the ancestor at depth d; the last entry is the node
+        // itself and the first is the root.
+        std::vector<_Node const*> ancestors;
+        mutable tbb::concurrent_unordered_map<TfToken, _Node*, TfToken::HashFunctor> children;
+
+        size_t GetDepth() const { return ancestors.size() - 1; }
+    };
+
+public:
+    /// The empty locator.
+    Hd_InternedLocator() : _node(_GetRoot()) {}
+
+    explicit Hd_InternedLocator(HdDataSourceLocator const& locator) : _node(_GetRoot()) {
+        for (size_t i = 0; i != locator.GetElementCount(); ++i) {
+            _node = _GetChild(_node, locator.GetElement(i));
+        }
+    }
+
+    bool IsEmpty() const { return _node->GetDepth() == 0; }
+
+    size_t GetElementCount() const { return _node->GetDepth(); }
+
+    TfToken const& GetLastElement() const { return _node->element; }
+
+    Hd_InternedLocator GetParent() const {
+        return IsEmpty() ? *this : Hd_InternedLocator(_node->ancestors[_node->GetDepth() - 1]);
+    }
+
+    Hd_InternedLocator Append(TfToken const& element) const { return Hd_InternedLocator(_GetChild(_node, element)); }
+
+    /// Returns true if \p prefix is this locator or one of its ancestors.
+    bool HasPrefix(Hd_InternedLocator const& prefix) const {
+        const size_t depth = prefix._node->GetDepth();
+        return depth <= _node->GetDepth() && _node->ancestors[depth] == prefix._node;
+    }
+
+    /// Returns true if either locator is a prefix of the other.
+    bool Intersects(Hd_InternedLocator const& other) const { return HasPrefix(other) || other.HasPrefix(*this); }
+
+    /// Returns the equivalent HdDataSourceLocator.
+    HdDataSourceLocator GetLocator() const {
+        TfTokenVector elements;
+        elements.reserve(_node->GetDepth());
+        for (size_t d = 1; d < _node->ancestors.size(); ++d) {
+            elements.push_back(_node->ancestors[d]->element);
+        }
+        return {elements.size(), elements.data()};
+    }
+
+    bool operator==(Hd_InternedLocator const& rhs) const { return _node == rhs._node; }
+    bool operator!=(Hd_InternedLocator const& rhs) const { return _node != rhs._node; }
+
+    size_t Hash() const { return std::hash<_Node const*>()(_node); }
+
+    struct HashFunctor {
+        size_t operator()(Hd_InternedLocator const& locator) const { return locator.Hash(); }
+    };
+
+private:
+    explicit Hd_InternedLocator(_Node const* node) : _node(node) {}
+
+    static _Node* _GetRoot() {
+        static _Node* const root = new _Node(TfToken(), nullptr);
+        return root;
+    }
+
+    static _Node const* _GetChild(_Node const* parent, TfToken const& element) {
+        const auto it = parent->children.find(element);
+        if (it != parent->children.end()) {
+            return it->second;
+        }
+        // Another thread may intern the same child concurrently, in which
+        // case its node wins and ours is discarded.
+        _Node* node = new _Node(element, parent);
+        const auto result = parent->children.emplace(element, node);
+        if (!result.second) {
+            delete node;
+        }
+        return result.first->second;
+    }
+
+    _Node const* _node;
+};
+
+/// \class Hd_InternedLocatorSet
+///
+/// Set of interned locators with constant-time-per-level intersection
+/// tests.
+///
+/// Besides its members, the set keeps the closure of all their ancestors.
+/// A locator intersects the set if it is an ancestor of some member (it is
+/// in the closure) or if one of its own ancestors is a member, so
+/// Intersects costs at most one hash lookup per element of the queried
+/// locator, regardless of the size of the set.
+///
+class Hd_InternedLocatorSet {
+public:
+    Hd_InternedLocatorSet() = default;
+
+    Hd_InternedLocatorSet(std::initializer_list<Hd_InternedLocator> locators) {
+        for (Hd_InternedLocator const& locator : locators) {
+            insert(locator);
+        }
+    }
+
+    explicit Hd_InternedLocatorSet(HdDataSourceLocatorSet const& locators) {
+        for (HdDataSourceLocator const& locator : locators) {
+            insert(Hd_InternedLocator(locator));
+        }
+    }
+
+    void insert(Hd_InternedLocator const& locator) {
+        if (!_members.insert(locator).second) {
+            return;
+        }
+        // Stop at the first ancestor that is already in the closure, since
+        // its own ancestors are too.
+        Hd_InternedLocator l = locator;
+        while (_ancestors.insert(l).second && !l.IsEmpty()) {
+            l = l.GetParent();
+        }
+    }
+
+    bool IsEmpty() const { return _members.empty(); }
+
+    size_t GetSize() const { return _members.size(); }
+
+    bool Intersects(Hd_InternedLocator const& locator) const {
+        if (_members.empty()) {
+            return false;
+        }
+        if (_ancestors.count(locator)) {
+            return true;
+        }
+        for (Hd_InternedLocator l = locator.GetParent();; l = l.GetParent()) {
+            if (_members.count(l)) {
+                return true;
+            }
+            if (l.IsEmpty()) {
+                return false;
+            }
+        }
+    }
+
+    bool Intersects(Hd_InternedLocatorSet const& other) const {
+        Hd_InternedLocatorSet const& small = GetSize() < other.GetSize() ? *this : other;
+        Hd_InternedLocatorSet const& large = GetSize() < other.GetSize() ? other : *this;
+        for (Hd_InternedLocator const& locator : small._members) {
+            if (large.Intersects(locator)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    using _Set = std::unordered_set<Hd_InternedLocator, Hd_InternedLocator::HashFunctor>;
+
+    _Set _members;
+    // Members and all of their ancestors.
+    _Set _ancestors;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_INTERNED_DATA_SOURCE_LOCATOR_H
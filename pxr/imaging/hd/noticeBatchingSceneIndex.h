@@ -0,0 +1,339 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_NOTICE_BATCHING_SCENE_INDEX_H
+#define PXR_IMAGING_HD_NOTICE_BATCHING_SCENE_INDEX_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/filteringSceneIndex.h"
+#include "pxr/imaging/hd/sceneIndexObserver.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DECLARE_WEAK_AND_REF_PTRS(Hd_NoticeBatchingSceneIndex);
+
+/// \class Hd_SceneIndexNoticeBlock
+///
+/// Batches scene index notices for the lifetime of the block, in the spirit
+/// of SdfChangeBlock.
+///
+/// While a block is open on a thread, every Hd_NoticeBatchingSceneIndex
+/// that receives notices on that thread buffers them instead of forwarding
+/// them.  When the outermost block closes, each of those scene indices sends
+/// what it buffered as at most one PrimsRemoved, one PrimsAdded and one
+/// PrimsDirtied notice.  Blocks may be nested.
+///
+class Hd_SceneIndexNoticeBlock {
+public:
+    Hd_SceneIndexNoticeBlock() { ++_GetState().depth; }
+
+    ~Hd_SceneIndexNoticeBlock() {
+        _State& state = _GetState();
+        if (--state.depth != 0) {
+            return;
+        }
+        // Flushing may make a scene index pending again, e.g. through
+        // observers that open blocks of their own.
+        while (!state.pending.empty()) {
+            std::vector<Hd_NoticeBatchingSceneIndexPtr> pending;
+            pending.swap(state.pending);
+            for (Hd_NoticeBatchingSceneIndexPtr const& sceneIndex : pending) {
+                _Flush(sceneIndex);
+            }
+        }
+    }
+
+    Hd_SceneIndexNoticeBlock(Hd_SceneIndexNoticeBlock const&) = delete;
+    Hd_SceneIndexNoticeBlock& operator=(Hd_SceneIndexNoticeBlock const&) = delete;
+
+    /// Returns true if a block is open on the calling thread.
+    static bool IsOpen() { return _GetState().depth != 0; }
+
+private:
+    friend class Hd_NoticeBatchingSceneIndex;
+
+    struct _State {
+        size_t depth = 0;
+        // Scene indices with buffered notices, in the order they started
+        // buffering.
+        std::vector<Hd_NoticeBatchingSceneIndexPtr> pending;
+    };
+
+    static _State& _GetState() {
+        static thread_local _State state;
+        return state;
+    }
+
+    static void _Flush(Hd_NoticeBatchingSceneIndexPtr const& sceneIndex);
+};
+
+/// \class Hd_NoticeBatchingSceneIndex
+///
+/// Filtering scene index that coalesces the notices it receives while an
+/// Hd_SceneIndexNoticeBlock is open.
+///
+/// Placed near the input of a chain of filtering scene indices, it turns a
+/// burst of small notices, e.g. one DirtyPrims call per edited prim, into a
+/// single notice that each downstream filter and observer handles once.
+/// Buffered notices are deduplicated:
+///
+/// - Dirtied locators for the same prim are merged into one entry, and
+///   dirties of prims that are added in the same batch are dropped.
+/// - Adding a prim again replaces the type of its earlier entry.
+/// - Removing a prim drops the buffered adds and dirties at or below it,
+///   and removals below another removal are dropped.
+/// - Renames are converted to removals and additions, which is what most
+///   observers do with them anyway.
+///
+/// On flush, removals are sent before additions and additions before
+/// dirties, which preserves the meaning of any sequence of notices given
+/// the rules above.  Outside of a block, notices are forwarded unchanged.
+///
+/// As with other scene indices, notices for one instance must not be sent
+/// from several threads at once.
+///
+class Hd_NoticeBatchingSceneIndex : public HdSingleInputFilteringSceneIndexBase {
+public:
+    static Hd_NoticeBatchingSceneIndexRefPtr New(HdSceneIndexBaseRefPtr const& inputSceneIndex) {
+        return TfCreateRefPtr(new Hd_NoticeBatchingSceneIndex(inputSceneIndex));
+    }
+
+    HdSceneIndexPrim GetPrim(SdfPath const& primPath) const override {
+        return _GetInputSceneIndex()->GetPrim(primPath);
+    }
+
+    SdfPathVector GetChildPrimPaths(SdfPath const& primPath) const override {
+        return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+    }
+
+    bool HasPendingNotices() const { return !_removed.empty() || !_added.empty() || !_dirtied.empty(); }
+
+    /// Sends the buffered notices now, even if a block is open.
+    void Flush() {
+        HdSceneIndexObserver::RemovedPrimEntries removed = _TakeRemoved();
+        HdSceneIndexObserver::AddedPrimEntries added;
+        added.swap(_added);
+        HdSceneIndexObserver::DirtiedPrimEntries dirtied;
+        dirtied.swap(_dirtied);
+        _addedIndices.clear();
+        _dirtiedIndices.clear();
+
+        if (!removed.empty()) {
+            _SendPrimsRemoved(removed);
+        }
+        if (!added.empty()) {
+            _SendPrimsAdded(added);
+        }
+        if (!dirtied.empty()) {
+            _SendPrimsDirtied(dirtied);
+        }
+    }
+
+protected:
+    explicit Hd_NoticeBatchingSceneIndex(HdSceneIndexBaseRefPtr const& inputSceneIndex)
+        : HdSingleInputFilteringSceneIndexBase(inputSceneIndex) {}
+
+    void _PrimsAdded(HdSceneIndexBase const& sender, HdSceneIndexObserver::AddedPrimEntries const& entries) override {
+        if (!_BeginBuffering()) {
+            _SendPrimsAdded(entries);
+            return;
+        }
+        for (HdSceneIndexObserver::AddedPrimEntry const& entry : entries) {
+            _BufferAdded(entry);
+        }
+    }
+
+    void _PrimsRemoved(HdSceneIndexBase const& sender,
+                       HdSceneIndexObserver::RemovedPrimEntries const& entries) override {
+        if (!_BeginBuffering()) {
+            _SendPrimsRemoved(entries);
+            return;
+        }
+        _BufferRemoved(entries);
+    }
+
+    void _PrimsDirtied(HdSceneIndexBase const& sender,
+                       HdSceneIndexObserver::DirtiedPrimEntries const& entries) override {
+        if (!_BeginBuffering()) {
+            _SendPrimsDirtied(entries);
+            return;
+        }
+        for (HdSceneIndexObserver::DirtiedPrimEntry const& entry : entries) {
+            if (_addedIndices.count(entry.primPath)) {
+                continue;
+            }
+            const auto inserted = _dirtiedIndices.emplace(entry.primPath, _dirtied.size());
+            if (inserted.second) {
+                _dirtied.push_back(entry);
+            } else {
+                _dirtied[inserted.first->second].dirtyLocators.insert(entry.dirtyLocators);
+            }
+        }
+    }
+
+    void _PrimsRenamed(HdSceneIndexBase const& sender,
+                       HdSceneIndexObserver::RenamedPrimEntries const& entries) override {
+        if (!_BeginBuffering()) {
+            _SendPrimsRenamed(entries);
+            return;
+        }
+        HdSceneIndexObserver::RemovedPrimEntries removed;
+        removed.reserve(entries.size());
+        for (HdSceneIndexObserver::RenamedPrimEntry const& entry : entries) {
+            removed.emplace_back(entry.oldPrimPath);
+        }
+        _BufferRemoved(removed);
+
+        // The renamed subtrees are re-added as the sender sees them now.
+        for (HdSceneIndexObserver::RenamedPrimEntry const& entry : entries) {
+            SdfPathVector queue = {entry.newPrimPath};
+            while (!queue.empty()) {
+                const SdfPath path = queue.back();
+                queue.pop_back();
+                _BufferAdded(HdSceneIndexObserver::AddedPrimEntry(path, sender.GetPrim(path).primType));
+                const SdfPathVector childPaths = sender.GetChildPrimPaths(path);
+                queue.insert(queue.end(), childPaths.begin(), childPaths.end());
+            }
+        }
+    }
+
+private:
+    friend class Hd_SceneIndexNoticeBlock;
+
+    // Returns true if notices should be buffered.  Outside of a block,
+    // anything still buffered is sent first to keep notices in order.
+    bool _BeginBuffering() {
+        if (!Hd_SceneIndexNoticeBlock::IsOpen()) {
+            if (HasPendingNotices()) {
+                Flush();
+            }
+            return false;
+        }
+        if (!HasPendingNotices()) {
+            Hd_SceneIndexNoticeBlock::_GetState().pending.emplace_back(this);
+        }
+        return true;
+    }
+
+    void _BufferAdded(HdSceneIndexObserver::AddedPrimEntry const& entry) {
+        const auto inserted = _addedIndices.emplace(entry.primPath, _added.size());
+        if (inserted.second) {
+            _added.push_back(entry);
+        } else {
+            _added[inserted.first->second].primType = entry.primType;
+        }
+
+        // Observers pull everything about added prims anyway.
+        const auto dirtied = _dirtiedIndices.find(entry.primPath);
+        if (dirtied != _dirtiedIndices.end()) {
+            _dirtied[dirtied->second].dirtyLocators = HdDataSourceLocatorSet();
+            _dirtiedIndices.erase(dirtied);
+            _hasDroppedDirties = true;
+        }
+    }
+
+    // Drops buffered adds and dirties at or below any of entries, which
+    // walks every buffered entry once per call.  Removals are rare compared
+    // to dirties, so this is cheaper than keeping the buffers sorted.
+    void _BufferRemoved(HdSceneIndexObserver::RemovedPrimEntries const& entries) {
+        std::unordered_set<SdfPath, SdfPath::Hash> removedPaths;
+        for (HdSceneIndexObserver::RemovedPrimEntry const& entry : entries) {
+            removedPaths.insert(entry.primPath);
+            _removed.push_back(entry);
+        }
+        auto isRemoved = [&removedPaths](SdfPath path) {
+            for (; !path.IsEmpty(); path = path.GetParentPath()) {
+                if (removedPaths.count(path)) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        if (!_added.empty()) {
+            _added.erase(std::remove_if(_added.begin(), _added.end(),
+                                        [&](HdSceneIndexObserver::AddedPrimEntry const& entry) {
+                                            return isRemoved(entry.primPath);
+                                        }),
+                         _added.end());
+            _addedIndices.clear();
+            for (size_t i = 0; i != _added.size(); ++i) {
+                _addedIndices.emplace(_added[i].primPath, i);
+            }
+        }
+        if (!_dirtied.empty()) {
+            _CompactDirtied(isRemoved);
+        }
+    }
+
+    // Removes dirtied entries for which drop returns true, along with those
+    // already emptied by additions.
+    template <class Fn>
+    void _CompactDirtied(Fn const& drop) {
+        _dirtied.erase(std::remove_if(_dirtied.begin(), _dirtied.end(),
+                                      [&](HdSceneIndexObserver::DirtiedPrimEntry const& entry) {
+                                          return entry.dirtyLocators.IsEmpty() || drop(entry.primPath);
+                                      }),
+                       _dirtied.end());
+        _dirtiedIndices.clear();
+        for (size_t i = 0; i != _dirtied.size(); ++i) {
+            _dirtiedIndices.emplace(_dirtied[i].primPath, i);
+        }
+        _hasDroppedDirties = false;
+    }
+
+    // Returns the buffered removals sorted, without duplicates and without
+    // removals below other removals, and clears the buffer.
+    HdSceneIndexObserver::RemovedPrimEntries _TakeRemoved() {
+        if (_hasDroppedDirties) {
+            _CompactDirtied([](SdfPath const&) { return false; });
+        }
+        HdSceneIndexObserver::RemovedPrimEntries removed;
+        removed.swap(_removed);
+        if (removed.size() < 2) {
+            return removed;
+        }
+        // SdfPath's operator< sorts descendants right after their ancestors.
+        std::sort(removed.begin(), removed.end(),
+                  [](HdSceneIndexObserver::RemovedPrimEntry const& a, HdSceneIndexObserver::RemovedPrimEntry const& b) {
+                      return a.primPath < b.primPath;
+                  });
+        size_t numKept = 1;
+        for (size_t i = 1; i != removed.size(); ++i) {
+            if (!removed[i].primPath.HasPrefix(removed[numKept - 1].primPath)) {
+                removed[numKept++] = removed[i];
+            }
+        }
+        removed.erase(removed.begin() + numKept, removed.end());
+        return removed;
+    }
+
+    HdSceneIndexObserver::RemovedPrimEntries _removed;
+    HdSceneIndexObserver::AddedPrimEntries _added;
+    HdSceneIndexObserver::DirtiedPrimEntries _dirtied;
+    // Indices into _added and _dirtied.
+    std::unordered_map<SdfPath, size_t, SdfPath::Hash> _addedIndices;
+    std::unordered_map<SdfPath, size_t, SdfPath::Hash> _dirtiedIndices;
+    // Whether _dirtied has entries emptied by additions.
+    bool _hasDroppedDirties = false;
+};
+
+inline void Hd_SceneIndexNoticeBlock::_Flush(Hd_NoticeBatchingSceneIndexPtr const& sceneIndex) {
+    // The scene index may have been destroyed since it started buffering.
+    if (sceneIndex) {
+        sceneIndex->Flush();
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_NOTICE_BATCHING_SCENE_INDEX_H
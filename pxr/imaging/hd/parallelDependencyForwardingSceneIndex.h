@@ -0,0 +1,386 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_PARALLEL_DEPENDENCY_FORWARDING_SCENE_INDEX_H
+#define PXR_IMAGING_HD_PARALLEL_DEPENDENCY_FORWARDING_SCENE_INDEX_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/dependenciesSchema.h"
+#include "pxr/imaging/hd/dependencySchema.h"
+#include "pxr/imaging/hd/filteringSceneIndex.h"
+#include "pxr/imaging/hd/sceneIndexObserver.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/base/work/sort.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DECLARE_REF_PTRS(Hd_ParallelDependencyForwardingSceneIndex);
+
+/// \class Hd_ParallelDependencyForwardingSceneIndex
+///
+/// Dependency forwarding scene index whose dependency table is built up
+/// front, in parallel, rather than discovered as prims are pulled.
+///
+/// HdDependencyForwardingSceneIndex reads the __dependencies of a prim when
+/// it is first pulled and walks the dependency graph depth first on the
+/// notifying thread.  Populate() instead traverses the whole input one
+/// level of the namespace at a time, reads the dependencies of each level
+/// in parallel, and keeps every dependency as an edge in a flat table
+/// sorted by depended-on prim.  Later notices keep the table up to date:
+/// prims that are added or whose __dependencies are dirtied are read again,
+/// and removed prims stop contributing edges.  Those updates live in a
+/// small side table until the next Populate() folds them in.
+///
+/// Dirties are propagated breadth first.  All edges out of the prims dirtied
+/// at one level are matched in parallel, and the locators that reach each
+/// affected prim are merged before the next level.  A (prim, locator) pair
+/// that is already covered by a locator sent for that prim is not visited
+/// again, which is what terminates cycles like D->E->F->D after a single
+/// trip around them.
+///
+class Hd_ParallelDependencyForwardingSceneIndex : public HdSingleInputFilteringSceneIndexBase {
+public:
+    /// Counters for the last dirty propagation.
+    struct PropagationStats {
+        /// Number of breadth-first levels that dirtied prims.
+        size_t numLevels = 0;
+        /// Number of dirtied entries sent for dependent prims.
+        size_t numDirtied = 0;
+        /// Number of edges whose locator was already covered, e.g. by
+        /// going around a cycle.
+        size_t numRevisits = 0;
+    };
+
+    static Hd_ParallelDependencyForwardingSceneIndexRefPtr New(HdSceneIndexBaseRefPtr const& inputSceneIndex) {
+        return TfCreateRefPtr(new Hd_ParallelDependencyForwardingSceneIndex(inputSceneIndex));
+    }
+
+    HdSceneIndexPrim GetPrim(SdfPath const& primPath) const override {
+        return _GetInputSceneIndex()->GetPrim(primPath);
+    }
+
+    SdfPathVector GetChildPrimPaths(SdfPath const& primPath) const override {
+        return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+    }
+
+    /// Rebuilds the dependency table from a traversal of the input scene
+    /// index, which must be safe to read from several threads.
+    void Populate() {
+        tbb::enumerable_thread_specific<std::vector<_Edge>> edges;
+        SdfPathVector frontier = {SdfPath::AbsoluteRootPath()};
+        while (!frontier.empty()) {
+            tbb::enumerable_thread_specific<SdfPathVector> children;
+            WorkParallelForN(frontier.size(), [&](size_t begin, size_t end) {
+                HdSceneIndexBaseRefPtr const& input = _GetInputSceneIndex();
+                std::vector<_Edge>& localEdges = edges.local();
+                SdfPathVector& localChildren = children.local();
+                for (size_t i = begin; i != end; ++i) {
+                    _ReadDependencies(frontier[i], input->GetPrim(frontier[i]), &localEdges);
+                    const SdfPathVector childPaths = input->GetChildPrimPaths(frontier[i]);
+                    localChildren.insert(localChildren.end(), childPaths.begin(), childPaths.end());
+                }
+            });
+            frontier.clear();
+            for (SdfPathVector const& local : children) {
+                frontier.insert(frontier.end(), local.begin(), local.end());
+            }
+        }
+
+        _edges.clear();
+        for (std::vector<_Edge> const& local : edges) {
+            _edges.insert(_edges.end(), local.begin(), local.end());
+        }
+        // Sorting with operator< keeps the edges of a subtree contiguous.
+        WorkParallelSort(&_edges,
+                         [](_Edge const& a, _Edge const& b) { return a.dependedOnPrimPath < b.dependedOnPrimPath; });
+
+        _updatedEdges.clear();
+        _updatedDependedOnPaths.clear();
+        _updatedPrims.clear();
+        _removedPrims.clear();
+    }
+
+    /// Returns the number of dependencies in the table.
+    size_t GetNumDependencies() const {
+        size_t count = 0;
+        for (_Edge const& edge : _edges) {
+            count += !_IsStale(edge.affectedPrimPath);
+        }
+        for (auto const& entry : _updatedEdges) {
+            count += entry.second.size();
+        }
+        return count;
+    }
+
+    PropagationStats const& GetLastPropagationStats() const { return _stats; }
+
+protected:
+    explicit Hd_ParallelDependencyForwardingSceneIndex(HdSceneIndexBaseRefPtr const& inputSceneIndex)
+        : HdSingleInputFilteringSceneIndexBase(inputSceneIndex) {}
+
+    void _PrimsAdded(HdSceneIndexBase const& sender, HdSceneIndexObserver::AddedPrimEntries const& entries) override {
+        HdSceneIndexObserver::DirtiedPrimEntries seeds;
+        for (HdSceneIndexObserver::AddedPrimEntry const& entry : entries) {
+            _UpdatePrim(entry.primPath);
+            seeds.emplace_back(entry.primPath, HdDataSourceLocatorSet::UniversalSet());
+        }
+        _SendPrimsAdded(entries);
+        _SendDependentsDirtied(seeds);
+    }
+
+    void _PrimsRemoved(HdSceneIndexBase const& sender,
+                       HdSceneIndexObserver::RemovedPrimEntries const& entries) override {
+        // Everything that depends on a prim in the removed subtrees is
+        // dirtied, so collect those prims before dropping their edges.
+        std::unordered_set<SdfPath, SdfPath::Hash> dependedOn;
+        for (HdSceneIndexObserver::RemovedPrimEntry const& entry : entries) {
+            SdfPath const& root = entry.primPath;
+            auto it = std::lower_bound(_edges.begin(), _edges.end(), root,
+                                       [](_Edge const& edge, SdfPath const& p) { return edge.dependedOnPrimPath < p; });
+            for (; it != _edges.end() && it->dependedOnPrimPath.HasPrefix(root); ++it) {
+                dependedOn.insert(it->dependedOnPrimPath);
+            }
+            for (auto const& updated : _updatedEdges) {
+                if (updated.first.HasPrefix(root)) {
+                    dependedOn.insert(updated.first);
+                }
+            }
+            _RemoveUpdatedEdges([&root](SdfPath const& path) { return path.HasPrefix(root); });
+            _removedPrims.insert(root);
+        }
+
+        HdSceneIndexObserver::DirtiedPrimEntries seeds;
+        seeds.reserve(dependedOn.size());
+        for (SdfPath const& path : dependedOn) {
+            seeds.emplace_back(path, HdDataSourceLocatorSet::UniversalSet());
+        }
+        _SendPrimsRemoved(entries);
+        _SendDependentsDirtied(seeds);
+    }
+
+    void _PrimsDirtied(HdSceneIndexBase const& sender,
+                       HdSceneIndexObserver::DirtiedPrimEntries const& entries) override {
+        static const HdDataSourceLocator dependenciesLocator = HdDependenciesSchema::GetDefaultLocator();
+        for (HdSceneIndexObserver::DirtiedPrimEntry const& entry : entries) {
+            if (entry.dirtyLocators.Intersects(dependenciesLocator)) {
+                _UpdatePrim(entry.primPath);
+            }
+        }
+        _SendPrimsDirtied(entries);
+        _SendDependentsDirtied(entries);
+    }
+
+private:
+    struct _Edge {
+        SdfPath dependedOnPrimPath;
+        HdDataSourceLocator dependedOnLocator;
+        SdfPath affectedPrimPath;
+        HdDataSourceLocator affectedLocator;
+    };
+
+    static void _ReadDependencies(SdfPath const& primPath, HdSceneIndexPrim const& prim, std::vector<_Edge>* edges) {
+        HdDependenciesSchema dependencies = HdDependenciesSchema::GetFromParent(prim.dataSource);
+        if (!dependencies) {
+            return;
+        }
+        HdContainerDataSourceHandle const& container = dependencies.GetContainer();
+        for (TfToken const& name : container->GetNames()) {
+            HdDependencySchema dependency(HdContainerDataSource::Cast(container->Get(name)));
+            _Edge edge;
+            if (HdPathDataSourceHandle ds = dependency.GetDependedOnPrimPath()) {
+                edge.dependedOnPrimPath = ds->GetTypedValue(0.0f);
+            }
+            // An empty path refers to the prim itself.
+            if (edge.dependedOnPrimPath.IsEmpty()) {
+                edge.dependedOnPrimPath = primPath;
+            }
+            if (HdLocatorDataSourceHandle ds = dependency.GetDependedOnDataSourceLocator()) {
+                edge.dependedOnLocator = ds->GetTypedValue(0.0f);
+            }
+            if (HdLocatorDataSourceHandle ds = dependency.GetAffectedDataSourceLocator()) {
+                edge.affectedLocator = ds->GetTypedValue(0.0f);
+            }
+            edge.affectedPrimPath = primPath;
+            edges->push_back(std::move(edge));
+        }
+    }
+
+    // Returns true if the edges of the table for an affected prim are out
+    // of date.
+    bool _IsStale(SdfPath const& affectedPrimPath) const {
+        if (_updatedPrims.count(affectedPrimPath)) {
+            return true;
+        }
+        if (!_removedPrims.empty()) {
+            for (SdfPath path = affectedPrimPath; !path.IsEmpty(); path = path.GetParentPath()) {
+                if (_removedPrims.count(path)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Calls fn for every current edge out of dependedOnPrimPath.
+    template <class Fn>
+    void _ForEachEdge(SdfPath const& dependedOnPrimPath, Fn const& fn) const {
+        const auto range = std::equal_range(_edges.begin(), _edges.end(), dependedOnPrimPath, _EdgeLess());
+        const bool checkStale = !_updatedPrims.empty() || !_removedPrims.empty();
+        for (auto it = range.first; it != range.second; ++it) {
+            if (!checkStale || !_IsStale(it->affectedPrimPath)) {
+                fn(*it);
+            }
+        }
+        const auto updated = _updatedEdges.find(dependedOnPrimPath);
+        if (updated != _updatedEdges.end()) {
+            for (_Edge const& edge : updated->second) {
+                fn(edge);
+            }
+        }
+    }
+
+    struct _EdgeLess {
+        bool operator()(_Edge const& edge, SdfPath const& path) const { return edge.dependedOnPrimPath < path; }
+        bool operator()(SdfPath const& path, _Edge const& edge) const { return path < edge.dependedOnPrimPath; }
+    };
+
+    // Re-reads the dependencies of an added or changed prim into the side
+    // table.
+    void _UpdatePrim(SdfPath const& primPath) {
+        _RemoveUpdatedEdges([&primPath](SdfPath const& path) { return path == primPath; });
+        _updatedPrims.insert(primPath);
+
+        std::vector<_Edge> edges;
+        _ReadDependencies(primPath, _GetInputSceneIndex()->GetPrim(primPath), &edges);
+        SdfPathVector& dependedOnPaths = _updatedDependedOnPaths[primPath];
+        for (_Edge& edge : edges) {
+            dependedOnPaths.push_back(edge.dependedOnPrimPath);
+            _updatedEdges[edge.dependedOnPrimPath].push_back(std::move(edge));
+        }
+    }
+
+    // Drops the side table edges of every affected prim matching pred.
+    template <class Pred>
+    void _RemoveUpdatedEdges(Pred const& pred) {
+        for (auto it = _updatedDependedOnPaths.begin(); it != _updatedDependedOnPaths.end();) {
+            if (!pred(it->first)) {
+                ++it;
+                continue;
+            }
+            for (SdfPath const& dependedOnPrimPath : it->second) {
+                const auto edges = _updatedEdges.find(dependedOnPrimPath);
+                if (edges == _updatedEdges.end()) {
+                    continue;
+                }
+                std::vector<_Edge>& vec = edges->second;
+                vec.erase(std::remove_if(vec.begin(), vec.end(),
+                                         [&](_Edge const& edge) { return edge.affectedPrimPath == it->first; }),
+                          vec.end());
+                if (vec.empty()) {
+                    _updatedEdges.erase(edges);
+                }
+            }
+            it = _updatedDependedOnPaths.erase(it);
+        }
+    }
+
+    // Returns true if one of locators has locator as a prefix, i.e. a
+    // dirty of locator was already sent.
+    static bool _Covers(HdDataSourceLocatorSet const& locators, HdDataSourceLocator const& locator) {
+        for (HdDataSourceLocator const& covering : locators) {
+            if (locator.HasPrefix(covering)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void _SendDependentsDirtied(HdSceneIndexObserver::DirtiedPrimEntries const& seeds) {
+        _stats = PropagationStats();
+        if (seeds.empty() || (_edges.empty() && _updatedEdges.empty())) {
+            return;
+        }
+
+        std::unordered_map<SdfPath, HdDataSourceLocatorSet, SdfPath::Hash> visited;
+        for (HdSceneIndexObserver::DirtiedPrimEntry const& seed : seeds) {
+            visited[seed.primPath].insert(seed.dirtyLocators);
+        }
+
+        HdSceneIndexObserver::DirtiedPrimEntries dirtied;
+        HdSceneIndexObserver::DirtiedPrimEntries frontier = seeds;
+        while (!frontier.empty()) {
+            // Match the edges of this level in parallel.
+            using _Candidate = std::pair<SdfPath, HdDataSourceLocator>;
+            tbb::enumerable_thread_specific<std::vector<_Candidate>> candidates;
+            WorkParallelForN(frontier.size(), [&](size_t begin, size_t end) {
+                std::vector<_Candidate>& local = candidates.local();
+                for (size_t i = begin; i != end; ++i) {
+                    HdDataSourceLocatorSet const& locators = frontier[i].dirtyLocators;
+                    _ForEachEdge(frontier[i].primPath, [&](_Edge const& edge) {
+                        if (locators.Intersects(edge.dependedOnLocator)) {
+                            local.emplace_back(edge.affectedPrimPath, edge.affectedLocator);
+                        }
+                    });
+                }
+            });
+
+            // Merge them into one entry per prim, skipping what was sent.
+            std::unordered_map<SdfPath, size_t, SdfPath::Hash> nextIndices;
+            HdSceneIndexObserver::DirtiedPrimEntries next;
+            for (std::vector<_Candidate> const& local : candidates) {
+                for (_Candidate const& candidate : local) {
+                    HdDataSourceLocatorSet& seen = visited[candidate.first];
+                    if (_Covers(seen, candidate.second)) {
+                        ++_stats.numRevisits;
+                        continue;
+                    }
+                    seen.insert(candidate.second);
+                    const auto inserted = nextIndices.emplace(candidate.first, next.size());
+                    if (inserted.second) {
+                        next.emplace_back(candidate.first, HdDataSourceLocatorSet{candidate.second});
+                    } else {
+                        next[inserted.first->second].dirtyLocators.insert(candidate.second);
+                    }
+                }
+            }
+            if (!next.empty()) {
+                ++_stats.numLevels;
+                _stats.numDirtied += next.size();
+                dirtied.insert(dirtied.end(), next.begin(), next.end());
+            }
+            frontier.swap(next);
+        }
+
+        if (!dirtied.empty()) {
+            _SendPrimsDirtied(dirtied);
+        }
+    }
+
+    // Sorted by dependedOnPrimPath.
+    std::vector<_Edge> _edges;
+    // Edges of prims re-read since Populate(), by depended-on prim.
+    std::unordered_map<SdfPath, std::vector<_Edge>, SdfPath::Hash> _updatedEdges;
+    // Depended-on prims of the edges in _updatedEdges, by affected prim.
+    std::unordered_map<SdfPath, SdfPathVector, SdfPath::Hash> _updatedDependedOnPaths;
+    // Prims whose edges in _edges are out of date, and roots of removed
+    // subtrees whose edges in _edges are out of date.
+    std::unordered_set<SdfPath, SdfPath::Hash> _updatedPrims;
+    std::unordered_set<SdfPath, SdfPath::Hash> _removedPrims;
+    PropagationStats _stats;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_PARALLEL_DEPENDENCY_FORWARDING_SCENE_INDEX_H
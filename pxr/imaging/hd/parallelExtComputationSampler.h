@@ -0,0 +1,462 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_PARALLEL_EXT_COMPUTATION_SAMPLER_H
+#define PXR_IMAGING_HD_PARALLEL_EXT_COMPUTATION_SAMPLER_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/extComputation.h"
+#include "pxr/imaging/hd/extComputationContext.h"
+#include "pxr/imaging/hd/extComputationUtils.h"
+#include "pxr/imaging/hd/renderIndex.h"
+#include "pxr/imaging/hd/sceneDelegate.h"
+#include "pxr/imaging/hd/timeSampleArray.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/hash.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/base/work/withScopedParallelism.h"
+#include "extComputationSchedule.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_ParallelExtComputationSampler
+///
+/// Samples computed primvars like
+/// HdExtComputationUtils::SampleComputedPrimvarValues, running independent
+/// computations concurrently and memoizing their outputs.
+///
+/// HdExtComputationUtils invokes every computation of the sorted chain at
+/// each of its sample times, one after the other, and starts again for the
+/// next prim, so a computation shared by many prims, e.g. a rig feeding
+/// several deformers, runs once per prim and sample.  This sampler
+/// schedules the computations with Hd_ExtComputationSchedule and invokes
+/// each level of the schedule for all of its sample times in parallel.
+/// Outputs are memoized by computation and sample time, so later prims
+/// reuse them, and computations whose scene inputs have at most one sample
+/// and whose sources are themselves time invariant run only once for all
+/// sample times.
+///
+/// Sample times are chosen like HdExtComputationUtils does: a computation
+/// is sampled at the union of the sample times of its scene inputs and of
+/// its sources' outputs, truncated to maxSampleCount, and reads its
+/// sources' outputs resampled at those times.  The sampled values are the
+/// same as HdExtComputationUtils', except that an input reads the output of
+/// its source computation rather than the latest output with the same
+/// name.  Memoized values are kept until
+/// Clear(), so it must be called when the scene delegate's values change.
+/// The scene delegate's SampleExtComputationInput and InvokeExtComputation
+/// must be safe to call from several threads.  They run while other threads
+/// wait for their results, so any parallel work they start is isolated with
+/// WorkWithScopedParallelism.
+///
+template <unsigned int CAPACITY>
+class Hd_ParallelExtComputationSampler {
+public:
+    using SampledValueStore = HdExtComputationUtils::SampledValueStore<CAPACITY>;
+
+    explicit Hd_ParallelExtComputationSampler(HdSceneDelegate* sceneDelegate) : _sceneDelegate(sceneDelegate) {}
+
+    /// Samples \p compPrimvars into \p valueStore.  Returns false, leaving
+    /// \p valueStore unchanged, if the computations have a cycle or one of
+    /// them raises an error.
+    bool SampleComputedPrimvarValues(HdExtComputationPrimvarDescriptorVector const& compPrimvars,
+                                     size_t maxSampleCount,
+                                     SampledValueStore* valueStore) {
+        const Hd_ExtComputationSchedule schedule(_GenerateDependencyMap(compPrimvars));
+        if (!schedule.IsValid()) {
+            TF_WARN("Cycle in ext computations: %s", schedule.GetCycleDescription().c_str());
+            return false;
+        }
+
+        // Sources come before the computations that read them.
+        _SampleTimes sampleTimes;
+        for (HdExtComputation const* comp : schedule.GetSortedComputations()) {
+            std::vector<float> times = _ComputeSampleTimes(comp, maxSampleCount, sampleTimes);
+            sampleTimes.emplace(comp, std::move(times));
+        }
+
+        for (size_t level = 0; level != schedule.GetNumLevels(); ++level) {
+            std::vector<std::pair<HdExtComputation const*, float>> samples;
+            for (HdExtComputation const* comp : schedule.GetLevel(level)) {
+                if (!comp->IsInputAggregation()) {
+                    for (float time : sampleTimes.at(comp)) {
+                        samples.emplace_back(comp, time);
+                    }
+                }
+            }
+            WorkParallelForN(samples.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i != end; ++i) {
+                    _GetOutputs(samples[i].first, samples[i].second, maxSampleCount, sampleTimes);
+                }
+            });
+        }
+
+        SampledValueStore result;
+        for (HdExtComputationPrimvarDescriptor const& primvar : compPrimvars) {
+            HdExtComputation const* comp = _GetComputation(primvar.sourceComputationId);
+            if (!comp) {
+                continue;
+            }
+            _SampleArray& samples = result[primvar.name];
+            if (comp->IsInputAggregation()) {
+                samples = _FindSceneInput(_GetNode(comp), primvar.sourceComputationOutputName);
+                continue;
+            }
+            std::vector<float> const& times = sampleTimes.at(comp);
+            samples.Resize(times.size());
+            for (size_t i = 0; i != times.size(); ++i) {
+                _Outputs const& outputs = _GetOutputs(comp, times[i], maxSampleCount, sampleTimes);
+                if (outputs.error) {
+                    return false;
+                }
+                samples.times[i] = times[i];
+                samples.values[i] = _FindOutput(outputs, primvar.sourceComputationOutputName);
+            }
+        }
+        *valueStore = std::move(result);
+        return true;
+    }
+
+    /// Samples the computed primvars of several prims in parallel into
+    /// \p valueStores, replacing its contents.  The value store of a prim
+    /// whose computations fail is left empty.
+    void SampleComputedPrimvarValues(std::vector<HdExtComputationPrimvarDescriptorVector> const& compPrimvars,
+                                     size_t maxSampleCount,
+                                     std::vector<SampledValueStore>* valueStores) {
+        valueStores->assign(compPrimvars.size(), SampledValueStore());
+        WorkParallelForN(compPrimvars.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                SampleComputedPrimvarValues(compPrimvars[i], maxSampleCount, &(*valueStores)[i]);
+            }
+        });
+    }
+
+    /// Drops all memoized inputs and outputs.
+    void Clear() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _nodes.clear();
+        _outputs.clear();
+    }
+
+    /// Returns the number of InvokeExtComputation calls made so far.
+    size_t GetNumInvocations() const { return _numInvocations; }
+
+private:
+    using _SampleArray = HdTimeSampleArray<VtValue, CAPACITY>;
+    // Sample times of the computations of one SampleComputedPrimvarValues
+    // call.
+    using _SampleTimes = std::unordered_map<HdExtComputation const*, std::vector<float>>;
+
+    class _Context : public HdExtComputationContext {
+    public:
+        void SetInputValue(TfToken const& name, VtValue const& value) { _inputs[name] = value; }
+
+        VtValue const& GetInputValue(TfToken const& name) const override {
+            if (VtValue const* value = GetOptionalInputValuePtr(name)) {
+                return *value;
+            }
+            TF_CODING_ERROR("Asking for invalid input %s", name.GetText());
+            static const VtValue empty;
+            return empty;
+        }
+
+        VtValue const* GetOptionalInputValuePtr(TfToken const& name) const override {
+            const auto it = _inputs.find(name);
+            return it == _inputs.end() ? nullptr : &it->second;
+        }
+
+        void SetOutputValue(TfToken const& name, VtValue const& output) override { _outputs[name] = output; }
+
+        void RaiseComputationError() override { _error = true; }
+
+        bool HasComputationError() const { return _error; }
+
+        VtValue GetOutputValue(TfToken const& name) const {
+            const auto it = _outputs.find(name);
+            return it == _outputs.end() ? VtValue() : it->second;
+        }
+
+    private:
+        std::unordered_map<TfToken, VtValue, TfToken::HashFunctor> _inputs;
+        std::unordered_map<TfToken, VtValue, TfToken::HashFunctor> _outputs;
+        bool _error = false;
+    };
+
+    // Per computation data that does not depend on the sample time.
+    struct _Node {
+        std::once_flag once;
+        std::vector<std::pair<TfToken, _SampleArray>> sceneInputs;
+        // Source of each computation input, null if it is missing.
+        HdExtComputationConstPtrVector sources;
+        bool timeVarying = false;
+    };
+
+    // Outputs of a computation at a sample time.
+    struct _Outputs {
+        std::once_flag once;
+        std::vector<std::pair<TfToken, VtValue>> values;
+        bool error = false;
+    };
+
+    // The sample times of the sources, and so the inputs at a time, depend
+    // on maxSampleCount.
+    struct _OutputKey {
+        HdExtComputation const* comp;
+        float time;
+        size_t maxSampleCount;
+
+        bool operator==(_OutputKey const& other) const {
+            return comp == other.comp && time == other.time && maxSampleCount == other.maxSampleCount;
+        }
+    };
+
+    struct _OutputKeyHash {
+        size_t operator()(_OutputKey const& key) const {
+            return TfHash::Combine(key.comp, key.time, key.maxSampleCount);
+        }
+    };
+
+    HdExtComputation const* _GetComputation(SdfPath const& id) const {
+        if (id.IsEmpty()) {
+            return nullptr;
+        }
+        return static_cast<HdExtComputation const*>(
+                _sceneDelegate->GetRenderIndex().GetSprim(HdPrimTypeTokens->extComputation, id));
+    }
+
+    HdExtComputationUtils::ComputationDependencyMap _GenerateDependencyMap(
+            HdExtComputationPrimvarDescriptorVector const& compPrimvars) const {
+        HdExtComputationUtils::ComputationDependencyMap dependencies;
+        HdExtComputationConstPtrVector stack;
+        for (HdExtComputationPrimvarDescriptor const& primvar : compPrimvars) {
+            if (HdExtComputation const* comp = _GetComputation(primvar.sourceComputationId)) {
+                stack.push_back(comp);
+            }
+        }
+        while (!stack.empty()) {
+            HdExtComputation const* comp = stack.back();
+            stack.pop_back();
+            if (dependencies.count(comp)) {
+                continue;
+            }
+            HdExtComputationConstPtrVector& sources = dependencies[comp];
+            for (HdExtComputationInputDescriptor const& input : comp->GetComputationInputs()) {
+                if (HdExtComputation const* source = _GetComputation(input.sourceComputationId)) {
+                    sources.push_back(source);
+                    stack.push_back(source);
+                }
+            }
+        }
+        return dependencies;
+    }
+
+    // The computations reachable from comp must not have cycles.
+    _Node const& _GetNode(HdExtComputation const* comp) {
+        std::shared_ptr<_Node> node;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::shared_ptr<_Node>& entry = _nodes[comp];
+            if (!entry) {
+                entry = std::make_shared<_Node>();
+            }
+            node = entry;
+        }
+        // A thread that waits on parallel work started by the delegate must
+        // not pick up a task that waits on this flag.
+        std::call_once(node->once, [&]() {
+            WorkWithScopedParallelism([&]() {
+                for (TfToken const& name : comp->GetSceneInputNames()) {
+                    node->sceneInputs.emplace_back(name, _SampleArray());
+                    _sceneDelegate->SampleExtComputationInput(comp->GetId(), name,
+                                                              &node->sceneInputs.back().second);
+                    node->timeVarying |= node->sceneInputs.back().second.count > 1;
+                }
+                for (HdExtComputationInputDescriptor const& input : comp->GetComputationInputs()) {
+                    node->sources.push_back(_GetComputation(input.sourceComputationId));
+                    if (node->sources.back()) {
+                        node->timeVarying |= _GetNode(node->sources.back()).timeVarying;
+                    }
+                }
+            });
+        });
+        // The map owns the node until Clear().
+        return *node;
+    }
+
+    // Returns the union of the sample times of comp's scene inputs and of
+    // its sources' outputs, truncated to maxSampleCount, like
+    // HdExtComputationUtils.  The times of its sources must be known.
+    std::vector<float> _ComputeSampleTimes(HdExtComputation const* comp,
+                                           size_t maxSampleCount,
+                                           _SampleTimes const& sampleTimes) {
+        _Node const& node = _GetNode(comp);
+        std::vector<float> times;
+        auto addTimes = [&times](_SampleArray const& samples) {
+            times.insert(times.end(), samples.times.begin(), samples.times.begin() + samples.count);
+        };
+        for (auto const& input : node.sceneInputs) {
+            addTimes(input.second);
+        }
+        HdExtComputationInputDescriptorVector const& inputs = comp->GetComputationInputs();
+        for (size_t i = 0; i != inputs.size(); ++i) {
+            HdExtComputation const* source = node.sources[i];
+            if (!source) {
+                continue;
+            }
+            if (source->IsInputAggregation()) {
+                addTimes(_FindSceneInput(_GetNode(source), inputs[i].sourceComputationOutputName));
+            } else {
+                std::vector<float> const& sourceTimes = sampleTimes.at(source);
+                times.insert(times.end(), sourceTimes.begin(), sourceTimes.end());
+            }
+        }
+        std::sort(times.begin(), times.end());
+        times.erase(std::unique(times.begin(), times.end()), times.end());
+        if (times.size() > maxSampleCount) {
+            times.resize(maxSampleCount);
+        }
+        return times;
+    }
+
+    _Outputs const& _GetOutputs(HdExtComputation const* comp,
+                                float time,
+                                size_t maxSampleCount,
+                                _SampleTimes const& sampleTimes) {
+        _Node const& node = _GetNode(comp);
+        std::shared_ptr<_Outputs> outputs;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            // Time invariant outputs are shared by all sample times.
+            const _OutputKey key =
+                    node.timeVarying ? _OutputKey{comp, time, maxSampleCount} : _OutputKey{comp, 0.0f, 0};
+            std::shared_ptr<_Outputs>& entry = _outputs[key];
+            if (!entry) {
+                entry = std::make_shared<_Outputs>();
+            }
+            outputs = entry;
+        }
+        std::call_once(outputs->once, [&]() {
+            WorkWithScopedParallelism([&]() { _Invoke(comp, node, time, maxSampleCount, sampleTimes, outputs.get()); });
+        });
+        return *outputs;
+    }
+
+    // Returns the output name of the computed source resampled at time from
+    // its outputs at its own sample times.  Returns false if one of them
+    // failed.
+    bool _ResampleOutput(HdExtComputation const* source,
+                         TfToken const& name,
+                         float time,
+                         size_t maxSampleCount,
+                         _SampleTimes const& sampleTimes,
+                         VtValue* value) {
+        std::vector<float> const& times = sampleTimes.at(source);
+        if (times.empty()) {
+            *value = VtValue();
+            return true;
+        }
+        // Only the samples around time contribute, so only they are read.
+        const size_t upper = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+        const size_t first = upper == 0 ? 0 : upper - 1;
+        const size_t last = std::min(upper, times.size() - 1);
+        _SampleArray samples;
+        samples.Resize(last - first + 1);
+        for (size_t i = first; i <= last; ++i) {
+            _Outputs const& outputs = _GetOutputs(source, times[i], maxSampleCount, sampleTimes);
+            if (outputs.error) {
+                return false;
+            }
+            samples.times[i - first] = times[i];
+            samples.values[i - first] = _FindOutput(outputs, name);
+        }
+        *value = samples.Resample(time);
+        return true;
+    }
+
+    void _Invoke(HdExtComputation const* comp,
+                 _Node const& node,
+                 float time,
+                 size_t maxSampleCount,
+                 _SampleTimes const& sampleTimes,
+                 _Outputs* outputs) {
+        _Context context;
+        for (auto const& input : node.sceneInputs) {
+            context.SetInputValue(input.first, input.second.Resample(time));
+        }
+        HdExtComputationInputDescriptorVector const& inputs = comp->GetComputationInputs();
+        for (size_t i = 0; i != inputs.size(); ++i) {
+            if (!node.sources[i]) {
+                TF_RUNTIME_ERROR("Missing source computation %s for input %s of %s",
+                                 inputs[i].sourceComputationId.GetText(), inputs[i].name.GetText(),
+                                 comp->GetId().GetText());
+                outputs->error = true;
+                return;
+            }
+            if (node.sources[i]->IsInputAggregation()) {
+                _SampleArray const& samples =
+                        _FindSceneInput(_GetNode(node.sources[i]), inputs[i].sourceComputationOutputName);
+                context.SetInputValue(inputs[i].name, samples.count ? samples.Resample(time) : VtValue());
+                continue;
+            }
+            VtValue value;
+            if (!_ResampleOutput(node.sources[i], inputs[i].sourceComputationOutputName, time, maxSampleCount,
+                                 sampleTimes, &value)) {
+                outputs->error = true;
+                return;
+            }
+            context.SetInputValue(inputs[i].name, value);
+        }
+
+        _sceneDelegate->InvokeExtComputation(comp->GetId(), &context);
+        ++_numInvocations;
+        if (context.HasComputationError()) {
+            outputs->error = true;
+            return;
+        }
+        for (HdExtComputationOutputDescriptor const& output : comp->GetComputationOutputs()) {
+            outputs->values.emplace_back(output.name, context.GetOutputValue(output.name));
+        }
+    }
+
+    // Returns the samples of the scene input name of an input aggregation,
+    // which are its outputs.
+    static _SampleArray const& _FindSceneInput(_Node const& node, TfToken const& name) {
+        for (auto const& input : node.sceneInputs) {
+            if (input.first == name) {
+                return input.second;
+            }
+        }
+        static const _SampleArray empty;
+        return empty;
+    }
+
+    static VtValue _FindOutput(_Outputs const& outputs, TfToken const& name) {
+        for (auto const& value : outputs.values) {
+            if (value.first == name) {
+                return value.second;
+            }
+        }
+        return VtValue();
+    }
+
+    HdSceneDelegate* const _sceneDelegate;
+    std::mutex _mutex;
+    std::unordered_map<HdExtComputation const*, std::shared_ptr<_Node>> _nodes;
+    std::unordered_map<_OutputKey, std::shared_ptr<_Outputs>, _OutputKeyHash> _outputs;
+    std::atomic<size_t> _numInvocations{0};
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_PARALLEL_EXT_COMPUTATION_SAMPLER_H
@@ -0,0 +1,172 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_PERF_LOG_RECORDER_H
+#define PXR_IMAGING_HD_PERF_LOG_RECORDER_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/perfLog.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/token.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_PerfLogRecorder
+///
+/// Records HdPerfLog counters and cache statistics over time.
+///
+/// Call Sample() once per frame or tick.  Every sample snapshots all
+/// counters and the hits and misses of all caches known to the perf log at
+/// that point into a fixed-capacity ring buffer, so a long interactive
+/// session keeps the most recent history at a bounded cost.  The buffer
+/// can be written as CSV, or as a compact binary stream for large captures.
+///
+/// Columns are named after the counter, or "<cache>:hits" and
+/// "<cache>:misses" for caches.  Columns that first appear after some
+/// samples were taken have no value in those samples.
+///
+class Hd_PerfLogRecorder {
+public:
+    explicit Hd_PerfLogRecorder(size_t capacity) : _samples(TF_VERIFY(capacity > 0) ? capacity : 1) {}
+
+    /// Snapshots \p perfLog, tagging the sample with \p time, e.g. a frame
+    /// number or seconds since the session started.  Once the buffer is
+    /// full the oldest sample is overwritten.
+    void Sample(double time, HdPerfLog& perfLog = HdPerfLog::GetInstance()) {
+        _Sample& sample = _samples[(_first + _size) % _samples.size()];
+        if (_size == _samples.size()) {
+            _first = (_first + 1) % _samples.size();
+        } else {
+            ++_size;
+        }
+
+        sample.time = time;
+        sample.values.assign(_columns.size(), _Missing());
+        for (TfToken const& name : perfLog.GetCounterNames()) {
+            _Set(&sample, name.GetString(), perfLog.GetCounter(name));
+        }
+        for (TfToken const& name : perfLog.GetCacheNames()) {
+            _Set(&sample, name.GetString() + ":hits", perfLog.GetCacheHits(name));
+            _Set(&sample, name.GetString() + ":misses", perfLog.GetCacheMisses(name));
+        }
+    }
+
+    size_t GetNumSamples() const { return _size; }
+
+    std::vector<std::string> const& GetColumnNames() const { return _columns; }
+
+    /// Returns the time of the \p i'th oldest retained sample.
+    double GetTime(size_t i) const { return _Get(i).time; }
+
+    /// Returns the value of \p column in the \p i'th oldest retained
+    /// sample, or NaN if it was not recorded.
+    double GetValue(size_t i, std::string const& column) const {
+        const auto it = _columnIndices.find(column);
+        if (it == _columnIndices.end()) {
+            return _Missing();
+        }
+        const _Sample& sample = _Get(i);
+        return it->second < sample.values.size() ? sample.values[it->second] : _Missing();
+    }
+
+    void Clear() {
+        _first = 0;
+        _size = 0;
+    }
+
+    /// Writes one row per sample, oldest first.  Missing values are left
+    /// empty.  Values are written with enough digits to round trip.
+    void WriteCsv(std::ostream& out) const {
+        const std::streamsize precision = out.precision(std::numeric_limits<double>::max_digits10);
+        out << "time";
+        for (std::string const& column : _columns) {
+            out << ',' << column;
+        }
+        out << '\n';
+
+        for (size_t i = 0; i != _size; ++i) {
+            const _Sample& sample = _Get(i);
+            out << sample.time;
+            for (size_t c = 0; c != _columns.size(); ++c) {
+                out << ',';
+                if (c < sample.values.size() && !std::isnan(sample.values[c])) {
+                    out << sample.values[c];
+                }
+            }
+            out << '\n';
+        }
+        out.precision(precision);
+    }
+
+    /// Writes a native-endian binary stream:
+    ///
+    ///     "HDPL" u32 version
+    ///     u32 numColumns, then per column: u32 length, name bytes
+    ///     u32 numSamples, then per sample: f64 time, u32 numValues,
+    ///         numValues x f64 (NaN for missing)
+    ///
+    void WriteBinary(std::ostream& out) const {
+        out.write("HDPL", 4);
+        _WriteU32(out, 1);
+
+        _WriteU32(out, static_cast<uint32_t>(_columns.size()));
+        for (std::string const& column : _columns) {
+            _WriteU32(out, static_cast<uint32_t>(column.size()));
+            out.write(column.data(), column.size());
+        }
+
+        _WriteU32(out, static_cast<uint32_t>(_size));
+        for (size_t i = 0; i != _size; ++i) {
+            const _Sample& sample = _Get(i);
+            out.write(reinterpret_cast<const char*>(&sample.time), sizeof(double));
+            _WriteU32(out, static_cast<uint32_t>(sample.values.size()));
+            out.write(reinterpret_cast<const char*>(sample.values.data()), sample.values.size() * sizeof(double));
+        }
+    }
+
+private:
+    struct _Sample {
+        double time = 0.0;
+        std::vector<double> values;
+    };
+
+    static double _Missing() { return std::numeric_limits<double>::quiet_NaN(); }
+
+    static void _WriteU32(std::ostream& out, uint32_t value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    const _Sample& _Get(size_t i) const { return _samples[(_first + i) % _samples.size()]; }
+
+    void _Set(_Sample* sample, std::string const& column, double value) {
+        auto it = _columnIndices.find(column);
+        if (it == _columnIndices.end()) {
+            it = _columnIndices.emplace(column, _columns.size()).first;
+            _columns.push_back(column);
+            sample->values.resize(_columns.size(), _Missing());
+        }
+        sample->values[it->second] = value;
+    }
+
+    std::vector<_Sample> _samples;
+    size_t _first = 0;
+    size_t _size = 0;
+
+    std::vector<std::string> _columns;
+    std::unordered_map<std::string, size_t> _columnIndices;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_PERF_LOG_RECORDER_H
@@ -0,0 +1,137 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_SHARDED_PERF_COUNTERS_H
+#define PXR_IMAGING_HD_SHARDED_PERF_COUNTERS_H
+
+#include "pxr/pxr.h"
+#include "pxr/base/tf/token.h"
+
+#include <tbb/concurrent_unordered_map.h>
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_ShardedPerfCounters
+///
+/// Per-thread sharded version of the HdPerfLog counter API.
+///
+/// Every thread updates its own shard, so counter updates from parallel
+/// sync never contend on a shared map or lock.  Each shard entry has a
+/// single writer, so an update is a relaxed load and store on an atomic.
+/// The only lock is taken when a thread touches the counters for the first
+/// time, to register its shard.  GetCounter() aggregates the shards lazily,
+/// which makes reads more expensive than with HdPerfLog; reads are expected
+/// to be rare compared to updates.
+///
+/// As with HdPerfLog, updates are ignored while the counters are disabled
+/// but existing values can still be read.
+///
+class Hd_ShardedPerfCounters {
+public:
+    Hd_ShardedPerfCounters() = default;
+
+    Hd_ShardedPerfCounters(Hd_ShardedPerfCounters const&) = delete;
+    Hd_ShardedPerfCounters& operator=(Hd_ShardedPerfCounters const&) = delete;
+
+    void Enable() { _enabled.store(true, std::memory_order_relaxed); }
+    void Disable() { _enabled.store(false, std::memory_order_relaxed); }
+    bool IsEnabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    void IncrementCounter(TfToken const& name) { AddCounter(name, 1.0); }
+    void DecrementCounter(TfToken const& name) { AddCounter(name, -1.0); }
+    void SubtractCounter(TfToken const& name, double value) { AddCounter(name, -value); }
+
+    void AddCounter(TfToken const& name, double value) {
+        if (!IsEnabled()) {
+            return;
+        }
+        std::atomic<double>& counter = _GetLocalCounter(name);
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /// Sets the aggregated value of \p name.  The difference to the current
+    /// total is applied to the calling thread's shard, so a set that races
+    /// with updates on other threads is only as exact as it would be with a
+    /// single shared counter.
+    void SetCounter(TfToken const& name, double value) {
+        if (!IsEnabled()) {
+            return;
+        }
+        AddCounter(name, value - GetCounter(name));
+    }
+
+    /// Returns the sum of \p name over all shards.
+    double GetCounter(TfToken const& name) const {
+        std::lock_guard<std::mutex> lock(_registryMutex);
+        double total = 0.0;
+        for (_Shard const* shard : _registry) {
+            const auto it = shard->find(name);
+            if (it != shard->end()) {
+                total += it->second.load(std::memory_order_relaxed);
+            }
+        }
+        return total;
+    }
+
+    /// Returns the names of all counters that have been touched, sorted.
+    TfTokenVector GetCounterNames() const {
+        TfTokenVector names;
+        std::lock_guard<std::mutex> lock(_registryMutex);
+        for (_Shard const* shard : _registry) {
+            for (auto const& entry : *shard) {
+                names.push_back(entry.first);
+            }
+        }
+        std::sort(names.begin(), names.end(), TfTokenFastArbitraryLessThan());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        return names;
+    }
+
+    /// Resets all counters to zero.  Updates that race with the reset may
+    /// be lost.
+    void ResetCounters() {
+        std::lock_guard<std::mutex> lock(_registryMutex);
+        for (_Shard* shard : _registry) {
+            for (auto& entry : *shard) {
+                entry.second.store(0.0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    using _Shard = tbb::concurrent_unordered_map<TfToken, std::atomic<double>, TfToken::HashFunctor>;
+
+    std::atomic<double>& _GetLocalCounter(TfToken const& name) {
+        bool exists = false;
+        _Shard& shard = _shards.local(exists);
+        if (!exists) {
+            std::lock_guard<std::mutex> lock(_registryMutex);
+            _registry.push_back(&shard);
+        }
+        auto it = shard.find(name);
+        if (it == shard.end()) {
+            it = shard.emplace(name, 0.0).first;
+        }
+        return it->second;
+    }
+
+    tbb::enumerable_thread_specific<_Shard> _shards;
+    // Shards that readers aggregate over.  Registered on a thread's first
+    // update, since iterating _shards is not safe while it grows.
+    mutable std::mutex _registryMutex;
+    std::vector<_Shard*> _registry;
+    std::atomic<bool> _enabled{false};
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_SHARDED_PERF_COUNTERS_H
@@ -18,6 +18,15 @@
 #include "pxr/imaging/hd/primvarsSchema.h"
 #include "pxr/imaging/hd/purposeSchema.h"
 #include "pxr/imaging/hd/visibilitySchema.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/threadLimits.h"
+#include "bulkRetainedSceneIndex.h"
+#include "collectionMembershipCache.h"
+#include "compiledCollectionExpressionEvaluator.h"
+#include "unitTestPathGenerator.h"
+#include "unitTestPerfRunner.h"
+
+#include <algorithm>
 
 #include <gtest/gtest.h>
 
@@ -164,6 +173,11 @@ HdSceneIndexBaseRefPtr _CreateTestScene() {
     return sceneIndex_;
 }
 
+SdfPathVector _Sorted(SdfPathVector paths) {
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
 }  // namespace
 
 TEST(TestHydra, test_empty_evaluator) {
@@ -549,3 +563,337 @@ TEST(TestHydra, test_evaluator_utilities) {
         }
     }
 }
+
+TEST(TestHydra, test_compiled_evaluator) {
+    HdSceneIndexBaseRefPtr si = _CreateTestScene();
+
+    {
+        Hd_CompiledCollectionExpressionEvaluator eval;
+        ASSERT_TRUE(eval.IsEmpty());
+        ASSERT_TRUE(!eval.Match(SdfPath("/A")));
+
+        SdfPathVector resultVec;
+        eval.PopulateAllMatches(SdfPath::AbsoluteRootPath(), &resultVec);
+        ASSERT_TRUE(resultVec.empty());
+    }
+
+    // The compiled evaluator agrees with HdCollectionExpressionEvaluator for
+    // every match kind.
+    {
+        const std::vector<std::string> exprs = {
+                "//{hdType:scope}",
+                "//B/{type:fruit}",
+                "//{hdHasDataSource:\"materialBindings.\"}",
+                "//{hdPurpose:food and hdHasPrimvar:fresh}",
+                "//{hdHasDataSource:visibility and hdVisible:false}",
+                "//{hdHasMaterialBinding:\"Orange\"}",
+                "/A/B//",
+                "/A/C/* + /A/B/Carrot",
+                "~//{hdType:scope}",
+                "//* - /A/C//",
+                "//{eatable}",
+                "//{hdType:scope}/C/{hdPurpose:furniture}",
+        };
+        const std::vector<HdCollectionExpressionEvaluator::MatchKind> matchKinds = {
+                HdCollectionExpressionEvaluator::MatchAll,
+                HdCollectionExpressionEvaluator::ShallowestMatches,
+                HdCollectionExpressionEvaluator::ShallowestMatchesAndAllDescendants,
+        };
+        for (std::string const& exprString : exprs) {
+            const SdfPathExpression expr(exprString);
+            HdCollectionExpressionEvaluator stockEval(si, expr, _GetCustomPredicateLibrary());
+            Hd_CompiledCollectionExpressionEvaluator compiledEval(si, expr, _GetCustomPredicateLibrary());
+
+            for (HdCollectionExpressionEvaluator::MatchKind matchKind : matchKinds) {
+                for (SdfPath const& root : {SdfPath::AbsoluteRootPath(), SdfPath("/A/B"), SdfPath("/A/C")}) {
+                    SdfPathVector expected;
+                    stockEval.PopulateMatches(root, matchKind, &expected);
+                    SdfPathVector result;
+                    compiledEval.PopulateMatches(root, matchKind, &result);
+                    EXPECT_EQ(_Sorted(result), _Sorted(expected)) << exprString << " " << matchKind << " " << root;
+                }
+            }
+        }
+    }
+
+    // Only the subtree at the literal prefix of the pattern is traversed.
+    {
+        const SdfPathExpression expr("/A/C//{hdPurpose:furniture}");
+        Hd_CompiledCollectionExpressionEvaluator eval(si, expr);
+        ASSERT_EQ(eval.GetTraversalRoots(), SdfPathVector({SdfPath("/A/C")}));
+
+        SdfPathVector resultVec;
+        size_t numEvaluated = 0;
+        eval.PopulateAllMatches(SdfPath::AbsoluteRootPath(), &resultVec, &numEvaluated);
+        const SdfPathVector expected = {SdfPath("/A/C/Chair1"), SdfPath("/A/C/Chair2"), SdfPath("/A/C/Table")};
+        ASSERT_EQ(_Sorted(resultVec), expected);
+        // "/A/C" and its three children.
+        ASSERT_EQ(numEvaluated, 4u);
+
+        // A root outside the prefix has no matches.
+        resultVec.clear();
+        eval.PopulateAllMatches(SdfPath("/A/B"), &resultVec, &numEvaluated);
+        ASSERT_TRUE(resultVec.empty());
+        ASSERT_EQ(numEvaluated, 0u);
+    }
+
+    // Unions are bounded by the outermost prefixes of their patterns.
+    {
+        const SdfPathExpression expr("/A/B/Carrot + /A/C//{hdVisible:false} + /A/C/Table + /Missing//");
+        Hd_CompiledCollectionExpressionEvaluator eval(si, expr);
+        ASSERT_EQ(eval.GetTraversalRoots(),
+                  SdfPathVector({SdfPath("/A/B/Carrot"), SdfPath("/A/C"), SdfPath("/Missing")}));
+
+        SdfPathVector resultVec;
+        eval.PopulateAllMatches(SdfPath::AbsoluteRootPath(), &resultVec);
+        const SdfPathVector expected = {SdfPath("/A/B/Carrot"), SdfPath("/A/C/Chair2"), SdfPath("/A/C/Table")};
+        ASSERT_EQ(_Sorted(resultVec), expected);
+    }
+
+    // Complements can match anywhere.
+    {
+        Hd_CompiledCollectionExpressionEvaluator eval(si, SdfPathExpression("~/A/C//"));
+        ASSERT_EQ(eval.GetTraversalRoots(), SdfPathVector({SdfPath::AbsoluteRootPath()}));
+    }
+}
+
+TEST(TestHydra, test_compiled_evaluator_perf) {
+    const SdfPathVector leafPaths =
+            Hd_UnitTestPathGenerator(Hd_UnitTestPathGenerator::UniformOptions(1000000, 4)).Generate();
+
+    // A few shared prim containers give a mix of visibility, purposes,
+    // primvars and bindings like test_predicate_library's scene.
+    std::vector<HdContainerDataSourceHandle> containers;
+    for (size_t k = 0; k != 8; ++k) {
+        TfTokenVector primvarNames;
+        if (k % 4 == 0) {
+            primvarNames = {_primvarTokens->fresh};
+        } else if (k % 4 == 1) {
+            primvarNames = {_primvarTokens->fresh, _primvarTokens->glossy};
+        }
+        const _TokenPathPairVector bindings = {
+                k % 3 == 0 ? _TokenPathPair(HdMaterialBindingsSchemaTokens->allPurpose, SdfPath("/Looks/OrangeMat"))
+                           : _TokenPathPair(_matBindingPurposeTokens->preview, SdfPath("/Looks/GreenMat"))};
+        containers.push_back(_MakePrimContainer(
+                /* visibility */ k != 3, k % 2 ? _purposeTokens->furniture : _purposeTokens->food, primvarNames,
+                bindings));
+    }
+    const TfToken primTypes[] = {_primTypeTokens->veg, _primTypeTokens->fruit, _primTypeTokens->mesh};
+
+    HdRetainedSceneIndex::AddedPrimEntries entries;
+    entries.reserve(leafPaths.size());
+    for (size_t i = 0; i != leafPaths.size(); ++i) {
+        entries.push_back({leafPaths[i], primTypes[i % 3], containers[i % containers.size()]});
+    }
+    Hd_BulkRetainedSceneIndexRefPtr si = Hd_BulkRetainedSceneIndex::New();
+    si->AddPrims({entries});
+
+    const SdfPath group = leafPaths.front().GetPrefixes().front();
+    const std::vector<std::pair<std::string, std::string>> exprs = {
+            {"invisible", "//{hdVisible:false}"},
+            {"fresh_food", "//{hdPurpose:food and hdHasPrimvar:fresh}"},
+            {"orange_binding", "//{hdHasMaterialBinding:\"Orange\"}"},
+            {"group_veg", TfStringPrintf("%s//{hdType:veg}", group.GetText())},
+    };
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    for (auto const& [label, exprString] : exprs) {
+        const SdfPathExpression expr(exprString);
+
+        HdCollectionExpressionEvaluator stockEval(si, expr);
+        SdfPathVector expected;
+        runner.Measure(TfStringPrintf("collection_%s_stock", label.c_str()), [&]() {
+            expected.clear();
+            stockEval.PopulateAllMatches(SdfPath::AbsoluteRootPath(), &expected);
+        });
+        expected = _Sorted(expected);
+        EXPECT_FALSE(expected.empty()) << exprString;
+
+        for (unsigned numThreads : Hd_UnitTestPerfRunner::GetThreadCounts()) {
+            WorkSetConcurrencyLimit(numThreads);
+            SdfPathVector result;
+            runner.Measure(TfStringPrintf("collection_%s_compiled_%ut", label.c_str(), numThreads), [&]() {
+                result.clear();
+                Hd_CompiledCollectionExpressionEvaluator(si, expr).PopulateAllMatches(SdfPath::AbsoluteRootPath(),
+                                                                                    &result);
+            });
+            EXPECT_EQ(_Sorted(result), expected) << exprString;
+        }
+        WorkSetMaximumConcurrencyLimit();
+    }
+
+    EXPECT_TRUE(runner.Finish("testHdCollectionExpressionEvaluator.json", "perfstats_collection_evaluator.raw")
+                        .empty());
+}
+
+TEST(TestHydra, test_collection_membership_cache) {
+    HdRetainedSceneIndexRefPtr si = TfDynamic_cast<HdRetainedSceneIndexRefPtr>(_CreateTestScene());
+
+    // Match invisible prims.
+    {
+        Hd_CollectionMembershipCache cache(si, SdfPathExpression("//{hdVisible:false}"));
+        ASSERT_EQ(cache.GetMembers(), SdfPathSet({SdfPath("/A/C/Chair2")}));
+        ASSERT_EQ(cache.GetDependencies(), HdDataSourceLocatorSet{HdVisibilitySchema::GetDefaultLocator()});
+        ASSERT_FALSE(cache.GetDependsOnAncestors());
+        size_t numEvaluated = cache.GetNumEvaluatedPrims();
+
+        // Adding a prim again matches only that prim.
+        si->AddPrims({{SdfPath("/A/C/Table"), _primTypeTokens->mesh,
+                       _MakePrimContainer(/* visibility */ false, _purposeTokens->furniture)}});
+        ASSERT_EQ(cache.GetNumEvaluatedPrims(), ++numEvaluated);
+        ASSERT_TRUE(cache.Contains(SdfPath("/A/C/Table")));
+        Hd_CollectionMembershipCache::Delta delta = cache.TakeDelta();
+        ASSERT_EQ(delta.entered, SdfPathVector({SdfPath("/A/C/Table")}));
+        ASSERT_TRUE(delta.left.empty());
+
+        // Dirtying locators that no predicate reads matches nothing.
+        si->DirtyPrims({{SdfPath("/A/C/Chair1"), HdPurposeSchema::GetDefaultLocator()},
+                        {SdfPath("/A/B/Carrot"), HdPrimvarsSchema::GetDefaultLocator()}});
+        ASSERT_EQ(cache.GetNumEvaluatedPrims(), numEvaluated);
+
+        // Dirtying visibility matches the prim again, without a change.
+        si->DirtyPrims({{SdfPath("/A/B/Carrot"), HdVisibilitySchema::GetDefaultLocator()}});
+        ASSERT_EQ(cache.GetNumEvaluatedPrims(), ++numEvaluated);
+        delta = cache.TakeDelta();
+        ASSERT_TRUE(delta.entered.empty() && delta.left.empty());
+
+        // A path that enters and leaves between deltas is in neither list.
+        si->AddPrims({{SdfPath("/A/B/Carrot"), _primTypeTokens->veg,
+                       _MakePrimContainer(/* visibility */ false, _purposeTokens->food)}});
+        si->RemovePrims({SdfPath("/A/B"), SdfPath("/A/C")});
+        ASSERT_TRUE(cache.GetMembers().empty());
+        delta = cache.TakeDelta();
+        ASSERT_TRUE(delta.entered.empty());
+        ASSERT_EQ(delta.left, SdfPathVector({SdfPath("/A/C/Chair2"), SdfPath("/A/C/Table")}));
+    }
+
+    si = TfDynamic_cast<HdRetainedSceneIndexRefPtr>(_CreateTestScene());
+
+    // A predicate on an ancestor makes edits match the subtree again.
+    {
+        Hd_CollectionMembershipCache cache(si, SdfPathExpression("//{hdType:scope}/{hdPurpose:food}"));
+        ASSERT_EQ(cache.GetMembers(), SdfPathSet({SdfPath("/A/B/Apricot"), SdfPath("/A/B/Broccoli"),
+                                                  SdfPath("/A/B/Carrot"), SdfPath("/A/B/Tomato")}));
+        ASSERT_TRUE(cache.GetDependsOnAncestors());
+
+        si->AddPrims({{SdfPath("/A/B"), _primTypeTokens->mesh, nullptr}});
+        ASSERT_TRUE(cache.GetMembers().empty());
+        Hd_CollectionMembershipCache::Delta delta = cache.TakeDelta();
+        ASSERT_EQ(delta.left.size(), 4u);
+
+        si->AddPrims({{SdfPath("/A/B"), _primTypeTokens->scope, nullptr}});
+        delta = cache.TakeDelta();
+        ASSERT_EQ(delta.entered.size(), 4u);
+        ASSERT_TRUE(delta.left.empty());
+    }
+
+    // Dependencies of custom predicates can be declared.
+    {
+        const SdfPathExpression expr("//{eatable} + //{hdHasDataSource:\"materialBindings.\"}");
+        Hd_CollectionMembershipCache cache(si, expr, _GetCustomPredicateLibrary(),
+                                           {{"eatable", HdDataSourceLocatorSet()}});
+        ASSERT_EQ(cache.GetDependencies(), HdDataSourceLocatorSet{HdMaterialBindingsSchema::GetDefaultLocator().Append(
+                                                   HdMaterialBindingsSchemaTokens->allPurpose)});
+        const size_t numEvaluated = cache.GetNumEvaluatedPrims();
+        si->DirtyPrims({{SdfPath("/A/B/Carrot"), HdVisibilitySchema::GetDefaultLocator()}});
+        ASSERT_EQ(cache.GetNumEvaluatedPrims(), numEvaluated);
+    }
+}
+
+TEST(TestHydra, test_collection_membership_cache_perf) {
+    const SdfPathVector leafPaths =
+            Hd_UnitTestPathGenerator(Hd_UnitTestPathGenerator::UniformOptions(1000000, 4)).Generate();
+
+    // One leaf in eight is invisible.
+    const HdContainerDataSourceHandle visiblePrim =
+            _MakePrimContainer(/* visibility */ true, _purposeTokens->food, {_primvarTokens->fresh});
+    const HdContainerDataSourceHandle invisiblePrim =
+            _MakePrimContainer(/* visibility */ false, _purposeTokens->food, {_primvarTokens->fresh});
+    HdRetainedSceneIndex::AddedPrimEntries entries;
+    entries.reserve(leafPaths.size());
+    for (size_t i = 0; i != leafPaths.size(); ++i) {
+        entries.push_back({leafPaths[i], _primTypeTokens->veg, i % 8 ? visiblePrim : invisiblePrim});
+    }
+    HdRetainedSceneIndexRefPtr si = HdRetainedSceneIndex::New();
+    si->AddPrims(entries);
+
+    const SdfPathExpression expr("//{hdVisible:false}");
+    Hd_CollectionMembershipCache cache(si, expr);
+    ASSERT_EQ(cache.GetMembers().size(), (leafPaths.size() + 7) / 8);
+
+    // Each measurement makes a thousand single-prim edits to visible leaves,
+    // followed by taking the delta, as a client would per edit.
+    constexpr size_t numEdits = 1000;
+    const size_t stride = 8 * (leafPaths.size() / (8 * numEdits));
+    SdfPathVector editedPaths;
+    for (size_t i = 1; editedPaths.size() != numEdits; i += stride) {
+        editedPaths.push_back(leafPaths[i]);
+    }
+    const HdDataSourceLocatorSet visibilityLocators{HdVisibilitySchema::GetDefaultLocator()};
+    const HdDataSourceLocatorSet primvarLocators{HdPrimvarsSchema::GetDefaultLocator()};
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.trials = std::min<size_t>(options.trials, 5);
+    Hd_UnitTestPerfRunner runner(options);
+
+    // The stock evaluator recomputes membership after every edit; measure a
+    // single recompute.
+    HdCollectionExpressionEvaluator stockEval(si, expr);
+    size_t numStockMembers = 0;
+    runner.Measure("membership_recompute_stock_1M", [&]() {
+        SdfPathVector members;
+        stockEval.PopulateAllMatches(SdfPath::AbsoluteRootPath(), &members);
+        numStockMembers = members.size();
+    });
+    EXPECT_EQ(numStockMembers, cache.GetMembers().size());
+
+    size_t numChanges = 0;
+    runner.Measure("membership_dirty_unrelated_1000", [&]() {
+        numChanges = 0;
+        for (SdfPath const& path : editedPaths) {
+            si->DirtyPrims({{path, primvarLocators}});
+            const Hd_CollectionMembershipCache::Delta delta = cache.TakeDelta();
+            numChanges += delta.entered.size() + delta.left.size();
+        }
+    });
+    EXPECT_EQ(numChanges, 0u);
+
+    runner.Measure("membership_dirty_visibility_1000", [&]() {
+        numChanges = 0;
+        for (SdfPath const& path : editedPaths) {
+            si->DirtyPrims({{path, visibilityLocators}});
+            const Hd_CollectionMembershipCache::Delta delta = cache.TakeDelta();
+            numChanges += delta.entered.size() + delta.left.size();
+        }
+    });
+    EXPECT_EQ(numChanges, 0u);
+
+    runner.Measure("membership_toggle_visibility_1000", [&]() {
+        numChanges = 0;
+        for (SdfPath const& path : editedPaths) {
+            si->AddPrims({{path, _primTypeTokens->veg, invisiblePrim}});
+            numChanges += cache.TakeDelta().entered.size();
+            si->AddPrims({{path, _primTypeTokens->veg, visiblePrim}});
+            numChanges += cache.TakeDelta().left.size();
+        }
+    });
+    EXPECT_EQ(numChanges, 2 * numEdits);
+
+    runner.Measure("membership_remove_add_1000", [&]() {
+        numChanges = 0;
+        for (SdfPath const& path : editedPaths) {
+            si->RemovePrims({path});
+            si->AddPrims({{path, _primTypeTokens->veg, visiblePrim}});
+            const Hd_CollectionMembershipCache::Delta delta = cache.TakeDelta();
+            numChanges += delta.entered.size() + delta.left.size();
+        }
+    });
+    EXPECT_EQ(numChanges, 0u);
+    EXPECT_EQ(cache.GetMembers().size(), (leafPaths.size() + 7) / 8);
+
+    EXPECT_TRUE(runner.Finish("testHdCollectionMembershipCache.json", "perfstats_collection_membership.raw").empty());
+}
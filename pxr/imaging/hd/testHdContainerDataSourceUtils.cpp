@@ -6,7 +6,12 @@
 
 #include "pxr/imaging/hd/containerDataSourceEditor.h"
 #include "pxr/imaging/hd/overlayContainerDataSource.h"
+#include "pxr/imaging/hd/primvarSchema.h"
+#include "pxr/imaging/hd/primvarsSchema.h"
 #include "pxr/imaging/hd/retainedDataSource.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "flatteningOverlayContainerDataSource.h"
+#include "unitTestPerfRunner.h"
 
 #include <algorithm>
 #include <functional>
@@ -202,4 +207,199 @@ TEST(TestHydra, test_container_editor) {
 
         COMPARECONTAINERS("sub-container overlay:", test, baseline);
     }
-}
\ No newline at end of file
+}
+// ----------------------------------------------------------------------------
+
+// Container whose children can be replaced after it was handed out.
+class _MutableContainerDataSource : public HdContainerDataSource {
+public:
+    HD_DECLARE_DATASOURCE(_MutableContainerDataSource);
+
+    TfTokenVector GetNames() override {
+        TfTokenVector names;
+        for (auto const& child : _children) {
+            names.push_back(child.first);
+        }
+        return names;
+    }
+
+    HdDataSourceBaseHandle Get(TfToken const& name) override {
+        for (auto const& child : _children) {
+            if (child.first == name) {
+                return child.second;
+            }
+        }
+        return nullptr;
+    }
+
+    void Set(TfToken const& name, HdDataSourceBaseHandle const& value) {
+        for (auto& child : _children) {
+            if (child.first == name) {
+                child.second = value;
+                return;
+            }
+        }
+        _children.emplace_back(name, value);
+    }
+
+private:
+    _MutableContainerDataSource() = default;
+
+    std::vector<std::pair<TfToken, HdDataSourceBaseHandle>> _children;
+};
+
+HD_DECLARE_DATASOURCE_HANDLES(_MutableContainerDataSource);
+
+std::string _ToString(HdContainerDataSourceHandle const& container) {
+    std::ostringstream stream;
+    HdDebugPrintDataSource(stream, container);
+    return stream.str();
+}
+
+TEST(TestHydra, test_flattening_overlay) {
+    HdContainerDataSourceHandle containers[] = {
+            HdRetainedContainerDataSource::New(TfToken("A"), I(1), TfToken("F"), I(7)),
+
+            HdRetainedContainerDataSource::New(TfToken("B"), I(2), TfToken("C"), I(3), TfToken("D"),
+                                               HdRetainedContainerDataSource::New(TfToken("H"), I(5))),
+
+            HdRetainedContainerDataSource::New(TfToken("D"), HdRetainedContainerDataSource::New(TfToken("E"), I(4)),
+                                               TfToken("F"), I(6), TfToken("G"), I(8)),
+    };
+
+    Hd_FlatteningOverlayContainerDataSourceHandle test = Hd_FlatteningOverlayContainerDataSource::New(3, containers);
+    HdOverlayContainerDataSourceHandle baseline = HdOverlayContainerDataSource::New(3, containers);
+
+    EXPECT_EQ(_ToString(test), _ToString(baseline));
+    // Reading again is served from the memoized children.
+    EXPECT_EQ(test->GetNumMemoizedChildren(), size_t(6));
+    EXPECT_EQ(_ToString(test), _ToString(baseline));
+    EXPECT_EQ(test->GetNumMemoizedChildren(), size_t(6));
+}
+
+TEST(TestHydra, test_flattening_overlay_invalidation) {
+    _MutableContainerDataSourceHandle strongInner = _MutableContainerDataSource::New();
+    strongInner->Set(TfToken("x"), I(1));
+    _MutableContainerDataSourceHandle strong = _MutableContainerDataSource::New();
+    strong->Set(TfToken("A"), I(1));
+    strong->Set(TfToken("P"), strongInner);
+    HdContainerDataSourceHandle weak = HdRetainedContainerDataSource::New(
+            TfToken("A"), I(2), TfToken("P"), HdRetainedContainerDataSource::New(TfToken("y"), I(3)));
+
+    HdContainerDataSourceHandle containers[] = {strong, weak};
+    Hd_FlatteningOverlayContainerDataSourceHandle test = Hd_FlatteningOverlayContainerDataSource::New(2, containers);
+    EXPECT_EQ(_ToString(test), _ToString(HdOverlayContainerDataSource::New(2, containers)));
+
+    // Changes are not seen until their locators are invalidated.
+    strong->Set(TfToken("A"), I(4));
+    strongInner->Set(TfToken("x"), I(5));
+    strong->Set(TfToken("Q"), I(6));
+    const std::string stale = _ToString(test);
+    EXPECT_NE(stale, _ToString(HdOverlayContainerDataSource::New(2, containers)));
+
+    // The nested overlay at P keeps its layers and only drops x.
+    HdDataSourceBaseHandle nested = test->Get(TfToken("P"));
+    test->Invalidate(HdDataSourceLocatorSet{L("A"), L("P/x"), L("Q")});
+    EXPECT_EQ(test->Get(TfToken("P")), nested);
+    EXPECT_EQ(_ToString(test), _ToString(HdOverlayContainerDataSource::New(2, containers)));
+
+    // Replacing a layer's child container replaces the nested overlay.
+    strong->Set(TfToken("P"), HdRetainedContainerDataSource::New(TfToken("z"), I(7)));
+    test->Invalidate(HdDataSourceLocatorSet{L("P/z")});
+    EXPECT_NE(test->Get(TfToken("P")), nested);
+    EXPECT_EQ(_ToString(test), _ToString(HdOverlayContainerDataSource::New(2, containers)));
+
+    // A locator below a child that was not there adds the child's name.
+    strong->Set(TfToken("R"), HdRetainedContainerDataSource::New(TfToken("z"), I(8)));
+    test->Invalidate(HdDataSourceLocatorSet{L("R/z")});
+    const TfTokenVector names = test->GetNames();
+    EXPECT_NE(std::find(names.begin(), names.end(), TfToken("R")), names.end());
+    EXPECT_EQ(_ToString(test), _ToString(HdOverlayContainerDataSource::New(2, containers)));
+
+    test->Invalidate(HdDataSourceLocatorSet::UniversalSet());
+    EXPECT_EQ(test->GetNumMemoizedChildren(), size_t(0));
+}
+
+// Reads the value of every primvar of a prim and returns how many there are.
+size_t _ReadPrimvars(HdContainerDataSourceHandle const& prim) {
+    size_t numPrimvars = 0;
+    HdContainerDataSourceHandle primvars = HdContainerDataSource::Cast(prim->Get(HdPrimvarsSchemaTokens->primvars));
+    for (TfToken const& name : primvars->GetNames()) {
+        HdContainerDataSourceHandle primvar = HdContainerDataSource::Cast(primvars->Get(name));
+        if (HdSampledDataSourceHandle value =
+                    HdSampledDataSource::Cast(primvar->Get(HdPrimvarSchemaTokens->primvarValue))) {
+            value->GetValue(0.0f);
+            ++numPrimvars;
+        }
+    }
+    return numPrimvars;
+}
+
+TEST(TestHydra, test_flattening_overlay_perf) {
+    constexpr size_t numPrims = 10000;
+    constexpr size_t numLayers = 16;
+
+    // Each layer adds four primvars and overrides the interpolation of a
+    // shared one, like a chain of scene indices each contributing a little.
+    std::vector<HdContainerDataSourceHandle> layers;
+    for (size_t k = 0; k != numLayers; ++k) {
+        TfTokenVector names;
+        std::vector<HdDataSourceBaseHandle> primvars;
+        for (size_t j = 0; j != 4; ++j) {
+            names.emplace_back(TfStringPrintf("primvar%zu", 4 * k + j));
+            primvars.push_back(HdRetainedContainerDataSource::New(
+                    HdPrimvarSchemaTokens->primvarValue,
+                    HdRetainedTypedSampledDataSource<float>::New(float(k)),
+                    HdPrimvarSchemaTokens->interpolation,
+                    HdPrimvarSchema::BuildInterpolationDataSource(HdPrimvarSchemaTokens->vertex)));
+        }
+        names.push_back(HdTokens->displayColor);
+        primvars.push_back(HdRetainedContainerDataSource::New(
+                k + 1 == numLayers ? HdPrimvarSchemaTokens->primvarValue : HdPrimvarSchemaTokens->interpolation,
+                k + 1 == numLayers ? HdDataSourceBaseHandle(HdRetainedTypedSampledDataSource<float>::New(1.0f))
+                                   : HdPrimvarSchema::BuildInterpolationDataSource(HdPrimvarSchemaTokens->constant)));
+        layers.push_back(HdRetainedContainerDataSource::New(
+                HdPrimvarsSchemaTokens->primvars,
+                HdRetainedContainerDataSource::New(names.size(), names.data(), primvars.data()),
+                TfToken(TfStringPrintf("layer%zu", k)), I(int(k))));
+    }
+
+    std::vector<HdContainerDataSourceHandle> stockPrims;
+    std::vector<HdContainerDataSourceHandle> flattenedPrims;
+    for (size_t i = 0; i != numPrims; ++i) {
+        stockPrims.push_back(HdOverlayContainerDataSource::New(layers.size(), layers.data()));
+        flattenedPrims.push_back(Hd_FlatteningOverlayContainerDataSource::New(layers));
+    }
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.trials = std::min<size_t>(options.trials, 5);
+    Hd_UnitTestPerfRunner runner(options);
+
+    const size_t expectedNumPrimvars = numPrims * (4 * numLayers + 1);
+    size_t numPrimvars = 0;
+    runner.Measure("overlay_read_primvars_stock_16", [&]() {
+        numPrimvars = 0;
+        for (HdContainerDataSourceHandle const& prim : stockPrims) {
+            numPrimvars += _ReadPrimvars(prim);
+        }
+    });
+    EXPECT_EQ(numPrimvars, expectedNumPrimvars);
+
+    runner.Measure("overlay_read_primvars_flattened_cold_16", [&]() {
+        numPrimvars = 0;
+        for (size_t i = 0; i != numPrims; ++i) {
+            numPrimvars += _ReadPrimvars(Hd_FlatteningOverlayContainerDataSource::New(layers));
+        }
+    });
+    EXPECT_EQ(numPrimvars, expectedNumPrimvars);
+
+    runner.Measure("overlay_read_primvars_flattened_warm_16", [&]() {
+        numPrimvars = 0;
+        for (HdContainerDataSourceHandle const& prim : flattenedPrims) {
+            numPrimvars += _ReadPrimvars(prim);
+        }
+    });
+    EXPECT_EQ(numPrimvars, expectedNumPrimvars);
+
+    EXPECT_TRUE(runner.Finish("testHdFlatteningOverlay.json", "perfstats_flattening_overlay.raw").empty());
+}
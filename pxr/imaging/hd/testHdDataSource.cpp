@@ -14,7 +14,14 @@
 #include "pxr/imaging/hd/materialInterfaceMappingSchema.h"
 
 #include "pxr/imaging/hd/tokens.h"
-
+#include "pxr/base/tf/stringUtils.h"
+#include "dataSourceArena.h"
+#include "flatContainerDataSource.h"
+#include "unitTestPerfRunner.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
 #include <gtest/gtest.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -388,4 +395,171 @@ TEST(TestHydra, test_container_schemas) {
         std::cerr << "unexpected value for mapping node path" << std::endl;
         GTEST_FAIL();
     }
-}
\ No newline at end of file
+}
+//-----------------------------------------------------------------------------
+TEST(TestHydra, test_flat_container_data_source) {
+    auto _IDS = [](int v) {
+        return HdRetainedTypedSampledDataSource<int>::New(v);
+    };
+
+    Hd_FlatContainerDataSourceHandle empty = Hd_FlatContainerDataSource::Builder().Build();
+    EXPECT_EQ(empty->GetSize(), size_t(0));
+    EXPECT_TRUE(empty->GetNames().empty());
+    EXPECT_FALSE(empty->Get(TfToken("a")));
+
+    // Later entries with the same name replace earlier ones.
+    Hd_FlatContainerDataSourceHandle small = Hd_FlatContainerDataSource::Builder()
+                                                     .Set(TfToken("a"), _IDS(1))
+                                                     .Set(TfToken("b"), _IDS(2))
+                                                     .Set(TfToken("a"), _IDS(3))
+                                                     .Build();
+    EXPECT_EQ(small->GetSize(), size_t(2));
+    EXPECT_EQ(HdIntDataSource::Cast(small->Get(TfToken("a")))->GetTypedValue(0.0f), 3);
+    EXPECT_EQ(HdIntDataSource::Cast(small->Get(TfToken("b")))->GetTypedValue(0.0f), 2);
+    EXPECT_FALSE(small->Get(TfToken("c")));
+
+    // Large enough to take the binary search.
+    for (size_t count : {7, 8, 9, 64, 257}) {
+        TfTokenVector names;
+        std::vector<HdDataSourceBaseHandle> values;
+        for (size_t i = 0; i != count; ++i) {
+            names.emplace_back(TfStringPrintf("primvar%zu", i));
+            values.push_back(_IDS(static_cast<int>(i)));
+        }
+        HdContainerDataSourceHandle flat = Hd_FlatContainerDataSource::New(count, names.data(), values.data());
+
+        TfTokenVector flatNames = flat->GetNames();
+        std::sort(flatNames.begin(), flatNames.end());
+        TfTokenVector sortedNames = names;
+        std::sort(sortedNames.begin(), sortedNames.end());
+        EXPECT_EQ(flatNames, sortedNames);
+
+        for (size_t i = 0; i != count; ++i) {
+            EXPECT_EQ(flat->Get(names[i]), values[i]) << names[i] << " of " << count;
+        }
+        EXPECT_FALSE(flat->Get(TfToken("primvar")));
+        EXPECT_FALSE(flat->Get(TfToken(TfStringPrintf("primvar%zu", count))));
+        EXPECT_FALSE(flat->Get(TfToken()));
+    }
+
+    // Works wherever a container is expected.
+    HdContainerDataSourceHandle root = HdRetainedContainerDataSource::New(
+            TfToken("primvars"), Hd_FlatContainerDataSource::Builder().Set(TfToken("x"), _IDS(7)).Build());
+    EXPECT_TRUE(HdContainerDataSource::Get(root, HdDataSourceLocator(TfToken("primvars"), TfToken("x"))));
+}
+
+//-----------------------------------------------------------------------------
+// Builds and queries primvars containers with many entries, as for prims
+// coming from pipelines that attach dozens of primvars, with
+// HdRetainedContainerDataSource and Hd_FlatContainerDataSource.
+TEST(TestHydra, test_flat_container_data_source_perf) {
+    Hd_UnitTestPerfRunner runner;
+    std::mt19937 gen(5109223000);
+
+    const size_t numContainers = 10000;
+    const size_t numLookups = 1000000;
+
+    for (size_t count : {16, 64, 256}) {
+        TfTokenVector names;
+        std::vector<HdDataSourceBaseHandle> values;
+        for (size_t i = 0; i != count; ++i) {
+            names.emplace_back(TfStringPrintf("primvar%zu", i));
+            values.push_back(HdPrimvarSchema::Builder()
+                                     .SetPrimvarValue(HdRetainedTypedSampledDataSource<float>::New(float(i)))
+                                     .SetInterpolation(HdPrimvarSchema::BuildInterpolationDataSource(
+                                             HdPrimvarSchemaTokens->constant))
+                                     .Build());
+        }
+
+        std::vector<HdContainerDataSourceHandle> retained(numContainers);
+        runner.Measure(TfStringPrintf("retained_container_build_%zu", count), [&]() {
+            for (HdContainerDataSourceHandle& container : retained) {
+                container = HdRetainedContainerDataSource::New(count, names.data(), values.data());
+            }
+        });
+        std::vector<HdContainerDataSourceHandle> flat(numContainers);
+        runner.Measure(TfStringPrintf("flat_container_build_%zu", count), [&]() {
+            for (HdContainerDataSourceHandle& container : flat) {
+                container = Hd_FlatContainerDataSource::New(count, names.data(), values.data());
+            }
+        });
+
+        std::vector<size_t> lookups(numLookups);
+        std::uniform_int_distribution<size_t> nameDistrib(0, count - 1);
+        std::uniform_int_distribution<size_t> containerDistrib(0, numContainers - 1);
+        std::vector<size_t> containers(numLookups);
+        for (size_t i = 0; i != numLookups; ++i) {
+            lookups[i] = nameDistrib(gen);
+            containers[i] = containerDistrib(gen);
+        }
+
+        size_t numFound = 0;
+        runner.Measure(TfStringPrintf("retained_container_get_%zu", count), [&]() {
+            numFound = 0;
+            for (size_t i = 0; i != numLookups; ++i) {
+                numFound += bool(retained[containers[i]]->Get(names[lookups[i]]));
+            }
+        });
+        size_t numFlatFound = 0;
+        runner.Measure(TfStringPrintf("flat_container_get_%zu", count), [&]() {
+            numFlatFound = 0;
+            for (size_t i = 0; i != numLookups; ++i) {
+                numFlatFound += bool(flat[containers[i]]->Get(names[lookups[i]]));
+            }
+        });
+        ASSERT_EQ(numFound, numLookups);
+        ASSERT_EQ(numFlatFound, numLookups);
+
+        size_t numNames = 0;
+        runner.Measure(TfStringPrintf("retained_container_get_names_%zu", count), [&]() {
+            numNames = 0;
+            for (HdContainerDataSourceHandle const& container : retained) {
+                numNames += container->GetNames().size();
+            }
+        });
+        size_t numFlatNames = 0;
+        runner.Measure(TfStringPrintf("flat_container_get_names_%zu", count), [&]() {
+            numFlatNames = 0;
+            for (HdContainerDataSourceHandle const& container : flat) {
+                numFlatNames += container->GetNames().size();
+            }
+        });
+        ASSERT_EQ(numNames, numFlatNames);
+    }
+
+    EXPECT_TRUE(runner.Finish("testHdDataSource.json", "perfstats_data_source.raw").empty());
+}
+
+//-----------------------------------------------------------------------------
+TEST(TestHydra, test_data_source_arena) {
+    HdContainerDataSourceHandle container;
+    HdFloatDataSourceHandle value;
+    {
+        // Small blocks, so that the data sources span several of them.
+        Hd_DataSourceArena arena(256);
+
+        value = arena.NewTyped(2.5f);
+        EXPECT_EQ(value->GetTypedValue(0.0f), 2.5f);
+        EXPECT_EQ(arena.NewTyped(true), HdRetainedTypedSampledDataSource<bool>::New(true));
+
+        TfTokenVector names;
+        std::vector<HdDataSourceBaseHandle> values;
+        for (int i = 0; i < 32; ++i) {
+            names.emplace_back(TfStringPrintf("primvar%d", i));
+            values.push_back(arena.NewTyped(i));
+        }
+        container = arena.NewContainer(names.size(), names.data(), values.data());
+
+        const Hd_DataSourceArena::Stats stats = arena.GetStats();
+        EXPECT_EQ(stats.numAllocations, size_t(34));
+        EXPECT_GT(stats.numBlocks, size_t(1));
+        EXPECT_GE(stats.bytesReserved, stats.bytesAllocated);
+    }
+
+    // Data sources outlive the arena they were allocated from.
+    EXPECT_EQ(value->GetTypedValue(0.0f), 2.5f);
+    HdIntDataSourceHandle element = HdIntDataSource::Cast(container->Get(TfToken("primvar17")));
+    ASSERT_TRUE(element);
+    EXPECT_EQ(element->GetTypedValue(0.0f), 17);
+    EXPECT_EQ(container->GetNames().size(), size_t(32));
+}
@@ -5,10 +5,22 @@
 //  property of any third parties.
 
 #include "pxr/imaging/hd/dataSourceLocator.h"
+#include "pxr/imaging/hd/extentSchema.h"
+#include "pxr/imaging/hd/materialBindingsSchema.h"
+#include "pxr/imaging/hd/meshSchema.h"
+#include "pxr/imaging/hd/primvarSchema.h"
+#include "pxr/imaging/hd/primvarsSchema.h"
+#include "pxr/imaging/hd/tokens.h"
+#include "pxr/imaging/hd/visibilitySchema.h"
+#include "pxr/imaging/hd/xformSchema.h"
 #include "pxr/base/tf/denseHashSet.h"
 #include "pxr/base/tf/stringUtils.h"
+#include "internedDataSourceLocator.h"
+#include "trieDataSourceLocatorSet.h"
+#include "unitTestPerfRunner.h"
 #include <iostream>
 #include <algorithm>
+#include <random>
 #include <gtest/gtest.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -653,3 +665,330 @@ TEST(TestHydra, test_locator_set_intersection) {
                       {primvarsColor.GetLastElement(), primvarsOpacity.GetLastElement()});
     }
 }
+
+//-----------------------------------------------------------------------------
+TEST(TestHydra, test_interned_locator) {
+    const Hd_InternedLocator empty;
+    const Hd_InternedLocator ab(_Parse("a/b"));
+    const Hd_InternedLocator abc(_Parse("a/b/c"));
+
+    _ValueCompare("interned equality", ab == Hd_InternedLocator(_Parse("a/b")), true);
+    _ValueCompare("interned append equality", abc == ab.Append(TfToken("c")), true);
+    _ValueCompare("interned inequality", ab == Hd_InternedLocator(_Parse("a/c")), false);
+    _ValueCompare("interned hash", ab.Hash() == Hd_InternedLocator(_Parse("a/b")).Hash(), true);
+    _ValueCompare("interned parent", abc.GetParent() == ab, true);
+    _ValueCompare("interned empty parent", empty.GetParent() == empty, true);
+    _ValueCompare("interned element count", abc.GetElementCount(), size_t(3));
+    _ValueCompare("interned last element", abc.GetLastElement(), TfToken("c"));
+    _LocatorCompare("interned round trip", abc.GetLocator(), "a/b/c");
+    _LocatorCompare("interned empty round trip", empty.GetLocator(), "");
+
+    _ValueCompare("interned has prefix (self)", abc.HasPrefix(abc), true);
+    _ValueCompare("interned has prefix (parent)", abc.HasPrefix(ab), true);
+    _ValueCompare("interned has prefix (empty)", abc.HasPrefix(empty), true);
+    _ValueCompare("interned has prefix (child)", ab.HasPrefix(abc), false);
+    _ValueCompare("interned has prefix (sibling)", abc.HasPrefix(Hd_InternedLocator(_Parse("a/c"))), false);
+    _ValueCompare("interned intersects (child)", ab.Intersects(abc), true);
+    _ValueCompare("interned intersects (sibling)", ab.Intersects(Hd_InternedLocator(_Parse("a/c"))), false);
+
+    // Same cases as test_locator_set_intersects, against the interned set.
+    const HdDataSourceLocatorSet locators = {
+            _Parse("a/b"), _Parse("c/d"), _Parse("a/b/c"), _Parse("f"), _Parse("a/b/d"),
+    };
+    const Hd_InternedLocatorSet interned(locators);
+
+    for (const char* s : {"a", "a/b/e", "a/c", "f", "x/y/z", "", "c", "c/d/e", "f/g"}) {
+        _ValueCompare(TfStringPrintf("Interned set intersects '%s'", s).c_str(),
+                      interned.Intersects(Hd_InternedLocator(_Parse(s))), locators.Intersects(_Parse(s)));
+    }
+
+    _ValueCompare("Interned empty set intersects empty locator", Hd_InternedLocatorSet().Intersects(empty), false);
+    _ValueCompare("Interned universal set intersects anything", Hd_InternedLocatorSet{empty}.Intersects(abc), true);
+    const Hd_InternedLocator q(_Parse("q"));
+    _ValueCompare("Interned set intersects set", interned.Intersects(Hd_InternedLocatorSet{q, abc}), true);
+    _ValueCompare("Interned set intersects unrelated set",
+                  interned.Intersects(Hd_InternedLocatorSet{q, Hd_InternedLocator(_Parse("a/c"))}), false);
+}
+
+//-----------------------------------------------------------------------------
+// Intersects 1M dirty locators, shaped like the per-prim dirties a scene
+// index emits, against the locator sets an rprim typically cares about.
+TEST(TestHydra, test_interned_locator_perf) {
+    const HdDataSourceLocator primvars = HdPrimvarsSchema::GetDefaultLocator();
+
+    std::vector<HdDataSourceLocator> dirtyVocabulary = {
+            HdXformSchema::GetDefaultLocator(),
+            HdVisibilitySchema::GetDefaultLocator(),
+            HdExtentSchema::GetDefaultLocator(),
+            HdMeshSchema::GetTopologyLocator(),
+            HdMaterialBindingsSchema::GetDefaultLocator(),
+            primvars.Append(HdTokens->points).Append(HdPrimvarSchemaTokens->primvarValue),
+            primvars.Append(HdTokens->normals).Append(HdPrimvarSchemaTokens->primvarValue),
+    };
+    for (int i = 0; i < 64; ++i) {
+        const HdDataSourceLocator primvar = primvars.Append(TfToken(TfStringPrintf("attr%d", i)));
+        dirtyVocabulary.push_back(primvar.Append(HdPrimvarSchemaTokens->primvarValue));
+        dirtyVocabulary.push_back(primvar.Append(HdPrimvarSchemaTokens->interpolation));
+    }
+
+    const size_t numDirty = 1000000;
+    std::vector<HdDataSourceLocator> dirty;
+    dirty.reserve(numDirty);
+    std::mt19937 gen(5109223000);
+    std::uniform_int_distribution<size_t> distrib(0, dirtyVocabulary.size() - 1);
+    for (size_t i = 0; i != numDirty; ++i) {
+        dirty.push_back(dirtyVocabulary[distrib(gen)]);
+    }
+
+    const std::vector<HdDataSourceLocatorSet> schemaSets = {
+            // Points and topology, e.g. for a deforming mesh.
+            {primvars.Append(HdTokens->points), HdMeshSchema::GetTopologyLocator()},
+            // Everything a static rprim's sync depends on.
+            {HdXformSchema::GetDefaultLocator(), HdVisibilitySchema::GetDefaultLocator(),
+             HdExtentSchema::GetDefaultLocator(), HdMaterialBindingsSchema::GetDefaultLocator(),
+             primvars.Append(HdTokens->displayColor), primvars.Append(HdTokens->displayOpacity)},
+            // All primvars.
+            {primvars},
+    };
+
+    Hd_UnitTestPerfRunner runner;
+
+    std::vector<Hd_InternedLocator> internedDirty;
+    runner.Measure("locator_intern_1M", [&]() {
+        internedDirty.clear();
+        internedDirty.reserve(dirty.size());
+        for (HdDataSourceLocator const& locator : dirty) {
+            internedDirty.emplace_back(locator);
+        }
+    });
+
+    for (size_t s = 0; s != schemaSets.size(); ++s) {
+        HdDataSourceLocatorSet const& locators = schemaSets[s];
+        const Hd_InternedLocatorSet interned(locators);
+
+        size_t numHits = 0;
+        runner.Measure(TfStringPrintf("locator_set_intersects_1M_set%zu", s), [&]() {
+            numHits = 0;
+            for (HdDataSourceLocator const& locator : dirty) {
+                numHits += locators.Intersects(locator);
+            }
+        });
+
+        size_t numInternedHits = 0;
+        runner.Measure(TfStringPrintf("interned_locator_set_intersects_1M_set%zu", s), [&]() {
+            numInternedHits = 0;
+            for (Hd_InternedLocator const& locator : internedDirty) {
+                numInternedHits += interned.Intersects(locator);
+            }
+        });
+
+        ASSERT_EQ(numHits, numInternedHits);
+    }
+
+    // Pairwise prefix tests, as done when filtering a single dirty entry.
+    const HdDataSourceLocator points = primvars.Append(HdTokens->points);
+    const Hd_InternedLocator internedPoints(points);
+    size_t numHits = 0;
+    runner.Measure("locator_has_prefix_1M", [&]() {
+        numHits = 0;
+        for (HdDataSourceLocator const& locator : dirty) {
+            numHits += locator.HasPrefix(points);
+        }
+    });
+    size_t numInternedHits = 0;
+    runner.Measure("interned_locator_has_prefix_1M", [&]() {
+        numInternedHits = 0;
+        for (Hd_InternedLocator const& locator : internedDirty) {
+            numInternedHits += locator.HasPrefix(internedPoints);
+        }
+    });
+    ASSERT_EQ(numHits, numInternedHits);
+    ASSERT_TRUE(Hd_InternedLocator(dirtyVocabulary[5]).HasPrefix(internedPoints));
+
+    EXPECT_TRUE(runner.Finish("testHdDataSourceLocator.json", "perfstats_locators.raw").empty());
+}
+
+//-----------------------------------------------------------------------------
+TEST(TestHydra, test_trie_locator_set) {
+    {
+        Hd_TrieLocatorSet locators;
+        locators.insert(_Parse("a/b"));
+        locators.insert(_Parse("c/d"));
+        locators.insert(_Parse("a/b/c"));
+        locators.insert(_Parse("f"));
+        locators.insert(_Parse("a/b/d"));
+
+        _ValueCompare("Trie insert exclusion (intersecting)", locators.GetLocators(),
+                      HdDataSourceLocatorSet{_Parse("a/b"), _Parse("c/d"), _Parse("f")});
+        _ValueCompare("Trie size", locators.GetSize(), size_t(3));
+
+        locators.insert(_Parse("c"));
+        _ValueCompare("Trie insert subsumes existing", locators.GetLocators(),
+                      HdDataSourceLocatorSet{_Parse("a/b"), _Parse("c"), _Parse("f")});
+
+        locators.insert(HdDataSourceLocator());
+        _ValueCompare("Trie insert empty locator", locators.GetLocators(),
+                      HdDataSourceLocatorSet{HdDataSourceLocator()});
+        _ValueCompare("Trie universal size", locators.GetSize(), size_t(1));
+
+        locators.Clear();
+        _ValueCompare("Trie cleared", locators.IsEmpty(), true);
+        _ValueCompare("Trie cleared intersects", locators.Intersects(HdDataSourceLocator()), false);
+    }
+
+    // Compare against HdDataSourceLocatorSet on the small and large sets of
+    // the tests above.
+    const std::vector<HdDataSourceLocatorSet> sets = {
+            {_Parse("a/b"), _Parse("c/d"), _Parse("a/b/c"), _Parse("f"), _Parse("a/b/d")},
+            {_Parse("a/b"), _Parse("a/c/d"), _Parse("a/c/e/f"), _Parse("a/c/e/g"), _Parse("g/a"), _Parse("g/b"),
+             _Parse("g/c/c"), _Parse("g/d/b")},
+            {HdDataSourceLocator()},
+    };
+    const std::vector<const char*> queries = {"",    "a",   "a/b/e", "a/c", "f",     "x/y/z", "c",
+                                              "c/d/e", "f/g", "g",     "g/c", "a/c/e", "a/b"};
+    const std::vector<std::pair<const char*, const char*>> replaces = {
+            {"a/b", "a/d"}, {"a/c", "X/Y"}, {"a/c", "a/d"}, {"a/c", "g/b"}, {"", "X/Y"},
+            {"a/", ""},     {"g/", ""},     {"a/c/e/f", "b"}, {"a/b", "a/b/c"}, {"a/c/e", "a"},
+    };
+
+    for (size_t s = 0; s != sets.size(); ++s) {
+        HdDataSourceLocatorSet const& locators = sets[s];
+        const Hd_TrieLocatorSet trie(locators);
+
+        _ValueCompare(TfStringPrintf("Trie round trip (set %zu)", s).c_str(), trie.GetLocators(), locators);
+
+        for (const char* q : queries) {
+            _ValueCompare(TfStringPrintf("Trie intersects '%s' (set %zu)", q, s).c_str(),
+                          trie.Intersects(_Parse(q)), locators.Intersects(_Parse(q)));
+            _ValueCompare(TfStringPrintf("Trie contains '%s' (set %zu)", q, s).c_str(), trie.Contains(_Parse(q)),
+                          locators.Contains(_Parse(q)));
+        }
+
+        for (auto const& replace : replaces) {
+            const HdDataSourceLocator oldPrefix = _Parse(replace.first);
+            const HdDataSourceLocator newPrefix = _Parse(replace.second);
+            const HdDataSourceLocatorSet expected = locators.ReplacePrefix(oldPrefix, newPrefix);
+            const std::string msg = TfStringPrintf("Trie replace '%s' with '%s' (set %zu)", replace.first,
+                                                   replace.second, s);
+
+            const Hd_TrieLocatorSet replaced = trie.ReplacePrefix(oldPrefix, newPrefix);
+            _ValueCompare(msg.c_str(), replaced.GetLocators(), expected);
+            _ValueCompare((msg + " size").c_str(), replaced.GetSize(), size_t(expected.end() - expected.begin()));
+            _ValueCompare((msg + " leaves source").c_str(), trie.GetLocators(), locators);
+
+            // Inserting into the replaced set reuses the nodes it dropped.
+            Hd_TrieLocatorSet reused = replaced;
+            reused.insert(_Parse("z/z"));
+            HdDataSourceLocatorSet expectedReused = expected;
+            expectedReused.insert(_Parse("z/z"));
+            _ValueCompare((msg + " then insert").c_str(), reused.GetLocators(), expectedReused);
+        }
+    }
+
+    const Hd_TrieLocatorSet trie(sets[1]);
+    _ValueCompare("Trie set intersects set", trie.Intersects(Hd_TrieLocatorSet{_Parse("q"), _Parse("g/c")}), true);
+    _ValueCompare("Trie set intersects unrelated set",
+                  trie.Intersects(Hd_TrieLocatorSet{_Parse("q"), _Parse("a/c/x")}), false);
+    _ValueCompare("Trie set intersects universal set", trie.Intersects(Hd_TrieLocatorSet{HdDataSourceLocator()}),
+                  true);
+    _ValueCompare("Trie set intersects empty set", trie.Intersects(Hd_TrieLocatorSet()), false);
+}
+
+//-----------------------------------------------------------------------------
+// Builds and queries primvar-heavy dirty batches, as sent for crowds where
+// every agent dirties a few of thousands of primvars, with
+// HdDataSourceLocatorSet and Hd_TrieLocatorSet.
+TEST(TestHydra, test_trie_locator_set_perf) {
+    const HdDataSourceLocator primvars = HdPrimvarsSchema::GetDefaultLocator();
+    const HdDataSourceLocator instancedPrimvars(TfToken("instancedPrimvars"));
+
+    std::vector<HdDataSourceLocator> primvarLocators;
+    for (int i = 0; i < 4096; ++i) {
+        primvarLocators.push_back(primvars.Append(TfToken(TfStringPrintf("attr%d", i))));
+    }
+
+    Hd_UnitTestPerfRunner runner;
+    std::mt19937 gen(5109223000);
+
+    for (size_t batchSize : {1000, 10000}) {
+        // Mostly primvar values, some interpolation changes, and a few
+        // whole-primvar dirties that subsume the others.
+        std::vector<HdDataSourceLocator> batch;
+        batch.reserve(batchSize + 2);
+        std::uniform_int_distribution<size_t> primvarDistrib(0, primvarLocators.size() - 1);
+        std::uniform_int_distribution<int> kindDistrib(0, 99);
+        for (size_t i = 0; i != batchSize; ++i) {
+            HdDataSourceLocator const& primvar = primvarLocators[primvarDistrib(gen)];
+            const int kind = kindDistrib(gen);
+            if (kind < 80) {
+                batch.push_back(primvar.Append(HdPrimvarSchemaTokens->primvarValue));
+            } else if (kind < 95) {
+                batch.push_back(primvar.Append(HdPrimvarSchemaTokens->interpolation));
+            } else {
+                batch.push_back(primvar);
+            }
+        }
+        batch.push_back(HdXformSchema::GetDefaultLocator());
+        batch.push_back(HdVisibilitySchema::GetDefaultLocator());
+
+        const std::vector<HdDataSourceLocator> queries = {
+                HdXformSchema::GetDefaultLocator(),
+                HdExtentSchema::GetDefaultLocator(),
+                HdMeshSchema::GetTopologyLocator(),
+                primvars.Append(HdTokens->points),
+                primvars.Append(HdTokens->displayColor),
+                primvarLocators[17].Append(HdPrimvarSchemaTokens->primvarValue),
+                primvarLocators[4000].Append(HdPrimvarSchemaTokens->indices),
+                primvars,
+        };
+
+        HdDataSourceLocatorSet locators;
+        runner.Measure(TfStringPrintf("locator_set_insert_%zu", batchSize), [&]() {
+            locators = HdDataSourceLocatorSet();
+            for (HdDataSourceLocator const& locator : batch) {
+                locators.insert(locator);
+            }
+        });
+        runner.Measure(TfStringPrintf("locator_set_bulk_construct_%zu", batchSize),
+                       [&]() { locators = HdDataSourceLocatorSet(batch.begin(), batch.end()); });
+        Hd_TrieLocatorSet trie;
+        runner.Measure(TfStringPrintf("trie_locator_set_insert_%zu", batchSize), [&]() {
+            trie.Clear();
+            for (HdDataSourceLocator const& locator : batch) {
+                trie.insert(locator);
+            }
+        });
+        ASSERT_EQ(trie.GetLocators(), locators);
+
+        size_t numHits = 0;
+        runner.Measure(TfStringPrintf("locator_set_intersects_%zu", batchSize), [&]() {
+            numHits = 0;
+            for (HdDataSourceLocator const& query : queries) {
+                numHits += locators.Intersects(query);
+            }
+        });
+        size_t numTrieHits = 0;
+        runner.Measure(TfStringPrintf("trie_locator_set_intersects_%zu", batchSize), [&]() {
+            numTrieHits = 0;
+            for (HdDataSourceLocator const& query : queries) {
+                numTrieHits += trie.Intersects(query);
+            }
+        });
+        ASSERT_EQ(numHits, numTrieHits);
+
+        HdDataSourceLocatorSet replaced;
+        runner.Measure(TfStringPrintf("locator_set_replace_prefix_%zu", batchSize),
+                       [&]() { replaced = locators.ReplacePrefix(primvars, instancedPrimvars); });
+        Hd_TrieLocatorSet trieReplaced;
+        runner.Measure(TfStringPrintf("trie_locator_set_replace_prefix_%zu", batchSize),
+                       [&]() { trieReplaced = trie.ReplacePrefix(primvars, instancedPrimvars); });
+        ASSERT_EQ(trieReplaced.GetLocators(), replaced);
+        runner.Measure(TfStringPrintf("trie_locator_set_replace_prefix_in_place_%zu", batchSize), [&]() {
+            trie.ReplacePrefixInPlace(primvars, instancedPrimvars);
+            trie.ReplacePrefixInPlace(instancedPrimvars, primvars);
+        });
+        ASSERT_EQ(trie.GetLocators(), locators);
+    }
+
+    EXPECT_TRUE(runner.Finish("testHdDataSourceLocatorTrie.json", "perfstats_locator_trie.raw").empty());
+}
@@ -5,12 +5,28 @@
 //  property of any third parties.
 
 #include "pxr/imaging/hd/cameraSchema.h"
+#include "pxr/imaging/hd/categoriesSchema.h"
 #include "pxr/imaging/hd/changeTracker.h"
 #include "pxr/imaging/hd/dirtyBitsTranslator.h"
+#include "pxr/imaging/hd/extentSchema.h"
+#include "pxr/imaging/hd/instancedBySchema.h"
+#include "pxr/imaging/hd/materialBindingsSchema.h"
+#include "pxr/imaging/hd/meshSchema.h"
+#include "pxr/imaging/hd/primvarSchema.h"
+#include "pxr/imaging/hd/primvarsSchema.h"
+#include "pxr/imaging/hd/purposeSchema.h"
+#include "pxr/imaging/hd/tokens.h"
+#include "pxr/imaging/hd/visibilitySchema.h"
+#include "pxr/imaging/hd/xformSchema.h"
 
 #include "pxr/base/tf/staticTokens.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "compiledDirtyBitsTable.h"
+#include "unitTestPerfRunner.h"
 
 #include <iostream>
+#include <random>
+#include <vector>
 #include <gtest/gtest.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -23,7 +39,7 @@ enum _TacoDirtyBits : HdDirtyBits {
     AllDirty = (DirtyProtein | DirtyTortilla | DirtySalsa)
 };
 
-TF_DEFINE_PRIVATE_TOKENS(_tokens, (taco)(burger)(protein)(tortilla)(salsa));
+TF_DEFINE_PRIVATE_TOKENS(_tokens, (taco)(compiledTaco)(burger)(protein)(tortilla)(salsa)(spicy));
 
 void _ConvertLocatorSetToDirtyBitsForTacos(HdDataSourceLocatorSet const& set, HdDirtyBits* bits) {
     if (set.Intersects(HdDataSourceLocator(_tokens->taco, _tokens->protein))) {
@@ -53,12 +69,45 @@ void _ConvertDirtyBitsToLocatorSetForTacos(const HdDirtyBits bits, HdDataSourceL
     }
 }
 
+// Same mapping as the taco translators above, plus a three element entry,
+// compiled into a table.
+static const Hd_CompiledDirtyBitsTable& _GetTacoTable() {
+    static const Hd_CompiledDirtyBitsTable table = {
+            {HdDataSourceLocator(_tokens->taco, _tokens->protein), DirtyProtein},
+            {HdDataSourceLocator(_tokens->taco, _tokens->tortilla), DirtyTortilla},
+            {HdDataSourceLocator(_tokens->taco, _tokens->salsa), DirtySalsa},
+            {HdDataSourceLocator(_tokens->taco, _tokens->salsa, _tokens->spicy), DirtyProtein},
+    };
+    return table;
+}
+
+void _ConvertLocatorSetToDirtyBitsForCompiledTacos(HdDataSourceLocatorSet const& set, HdDirtyBits* bits) {
+    (*bits) |= _GetTacoTable().Translate(set);
+}
+
+void _ConvertDirtyBitsToLocatorSetForCompiledTacos(const HdDirtyBits bits, HdDataSourceLocatorSet* set) {
+    _GetTacoTable().ToLocatorSet(bits, set);
+}
+
+// Registers the taco and compiled taco translators once, so that each test
+// can run on its own or in any order.
+static void _RegisterTacoTranslators() {
+    static const bool registered = [] {
+        // This call would normally go in the type registry for something like a
+        // prim adapter, render delegate or scene delegate (who might care deeply
+        // about the dirtiness of tacos)
+        HdDirtyBitsTranslator::RegisterTranslatorsForCustomSprimType(
+                _tokens->taco, _ConvertLocatorSetToDirtyBitsForTacos, _ConvertDirtyBitsToLocatorSetForTacos);
+        HdDirtyBitsTranslator::RegisterTranslatorsForCustomSprimType(_tokens->compiledTaco,
+                                                                     _ConvertLocatorSetToDirtyBitsForCompiledTacos,
+                                                                     _ConvertDirtyBitsToLocatorSetForCompiledTacos);
+        return true;
+    }();
+    (void)registered;
+}
+
 TEST(TestHydra, test_custom_sprim_types) {
-    // This call would normally go in the type registry for something like a
-    // prim adapter, render delegate or scene delegate (who might care deeply
-    // about the dirtiness of tacos)
-    HdDirtyBitsTranslator::RegisterTranslatorsForCustomSprimType(_tokens->taco, _ConvertLocatorSetToDirtyBitsForTacos,
-                                                                 _ConvertDirtyBitsToLocatorSetForTacos);
+    _RegisterTacoTranslators();
 
     // confirm that dirtying an unrelated locator does not dirty a taco
     HdDataSourceLocatorSet dirtyStuff(HdCameraSchema::GetDefaultLocator());
@@ -84,3 +133,124 @@ TEST(TestHydra, test_custom_sprim_types) {
         GTEST_FAIL();
     }
 }
+
+TEST(TestHydra, test_compiled_dirty_bits_table) {
+    _RegisterTacoTranslators();
+
+    const HdDataSourceLocator taco(_tokens->taco);
+    const HdDataSourceLocator salsa(_tokens->taco, _tokens->salsa);
+    const HdDataSourceLocator spicySalsa = salsa.Append(_tokens->spicy);
+    const HdDataSourceLocator mildSalsa = salsa.Append(TfToken("mild"));
+
+    Hd_CompiledDirtyBitsTable const& table = _GetTacoTable();
+    EXPECT_EQ(table.GetAllBits(), HdDirtyBits(AllDirty));
+    EXPECT_EQ(table.Translate(HdDataSourceLocator()), HdDirtyBits(AllDirty));
+    EXPECT_EQ(table.Translate(taco), HdDirtyBits(AllDirty));
+    EXPECT_EQ(table.Translate(salsa), HdDirtyBits(DirtySalsa | DirtyProtein));
+    EXPECT_EQ(table.Translate(spicySalsa), HdDirtyBits(DirtySalsa | DirtyProtein));
+    EXPECT_EQ(table.Translate(mildSalsa), HdDirtyBits(DirtySalsa));
+    EXPECT_EQ(table.Translate(HdDataSourceLocator(_tokens->taco, _tokens->burger)), HdDirtyBits(Clean));
+    EXPECT_EQ(table.Translate(HdCameraSchema::GetDefaultLocator()), HdDirtyBits(Clean));
+
+    // The registered translators agree with the chained Intersects checks.
+    const std::vector<HdDataSourceLocatorSet> sets = {
+            {},
+            {HdCameraSchema::GetDefaultLocator()},
+            {taco},
+            {mildSalsa},
+            {HdDataSourceLocator(_tokens->taco, _tokens->tortilla), mildSalsa},
+            {HdDataSourceLocator(_tokens->taco, _tokens->protein).Append(TfToken("beans"))},
+    };
+    for (HdDataSourceLocatorSet const& set : sets) {
+        EXPECT_EQ(HdDirtyBitsTranslator::SprimLocatorSetToDirtyBits(_tokens->compiledTaco, set),
+                  HdDirtyBitsTranslator::SprimLocatorSetToDirtyBits(_tokens->taco, set))
+                << set;
+    }
+
+    HdDataSourceLocatorSet set;
+    HdDirtyBitsTranslator::SprimDirtyBitsToLocatorSet(_tokens->compiledTaco, DirtySalsa, &set);
+    EXPECT_EQ(set, HdDataSourceLocatorSet(salsa));
+    EXPECT_EQ(HdDirtyBitsTranslator::SprimLocatorSetToDirtyBits(_tokens->compiledTaco, set),
+              HdDirtyBits(DirtySalsa | DirtyProtein));
+}
+
+// Translates one notice worth of dirtied meshes, 100k prims with a few
+// dirty locators each, with chained Intersects checks, with a compiled
+// table holding the same mapping, and with the built-in rprim translator.
+TEST(TestHydra, test_compiled_dirty_bits_table_perf) {
+    const HdDataSourceLocator primvars = HdPrimvarsSchema::GetDefaultLocator();
+    const std::vector<Hd_CompiledDirtyBitsTable::Entry> entries = {
+            {HdXformSchema::GetDefaultLocator(), HdChangeTracker::DirtyTransform},
+            {HdVisibilitySchema::GetDefaultLocator(), HdChangeTracker::DirtyVisibility},
+            {HdExtentSchema::GetDefaultLocator(), HdChangeTracker::DirtyExtent},
+            {HdPurposeSchema::GetDefaultLocator(), HdChangeTracker::DirtyRenderTag},
+            {HdCategoriesSchema::GetDefaultLocator(), HdChangeTracker::DirtyCategories},
+            {HdInstancedBySchema::GetDefaultLocator(), HdChangeTracker::DirtyInstancer},
+            {HdMaterialBindingsSchema::GetDefaultLocator(), HdChangeTracker::DirtyMaterialId},
+            {HdMeshSchema::GetTopologyLocator(), HdChangeTracker::DirtyTopology},
+            {HdMeshSchema::GetDefaultLocator().Append(HdMeshSchemaTokens->doubleSided),
+             HdChangeTracker::DirtyDoubleSided},
+            {HdMeshSchema::GetDefaultLocator().Append(HdMeshSchemaTokens->subdivisionTags),
+             HdChangeTracker::DirtySubdivTags},
+            {primvars.Append(HdTokens->points), HdChangeTracker::DirtyPoints},
+            {primvars.Append(HdTokens->normals), HdChangeTracker::DirtyNormals},
+            {primvars.Append(HdTokens->widths), HdChangeTracker::DirtyWidths},
+            {primvars, HdChangeTracker::DirtyPrimvar},
+    };
+    const Hd_CompiledDirtyBitsTable table(entries);
+
+    std::vector<HdDataSourceLocator> dirtyVocabulary = {
+            HdXformSchema::GetDefaultLocator(),
+            HdVisibilitySchema::GetDefaultLocator(),
+            HdExtentSchema::GetDefaultLocator(),
+            HdMeshSchema::GetTopologyLocator(),
+            primvars.Append(HdTokens->points).Append(HdPrimvarSchemaTokens->primvarValue),
+            primvars.Append(HdTokens->normals).Append(HdPrimvarSchemaTokens->primvarValue),
+    };
+    for (int i = 0; i < 16; ++i) {
+        dirtyVocabulary.push_back(primvars.Append(TfToken(TfStringPrintf("attr%d", i)))
+                                          .Append(HdPrimvarSchemaTokens->primvarValue));
+    }
+
+    const size_t numPrims = 100000;
+    std::vector<HdDataSourceLocatorSet> dirtySets(numPrims);
+    std::mt19937 gen(5109223000);
+    std::uniform_int_distribution<size_t> locatorDistrib(0, dirtyVocabulary.size() - 1);
+    std::uniform_int_distribution<size_t> countDistrib(1, 4);
+    for (HdDataSourceLocatorSet& set : dirtySets) {
+        for (size_t i = countDistrib(gen); i != 0; --i) {
+            set.insert(dirtyVocabulary[locatorDistrib(gen)]);
+        }
+    }
+
+    Hd_UnitTestPerfRunner runner;
+    std::vector<HdDirtyBits> chainedBits(numPrims);
+    runner.Measure("dirty_bits_chained_intersects_100k", [&]() {
+        for (size_t i = 0; i != numPrims; ++i) {
+            HdDirtyBits bits = HdChangeTracker::Clean;
+            for (Hd_CompiledDirtyBitsTable::Entry const& entry : entries) {
+                if (dirtySets[i].Intersects(entry.first)) {
+                    bits |= entry.second;
+                }
+            }
+            chainedBits[i] = bits;
+        }
+    });
+    std::vector<HdDirtyBits> compiledBits(numPrims);
+    runner.Measure("dirty_bits_compiled_table_100k", [&]() {
+        for (size_t i = 0; i != numPrims; ++i) {
+            compiledBits[i] = table.Translate(dirtySets[i]);
+        }
+    });
+    ASSERT_EQ(chainedBits, compiledBits);
+
+    std::vector<HdDirtyBits> translatorBits(numPrims);
+    runner.Measure("dirty_bits_translator_mesh_100k", [&]() {
+        for (size_t i = 0; i != numPrims; ++i) {
+            translatorBits[i] = HdDirtyBitsTranslator::RprimLocatorSetToDirtyBits(HdPrimTypeTokens->mesh,
+                                                                                  dirtySets[i]);
+        }
+    });
+
+    EXPECT_TRUE(runner.Finish("testHdDirtyBitsTranslator.json", "perfstats_dirty_bits.raw").empty());
+}
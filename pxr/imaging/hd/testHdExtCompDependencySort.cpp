@@ -7,12 +7,18 @@
 #include "pxr/pxr.h"
 #include "pxr/imaging/hd/extComputation.h"
 #include "pxr/imaging/hd/extComputationUtils.h"
+#include "pxr/base/tf/stringUtils.h"
 #include "pxr/usd/sdf/path.h"
+#include "extComputationSchedule.h"
+#include "unitTestPerfRunner.h"
 
 #include <algorithm>
 #include <iostream>
 #include <memory>
+#include <random>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include <gtest/gtest.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -132,3 +138,159 @@ TEST(TestHydra, test_cycle_dependency) {
     HdExtComputationConstPtrVector sortedComps;
     ASSERT_FALSE(HdExtComputationUtils::DependencySort(cdm, &sortedComps));
 }
+
+static bool DependsOn(HdExtComputationUtils::ComputationDependencyMap const& cdm,
+                      HdExtComputationConstPtr comp,
+                      HdExtComputationConstPtr dependency) {
+    const auto it = cdm.find(comp);
+    return it != cdm.end() && std::find(it->second.begin(), it->second.end(), dependency) != it->second.end();
+}
+
+TEST(TestHydra, test_schedule_tree_dependency) {
+    // Same tree as test_tree_chain_dependency:
+    // A <-- B <-- C
+    // ^     ^
+    // |     '-- D <-- E
+    // '-- F
+    HdExtComputationSharedPtr compA(new HdExtComputation(SdfPath("A")));
+    HdExtComputationSharedPtr compB(new HdExtComputation(SdfPath("B")));
+    HdExtComputationSharedPtr compC(new HdExtComputation(SdfPath("C")));
+    HdExtComputationSharedPtr compD(new HdExtComputation(SdfPath("D")));
+    HdExtComputationSharedPtr compE(new HdExtComputation(SdfPath("E")));
+    HdExtComputationSharedPtr compF(new HdExtComputation(SdfPath("F")));
+    HdExtComputationUtils::ComputationDependencyMap cdm;
+    cdm[compA.get()] = {compB.get(), compF.get()};
+    cdm[compB.get()] = {compC.get(), compD.get()};
+    cdm[compD.get()] = {compE.get()};
+    cdm[compC.get()] = {};
+    cdm[compE.get()] = {};
+    cdm[compF.get()] = {};
+
+    const Hd_ExtComputationSchedule schedule(cdm);
+    HdExtComputationConstPtrVector const& sortedComps = schedule.GetSortedComputations();
+    PrintComputations(sortedComps, "Scheduled");
+
+    ASSERT_TRUE(schedule.IsValid());
+    ASSERT_EQ(sortedComps.size(), cdm.size());
+    ASSERT_TRUE(OccursBefore(sortedComps, compF.get(), compA.get()) &&
+                OccursBefore(sortedComps, compC.get(), compB.get()) &&
+                OccursBefore(sortedComps, compE.get(), compD.get()) &&
+                OccursBefore(sortedComps, compD.get(), compB.get()) &&
+                OccursBefore(sortedComps, compB.get(), compA.get()));
+
+    // Wavefronts: {C, E, F}, {D}, {B}, {A}.
+    ASSERT_EQ(schedule.GetNumLevels(), 4u);
+    const TfSpan<HdExtComputation const* const> leaves = schedule.GetLevel(0);
+    ASSERT_EQ(std::set<HdExtComputationConstPtr>(leaves.begin(), leaves.end()),
+              std::set<HdExtComputationConstPtr>({compC.get(), compE.get(), compF.get()}));
+    ASSERT_EQ(schedule.GetLevel(1).size(), 1u);
+    ASSERT_EQ(schedule.GetLevel(1)[0], compD.get());
+    ASSERT_EQ(schedule.GetLevel(2)[0], compB.get());
+    ASSERT_EQ(schedule.GetLevel(3)[0], compA.get());
+
+    ASSERT_EQ(schedule.GetCriticalPathLength(), 4u);
+    ASSERT_EQ(schedule.GetCriticalPath(),
+              HdExtComputationConstPtrVector({compE.get(), compD.get(), compB.get(), compA.get()}));
+}
+
+TEST(TestHydra, test_schedule_cycle_dependency) {
+    // Same graph as test_cycle_dependency, where B, C and D form a cycle.
+    HdExtComputationSharedPtr compA(new HdExtComputation(SdfPath("A")));
+    HdExtComputationSharedPtr compB(new HdExtComputation(SdfPath("B")));
+    HdExtComputationSharedPtr compC(new HdExtComputation(SdfPath("C")));
+    HdExtComputationSharedPtr compD(new HdExtComputation(SdfPath("D")));
+    HdExtComputationSharedPtr compE(new HdExtComputation(SdfPath("E")));
+    HdExtComputationSharedPtr compF(new HdExtComputation(SdfPath("F")));
+    HdExtComputationUtils::ComputationDependencyMap cdm;
+    cdm[compA.get()] = {compB.get(), compF.get()};
+    cdm[compB.get()] = {compD.get()};
+    cdm[compC.get()] = {compB.get()};
+    cdm[compD.get()] = {compC.get(), compE.get()};
+    cdm[compE.get()] = {};
+    cdm[compF.get()] = {};
+
+    const Hd_ExtComputationSchedule schedule(cdm);
+    ASSERT_FALSE(schedule.IsValid());
+    std::cout << "Cycle: " << schedule.GetCycleDescription() << std::endl;
+
+    HdExtComputationConstPtrVector const& cycle = schedule.GetCycle();
+    ASSERT_EQ(std::set<HdExtComputationConstPtr>(cycle.begin(), cycle.end()),
+              std::set<HdExtComputationConstPtr>({compB.get(), compC.get(), compD.get()}));
+    for (size_t i = 0; i != cycle.size(); ++i) {
+        ASSERT_TRUE(DependsOn(cdm, cycle[i], cycle[(i + 1) % cycle.size()]));
+    }
+
+    // Only the computations that do not depend on the cycle are scheduled.
+    HdExtComputationConstPtrVector const& sortedComps = schedule.GetSortedComputations();
+    ASSERT_EQ(std::set<HdExtComputationConstPtr>(sortedComps.begin(), sortedComps.end()),
+              std::set<HdExtComputationConstPtr>({compE.get(), compF.get()}));
+}
+
+TEST(TestHydra, test_schedule_perf) {
+    Hd_UnitTestPerfRunner::Options options;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    // The sorts only use the computations' addresses, so they share an id.
+    const SdfPath id("/Computation");
+    std::mt19937 randomGen(17);
+    for (size_t numComps : {10000, 100000, 1000000}) {
+        // Each computation depends on up to three distinct computations among
+        // the previous 64, which gives long chains like a rig's.
+        std::vector<std::unique_ptr<HdExtComputation>> comps;
+        comps.reserve(numComps);
+        HdExtComputationUtils::ComputationDependencyMap cdm;
+        cdm.reserve(numComps);
+        for (size_t i = 0; i != numComps; ++i) {
+            comps.emplace_back(new HdExtComputation(id));
+            HdExtComputationConstPtrVector& dependencies = cdm[comps.back().get()];
+            const size_t window = std::min<size_t>(i, 64);
+            for (size_t d = 0; d != std::min<size_t>(window, 3); ++d) {
+                HdExtComputationConstPtr dependency;
+                do {
+                    dependency = comps[i - 1 - randomGen() % window].get();
+                } while (std::find(dependencies.begin(), dependencies.end(), dependency) != dependencies.end());
+                dependencies.push_back(dependency);
+            }
+        }
+
+        // The stock sort only runs on the smallest graph to keep the test
+        // short.
+        if (numComps == 10000) {
+            runner.Measure(TfStringPrintf("dependency_sort_stock_%zu", numComps), [&]() {
+                HdExtComputationConstPtrVector sortedComps;
+                EXPECT_TRUE(HdExtComputationUtils::DependencySort(cdm, &sortedComps));
+            });
+        }
+
+        Hd_ExtComputationSchedule schedule;
+        runner.Measure(TfStringPrintf("dependency_schedule_%zu", numComps),
+                       [&]() { schedule = Hd_ExtComputationSchedule(cdm); });
+        ASSERT_TRUE(schedule.IsValid());
+        ASSERT_EQ(schedule.GetSortedComputations().size(), numComps);
+
+        // Every computation is on a later level than its dependencies, and
+        // the levels match the longest chains.
+        std::unordered_map<HdExtComputationConstPtr, size_t> levels;
+        size_t longestChain = 0;
+        for (size_t level = 0; level != schedule.GetNumLevels(); ++level) {
+            for (HdExtComputationConstPtr comp : schedule.GetLevel(level)) {
+                size_t chain = 0;
+                for (HdExtComputationConstPtr dependency : cdm.at(comp)) {
+                    ASSERT_TRUE(levels.count(dependency) && levels[dependency] < level);
+                    chain = std::max(chain, levels[dependency] + 1);
+                }
+                ASSERT_EQ(chain, level);
+                levels[comp] = level;
+                longestChain = std::max(longestChain, chain + 1);
+            }
+        }
+        ASSERT_EQ(schedule.GetCriticalPathLength(), longestChain);
+        HdExtComputationConstPtrVector const& criticalPath = schedule.GetCriticalPath();
+        for (size_t i = 1; i < criticalPath.size(); ++i) {
+            ASSERT_TRUE(DependsOn(cdm, criticalPath[i], criticalPath[i - 1]));
+        }
+    }
+
+    EXPECT_TRUE(runner.Finish("testHdExtCompDependencySort.json", "perfstats_ext_comp_dependency_sort.raw").empty());
+}
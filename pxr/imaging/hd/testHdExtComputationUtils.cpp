@@ -6,14 +6,23 @@
 
 #include "pxr/pxr.h"
 
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/rotation.h"
+#include "pxr/base/gf/vec3f.h"
 #include "pxr/base/tf/errorMark.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/vt/array.h"
+#include "pxr/base/work/threadLimits.h"
 
 #include "pxr/imaging/hd/extComputation.h"
 #include "pxr/imaging/hd/extComputationContext.h"
 #include "pxr/imaging/hd/extComputationUtils.h"
 #include "pxr/imaging/hd/renderDelegate.h"
 #include "pxr/imaging/hd/unitTestDelegate.h"
+#include "parallelExtComputationSampler.h"
+#include "unitTestPerfRunner.h"
 
+#include <cmath>
 #include <iostream>
 #include <gtest/gtest.h>
 
@@ -224,3 +233,552 @@ TEST(TestHydra, test_ext_computation_utils) {
     RunTest();
     ASSERT_TRUE(mark.IsClean());
 }
+
+template <unsigned int CAPACITY>
+static void ExpectSameSamples(HdExtComputationUtils::SampledValueStore<CAPACITY> const& expected,
+                              HdExtComputationUtils::SampledValueStore<CAPACITY> const& result) {
+    ASSERT_EQ(result.size(), expected.size());
+    for (auto const& entry : expected) {
+        auto const& expectedSamples = entry.second;
+        auto const& samples = result.at(entry.first);
+        ASSERT_EQ(samples.count, expectedSamples.count);
+        for (size_t i = 0; i != expectedSamples.count; ++i) {
+            EXPECT_EQ(samples.times[i], expectedSamples.times[i]);
+            EXPECT_EQ(samples.values[i], expectedSamples.values[i]);
+        }
+    }
+}
+
+TEST(TestHydra, test_parallel_ext_computation_sampler) {
+    TfErrorMark mark;
+
+    ExtCompTestRenderDelegate renderDelegate;
+    std::unique_ptr<HdRenderIndex> index(HdRenderIndex::New(&renderDelegate, {}));
+    ExtComputationTestDelegate delegate(index.get());
+    for (const SdfPath& comp : {compA, compB, compC}) {
+        index->InsertSprim(HdPrimTypeTokens->extComputation, &delegate, comp);
+        HdDirtyBits dirty = HdExtComputation::DirtyBits::AllDirty;
+        index->GetSprim(HdPrimTypeTokens->extComputation, comp)->Sync(&delegate, nullptr, &dirty);
+    }
+
+    const HdExtComputationPrimvarDescriptorVector compPrimvars =
+            delegate.GetExtComputationPrimvarDescriptors(pathA, HdInterpolationConstant);
+    const size_t maxSamples = 5;
+    HdExtComputationUtils::SampledValueStore<4> expected;
+    HdExtComputationUtils::SampleComputedPrimvarValues(compPrimvars, &delegate, maxSamples, &expected);
+
+    Hd_ParallelExtComputationSampler<4> sampler(&delegate);
+    HdExtComputationUtils::SampledValueStore<4> valueStore;
+    ASSERT_TRUE(sampler.SampleComputedPrimvarValues(compPrimvars, maxSamples, &valueStore));
+    ExpectSameSamples(expected, valueStore);
+    // computationB and computationC aggregate inputs; only computationA is
+    // invoked, once per sample time.
+    ASSERT_EQ(sampler.GetNumInvocations(), maxSamples);
+
+    // Sampling again reuses the memoized outputs.
+    valueStore.clear();
+    ASSERT_TRUE(sampler.SampleComputedPrimvarValues(compPrimvars, maxSamples, &valueStore));
+    ExpectSameSamples(expected, valueStore);
+    ASSERT_EQ(sampler.GetNumInvocations(), maxSamples);
+
+    sampler.Clear();
+    ASSERT_TRUE(sampler.SampleComputedPrimvarValues(compPrimvars, maxSamples, &valueStore));
+    ASSERT_EQ(sampler.GetNumInvocations(), 2 * maxSamples);
+
+    ASSERT_TRUE(mark.IsClean());
+}
+
+// Delegate whose computations fail: each prim reads an input aggregation
+// through one computation, whose other input is missing, that raises an
+// error on demand, or that is part of a cycle:
+//
+// /Missing/inputs -> /Missing/comp <- /Missing/absent (no sprim)
+// /Raise/inputs -> /Raise/comp
+// /Cycle/inputs -> /Cycle/comp <-> /Cycle/other
+//
+class FailingExtComputationTestDelegate : public HdUnitTestDelegate {
+public:
+    FailingExtComputationTestDelegate(HdRenderIndex* parentIndex)
+        : HdUnitTestDelegate(parentIndex, SdfPath::AbsoluteRootPath()) {}
+
+    static SdfPathVector GetComputationPaths() {
+        return {SdfPath("/Missing/inputs"), SdfPath("/Missing/comp"), SdfPath("/Raise/inputs"), SdfPath("/Raise/comp"),
+                SdfPath("/Cycle/inputs"), SdfPath("/Cycle/comp"), SdfPath("/Cycle/other")};
+    }
+
+    HdExtComputationPrimvarDescriptorVector GetExtComputationPrimvarDescriptors(
+            SdfPath const& id, HdInterpolation interpolationMode) override {
+        if (interpolationMode != HdInterpolationConstant) {
+            return {};
+        }
+        return {{primvarName, HdInterpolationConstant, HdPrimvarRoleTokens->none, id.AppendChild(_comp),
+                 compOutputName, {HdTypeDouble, 1}}};
+    }
+
+    TfTokenVector GetExtComputationSceneInputNames(SdfPath const& computationId) override {
+        if (computationId.GetNameToken() == _inputs) {
+            return {input1};
+        }
+        return {};
+    }
+
+    HdExtComputationInputDescriptorVector GetExtComputationInputDescriptors(SdfPath const& computationId) override {
+        const SdfPath primPath = computationId.GetParentPath();
+        if (computationId.GetNameToken() == _comp) {
+            HdExtComputationInputDescriptorVector inputs = {{input1, primPath.AppendChild(_inputs), input1}};
+            if (primPath == SdfPath("/Missing")) {
+                inputs.emplace_back(input2, primPath.AppendChild(TfToken("absent")), compOutputName);
+            } else if (primPath == SdfPath("/Cycle")) {
+                inputs.emplace_back(input2, primPath.AppendChild(_other), compOutputName);
+            }
+            return inputs;
+        } else if (computationId.GetNameToken() == _other) {
+            return {{input2, primPath.AppendChild(_comp), compOutputName}};
+        }
+        return {};
+    }
+
+    HdExtComputationOutputDescriptorVector GetExtComputationOutputDescriptors(
+            SdfPath const& computationId) override {
+        if (computationId.GetNameToken() == _inputs) {
+            return {};
+        }
+        return {{compOutputName, {HdTypeDouble, 1}}};
+    }
+
+    size_t SampleExtComputationInput(SdfPath const& computationId,
+                                     TfToken const& input,
+                                     size_t maxSampleCount,
+                                     float* sampleTimes,
+                                     VtValue* sampleValues) override {
+        if (computationId.GetNameToken() != _inputs || input != input1 || maxSampleCount == 0) {
+            return 0;
+        }
+        sampleTimes[0] = 0.0f;
+        sampleValues[0] = VtValue(1.0);
+        return 1;
+    }
+
+    void InvokeExtComputation(SdfPath const& computationId, HdExtComputationContext* context) override {
+        if (raiseError) {
+            context->RaiseComputationError();
+            return;
+        }
+        context->SetOutputValue(compOutputName, context->GetInputValue(input1));
+    }
+
+    bool raiseError = true;
+
+private:
+    const TfToken _inputs{"inputs"};
+    const TfToken _comp{"comp"};
+    const TfToken _other{"other"};
+};
+
+TEST(TestHydra, test_parallel_ext_computation_sampler_errors) {
+    TfErrorMark mark;
+
+    ExtCompTestRenderDelegate renderDelegate;
+    std::unique_ptr<HdRenderIndex> index(HdRenderIndex::New(&renderDelegate, {}));
+    FailingExtComputationTestDelegate delegate(index.get());
+    for (SdfPath const& comp : delegate.GetComputationPaths()) {
+        index->InsertSprim(HdPrimTypeTokens->extComputation, &delegate, comp);
+        HdDirtyBits dirty = HdExtComputation::DirtyBits::AllDirty;
+        index->GetSprim(HdPrimTypeTokens->extComputation, comp)->Sync(&delegate, nullptr, &dirty);
+    }
+    auto primvarsOf = [&](char const* primPath) {
+        return delegate.GetExtComputationPrimvarDescriptors(SdfPath(primPath), HdInterpolationConstant);
+    };
+
+    Hd_ParallelExtComputationSampler<4> sampler(&delegate);
+    HdExtComputationUtils::SampledValueStore<4> valueStore;
+    valueStore[primvarName].Resize(1);
+
+    // A missing source computation is a runtime error, and the value store is
+    // left unchanged.  The error is posted on whichever thread invoked it.
+    ASSERT_FALSE(sampler.SampleComputedPrimvarValues(primvarsOf("/Missing"), 4, &valueStore));
+    mark.Clear();
+    EXPECT_EQ(sampler.GetNumInvocations(), 0u);
+    EXPECT_EQ(valueStore.size(), 1u);
+
+    // Cycles are reported before anything is invoked.
+    ASSERT_FALSE(sampler.SampleComputedPrimvarValues(primvarsOf("/Cycle"), 4, &valueStore));
+    EXPECT_EQ(sampler.GetNumInvocations(), 0u);
+
+    // A raised error is memoized like any output until Clear().
+    ASSERT_FALSE(sampler.SampleComputedPrimvarValues(primvarsOf("/Raise"), 4, &valueStore));
+    EXPECT_EQ(sampler.GetNumInvocations(), 1u);
+    delegate.raiseError = false;
+    ASSERT_FALSE(sampler.SampleComputedPrimvarValues(primvarsOf("/Raise"), 4, &valueStore));
+    EXPECT_EQ(sampler.GetNumInvocations(), 1u);
+    sampler.Clear();
+    ASSERT_TRUE(sampler.SampleComputedPrimvarValues(primvarsOf("/Raise"), 4, &valueStore));
+    EXPECT_EQ(sampler.GetNumInvocations(), 2u);
+    ASSERT_EQ(valueStore.at(primvarName).count, 1u);
+    EXPECT_EQ(valueStore.at(primvarName).values[0], VtValue(1.0));
+
+    // Sampling several prims replaces the previous value stores, so the
+    // stores of the failing prims are empty.
+    std::vector<HdExtComputationUtils::SampledValueStore<4>> valueStores(3, valueStore);
+    sampler.SampleComputedPrimvarValues({primvarsOf("/Raise"), primvarsOf("/Cycle")}, 4, &valueStores);
+    ASSERT_EQ(valueStores.size(), 2u);
+    EXPECT_EQ(valueStores[0].size(), 1u);
+    EXPECT_TRUE(valueStores[1].empty());
+
+    ASSERT_TRUE(mark.IsClean());
+}
+
+// Delegate with two chains whose scene inputs have disjoint sample times,
+// 0 to 3 and 10 to 13, and a computation that reads both:
+//
+// /Early/inputs (input1) -> /Early/comp -> early
+// /Late/inputs (input2) -> /Late/comp -> late
+// /Early/comp + /Late/comp -> /Sum -> sum
+//
+class DisjointExtComputationTestDelegate : public HdUnitTestDelegate {
+public:
+    DisjointExtComputationTestDelegate(HdRenderIndex* parentIndex)
+        : HdUnitTestDelegate(parentIndex, SdfPath::AbsoluteRootPath()) {}
+
+    SdfPathVector GetComputationPaths() const {
+        return {_earlyInputs, _earlyComp, _lateInputs, _lateComp, _sum};
+    }
+
+    HdExtComputationPrimvarDescriptorVector GetExtComputationPrimvarDescriptors(
+            SdfPath const& id, HdInterpolation interpolationMode) override {
+        if (interpolationMode != HdInterpolationConstant) {
+            return {};
+        }
+        return {{early, HdInterpolationConstant, HdPrimvarRoleTokens->none, _earlyComp, early, {HdTypeDouble, 1}},
+                {late, HdInterpolationConstant, HdPrimvarRoleTokens->none, _lateComp, late, {HdTypeDouble, 1}},
+                {sum, HdInterpolationConstant, HdPrimvarRoleTokens->none, _sum, sum, {HdTypeDouble, 1}}};
+    }
+
+    TfTokenVector GetExtComputationSceneInputNames(SdfPath const& computationId) override {
+        if (computationId == _earlyInputs) {
+            return {input1};
+        } else if (computationId == _lateInputs) {
+            return {input2};
+        }
+        return {};
+    }
+
+    HdExtComputationInputDescriptorVector GetExtComputationInputDescriptors(SdfPath const& computationId) override {
+        if (computationId == _earlyComp) {
+            return {{input1, _earlyInputs, input1}};
+        } else if (computationId == _lateComp) {
+            return {{input2, _lateInputs, input2}};
+        } else if (computationId == _sum) {
+            return {{early, _earlyComp, early}, {late, _lateComp, late}};
+        }
+        return {};
+    }
+
+    HdExtComputationOutputDescriptorVector GetExtComputationOutputDescriptors(
+            SdfPath const& computationId) override {
+        if (computationId == _earlyComp) {
+            return {{early, {HdTypeDouble, 1}}};
+        } else if (computationId == _lateComp) {
+            return {{late, {HdTypeDouble, 1}}};
+        } else if (computationId == _sum) {
+            return {{sum, {HdTypeDouble, 1}}};
+        }
+        return {};
+    }
+
+    // The value of each sample is its time.
+    size_t SampleExtComputationInput(SdfPath const& computationId,
+                                     TfToken const& input,
+                                     size_t maxSampleCount,
+                                     float* sampleTimes,
+                                     VtValue* sampleValues) override {
+        float start;
+        if (computationId == _earlyInputs && input == input1) {
+            start = 0.0f;
+        } else if (computationId == _lateInputs && input == input2) {
+            start = 10.0f;
+        } else {
+            return 0;
+        }
+        const size_t numSamples = std::min(size_t(4), maxSampleCount);
+        for (size_t i = 0; i != numSamples; ++i) {
+            sampleTimes[i] = start + i;
+            sampleValues[i] = VtValue(double(sampleTimes[i]));
+        }
+        return numSamples;
+    }
+
+    // The chains double their input, and /Sum adds their outputs.
+    void InvokeExtComputation(SdfPath const& computationId, HdExtComputationContext* context) override {
+        if (computationId == _earlyComp) {
+            context->SetOutputValue(early, VtValue(2.0 * context->GetInputValue(input1).Get<double>()));
+        } else if (computationId == _lateComp) {
+            context->SetOutputValue(late, VtValue(2.0 * context->GetInputValue(input2).Get<double>()));
+        } else if (computationId == _sum) {
+            context->SetOutputValue(sum, VtValue(context->GetInputValue(early).Get<double>() +
+                                                 context->GetInputValue(late).Get<double>()));
+        }
+    }
+
+    const TfToken early{"early"};
+    const TfToken late{"late"};
+    const TfToken sum{"sum"};
+
+private:
+    const SdfPath _earlyInputs{"/Early/inputs"};
+    const SdfPath _earlyComp{"/Early/comp"};
+    const SdfPath _lateInputs{"/Late/inputs"};
+    const SdfPath _lateComp{"/Late/comp"};
+    const SdfPath _sum{"/Sum"};
+};
+
+TEST(TestHydra, test_parallel_ext_computation_sampler_disjoint_times) {
+    TfErrorMark mark;
+
+    ExtCompTestRenderDelegate renderDelegate;
+    std::unique_ptr<HdRenderIndex> index(HdRenderIndex::New(&renderDelegate, {}));
+    DisjointExtComputationTestDelegate delegate(index.get());
+    for (SdfPath const& comp : delegate.GetComputationPaths()) {
+        index->InsertSprim(HdPrimTypeTokens->extComputation, &delegate, comp);
+        HdDirtyBits dirty = HdExtComputation::DirtyBits::AllDirty;
+        index->GetSprim(HdPrimTypeTokens->extComputation, comp)->Sync(&delegate, nullptr, &dirty);
+    }
+
+    const HdExtComputationPrimvarDescriptorVector compPrimvars =
+            delegate.GetExtComputationPrimvarDescriptors(SdfPath("/Prim"), HdInterpolationConstant);
+    const size_t maxSamples = 4;
+    HdExtComputationUtils::SampledValueStore<4> expected;
+    HdExtComputationUtils::SampleComputedPrimvarValues(compPrimvars, &delegate, maxSamples, &expected);
+
+    Hd_ParallelExtComputationSampler<4> sampler(&delegate);
+    HdExtComputationUtils::SampledValueStore<4> valueStore;
+    ASSERT_TRUE(sampler.SampleComputedPrimvarValues(compPrimvars, maxSamples, &valueStore));
+    ExpectSameSamples(expected, valueStore);
+
+    // Each chain keeps its own sample times, and /Sum, whose union of times
+    // is truncated to the early ones, reads the late output held at its
+    // first sample.
+    auto const& late = valueStore.at(delegate.late);
+    ASSERT_EQ(late.count, maxSamples);
+    EXPECT_EQ(late.times[0], 10.0f);
+    EXPECT_EQ(late.values[3], VtValue(26.0));
+    auto const& sum = valueStore.at(delegate.sum);
+    ASSERT_EQ(sum.count, maxSamples);
+    EXPECT_EQ(sum.times[3], 3.0f);
+    EXPECT_EQ(sum.values[3], VtValue(26.0));
+    // Every computation runs once per sample time of its own.
+    EXPECT_EQ(sampler.GetNumInvocations(), 3 * maxSamples);
+
+    ASSERT_TRUE(mark.IsClean());
+}
+
+// Delegate for a deformer stack: every prim runs a chain of three
+// computations, and every deform reads the pose of a shared rig:
+//
+// <prim>/inputs (restPoints) -> <prim>/bind -> <prim>/deform -> <prim>/displace -> points
+// /Rig/inputs (time) -> /Rig/pose ------------/
+//                    \-----------------------------------------/
+//
+class DeformerChainTestDelegate : public HdUnitTestDelegate {
+public:
+    static constexpr size_t numSamples = 8;
+
+    DeformerChainTestDelegate(HdRenderIndex* parentIndex, size_t numPrims, size_t numPoints)
+        : HdUnitTestDelegate(parentIndex, SdfPath::AbsoluteRootPath()) {
+        for (size_t i = 0; i != numPrims; ++i) {
+            primPaths.push_back(SdfPath(TfStringPrintf("/Prims/P%zu", i)));
+        }
+        _restPoints.resize(numPoints);
+        for (size_t i = 0; i != numPoints; ++i) {
+            _restPoints[i] = GfVec3f(float(i), float(i % 7), float(i % 3));
+        }
+    }
+
+    SdfPathVector GetComputationPaths() const {
+        SdfPathVector paths = {_rigInputs, _rigPose};
+        for (SdfPath const& primPath : primPaths) {
+            for (TfToken const& name : {_tokens.inputs, _tokens.bind, _tokens.deform, _tokens.displace}) {
+                paths.push_back(primPath.AppendChild(name));
+            }
+        }
+        return paths;
+    }
+
+    HdExtComputationPrimvarDescriptorVector GetExtComputationPrimvarDescriptors(
+            SdfPath const& id, HdInterpolation interpolationMode) override {
+        if (interpolationMode != HdInterpolationVertex || id.GetParentPath() != _prims) {
+            return {};
+        }
+        return {{HdTokens->points, HdInterpolationVertex, HdPrimvarRoleTokens->point,
+                 id.AppendChild(_tokens.displace), HdTokens->points, {HdTypeFloatVec3, 1}}};
+    }
+
+    TfTokenVector GetExtComputationSceneInputNames(SdfPath const& computationId) override {
+        if (computationId == _rigInputs) {
+            return {_tokens.time};
+        }
+        if (computationId.GetNameToken() == _tokens.inputs) {
+            return {_tokens.restPoints};
+        }
+        return {};
+    }
+
+    HdExtComputationInputDescriptorVector GetExtComputationInputDescriptors(SdfPath const& computationId) override {
+        const SdfPath primPath = computationId.GetParentPath();
+        const TfToken& name = computationId.GetNameToken();
+        if (computationId == _rigPose) {
+            return {{_tokens.time, _rigInputs, _tokens.time}};
+        } else if (name == _tokens.bind) {
+            return {{_tokens.restPoints, primPath.AppendChild(_tokens.inputs), _tokens.restPoints}};
+        } else if (name == _tokens.deform) {
+            return {{_tokens.boundPoints, primPath.AppendChild(_tokens.bind), _tokens.boundPoints},
+                    {_tokens.pose, _rigPose, _tokens.pose}};
+        } else if (name == _tokens.displace) {
+            return {{_tokens.deformedPoints, primPath.AppendChild(_tokens.deform), _tokens.deformedPoints},
+                    {_tokens.time, _rigInputs, _tokens.time}};
+        }
+        return {};
+    }
+
+    HdExtComputationOutputDescriptorVector GetExtComputationOutputDescriptors(
+            SdfPath const& computationId) override {
+        const TfToken& name = computationId.GetNameToken();
+        if (computationId == _rigPose) {
+            return {{_tokens.pose, {HdTypeDoubleMat4, 1}}};
+        } else if (name == _tokens.bind) {
+            return {{_tokens.boundPoints, {HdTypeFloatVec3, 1}}};
+        } else if (name == _tokens.deform) {
+            return {{_tokens.deformedPoints, {HdTypeFloatVec3, 1}}};
+        } else if (name == _tokens.displace) {
+            return {{HdTokens->points, {HdTypeFloatVec3, 1}}};
+        }
+        return {};
+    }
+
+    size_t SampleExtComputationInput(SdfPath const& computationId,
+                                     TfToken const& input,
+                                     size_t maxSampleCount,
+                                     float* sampleTimes,
+                                     VtValue* sampleValues) override {
+        if (computationId == _rigInputs && input == _tokens.time) {
+            for (size_t i = 0; i < std::min(numSamples, maxSampleCount); ++i) {
+                sampleTimes[i] = float(i) / numSamples;
+                sampleValues[i] = VtValue(double(sampleTimes[i]));
+            }
+            return numSamples;
+        }
+        if (input == _tokens.restPoints && maxSampleCount > 0) {
+            sampleTimes[0] = 0.0f;
+            sampleValues[0] = VtValue(_restPoints);
+            return 1;
+        }
+        return 0;
+    }
+
+    // Called concurrently by Hd_ParallelExtComputationSampler.
+    void InvokeExtComputation(SdfPath const& computationId, HdExtComputationContext* context) override {
+        const TfToken& name = computationId.GetNameToken();
+        if (computationId == _rigPose) {
+            const double time = context->GetInputValue(_tokens.time).Get<double>();
+            GfMatrix4d pose(1.0);
+            pose.SetRotate(GfRotation(GfVec3d::ZAxis(), 90.0 * time));
+            pose.SetTranslateOnly(GfVec3d(time, 0.0, 0.0));
+            context->SetOutputValue(_tokens.pose, VtValue(pose));
+        } else if (name == _tokens.bind) {
+            VtVec3fArray points = context->GetInputValue(_tokens.restPoints).Get<VtVec3fArray>();
+            for (GfVec3f& point : points) {
+                point *= 2.0f;
+            }
+            context->SetOutputValue(_tokens.boundPoints, VtValue(points));
+        } else if (name == _tokens.deform) {
+            VtVec3fArray points = context->GetInputValue(_tokens.boundPoints).Get<VtVec3fArray>();
+            const GfMatrix4d& pose = context->GetInputValue(_tokens.pose).Get<GfMatrix4d>();
+            for (GfVec3f& point : points) {
+                point = GfVec3f(pose.Transform(GfVec3d(point)));
+            }
+            context->SetOutputValue(_tokens.deformedPoints, VtValue(points));
+        } else if (name == _tokens.displace) {
+            VtVec3fArray points = context->GetInputValue(_tokens.deformedPoints).Get<VtVec3fArray>();
+            const float offset = 0.1f * std::sin(float(context->GetInputValue(_tokens.time).Get<double>()));
+            for (GfVec3f& point : points) {
+                point[2] += offset;
+            }
+            context->SetOutputValue(HdTokens->points, VtValue(points));
+        }
+    }
+
+    SdfPathVector primPaths;
+
+private:
+    struct _Tokens {
+        const TfToken inputs{"inputs"};
+        const TfToken bind{"bind"};
+        const TfToken deform{"deform"};
+        const TfToken displace{"displace"};
+        const TfToken time{"time"};
+        const TfToken restPoints{"restPoints"};
+        const TfToken boundPoints{"boundPoints"};
+        const TfToken deformedPoints{"deformedPoints"};
+        const TfToken pose{"pose"};
+    };
+
+    const _Tokens _tokens;
+    const SdfPath _prims{"/Prims"};
+    const SdfPath _rigInputs{"/Rig/inputs"};
+    const SdfPath _rigPose{"/Rig/pose"};
+    VtVec3fArray _restPoints;
+};
+
+TEST(TestHydra, test_parallel_ext_computation_sampler_perf) {
+    constexpr size_t numPrims = 10000;
+    constexpr size_t numSamples = DeformerChainTestDelegate::numSamples;
+    using ValueStore = HdExtComputationUtils::SampledValueStore<numSamples>;
+
+    ExtCompTestRenderDelegate renderDelegate;
+    std::unique_ptr<HdRenderIndex> index(HdRenderIndex::New(&renderDelegate, {}));
+    DeformerChainTestDelegate delegate(index.get(), numPrims, 64);
+    for (SdfPath const& comp : delegate.GetComputationPaths()) {
+        index->InsertSprim(HdPrimTypeTokens->extComputation, &delegate, comp);
+        HdDirtyBits dirty = HdExtComputation::DirtyBits::AllDirty;
+        index->GetSprim(HdPrimTypeTokens->extComputation, comp)->Sync(&delegate, nullptr, &dirty);
+    }
+
+    std::vector<HdExtComputationPrimvarDescriptorVector> compPrimvars;
+    for (SdfPath const& primPath : delegate.primPaths) {
+        compPrimvars.push_back(delegate.GetExtComputationPrimvarDescriptors(primPath, HdInterpolationVertex));
+    }
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.trials = std::min<size_t>(options.trials, 5);
+    Hd_UnitTestPerfRunner runner(options);
+
+    std::vector<ValueStore> expected(numPrims);
+    runner.Measure("ext_computation_sample_stock_10k", [&]() {
+        for (size_t i = 0; i != numPrims; ++i) {
+            HdExtComputationUtils::SampleComputedPrimvarValues(compPrimvars[i], &delegate, numSamples, &expected[i]);
+        }
+    });
+
+    for (unsigned numThreads : Hd_UnitTestPerfRunner::GetThreadCounts()) {
+        WorkSetConcurrencyLimit(numThreads);
+        std::vector<ValueStore> valueStores;
+        size_t numInvocations = 0;
+        runner.Measure(TfStringPrintf("ext_computation_sample_parallel_10k_%ut", numThreads), [&]() {
+            // Memoized outputs only live as long as the sampler.
+            Hd_ParallelExtComputationSampler<numSamples> sampler(&delegate);
+            valueStores.clear();
+            sampler.SampleComputedPrimvarValues(compPrimvars, numSamples, &valueStores);
+            numInvocations = sampler.GetNumInvocations();
+        });
+        // The rig pose runs once per sample for all prims, and bind once per
+        // prim for all samples.
+        EXPECT_EQ(numInvocations, numSamples + numPrims * (1 + 2 * numSamples));
+        ASSERT_EQ(valueStores.size(), numPrims);
+        for (size_t i = 0; i != numPrims; ++i) {
+            ExpectSameSamples(expected[i], valueStores[i]);
+        }
+    }
+    WorkSetMaximumConcurrencyLimit();
+
+    EXPECT_TRUE(runner.Finish("testHdExtComputationUtils.json", "perfstats_ext_computation_utils.raw").empty());
+}
@@ -6,10 +6,16 @@
 
 #include "pxr/imaging/hd/filteringSceneIndex.h"
 #include "pxr/imaging/hd/mergingSceneIndex.h"
+#include "pxr/imaging/hd/retainedDataSource.h"
 #include "pxr/imaging/hd/retainedSceneIndex.h"
 
 #include "pxr/base/tf/declarePtrs.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "indexedMergingSceneIndex.h"
+#include "unitTestPathGenerator.h"
+#include "unitTestPerfRunner.h"
 
+#include <algorithm>
 #include <iostream>
 #include <gtest/gtest.h>
 
@@ -176,3 +182,205 @@ TEST(TestHydra, test_notices_after_remove) {
                           _LogEntry("add", "/Parent/Child"),
                   });
 }
+
+// Compares types, data source names and children of every prim.
+static void _CompareMergedScenes(HdSceneIndexBase& expected, HdSceneIndexBase& actual, const SdfPath& path) {
+    const HdSceneIndexPrim expectedPrim = expected.GetPrim(path);
+    const HdSceneIndexPrim actualPrim = actual.GetPrim(path);
+    ASSERT_EQ(expectedPrim.primType, actualPrim.primType) << path;
+    ASSERT_EQ(bool(expectedPrim.dataSource), bool(actualPrim.dataSource)) << path;
+    if (expectedPrim.dataSource) {
+        TfTokenVector expectedNames = expectedPrim.dataSource->GetNames();
+        TfTokenVector actualNames = actualPrim.dataSource->GetNames();
+        std::sort(expectedNames.begin(), expectedNames.end());
+        std::sort(actualNames.begin(), actualNames.end());
+        ASSERT_EQ(expectedNames, actualNames) << path;
+    }
+
+    SdfPathVector expectedChildren = expected.GetChildPrimPaths(path);
+    SdfPathVector actualChildren = actual.GetChildPrimPaths(path);
+    std::sort(expectedChildren.begin(), expectedChildren.end());
+    std::sort(actualChildren.begin(), actualChildren.end());
+    ASSERT_EQ(expectedChildren, actualChildren) << path;
+
+    for (const SdfPath& child : expectedChildren) {
+        _CompareMergedScenes(expected, actual, child);
+    }
+}
+
+static HdContainerDataSourceHandle _NamedDataSource(const char* name) {
+    return HdRetainedContainerDataSource::New(TfToken(name), HdRetainedTypedSampledDataSource<int>::New(1));
+}
+
+TEST(TestHydra, test_indexed_merging_scene_index) {
+    HdRetainedSceneIndexRefPtr siA = HdRetainedSceneIndex::New();
+    siA->AddPrims({
+            {SdfPath("/Shared/X"), TfToken("A"), _NamedDataSource("a")},
+            {SdfPath("/OnlyA"), TfToken("A"), nullptr},
+    });
+    HdRetainedSceneIndexRefPtr siB = HdRetainedSceneIndex::New();
+    siB->AddPrims({
+            {SdfPath("/Shared/X"), TfToken(), _NamedDataSource("b")},
+            {SdfPath("/Shared/Y"), TfToken("B"), nullptr},
+            {SdfPath("/Deep/P/Q/R"), TfToken("B"), _NamedDataSource("b")},
+    });
+    // Only prims below /Shared/Z are active.
+    HdRetainedSceneIndexRefPtr siC = HdRetainedSceneIndex::New();
+    siC->AddPrims({
+            {SdfPath("/Shared/Z/W"), TfToken("C"), _NamedDataSource("c")},
+            {SdfPath("/Shared/X"), TfToken("C"), _NamedDataSource("c")},
+            {SdfPath("/Other"), TfToken("C"), nullptr},
+    });
+
+    HdMergingSceneIndexRefPtr expected = HdMergingSceneIndex::New();
+    Hd_IndexedMergingSceneIndexRefPtr indexed = Hd_IndexedMergingSceneIndex::New();
+    expected->AddInputScene(siA, SdfPath::AbsoluteRootPath());
+    expected->AddInputScene(siB, SdfPath::AbsoluteRootPath());
+    expected->AddInputScene(siC, SdfPath("/Shared/Z"));
+    indexed->AddInputScene(siA, SdfPath::AbsoluteRootPath());
+    indexed->AddInputScene(siB, SdfPath::AbsoluteRootPath());
+    indexed->AddInputScene(siC, SdfPath("/Shared/Z"));
+    _CompareMergedScenes(*expected, *indexed, SdfPath::AbsoluteRootPath());
+
+    EXPECT_EQ(indexed->GetNumContributingInputs(SdfPath("/")), size_t(3));
+    EXPECT_EQ(indexed->GetNumContributingInputs(SdfPath("/OnlyA")), size_t(1));
+    EXPECT_EQ(indexed->GetNumContributingInputs(SdfPath("/Deep/P/Q/R")), size_t(1));
+    EXPECT_EQ(indexed->GetNumContributingInputs(SdfPath("/Missing")), size_t(0));
+
+    // The index grows with added prims.
+    siA->AddPrims({{SdfPath("/Deep/P/Q/S"), TfToken("A"), _NamedDataSource("a")}});
+    EXPECT_EQ(indexed->GetNumContributingInputs(SdfPath("/Deep/P/Q/S")), size_t(2));
+    _CompareMergedScenes(*expected, *indexed, SdfPath::AbsoluteRootPath());
+
+    // Removals leave the index conservative until it is rebuilt.
+    siB->RemovePrims({SdfPath("/Deep")});
+    _CompareMergedScenes(*expected, *indexed, SdfPath::AbsoluteRootPath());
+    EXPECT_EQ(indexed->GetNumContributingInputs(SdfPath("/Deep/P")), size_t(2));
+    indexed->RebuildOwnershipIndex();
+    EXPECT_EQ(indexed->GetNumContributingInputs(SdfPath("/Deep/P")), size_t(1));
+
+    // Queries can fan out in parallel.
+    indexed->SetParallelFanOutThreshold(2);
+    _CompareMergedScenes(*expected, *indexed, SdfPath::AbsoluteRootPath());
+
+    _Logger logger;
+    indexed->AddObserver(HdSceneIndexObserverPtr(&logger));
+    expected->RemoveInputScene(siA);
+    indexed->RemoveInputScene(siA);
+    _CompareMergedScenes(*expected, *indexed, SdfPath::AbsoluteRootPath());
+    std::vector<_LogEntry> logEntries = logger.GetLog();
+    std::sort(logEntries.begin(), logEntries.end());
+    _CompareValue("NOTICES", logEntries,
+                  {
+                          _LogEntry("add", "/"),
+                          _LogEntry("add", "/Shared"),
+                          _LogEntry("add", "/Shared/X"),
+                          _LogEntry("remove", "/Deep"),
+                          _LogEntry("remove", "/OnlyA"),
+                  });
+}
+
+TEST(TestHydra, test_indexed_merging_scene_index_notices_after_remove) {
+    HdRetainedSceneIndexRefPtr siA = HdRetainedSceneIndex::New();
+    siA->AddPrims({{SdfPath("/Parent"), TfToken("A"), nullptr}, {SdfPath("/Parent/Child"), TfToken("A"), nullptr}});
+
+    HdRetainedSceneIndexRefPtr siB = HdRetainedSceneIndex::New();
+    siB->AddPrims({{SdfPath("/Parent"), TfToken("B"), nullptr}, {SdfPath("/Parent/Child"), TfToken("B"), nullptr}});
+
+    _MySceneIndexRefPtr dA = _MySceneIndex::New(siA);
+    _MySceneIndexRefPtr dB = _MySceneIndex::New(siB);
+
+    Hd_IndexedMergingSceneIndexRefPtr mergingSceneIndex = Hd_IndexedMergingSceneIndex::New();
+    static const SdfPath rootPath = SdfPath::AbsoluteRootPath();
+    mergingSceneIndex->AddInputScene(dA, rootPath);
+    mergingSceneIndex->AddInputScene(dB, rootPath);
+
+    // Unlike HdMergingSceneIndex, the removal is forwarded before the prims
+    // that "B" still has are added again, so that prims only "A" had would
+    // not linger downstream.
+    _Logger logger;
+    mergingSceneIndex->AddObserver(HdSceneIndexObserverPtr(&logger));
+    dA->Disable();
+
+    _CompareValue("NOTICES", logger.GetLog(),
+                  {
+                          _LogEntry("remove", "/"),
+                          _LogEntry("add", "/"),
+                          _LogEntry("add", "/Parent"),
+                          _LogEntry("add", "/Parent/Child"),
+                  });
+    EXPECT_EQ(mergingSceneIndex->GetPrim(SdfPath("/Parent")).primType, TfToken("B"));
+}
+
+// Traverses merged scenes of 4 to 32 inputs with 5000 prims each, of which
+// a varying fraction is in a subtree that every input populates, with
+// HdMergingSceneIndex and with the ownership index, serially and in
+// parallel.
+TEST(TestHydra, test_indexed_merging_scene_index_perf) {
+    // Every input has the same 100 groups of 50 leaves, in traversal order
+    // so the shared fraction is made of whole groups.
+    Hd_UnitTestPathGenerator::Options pathOptions;
+    pathOptions.fanout = {100, 50};
+    pathOptions.shuffle = false;
+    const SdfPathVector inputPaths = Hd_UnitTestPathGenerator(pathOptions).Generate();
+    const size_t numPrimsPerInput = inputPaths.size();
+
+    auto traverse = [](HdSceneIndexBase& sceneIndex) {
+        size_t count = 0;
+        SdfPathVector queue = {SdfPath::AbsoluteRootPath()};
+        while (!queue.empty()) {
+            const SdfPath path = queue.back();
+            queue.pop_back();
+            count += bool(sceneIndex.GetPrim(path).dataSource);
+            const SdfPathVector children = sceneIndex.GetChildPrimPaths(path);
+            queue.insert(queue.end(), children.begin(), children.end());
+        }
+        return count;
+    };
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    const HdContainerDataSourceHandle dataSource = _NamedDataSource("value");
+    const SdfPath sharedRoot("/Shared");
+    for (size_t numInputs : {4, 16, 32}) {
+        for (double overlap : {0.0, 0.25, 1.0}) {
+            const size_t numShared = static_cast<size_t>(numPrimsPerInput * overlap);
+            std::vector<HdSceneIndexBaseRefPtr> inputs;
+            for (size_t i = 0; i != numInputs; ++i) {
+                HdRetainedSceneIndex::AddedPrimEntries entries;
+                const SdfPath inputRoot(TfStringPrintf("/Input_%zu", i));
+                for (size_t p = 0; p != numPrimsPerInput; ++p) {
+                    const SdfPath& root = p < numShared ? sharedRoot : inputRoot;
+                    entries.push_back({root.AppendPath(inputPaths[p].MakeRelativePath(SdfPath::AbsoluteRootPath())),
+                                       TfToken("mesh"), dataSource});
+                }
+                HdRetainedSceneIndexRefPtr input = HdRetainedSceneIndex::New();
+                input->AddPrims(entries);
+                inputs.push_back(input);
+            }
+
+            HdMergingSceneIndexRefPtr merging = HdMergingSceneIndex::New();
+            Hd_IndexedMergingSceneIndexRefPtr indexed = Hd_IndexedMergingSceneIndex::New();
+            Hd_IndexedMergingSceneIndexRefPtr parallel = Hd_IndexedMergingSceneIndex::New();
+            parallel->SetParallelFanOutThreshold(8);
+            for (HdSceneIndexBaseRefPtr const& input : inputs) {
+                merging->AddInputScene(input, SdfPath::AbsoluteRootPath());
+                indexed->AddInputScene(input, SdfPath::AbsoluteRootPath());
+                parallel->AddInputScene(input, SdfPath::AbsoluteRootPath());
+            }
+            const size_t numPrims = traverse(*merging);
+            EXPECT_EQ(traverse(*indexed), numPrims);
+            EXPECT_EQ(traverse(*parallel), numPrims);
+
+            const std::string label = TfStringPrintf("%zu_inputs_%zu_pct_shared", numInputs, size_t(overlap * 100));
+            runner.Measure("merging_traverse_" + label, [&]() { traverse(*merging); });
+            runner.Measure("indexed_merging_traverse_" + label, [&]() { traverse(*indexed); });
+            runner.Measure("indexed_merging_parallel_traverse_" + label, [&]() { traverse(*parallel); });
+        }
+    }
+
+    EXPECT_TRUE(runner.Finish("testHdMergingSceneIndex.json", "perfstats_merging_scene_index.raw").empty());
+}
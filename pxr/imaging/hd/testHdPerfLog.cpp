@@ -8,9 +8,16 @@
 
 #include "pxr/imaging/hd/perfLog.h"
 #include "pxr/imaging/hd/tokens.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "perfLogRecorder.h"
+#include "shardedPerfCounters.h"
+#include "unitTestPerfRunner.h"
 
 #include <iostream>
+#include <sstream>
 #include <cmath>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -114,6 +121,129 @@ TEST(TestHydra, counter_test) {
     ASSERT_TRUE(perfLog.GetCounter(foo) == 41);
 }
 
+TEST(TestHydra, sharded_counter_test) {
+    Hd_ShardedPerfCounters counters;
+    TfToken foo("foo");
+    TfToken bar("bar");
+
+    // Disabled by default, expect no tracking
+    counters.IncrementCounter(foo);
+    ASSERT_TRUE(counters.GetCounter(foo) == 0);
+    counters.AddCounter(foo, 5);
+    ASSERT_TRUE(counters.GetCounter(foo) == 0);
+    counters.SetCounter(foo, 42);
+    ASSERT_TRUE(counters.GetCounter(foo) == 0);
+
+    counters.Enable();
+
+    counters.IncrementCounter(foo);
+    ASSERT_TRUE(counters.GetCounter(foo) == 1);
+    counters.DecrementCounter(foo);
+    ASSERT_TRUE(counters.GetCounter(foo) == 0);
+    counters.SetCounter(foo, 42);
+    ASSERT_TRUE(counters.GetCounter(foo) == 42);
+    counters.AddCounter(foo, 5);
+    ASSERT_TRUE(counters.GetCounter(foo) == 47);
+    counters.SubtractCounter(foo, 6);
+    ASSERT_TRUE(counters.GetCounter(foo) == 41);
+
+    counters.SetCounter(bar, .1);
+    ASSERT_TRUE(_IsClose(counters.GetCounter(bar), .1));
+
+    // Updates from many threads land in separate shards and are summed on
+    // read.  SetCounter from another thread overrides the total.
+    const int numThreads = 8;
+    const int numIncrements = 10000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&counters, &foo]() {
+            for (int i = 0; i < numIncrements; ++i) {
+                counters.IncrementCounter(foo);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    ASSERT_TRUE(counters.GetCounter(foo) == 41 + numThreads * numIncrements);
+
+    std::thread([&counters, &foo]() { counters.SetCounter(foo, 7); }).join();
+    ASSERT_TRUE(counters.GetCounter(foo) == 7);
+
+    const TfTokenVector names = counters.GetCounterNames();
+    ASSERT_TRUE(names.size() == 2);
+
+    // Values can still be read once disabled.
+    counters.Disable();
+    counters.IncrementCounter(foo);
+    ASSERT_TRUE(counters.GetCounter(foo) == 7);
+
+    counters.ResetCounters();
+    ASSERT_TRUE(counters.GetCounter(foo) == 0);
+    ASSERT_TRUE(counters.GetCounter(bar) == 0);
+}
+
+// Runs \p numOps counter increments split over \p numThreads threads.  Half
+// of the increments go to a counter shared by all threads and half to one of
+// a few per-thread counters, like rprim sync counting both totals and per
+// prim type values.
+template <class IncrementFn>
+static void _RunContention(unsigned numThreads, size_t numOps, TfTokenVector const& names, IncrementFn const& fn) {
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            const size_t opsPerThread = numOps / numThreads;
+            for (size_t i = 0; i < opsPerThread; ++i) {
+                fn(names[i % 2 ? 0 : 1 + t % (names.size() - 1)]);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+TEST(TestHydra, counter_contention_perf) {
+    const TfTokenVector names = {TfToken("contentionTotal"), TfToken("contentionA"), TfToken("contentionB"),
+                                 TfToken("contentionC"), TfToken("contentionD")};
+    const size_t numOps = 1 << 20;
+
+    HdPerfLog& perfLog = HdPerfLog::GetInstance();
+    Hd_ShardedPerfCounters sharded;
+
+    Hd_UnitTestPerfRunner runner;
+
+    perfLog.Enable();
+    sharded.Enable();
+    for (unsigned numThreads : {1u, 2u, 4u, 8u, 16u, 32u, 64u}) {
+        const double perfLogNs = runner.Measure(TfStringPrintf("counter_perf_log_%ut", numThreads), [&]() {
+            _RunContention(numThreads, numOps, names, [&perfLog](TfToken const& name) {
+                perfLog.IncrementCounter(name);
+            });
+        }).medianNs;
+
+        const double shardedNs = runner.Measure(TfStringPrintf("counter_sharded_%ut", numThreads), [&]() {
+            _RunContention(numThreads, numOps, names, [&sharded](TfToken const& name) {
+                sharded.IncrementCounter(name);
+            });
+        }).medianNs;
+
+        printf("%u threads: HdPerfLog %.1f Mops/s, sharded %.1f Mops/s\n", numThreads, numOps * 1e3 / perfLogNs,
+               numOps * 1e3 / shardedNs);
+    }
+
+    // Every update must have been counted, however many shards it went to.
+    ASSERT_TRUE(sharded.GetCounter(names[0]) == perfLog.GetCounter(names[0]));
+
+    for (TfToken const& name : names) {
+        perfLog.SetCounter(name, 0);
+    }
+    perfLog.Disable();
+
+    EXPECT_TRUE(runner.Finish("testHdPerfLog.json", "perfstats_counters.raw").empty());
+}
+
 TEST(TestHydra, cache_test) {
     HdPerfLog& perfLog = HdPerfLog::GetInstance();
     TfToken foo("foo");
@@ -193,3 +323,75 @@ TEST(TestHydra, cache_test) {
     }
     ASSERT_TRUE(perfLog.GetCacheNames() == populatedNames);
 }
+
+TEST(TestHydra, perf_log_recorder_test) {
+    HdPerfLog& perfLog = HdPerfLog::GetInstance();
+    TfToken counter("recorderCounter");
+    // Cache names stay registered in the process-wide perf log, so use one
+    // no other test, or earlier repeat of this one, has seen.
+    static int numRuns = 0;
+    const std::string cacheName = TfStringPrintf("perfLogRecorderTestCache%d", numRuns++);
+    const std::string hits = cacheName + ":hits";
+    const std::string misses = cacheName + ":misses";
+    TfToken cache(cacheName);
+    SdfPath id("/Some/Path");
+
+    Hd_PerfLogRecorder recorder(3);
+    ASSERT_TRUE(recorder.GetNumSamples() == 0);
+
+    perfLog.Enable();
+
+    perfLog.SetCounter(counter, 1);
+    recorder.Sample(1.0);
+    ASSERT_TRUE(recorder.GetNumSamples() == 1);
+    ASSERT_TRUE(recorder.GetValue(0, "recorderCounter") == 1);
+    // The cache has not been seen yet.
+    ASSERT_TRUE(std::isnan(recorder.GetValue(0, hits)));
+
+    perfLog.IncrementCounter(counter);
+    perfLog.AddCacheHit(cache, id);
+    perfLog.AddCacheMiss(cache, id);
+    perfLog.AddCacheHit(cache, id);
+    recorder.Sample(2.0);
+    ASSERT_TRUE(recorder.GetValue(1, "recorderCounter") == 2);
+    ASSERT_TRUE(recorder.GetValue(1, hits) == 2);
+    ASSERT_TRUE(recorder.GetValue(1, misses) == 1);
+    ASSERT_TRUE(std::isnan(recorder.GetValue(0, hits)));
+
+    // Overflowing the ring buffer drops the oldest samples.
+    perfLog.IncrementCounter(counter);
+    recorder.Sample(3.0);
+    perfLog.IncrementCounter(counter);
+    recorder.Sample(4.0);
+    ASSERT_TRUE(recorder.GetNumSamples() == 3);
+    ASSERT_TRUE(recorder.GetTime(0) == 2.0);
+    ASSERT_TRUE(recorder.GetTime(2) == 4.0);
+    ASSERT_TRUE(recorder.GetValue(2, "recorderCounter") == 4);
+
+    // Large values keep all their digits in the CSV.
+    perfLog.SetCounter(counter, 123456789);
+    recorder.Sample(5.0);
+
+    // Zero what this test recorded and disable the log again.
+    perfLog.SetCounter(counter, 0);
+    perfLog.ResetCache(cache);
+    perfLog.Disable();
+
+    std::ostringstream csv;
+    recorder.WriteCsv(csv);
+    std::istringstream lines(csv.str());
+    std::string header, line;
+    std::getline(lines, header);
+    ASSERT_TRUE(TfStringStartsWith(header, "time,"));
+    ASSERT_TRUE(header.find(misses) != std::string::npos);
+    size_t numRows = 0;
+    while (std::getline(lines, line)) {
+        ++numRows;
+    }
+    ASSERT_TRUE(numRows == 3);
+    ASSERT_TRUE(csv.str().find(",123456789") != std::string::npos);
+
+    std::ostringstream binary;
+    recorder.WriteBinary(binary);
+    ASSERT_TRUE(binary.str().compare(0, 4, "HDPL") == 0);
+}
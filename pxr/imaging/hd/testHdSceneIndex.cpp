@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <random>
 #include <unordered_set>
 #include <utility>
 
@@ -19,7 +20,19 @@
 #include "pxr/imaging/hd/flattenedDataSourceProviders.h"
 
 #include "pxr/imaging/hd/dependenciesSchema.h"
+#include "pxr/imaging/hd/primvarSchema.h"
+#include "pxr/imaging/hd/primvarsSchema.h"
+#include "pxr/imaging/hd/visibilitySchema.h"
 #include "pxr/imaging/hd/xformSchema.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/base/work/threadLimits.h"
+#include "boundedDependencyForwardingSceneIndex.h"
+#include "bulkRetainedSceneIndex.h"
+#include "dataSourceArena.h"
+#include "noticeBatchingSceneIndex.h"
+#include "parallelDependencyForwardingSceneIndex.h"
+#include "unitTestPathGenerator.h"
+#include "unitTestPerfRunner.h"
 
 #include <gtest/gtest.h>
 
@@ -909,3 +922,865 @@ TEST(TestHydra, test_dependency_forwarding_scene_index_eviction) {
                       baselineDependedOn);
     }
 }
+
+//-----------------------------------------------------------------------------
+// Builds prim data sources on the heap, like the scene index tests above.
+struct _HeapDataSourceFactory {
+    template <class T>
+    HdDataSourceBaseHandle Typed(T const& value) {
+        return HdRetainedTypedSampledDataSource<T>::New(value);
+    }
+
+    HdContainerDataSourceHandle Container(size_t count, TfToken const* names, HdDataSourceBaseHandle const* values) {
+        return HdRetainedContainerDataSource::New(count, names, values);
+    }
+};
+
+// Builds the same data sources in an arena.
+struct _ArenaDataSourceFactory {
+    template <class T>
+    HdDataSourceBaseHandle Typed(T const& value) {
+        return arena->NewTyped(value);
+    }
+
+    HdContainerDataSourceHandle Container(size_t count, TfToken const* names, HdDataSourceBaseHandle const* values) {
+        return arena->NewContainer(count, names, values);
+    }
+
+    Hd_DataSourceArena* arena;
+};
+
+// A mesh-like prim with a transform, visibility and four primvars.
+template <class Factory>
+static HdContainerDataSourceHandle _BuildPopulatePrim(Factory& factory, size_t index) {
+    static const TfToken primvarNames[] = {TfToken("displayColor"), TfToken("displayOpacity"), TfToken("st"),
+                                           TfToken("id")};
+    const TfToken primvarKeys[] = {HdPrimvarSchemaTokens->primvarValue, HdPrimvarSchemaTokens->interpolation};
+
+    HdDataSourceBaseHandle primvars[4];
+    for (size_t i = 0; i != 4; ++i) {
+        const HdDataSourceBaseHandle values[] = {factory.Typed(static_cast<float>(index + i)),
+                                                 factory.Typed(HdPrimvarSchemaTokens->constant)};
+        primvars[i] = factory.Container(2, primvarKeys, values);
+    }
+
+    GfMatrix4d matrix(1.0);
+    matrix.SetTranslateOnly(GfVec3d(static_cast<double>(index)));
+    const TfToken xformKeys[] = {HdXformSchemaTokens->matrix};
+    const HdDataSourceBaseHandle xformValues[] = {factory.Typed(matrix)};
+
+    const TfToken keys[] = {HdXformSchemaTokens->xform, HdVisibilitySchemaTokens->visibility,
+                            HdPrimvarsSchemaTokens->primvars};
+    const HdDataSourceBaseHandle values[] = {factory.Container(1, xformKeys, xformValues),
+                                             factory.Typed(index % 7 != 0),
+                                             factory.Container(4, primvarNames, primvars)};
+    return factory.Container(3, keys, values);
+}
+
+template <class Factory>
+static HdRetainedSceneIndexRefPtr _PopulateRetainedScene(SdfPathVector const& paths, Factory& factory, bool parallel) {
+    static const TfToken meshType("mesh");
+    HdRetainedSceneIndex::AddedPrimEntries entries(paths.size());
+    auto build = [&](Factory& localFactory, size_t begin, size_t end) {
+        for (size_t i = begin; i != end; ++i) {
+            entries[i] = {paths[i], meshType, _BuildPopulatePrim(localFactory, i)};
+        }
+    };
+    if (parallel) {
+        WorkParallelForN(paths.size(), [&](size_t begin, size_t end) {
+            Factory localFactory = factory;
+            build(localFactory, begin, end);
+        });
+    } else {
+        build(factory, 0, paths.size());
+    }
+
+    HdRetainedSceneIndexRefPtr sceneIndex = HdRetainedSceneIndex::New();
+    sceneIndex->AddPrims(entries);
+    return sceneIndex;
+}
+
+// Populates a retained scene index with 1M prims with heap and arena
+// allocated data sources.  Builds the prims in parallel for the timings,
+// and once on the main thread to report the heap memory and RSS each
+// variant takes, as measured by malloc and the kernel.
+TEST(TestHydra, test_retained_scene_index_arena_populate_perf) {
+    Hd_UnitTestPathGenerator::Options pathOptions = Hd_UnitTestPathGenerator::UniformOptions(1000000, 3);
+    pathOptions.shuffle = false;
+    const SdfPathVector paths = Hd_UnitTestPathGenerator(pathOptions).Generate();
+
+    // Each variant is measured from a clean slate: the scene of the
+    // previous one is destroyed and its memory released first.
+    auto report = [&paths](const char* label, auto&& populate) {
+        Hd_UnitTestPerfRunner::ReleaseFreedMemory();
+        const size_t heapBefore = Hd_UnitTestPerfRunner::GetHeapBytesInUse();
+        const size_t rssBefore = Hd_UnitTestPerfRunner::GetResidentBytes();
+        HdRetainedSceneIndexRefPtr sceneIndex = populate();
+        const size_t heapBytes = Hd_UnitTestPerfRunner::GetHeapBytesInUse() - heapBefore;
+        const size_t rssAfter = Hd_UnitTestPerfRunner::GetResidentBytes();
+        printf("%s: %zu prims, %.1f MB heap in use (%.1f bytes per prim), RSS %.1f MB -> %.1f MB\n", label,
+               paths.size(), heapBytes / 1048576.0, double(heapBytes) / paths.size(), rssBefore / 1048576.0,
+               rssAfter / 1048576.0);
+    };
+
+    report("heap", [&]() {
+        _HeapDataSourceFactory factory;
+        return _PopulateRetainedScene(paths, factory, false);
+    });
+    report("arena", [&]() {
+        Hd_DataSourceArena arena;
+        _ArenaDataSourceFactory factory{&arena};
+        HdRetainedSceneIndexRefPtr sceneIndex = _PopulateRetainedScene(paths, factory, false);
+        const Hd_DataSourceArena::Stats stats = arena.GetStats();
+        printf("arena: %zu allocations in %zu blocks, %.1f MB used of %.1f MB reserved\n", stats.numAllocations,
+               stats.numBlocks, stats.bytesAllocated / 1048576.0, stats.bytesReserved / 1048576.0);
+        // The arena takes memory from the heap a block at a time.
+        EXPECT_LT(stats.numBlocks, stats.numAllocations);
+        return sceneIndex;
+    });
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    runner.Measure("retained_populate_heap_1M", [&]() {
+        _HeapDataSourceFactory factory;
+        _PopulateRetainedScene(paths, factory, true);
+    });
+    runner.Measure("retained_populate_arena_1M", [&]() {
+        Hd_DataSourceArena arena;
+        _ArenaDataSourceFactory factory{&arena};
+        _PopulateRetainedScene(paths, factory, true);
+    });
+
+    EXPECT_TRUE(runner.Finish("testHdSceneIndex.json", "perfstats_scene_index.raw").empty());
+}
+
+//-----------------------------------------------------------------------------
+// Counts notices and the entries they carry.
+class CountingSceneIndexObserver : public HdSceneIndexObserver {
+public:
+    void PrimsAdded(const HdSceneIndexBase& sender, const AddedPrimEntries& entries) override {
+        ++numNotices;
+        numEntries += entries.size();
+    }
+
+    void PrimsRemoved(const HdSceneIndexBase& sender, const RemovedPrimEntries& entries) override {
+        ++numNotices;
+        numEntries += entries.size();
+    }
+
+    void PrimsDirtied(const HdSceneIndexBase& sender, const DirtiedPrimEntries& entries) override {
+        ++numNotices;
+        numEntries += entries.size();
+    }
+
+    void PrimsRenamed(const HdSceneIndexBase& sender, const RenamedPrimEntries& entries) override {
+        ++numNotices;
+        numEntries += entries.size();
+    }
+
+    size_t numNotices = 0;
+    size_t numEntries = 0;
+};
+
+// Splits entries into numBatches contiguous batches.
+static std::vector<HdRetainedSceneIndex::AddedPrimEntries> _PartitionEntries(
+        HdRetainedSceneIndex::AddedPrimEntries const& entries, size_t numBatches) {
+    std::vector<HdRetainedSceneIndex::AddedPrimEntries> batches(numBatches);
+    for (size_t b = 0; b != numBatches; ++b) {
+        batches[b].assign(entries.begin() + entries.size() * b / numBatches,
+                          entries.begin() + entries.size() * (b + 1) / numBatches);
+    }
+    return batches;
+}
+
+static void _CompareSceneIndices(HdSceneIndexBase& expected, HdSceneIndexBase& actual, SdfPath const& path) {
+    const HdSceneIndexPrim expectedPrim = expected.GetPrim(path);
+    const HdSceneIndexPrim actualPrim = actual.GetPrim(path);
+    ASSERT_EQ(expectedPrim.primType, actualPrim.primType) << path;
+    ASSERT_EQ(expectedPrim.dataSource, actualPrim.dataSource) << path;
+
+    SdfPathVector expectedChildren = expected.GetChildPrimPaths(path);
+    SdfPathVector actualChildren = actual.GetChildPrimPaths(path);
+    std::sort(expectedChildren.begin(), expectedChildren.end());
+    std::sort(actualChildren.begin(), actualChildren.end());
+    ASSERT_EQ(expectedChildren, actualChildren) << path;
+
+    for (SdfPath const& child : expectedChildren) {
+        _CompareSceneIndices(expected, actual, child);
+    }
+}
+
+TEST(TestHydra, test_bulk_retained_scene_index) {
+    Hd_UnitTestPathGenerator::Options pathOptions;
+    pathOptions.fanout = {3, 4, 5};
+    pathOptions.zipfSkew = 1.0;
+    const SdfPathVector paths = Hd_UnitTestPathGenerator(pathOptions).Generate();
+
+    HdRetainedSceneIndex::AddedPrimEntries entries;
+    for (SdfPath const& path : paths) {
+        entries.push_back({path, TfToken("mesh"), HdRetainedContainerDataSource::New()});
+    }
+    // Re-added prims replace earlier entries, and interior prims may be
+    // added explicitly.
+    entries.push_back({paths[3], TfToken("cube"), HdRetainedContainerDataSource::New()});
+    entries.push_back({paths[5].GetParentPath(), TfToken("scope"), HdRetainedContainerDataSource::New()});
+
+    HdRetainedSceneIndexRefPtr expected = HdRetainedSceneIndex::New();
+    expected->AddPrims(entries);
+
+    Hd_BulkRetainedSceneIndexRefPtr bulk = Hd_BulkRetainedSceneIndex::New();
+    CountingSceneIndexObserver observer;
+    bulk->AddObserver(HdSceneIndexObserverPtr(&observer));
+    bulk->AddPrims(_PartitionEntries(entries, 7));
+
+    EXPECT_EQ(observer.numNotices, size_t(1));
+    EXPECT_EQ(observer.numEntries, entries.size());
+    _CompareSceneIndices(*expected, *bulk, SdfPath::AbsoluteRootPath());
+    EXPECT_EQ(bulk->GetPrim(paths[3]).primType, TfToken("cube"));
+    EXPECT_FALSE(bulk->GetPrim(SdfPath("/Missing")).dataSource);
+    EXPECT_TRUE(bulk->GetChildPrimPaths(SdfPath("/Missing")).empty());
+
+    // A second call merges with the existing prims.
+    HdRetainedSceneIndex::AddedPrimEntries more = {
+            {SdfPath("/Extra/Deep/Prim"), TfToken("mesh"), HdRetainedContainerDataSource::New()},
+            {paths[0], TfToken("sphere"), HdRetainedContainerDataSource::New()},
+    };
+    expected->AddPrims(more);
+    bulk->AddPrims({more});
+    EXPECT_EQ(observer.numNotices, size_t(2));
+    _CompareSceneIndices(*expected, *bulk, SdfPath::AbsoluteRootPath());
+}
+
+// Populates 1M and 10M prims with HdRetainedSceneIndex::AddPrims and with
+// Hd_BulkRetainedSceneIndex from 64 batches at increasing thread counts, up
+// to 32.  Timings include releasing the scene index.
+TEST(TestHydra, test_bulk_retained_scene_index_scaling_perf) {
+    Hd_UnitTestPerfRunner runner;
+    const HdContainerDataSourceHandle dataSource = HdRetainedContainerDataSource::New();
+    static const TfToken meshType("mesh");
+
+    for (size_t numPrims : {1000000, 10000000}) {
+        Hd_UnitTestPerfRunner::Options options;
+        options.warmup = 0;
+        options.trials = std::min<size_t>(options.trials, numPrims > 1000000 ? 1 : 3);
+        const std::string label = TfStringPrintf("%zuM", numPrims / 1000000);
+
+        HdRetainedSceneIndex::AddedPrimEntries entries;
+        {
+            const SdfPathVector paths =
+                    Hd_UnitTestPathGenerator(Hd_UnitTestPathGenerator::UniformOptions(numPrims, 4)).Generate();
+            entries.reserve(paths.size());
+            for (SdfPath const& path : paths) {
+                entries.push_back({path, meshType, dataSource});
+            }
+        }
+        const std::vector<HdRetainedSceneIndex::AddedPrimEntries> batches = _PartitionEntries(entries, 64);
+
+        runner.Measure("retained_add_prims_" + label, options, [&]() {
+            HdRetainedSceneIndexRefPtr sceneIndex = HdRetainedSceneIndex::New();
+            sceneIndex->AddPrims(entries);
+        });
+
+        for (unsigned numThreads : Hd_UnitTestPerfRunner::GetThreadCounts(32)) {
+            WorkSetConcurrencyLimit(numThreads);
+            runner.Measure(TfStringPrintf("bulk_add_prims_%s_%ut", label.c_str(), numThreads), options, [&]() {
+                Hd_BulkRetainedSceneIndexRefPtr sceneIndex = Hd_BulkRetainedSceneIndex::New();
+                sceneIndex->AddPrims(batches);
+            });
+        }
+        WorkSetMaximumConcurrencyLimit();
+    }
+
+    EXPECT_TRUE(runner.Finish("testHdBulkRetainedSceneIndex.json", "perfstats_bulk_scene_index.raw").empty());
+}
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+TF_DECLARE_REF_PTRS(_RenamingSceneIndex);
+
+// Retained scene index that can send rename notices for prims that already
+// exist under their new path.
+class _RenamingSceneIndex : public HdRetainedSceneIndex {
+public:
+    static _RenamingSceneIndexRefPtr New() { return TfCreateRefPtr(new _RenamingSceneIndex()); }
+
+    void SendPrimsRenamed(const HdSceneIndexObserver::RenamedPrimEntries& entries) { _SendPrimsRenamed(entries); }
+};
+
+}  // namespace
+
+TEST(TestHydra, test_notice_batching_scene_index) {
+    _RenamingSceneIndexRefPtr retainedScene = _RenamingSceneIndex::New();
+    retainedScene->AddPrims({
+            {SdfPath("/A"), TfToken("mesh"), HdRetainedContainerDataSource::New()},
+            {SdfPath("/A/B"), TfToken("mesh"), HdRetainedContainerDataSource::New()},
+            {SdfPath("/C"), TfToken("mesh"), HdRetainedContainerDataSource::New()},
+            {SdfPath("/R2/S"), TfToken("mesh"), HdRetainedContainerDataSource::New()},
+    });
+
+    Hd_NoticeBatchingSceneIndexRefPtr batchingScene = Hd_NoticeBatchingSceneIndex::New(retainedScene);
+    _RepopulatingSceneIndexRefPtr filteringScene = _RepopulatingSceneIndex::New(batchingScene);
+
+    RecordingSceneIndexObserver observer;
+    CountingSceneIndexObserver counter;
+    filteringScene->AddObserver(HdSceneIndexObserverPtr(&observer));
+    filteringScene->AddObserver(HdSceneIndexObserverPtr(&counter));
+
+    const HdDataSourceLocator primvarsLocator = HdPrimvarsSchema::GetDefaultLocator();
+    const HdDataSourceLocator xformLocator = HdXformSchema::GetDefaultLocator();
+    const HdDataSourceLocator visibilityLocator = HdVisibilitySchema::GetDefaultLocator();
+
+    using _Event = RecordingSceneIndexObserver::Event;
+    using _EventSet = RecordingSceneIndexObserver::EventSet;
+
+    // Outside of a block, notices are forwarded right away.
+    retainedScene->DirtyPrims({{SdfPath("/A"), primvarsLocator}});
+    EXPECT_EQ(observer.GetEventsAsSet(),
+              _EventSet({_Event{RecordingSceneIndexObserver::EventType_PrimDirtied, SdfPath("/A"), TfToken(),
+                                primvarsLocator}}));
+    EXPECT_FALSE(batchingScene->HasPendingNotices());
+    observer.Clear();
+    counter.numNotices = 0;
+
+    {
+        Hd_SceneIndexNoticeBlock block;
+        retainedScene->DirtyPrims({{SdfPath("/A"), primvarsLocator}});
+        retainedScene->DirtyPrims({{SdfPath("/A"), xformLocator}});
+        retainedScene->DirtyPrims({{SdfPath("/A"), primvarsLocator}});
+        retainedScene->DirtyPrims({{SdfPath("/C"), visibilityLocator}});
+        {
+            Hd_SceneIndexNoticeBlock nestedBlock;
+            retainedScene->AddPrims({{SdfPath("/D"), TfToken("mesh"), HdRetainedContainerDataSource::New()}});
+            // Dropped, /D is added in the same batch.
+            retainedScene->DirtyPrims({{SdfPath("/D"), primvarsLocator}});
+        }
+        EXPECT_TRUE(observer.GetEvents().empty());
+
+        // Drops the dirty for /C.
+        retainedScene->RemovePrims({SdfPath("/C")});
+        EXPECT_TRUE(batchingScene->HasPendingNotices());
+        EXPECT_TRUE(observer.GetEvents().empty());
+    }
+
+    EXPECT_EQ(counter.numNotices, size_t(3));
+    EXPECT_EQ(observer.GetEventsAsSet(),
+              _EventSet({
+                      _Event{RecordingSceneIndexObserver::EventType_PrimRemoved, SdfPath("/C")},
+                      _Event{RecordingSceneIndexObserver::EventType_PrimAdded, SdfPath("/D"), TfToken("mesh")},
+                      _Event{RecordingSceneIndexObserver::EventType_PrimDirtied, SdfPath("/A"), TfToken(),
+                             primvarsLocator},
+                      _Event{RecordingSceneIndexObserver::EventType_PrimDirtied, SdfPath("/A"), TfToken(),
+                             xformLocator},
+              }));
+    EXPECT_FALSE(batchingScene->HasPendingNotices());
+    observer.Clear();
+    counter.numNotices = 0;
+
+    // Renames become a removal and the additions of the renamed subtree.
+    {
+        Hd_SceneIndexNoticeBlock block;
+        retainedScene->SendPrimsRenamed({{SdfPath("/R"), SdfPath("/R2")}});
+        retainedScene->DirtyPrims({{SdfPath("/R2/S"), xformLocator}});
+    }
+
+    EXPECT_EQ(counter.numNotices, size_t(2));
+    EXPECT_EQ(observer.GetEventsAsSet(),
+              _EventSet({
+                      _Event{RecordingSceneIndexObserver::EventType_PrimRemoved, SdfPath("/R")},
+                      _Event{RecordingSceneIndexObserver::EventType_PrimAdded, SdfPath("/R2"), TfToken()},
+                      _Event{RecordingSceneIndexObserver::EventType_PrimAdded, SdfPath("/R2/S"), TfToken("mesh")},
+              }));
+}
+
+// Sends 100k dirties of random prims, one DirtyPrims call each, through a
+// chain of twelve filtering scene indices, with and without a notice block.
+TEST(TestHydra, test_notice_batching_scene_index_perf) {
+    const SdfPathVector paths =
+            Hd_UnitTestPathGenerator(Hd_UnitTestPathGenerator::UniformOptions(100000, 4)).Generate();
+
+    HdRetainedSceneIndexRefPtr retainedScene = HdRetainedSceneIndex::New();
+    {
+        HdRetainedSceneIndex::AddedPrimEntries entries;
+        entries.reserve(paths.size());
+        for (SdfPath const& path : paths) {
+            entries.push_back({path, TfToken("mesh"), HdRetainedContainerDataSource::New()});
+        }
+        retainedScene->AddPrims(entries);
+    }
+
+    constexpr size_t numFilters = 12;
+    Hd_NoticeBatchingSceneIndexRefPtr batchingScene = Hd_NoticeBatchingSceneIndex::New(retainedScene);
+    HdSceneIndexBaseRefPtr lastScene = batchingScene;
+    for (size_t i = 0; i != numFilters; ++i) {
+        lastScene = _RepopulatingSceneIndex::New(lastScene);
+    }
+    CountingSceneIndexObserver counter;
+    lastScene->AddObserver(HdSceneIndexObserverPtr(&counter));
+
+    const std::vector<HdDataSourceLocator> locators = {
+            HdPrimvarsSchema::GetDefaultLocator().Append(TfToken("points")),
+            HdPrimvarsSchema::GetDefaultLocator().Append(TfToken("normals")),
+            HdXformSchema::GetDefaultLocator(),
+            HdVisibilitySchema::GetDefaultLocator(),
+    };
+    std::vector<HdSceneIndexObserver::DirtiedPrimEntry> dirties;
+    {
+        std::mt19937 randomGen(42);
+        std::uniform_int_distribution<size_t> pathDist(0, paths.size() - 1);
+        std::uniform_int_distribution<size_t> locatorDist(0, locators.size() - 1);
+        for (size_t i = 0; i != 100000; ++i) {
+            dirties.emplace_back(paths[pathDist(randomGen)], HdDataSourceLocatorSet{locators[locatorDist(randomGen)]});
+        }
+    }
+
+    auto sendDirties = [&]() {
+        for (HdSceneIndexObserver::DirtiedPrimEntry const& entry : dirties) {
+            retainedScene->DirtyPrims({entry});
+        }
+    };
+    auto report = [&](const char* label, auto&& fn) {
+        counter.numNotices = counter.numEntries = 0;
+        fn();
+        // Every filter in the chain handles every notice the last one sends.
+        printf("%s: %zu notices with %zu entries, %zu filter callbacks\n", label, counter.numNotices,
+               counter.numEntries, counter.numNotices * (numFilters + 1));
+        return counter.numNotices;
+    };
+
+    EXPECT_EQ(report("unbatched", sendDirties), dirties.size());
+    EXPECT_EQ(report("batched",
+                     [&]() {
+                         Hd_SceneIndexNoticeBlock block;
+                         sendDirties();
+                     }),
+              size_t(1));
+
+    Hd_UnitTestPerfRunner runner;
+    runner.Measure("notice_dirty_unbatched_100k", sendDirties);
+    runner.Measure("notice_dirty_batched_100k", [&]() {
+        Hd_SceneIndexNoticeBlock block;
+        sendDirties();
+    });
+
+    EXPECT_TRUE(runner.Finish("testHdNoticeBatching.json", "perfstats_notice_batching.raw").empty());
+}
+
+//-----------------------------------------------------------------------------
+
+static HdContainerDataSourceHandle _BuildDependency(const SdfPath& dependedOnPrimPath,
+                                                    const HdDataSourceLocator& dependedOnLocator,
+                                                    const HdDataSourceLocator& affectedLocator) {
+    using RDS = HdRetainedTypedSampledDataSource<HdDataSourceLocator>;
+    return HdDependencySchema::Builder()
+            .SetDependedOnPrimPath(HdRetainedTypedSampledDataSource<SdfPath>::New(dependedOnPrimPath))
+            .SetDependedOnDataSourceLocator(RDS::New(dependedOnLocator))
+            .SetAffectedDataSourceLocator(RDS::New(affectedLocator))
+            .Build();
+}
+
+static HdRetainedSceneIndex::AddedPrimEntry _BuildDependentPrim(const SdfPath& path,
+                                                                const SdfPath& dependedOnPrimPath,
+                                                                const TfToken& dependedOnLocator,
+                                                                const TfToken& affectedLocator) {
+    return {path, TfToken("group"),
+            HdRetainedContainerDataSource::New(
+                    HdDependenciesSchemaTokens->__dependencies,
+                    HdRetainedContainerDataSource::New(
+                            TfToken("test"),
+                            _BuildDependency(dependedOnPrimPath, HdDataSourceLocator(dependedOnLocator),
+                                             HdDataSourceLocator(affectedLocator))))};
+}
+
+// Checks that the parallel dependency forwarding scene index sends the same
+// dirties as HdDependencyForwardingSceneIndex, including around cycles and
+// after dependencies change.
+TEST(TestHydra, test_parallel_dependency_forwarding_scene_index) {
+    using EventType = RecordingSceneIndexObserver::EventType;
+    using Event = RecordingSceneIndexObserver::Event;
+    using EventSet = RecordingSceneIndexObserver::EventSet;
+
+    HdRetainedSceneIndexRefPtr retainedScene = HdRetainedSceneIndex::New();
+    retainedScene->AddPrims({
+            {SdfPath("/A"), TfToken("group"), HdRetainedContainerDataSource::New()},
+            _BuildDependentPrim(SdfPath("/B"), SdfPath("/A"), TfToken("taco"), TfToken("chicken")),
+            _BuildDependentPrim(SdfPath("/C"), SdfPath("/B"), TfToken("chicken"), TfToken("salsa")),
+            // ...D->E->F->D->...
+            _BuildDependentPrim(SdfPath("/D"), SdfPath("/E"), TfToken("attr2"), TfToken("attr1")),
+            _BuildDependentPrim(SdfPath("/E"), SdfPath("/F"), TfToken("attr3"), TfToken("attr2")),
+            _BuildDependentPrim(SdfPath("/F"), SdfPath("/D"), TfToken("attr1"), TfToken("attr3")),
+    });
+
+    HdDependencyForwardingSceneIndexRefPtr expectedScene = HdDependencyForwardingSceneIndex::New(retainedScene);
+    Hd_ParallelDependencyForwardingSceneIndexRefPtr parallelScene =
+            Hd_ParallelDependencyForwardingSceneIndex::New(retainedScene);
+    parallelScene->Populate();
+    EXPECT_EQ(parallelScene->GetNumDependencies(), size_t(5));
+
+    // Pulls every prim, which also seeds the dependencies of expectedScene.
+    _CompareSceneIndices(*expectedScene, *parallelScene, SdfPath::AbsoluteRootPath());
+
+    RecordingSceneIndexObserver expectedObserver;
+    RecordingSceneIndexObserver parallelObserver;
+    expectedScene->AddObserver(HdSceneIndexObserverPtr(&expectedObserver));
+    parallelScene->AddObserver(HdSceneIndexObserverPtr(&parallelObserver));
+
+    auto compareDirty = [&](const char* path, const HdDataSourceLocator& locator) {
+        expectedObserver.Clear();
+        parallelObserver.Clear();
+        retainedScene->DirtyPrims({{SdfPath(path), locator}});
+        _CompareValue((std::string("DIRTYING ") + path).c_str(), parallelObserver.GetEventsAsSet(),
+                      expectedObserver.GetEventsAsSet());
+    };
+
+    compareDirty("/A", HdDataSourceLocator(TfToken("taco")));
+    EXPECT_EQ(parallelScene->GetLastPropagationStats().numLevels, size_t(2));
+    compareDirty("/A", HdDataSourceLocator());
+    compareDirty("/A", HdDataSourceLocator(TfToken("burrito")));
+    EXPECT_EQ(parallelScene->GetLastPropagationStats().numDirtied, size_t(0));
+
+    // The cycle is followed once around.
+    compareDirty("/D", HdDataSourceLocator(TfToken("attr1")));
+    EXPECT_EQ(parallelScene->GetLastPropagationStats().numDirtied, size_t(2));
+    EXPECT_EQ(parallelScene->GetLastPropagationStats().numRevisits, size_t(1));
+    compareDirty("/E", HdDataSourceLocator(TfToken("attr2")));
+    compareDirty("/F", HdDataSourceLocator(TfToken("attr3")));
+
+    // Re-adding /C with a dependency on /A replaces its dependency on /B.
+    retainedScene->AddPrims({_BuildDependentPrim(SdfPath("/C"), SdfPath("/A"), TfToken("taco"), TfToken("salsa"))});
+    EXPECT_EQ(parallelScene->GetNumDependencies(), size_t(5));
+    parallelObserver.Clear();
+    retainedScene->DirtyPrims({{SdfPath("/B"), HdDataSourceLocator(TfToken("chicken"))}});
+    _CompareValue("DIRTYING /B after changing /C", parallelObserver.GetEventsAsSet(),
+                  EventSet{Event{EventType::EventType_PrimDirtied, SdfPath("/B"), TfToken(),
+                                 HdDataSourceLocator(TfToken("chicken"))}});
+    parallelObserver.Clear();
+    retainedScene->DirtyPrims({{SdfPath("/A"), HdDataSourceLocator(TfToken("taco"))}});
+    _CompareValue(
+            "DIRTYING /A after changing /C", parallelObserver.GetEventsAsSet(),
+            EventSet{
+                    Event{EventType::EventType_PrimDirtied, SdfPath("/A"), TfToken(),
+                          HdDataSourceLocator(TfToken("taco"))},
+                    Event{EventType::EventType_PrimDirtied, SdfPath("/B"), TfToken(),
+                          HdDataSourceLocator(TfToken("chicken"))},
+                    Event{EventType::EventType_PrimDirtied, SdfPath("/C"), TfToken(),
+                          HdDataSourceLocator(TfToken("salsa"))},
+            });
+
+    // Removing /A dirties its dependents, and removing /B drops its
+    // dependency.
+    parallelObserver.Clear();
+    retainedScene->RemovePrims({SdfPath("/A")});
+    _CompareValue(
+            "Removing /A", parallelObserver.GetEventsAsSet(),
+            EventSet{
+                    Event{EventType::EventType_PrimRemoved, SdfPath("/A"), TfToken(), HdDataSourceLocator()},
+                    Event{EventType::EventType_PrimDirtied, SdfPath("/B"), TfToken(),
+                          HdDataSourceLocator(TfToken("chicken"))},
+                    Event{EventType::EventType_PrimDirtied, SdfPath("/C"), TfToken(),
+                          HdDataSourceLocator(TfToken("salsa"))},
+            });
+    retainedScene->RemovePrims({SdfPath("/B")});
+    EXPECT_EQ(parallelScene->GetNumDependencies(), size_t(4));
+
+    // Populating again folds the changes into the table.
+    parallelScene->Populate();
+    EXPECT_EQ(parallelScene->GetNumDependencies(), size_t(4));
+}
+
+// Builds 1M meshes that each depend on one of 1000 materials and four of
+// 100 lights, with every material depending on one of 10 textures, and
+// compares HdDependencyForwardingSceneIndex with the parallel table for
+// building the dependencies and for propagating texture and light dirties.
+TEST(TestHydra, test_parallel_dependency_forwarding_scene_index_perf) {
+    constexpr size_t numMaterials = 1000;
+    constexpr size_t numLights = 100;
+    constexpr size_t numTextures = 10;
+    static const TfToken materialToken("material");
+    static const TfToken lightToken("light");
+    static const TfToken textureToken("texture");
+
+    auto materialPath = [](size_t i) { return SdfPath(TfStringPrintf("/Looks/M_%zu", i)); };
+    auto lightPath = [](size_t i) { return SdfPath(TfStringPrintf("/Lights/L_%zu", i)); };
+    auto texturePath = [](size_t i) { return SdfPath(TfStringPrintf("/Looks/Textures/T_%zu", i)); };
+
+    const SdfPathVector meshPaths =
+            Hd_UnitTestPathGenerator(Hd_UnitTestPathGenerator::UniformOptions(1000000, 4)).Generate();
+
+    // Meshes share dependency containers by material and light set.
+    std::vector<HdContainerDataSourceHandle> meshDataSources;
+    for (size_t c = 0; c != 10 * numMaterials; ++c) {
+        const TfToken names[] = {materialToken, TfToken("light0"), TfToken("light1"), TfToken("light2"),
+                                 TfToken("light3")};
+        HdDataSourceBaseHandle values[5];
+        values[0] = _BuildDependency(materialPath(c % numMaterials), HdDataSourceLocator(materialToken),
+                                     HdDataSourceLocator(materialToken));
+        for (size_t k = 0; k != 4; ++k) {
+            values[k + 1] = _BuildDependency(lightPath((c / numMaterials + k * 25) % numLights),
+                                             HdDataSourceLocator(lightToken), HdDataSourceLocator(lightToken));
+        }
+        meshDataSources.push_back(HdRetainedContainerDataSource::New(
+                HdDependenciesSchemaTokens->__dependencies, HdRetainedContainerDataSource::New(5, names, values)));
+    }
+
+    HdRetainedSceneIndex::AddedPrimEntries entries;
+    entries.reserve(meshPaths.size() + numMaterials + numLights + numTextures);
+    for (size_t i = 0; i != meshPaths.size(); ++i) {
+        entries.push_back({meshPaths[i], TfToken("mesh"), meshDataSources[i % meshDataSources.size()]});
+    }
+    for (size_t i = 0; i != numMaterials; ++i) {
+        entries.push_back({materialPath(i), TfToken("material"),
+                           HdRetainedContainerDataSource::New(
+                                   HdDependenciesSchemaTokens->__dependencies,
+                                   HdRetainedContainerDataSource::New(
+                                           textureToken,
+                                           _BuildDependency(texturePath(i % numTextures),
+                                                            HdDataSourceLocator(textureToken),
+                                                            HdDataSourceLocator(materialToken))))});
+    }
+    for (size_t i = 0; i != numLights; ++i) {
+        entries.push_back({lightPath(i), TfToken("light"), HdRetainedContainerDataSource::New()});
+    }
+    for (size_t i = 0; i != numTextures; ++i) {
+        entries.push_back({texturePath(i), TfToken("texture"), HdRetainedContainerDataSource::New()});
+    }
+    Hd_BulkRetainedSceneIndexRefPtr inputScene = Hd_BulkRetainedSceneIndex::New();
+    inputScene->AddPrims({entries});
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    const HdSceneIndexObserver::DirtiedPrimEntries textureDirty = {
+            {texturePath(0), HdDataSourceLocatorSet{HdDataSourceLocator(textureToken)}}};
+    const HdSceneIndexObserver::DirtiedPrimEntries lightDirty = {
+            {lightPath(0), HdDataSourceLocatorSet{HdDataSourceLocator(lightToken)}}};
+
+    CountingSceneIndexObserver expectedCounter;
+    {
+        HdDependencyForwardingSceneIndexRefPtr expectedScene;
+        runner.Measure("dependency_lazy_pull_1M", [&]() {
+            expectedScene = HdDependencyForwardingSceneIndex::New(inputScene);
+            for (const HdRetainedSceneIndex::AddedPrimEntry& entry : entries) {
+                expectedScene->GetPrim(entry.primPath);
+            }
+        });
+        expectedScene->AddObserver(HdSceneIndexObserverPtr(&expectedCounter));
+        runner.Measure("dependency_dirty_texture_stock", [&]() { inputScene->DirtyPrims(textureDirty); });
+        runner.Measure("dependency_dirty_light_stock", [&]() { inputScene->DirtyPrims(lightDirty); });
+    }
+
+    for (unsigned numThreads : Hd_UnitTestPerfRunner::GetThreadCounts()) {
+        WorkSetConcurrencyLimit(numThreads);
+        Hd_ParallelDependencyForwardingSceneIndexRefPtr parallelScene =
+                Hd_ParallelDependencyForwardingSceneIndex::New(inputScene);
+        runner.Measure(TfStringPrintf("dependency_parallel_populate_1M_%ut", numThreads),
+                       [&]() { parallelScene->Populate(); });
+
+        CountingSceneIndexObserver counter;
+        parallelScene->AddObserver(HdSceneIndexObserverPtr(&counter));
+        runner.Measure(TfStringPrintf("dependency_dirty_texture_parallel_%ut", numThreads),
+                       [&]() { inputScene->DirtyPrims(textureDirty); });
+        // The texture reaches 100 materials and, through them, every tenth
+        // mesh.
+        EXPECT_EQ(parallelScene->GetLastPropagationStats().numLevels, size_t(2));
+        EXPECT_EQ(parallelScene->GetLastPropagationStats().numDirtied,
+                  numMaterials / numTextures + (meshPaths.size() + numTextures - 1) / numTextures);
+        runner.Measure(TfStringPrintf("dependency_dirty_light_parallel_%ut", numThreads),
+                       [&]() { inputScene->DirtyPrims(lightDirty); });
+        parallelScene->RemoveObserver(HdSceneIndexObserverPtr(&counter));
+    }
+    WorkSetMaximumConcurrencyLimit();
+
+    EXPECT_TRUE(runner.Finish("testHdDependencyForwarding.json", "perfstats_dependency_forwarding.raw").empty());
+}
+
+//-----------------------------------------------------------------------------
+
+TEST(TestHydra, test_bounded_dependency_forwarding_scene_index_eviction) {
+    using EventType = RecordingSceneIndexObserver::EventType;
+    using Event = RecordingSceneIndexObserver::Event;
+    using EventSet = RecordingSceneIndexObserver::EventSet;
+    using Stats = Hd_BoundedDependencyForwardingSceneIndex::Stats;
+
+    HdRetainedSceneIndexRefPtr retainedScene = HdRetainedSceneIndex::New();
+    retainedScene->AddPrims({
+            {SdfPath("/A"), TfToken("group"), HdRetainedContainerDataSource::New()},
+            _BuildDependentPrim(SdfPath("/B"), SdfPath("/A"), TfToken("taco"), TfToken("chicken")),
+            _BuildDependentPrim(SdfPath("/C"), SdfPath("/A"), TfToken("taco"), TfToken("salsa")),
+    });
+
+    Hd_BoundedDependencyForwardingSceneIndexRefPtr dependencyForwardingScene =
+            Hd_BoundedDependencyForwardingSceneIndex::New(retainedScene);
+    RecordingSceneIndexObserver recordingScene;
+    dependencyForwardingScene->AddObserver(HdSceneIndexObserverPtr(&recordingScene));
+
+    auto dirtyA = [&]() {
+        recordingScene.Clear();
+        retainedScene->DirtyPrims({{SdfPath("/A"), HdDataSourceLocator(TfToken("taco"))}});
+        return recordingScene.GetEventsAsSet();
+    };
+    const Event dirtyAEvent{EventType::EventType_PrimDirtied, SdfPath("/A"), TfToken(),
+                            HdDataSourceLocator(TfToken("taco"))};
+    const Event dirtyBEvent{EventType::EventType_PrimDirtied, SdfPath("/B"), TfToken(),
+                            HdDataSourceLocator(TfToken("chicken"))};
+    const Event dirtyCEvent{EventType::EventType_PrimDirtied, SdfPath("/C"), TfToken(),
+                            HdDataSourceLocator(TfToken("salsa"))};
+    // Evicted prims no longer know which of their locators are affected.
+    const Event dirtyAllBEvent{EventType::EventType_PrimDirtied, SdfPath("/B"), TfToken(), HdDataSourceLocator()};
+    const Event dirtyAllCEvent{EventType::EventType_PrimDirtied, SdfPath("/C"), TfToken(), HdDataSourceLocator()};
+
+    // Prims without dependencies have no records.
+    dependencyForwardingScene->GetPrim(SdfPath("/A"));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEntries, size_t(0));
+
+    // Leave room for a single record.
+    dependencyForwardingScene->GetPrim(SdfPath("/B"));
+    const Stats oneEntry = dependencyForwardingScene->GetStats();
+    EXPECT_EQ(oneEntry.numEntries, size_t(1));
+    EXPECT_GT(oneEntry.numBytes, size_t(0));
+    dependencyForwardingScene->SetMemoryBudget(oneEntry.numBytes);
+    _CompareValue("DIRTYING /A with /B pulled", dirtyA(), EventSet{dirtyAEvent, dirtyBEvent});
+
+    // Pulling /C evicts the record of /B, which keeps receiving dirties,
+    // only for all of its locators.
+    dependencyForwardingScene->GetPrim(SdfPath("/C"));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEntries, size_t(1));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEvictions, size_t(1));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEvictedEntries, size_t(1));
+    EXPECT_LE(dependencyForwardingScene->GetStats().numBytes, oneEntry.numBytes);
+    _CompareValue("DIRTYING /A with /B evicted", dirtyA(), EventSet{dirtyAEvent, dirtyAllBEvent, dirtyCEvent});
+
+    // Pulling /B again discovers its dependency again, and evicts /C.
+    dependencyForwardingScene->GetPrim(SdfPath("/B"));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numDiscoveries, size_t(3));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEvictions, size_t(2));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEvictedEntries, size_t(1));
+    _CompareValue("DIRTYING /A with /C evicted", dirtyA(), EventSet{dirtyAEvent, dirtyBEvent, dirtyAllCEvent});
+
+    // Removal still dirties dependents, as in
+    // test_dependency_forwarding_scene_index_eviction, and drops records
+    // without counting them as evictions.
+    recordingScene.Clear();
+    retainedScene->RemovePrims({SdfPath("/A")});
+    _CompareValue("Removing /A", recordingScene.GetEventsAsSet(),
+                  EventSet{Event{EventType::EventType_PrimRemoved, SdfPath("/A"), TfToken(), HdDataSourceLocator()},
+                           dirtyBEvent, dirtyAllCEvent});
+    retainedScene->RemovePrims({SdfPath("/B"), SdfPath("/C")});
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEntries, size_t(0));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numBytes, size_t(0));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEvictedEntries, size_t(0));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEvictedBytes, size_t(0));
+    EXPECT_EQ(dependencyForwardingScene->GetStats().numEvictions, size_t(2));
+}
+
+// Scales the eviction scenario up to 2M prims that each depend on one of
+// 1000 source prims, and pulls all of them with and without a budget of an
+// eighth of the unbounded cache.
+TEST(TestHydra, test_bounded_dependency_forwarding_scene_index_eviction_perf) {
+    constexpr size_t numSources = 1000;
+    auto sourcePath = [](size_t i) { return SdfPath(TfStringPrintf("/Sources/S_%zu", i)); };
+
+    const SdfPathVector paths =
+            Hd_UnitTestPathGenerator(Hd_UnitTestPathGenerator::UniformOptions(2000000, 4)).Generate();
+    HdRetainedSceneIndex::AddedPrimEntries entries;
+    entries.reserve(paths.size() + numSources);
+    {
+        std::vector<HdContainerDataSourceHandle> dataSources;
+        for (size_t i = 0; i != numSources; ++i) {
+            dataSources.push_back(
+                    _BuildDependentPrim(SdfPath(), sourcePath(i), TfToken("taco"), TfToken("chicken")).dataSource);
+            entries.push_back({sourcePath(i), TfToken("group"), HdRetainedContainerDataSource::New()});
+        }
+        for (size_t i = 0; i != paths.size(); ++i) {
+            entries.push_back({paths[i], TfToken("group"), dataSources[i % numSources]});
+        }
+    }
+    Hd_BulkRetainedSceneIndexRefPtr inputScene = Hd_BulkRetainedSceneIndex::New();
+    inputScene->AddPrims({entries});
+
+    auto pullAll = [&](Hd_BoundedDependencyForwardingSceneIndex& sceneIndex) {
+        for (SdfPath const& path : paths) {
+            sceneIndex.GetPrim(path);
+        }
+    };
+    auto pullAllInParallel = [&](Hd_BoundedDependencyForwardingSceneIndex& sceneIndex) {
+        WorkParallelForN(paths.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i != end; ++i) {
+                sceneIndex.GetPrim(paths[i]);
+            }
+        });
+    };
+    auto report = [](const char* label, Hd_BoundedDependencyForwardingSceneIndex const& sceneIndex) {
+        const Hd_BoundedDependencyForwardingSceneIndex::Stats stats = sceneIndex.GetStats();
+        printf("%s: %zu entries, %.1f MB, %zu evictions, %zu evicted entries, %.1f MB, %zu discoveries, RSS %.1f MB\n",
+               label, stats.numEntries, stats.numBytes / 1048576.0, stats.numEvictions, stats.numEvictedEntries,
+               stats.numEvictedBytes / 1048576.0, stats.numDiscoveries,
+               Hd_UnitTestPerfRunner::GetResidentBytes() / 1048576.0);
+        return stats;
+    };
+
+    size_t budget = 0;
+    {
+        Hd_BoundedDependencyForwardingSceneIndexRefPtr sceneIndex =
+                Hd_BoundedDependencyForwardingSceneIndex::New(inputScene);
+        pullAll(*sceneIndex);
+        const Hd_BoundedDependencyForwardingSceneIndex::Stats stats = report("unbounded", *sceneIndex);
+        EXPECT_EQ(stats.numEntries, paths.size());
+        EXPECT_EQ(stats.numEvictions, size_t(0));
+        budget = stats.numBytes / 8;
+    }
+    {
+        Hd_BoundedDependencyForwardingSceneIndexRefPtr sceneIndex =
+                Hd_BoundedDependencyForwardingSceneIndex::New(inputScene, budget);
+        pullAll(*sceneIndex);
+        const Hd_BoundedDependencyForwardingSceneIndex::Stats stats = report("bounded", *sceneIndex);
+        EXPECT_LE(stats.numBytes, budget);
+        EXPECT_GT(stats.numEvictions, size_t(0));
+        EXPECT_EQ(stats.numEntries + stats.numEvictions, paths.size());
+        EXPECT_EQ(stats.numEvictedEntries, stats.numEvictions);
+    }
+    {
+        Hd_BoundedDependencyForwardingSceneIndexRefPtr sceneIndex =
+                Hd_BoundedDependencyForwardingSceneIndex::New(inputScene);
+        pullAllInParallel(*sceneIndex);
+        const Hd_BoundedDependencyForwardingSceneIndex::Stats stats = report("unbounded parallel", *sceneIndex);
+        EXPECT_EQ(stats.numEntries, paths.size());
+        EXPECT_EQ(stats.numDiscoveries, paths.size());
+    }
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    const HdSceneIndexObserver::DirtiedPrimEntries sourceDirty = {
+            {sourcePath(0), HdDataSourceLocatorSet{HdDataSourceLocator(TfToken("taco"))}}};
+    for (const bool bounded : {false, true}) {
+        const std::string label = bounded ? "bounded" : "unbounded";
+        Hd_BoundedDependencyForwardingSceneIndexRefPtr sceneIndex;
+        runner.Measure("dependency_pull_2M_" + label, [&]() {
+            sceneIndex = nullptr;
+            sceneIndex = Hd_BoundedDependencyForwardingSceneIndex::New(
+                    inputScene, bounded ? budget : std::numeric_limits<size_t>::max());
+            pullAll(*sceneIndex);
+        });
+        runner.Measure("dependency_pull_parallel_2M_" + label, [&]() {
+            sceneIndex = nullptr;
+            sceneIndex = Hd_BoundedDependencyForwardingSceneIndex::New(
+                    inputScene, bounded ? budget : std::numeric_limits<size_t>::max());
+            pullAllInParallel(*sceneIndex);
+        });
+        CountingSceneIndexObserver counter;
+        sceneIndex->AddObserver(HdSceneIndexObserverPtr(&counter));
+        runner.Measure("dependency_dirty_source_" + label, [&]() { inputScene->DirtyPrims(sourceDirty); });
+        sceneIndex->RemoveObserver(HdSceneIndexObserverPtr(&counter));
+    }
+
+    EXPECT_TRUE(runner.Finish("testHdBoundedDependencyForwarding.json", "perfstats_bounded_dependency.raw").empty());
+}
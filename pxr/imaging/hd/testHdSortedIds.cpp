@@ -7,6 +7,7 @@
 #include "pxr/pxr.h"
 #include "pxr/imaging/hd/sortedIds.h"
 #include "pxr/usd/sdf/path.h"
+#include "batchedSortedIds.h"
 
 #include <random>
 #include <algorithm>
@@ -358,3 +359,89 @@ TEST(TestHydra, insert_remove_dupes_test) {
     expected = {P("A"), P("C")};
     ASSERT_TRUE(sortedIds.GetIds() == expected);
 }
+
+TEST(TestHydra, batched_insert_remove_test) {
+    std::cout << "\n\nBatchedInsertRemoveTest():\n";
+
+    Hd_SortedIds sortedIds;
+    Hd_BatchedSortedIds batchedIds;
+
+    _Populate(&sortedIds);  // Also initializes populatePaths.
+    batchedIds.Insert(populatePaths.begin(), populatePaths.end());
+    ASSERT_TRUE(batchedIds.GetIds() == sortedIds.GetIds());
+
+    // Mix batched and single edits, including dupes, and check the result matches Hd_SortedIds after each step.
+    std::mt19937 randomGen(0);
+    for (int step = 0; step < 20; ++step) {
+        // Take 16 distinct entries currently present in the set.
+        SdfPathVector batch = sortedIds.GetIds();
+        std::shuffle(batch.begin(), batch.end(), randomGen);
+        batch.resize(16);
+        if (step % 2 == 0) {
+            batchedIds.Remove(batch.begin(), batch.end());
+            for (const SdfPath& path : batch) {
+                sortedIds.Remove(path);
+            }
+        } else {
+            batchedIds.Insert(batch.begin(), batch.end());
+            batchedIds.Insert(SdfPath("/I/J"));
+            for (const SdfPath& path : batch) {
+                sortedIds.Insert(path);
+            }
+            sortedIds.Insert(SdfPath("/I/J"));
+        }
+        ASSERT_TRUE(batchedIds.GetIds() == sortedIds.GetIds());
+    }
+
+    Hd_BatchedSortedIds populatedIds;
+    populatedIds.Populate(populatePaths);
+    ASSERT_TRUE(std::is_sorted(populatedIds.GetIds().begin(), populatedIds.GetIds().end()));
+    ASSERT_TRUE(populatedIds.GetIds().size() == populatePaths.size());
+}
+
+TEST(TestHydra, batched_subtree_test) {
+    std::cout << "\n\nBatchedSubtreeTest():\n";
+
+    using P = SdfPath;
+    Hd_BatchedSortedIds sortedIds;
+    SdfPathVector expected;
+
+    sortedIds.Populate({P("/A"), P("/A/X"), P("/B"), P("/B/X"), P("/B/Y"), P("/B0"), P("/C/X"), P("/B/X/Z")});
+
+    sortedIds.RemoveSubtree(P("/B/X"));
+
+    expected = {P("/A"), P("/A/X"), P("/B"), P("/B/Y"), P("/B0"), P("/C/X")};
+    ASSERT_TRUE(sortedIds.GetIds() == expected);
+
+    // Rename into a prefix that already has descendants.
+    sortedIds.RenameSubtree(P("/B"), P("/C"));
+
+    expected = {P("/A"), P("/A/X"), P("/B0"), P("/C"), P("/C/X"), P("/C/Y")};
+    ASSERT_TRUE(sortedIds.GetIds() == expected);
+
+    // Queued edits are applied before the subtree operation.
+    sortedIds.Insert(P("/D/X"));
+    sortedIds.RenameSubtree(P("/D"), P("/A/D"));
+
+    expected = {P("/A"), P("/A/D/X"), P("/A/X"), P("/B0"), P("/C"), P("/C/X"), P("/C/Y")};
+    ASSERT_TRUE(sortedIds.GetIds() == expected);
+
+    sortedIds.RemoveSubtree(P("/A"));
+    sortedIds.RemoveSubtree(P("/E"));
+
+    expected = {P("/B0"), P("/C"), P("/C/X"), P("/C/Y")};
+    ASSERT_TRUE(sortedIds.GetIds() == expected);
+
+    // Move subtrees backwards and forwards across other ids, merging with
+    // existing descendants.
+    sortedIds.Populate({P("/A/X"), P("/B"), P("/C"), P("/C/Z"), P("/D/Y")});
+    sortedIds.RenameSubtree(P("/C"), P("/A"));
+
+    expected = {P("/A"), P("/A/X"), P("/A/Z"), P("/B"), P("/D/Y")};
+    ASSERT_TRUE(sortedIds.GetIds() == expected);
+
+    sortedIds.RenameSubtree(P("/A"), P("/D"));
+
+    expected = {P("/B"), P("/D"), P("/D/X"), P("/D/Y"), P("/D/Z")};
+    ASSERT_TRUE(sortedIds.GetIds() == expected);
+}
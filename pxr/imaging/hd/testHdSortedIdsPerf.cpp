@@ -9,6 +9,10 @@
 #include "pxr/usd/sdf/path.h"
 #include "pxr/base/arch/timing.h"
 #include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/threadLimits.h"
+#include "batchedSortedIds.h"
+#include "unitTestPathGenerator.h"
+#include "unitTestPerfRunner.h"
 #include <random>
 #include <algorithm>
 #include <iterator>
@@ -53,9 +57,6 @@ static SdfPathVector const& _GetInitPaths() {
     return theInitPaths;
 }
 
-// Metric name to time in nanoseconds.
-using Metrics = std::vector<std::pair<std::string, int64_t>>;
-
 // Replace interior '/' with '_', e.g. '/foo/bar' -> 'foo_bar'.
 static std::string _PathToLabel(SdfPath const& p) {
     std::string str = p.GetAsString();
@@ -65,15 +66,31 @@ static std::string _PathToLabel(SdfPath const& p) {
     return TfStringReplace(str, "/", "_");
 }
 
-static void PopulateTest(Metrics& metrics) {
-    int64_t ticks = ArchMeasureExecutionTime([]() {
+static void PopulateTest(Hd_UnitTestPerfRunner& runner) {
+    runner.Measure("populate", []() {
         Hd_SortedIds result;
         for (SdfPath const& p : _GetInitPaths()) {
             result.Insert(p);
         }
         result.GetIds();  // Ensure it's sorted.
     });
-    metrics.emplace_back("populate", ArchTicksToNanoseconds(ticks));
+}
+
+static void BatchedPopulateTest(Hd_UnitTestPerfRunner& runner) {
+    for (unsigned numThreads : Hd_UnitTestPerfRunner::GetThreadCounts()) {
+        WorkSetConcurrencyLimit(numThreads);
+        runner.Measure(TfStringPrintf("populate_batched_%ut", numThreads), []() {
+            Hd_BatchedSortedIds result;
+            result.Insert(_GetInitPaths().begin(), _GetInitPaths().end());
+            result.GetIds();  // Ensure it's sorted.
+        });
+
+        runner.Measure(TfStringPrintf("populate_parallel_%ut", numThreads), []() {
+            Hd_BatchedSortedIds result;
+            result.Populate(_GetInitPaths());
+        });
+    }
+    WorkSetMaximumConcurrencyLimit();
 }
 
 static Hd_SortedIds const& _GetPopulatedIds() {
@@ -88,28 +105,27 @@ static Hd_SortedIds const& _GetPopulatedIds() {
     return theIds;
 }
 
-static void SingleRemoveInsertTest(Metrics& metrics) {
+static void SingleRemoveInsertTest(Hd_UnitTestPerfRunner& runner) {
     SdfPathVector testPaths = {SdfPath("/A/A/A/A"), SdfPath("/B/Y/O/B"), SdfPath("/Y/M/M/V"), SdfPath("/Z/Z/Z/Z")};
 
     Hd_SortedIds ids = _GetPopulatedIds();
 
     for (SdfPath const& path : testPaths) {
-        int64_t ticks = ArchMeasureExecutionTime([&ids, &path]() {
+        runner.Measure("add_del_" + _PathToLabel(path), [&ids, &path]() {
             ids.Remove(path);
             ids.GetIds();  // force sort.
             ids.Insert(path);
             ids.GetIds();  // force sort.
         });
-        metrics.emplace_back("add_del_" + _PathToLabel(path), ArchTicksToNanoseconds(ticks));
     }
 }
 
-static void MultiRemoveInsertTest(Metrics& metrics) {
+static void MultiRemoveInsertTest(Hd_UnitTestPerfRunner& runner) {
     SdfPathVector testPaths = {SdfPath("/A/A/A/A"), SdfPath("/B/Y/O/B"), SdfPath("/Y/M/M/V"), SdfPath("/Z/Z/Z/Z")};
 
     Hd_SortedIds ids = _GetPopulatedIds();
 
-    int64_t ticks = ArchMeasureExecutionTime([&ids, &testPaths]() {
+    runner.Measure("add_del_multiple", [&ids, &testPaths]() {
         for (SdfPath const& path : testPaths) {
             ids.Remove(path);
         }
@@ -119,11 +135,9 @@ static void MultiRemoveInsertTest(Metrics& metrics) {
         }
         ids.GetIds();  // force sort.
     });
-
-    metrics.emplace_back("add_del_multiple", ArchTicksToNanoseconds(ticks));
 }
 
-static void SubtreeRemoveInsertTest(Metrics& metrics) {
+static void SubtreeRemoveInsertTest(Hd_UnitTestPerfRunner& runner) {
     const SdfPathVector prefixes = {SdfPath("/A/A/A"), SdfPath("/B/Y/O"), SdfPath("/Y/M/M"), SdfPath("/Z/Z/Z")};
 
     const std::vector<SdfPathVector> subtreePathVecs = [&prefixes]() {
@@ -144,11 +158,9 @@ static void SubtreeRemoveInsertTest(Metrics& metrics) {
 
     Hd_SortedIds ids = _GetPopulatedIds();
 
-    std::vector<int64_t> timings;
-
-    timings.reserve(subtreePathVecs.size());
-    for (SdfPathVector const& subtreePaths : subtreePathVecs) {
-        timings.push_back(ArchMeasureExecutionTime([&ids, &subtreePaths]() {
+    for (size_t i = 0; i != subtreePathVecs.size(); ++i) {
+        SdfPathVector const& subtreePaths = subtreePathVecs[i];
+        runner.Measure("add_del_subtree_" + _PathToLabel(prefixes[i]), [&ids, &subtreePaths]() {
             for (SdfPath const& path : subtreePaths) {
                 ids.Remove(path);
             }
@@ -157,15 +169,11 @@ static void SubtreeRemoveInsertTest(Metrics& metrics) {
                 ids.Insert(path);
             }
             ids.GetIds();  // force sort.
-        }));
-    }
-
-    for (size_t i = 0; i != timings.size(); ++i) {
-        metrics.emplace_back("add_del_subtree_" + _PathToLabel(prefixes[i]), ArchTicksToNanoseconds(timings[i]));
+        });
     }
 }
 
-static void PartialSubtreeRemoveInsertTest(Metrics& metrics) {
+static void PartialSubtreeRemoveInsertTest(Hd_UnitTestPerfRunner& runner) {
     const SdfPathVector prefixes = {SdfPath("/A/A/A"), SdfPath("/B/Y/O"), SdfPath("/Y/M/M"), SdfPath("/Z/Z/Z")};
 
     const std::vector<SdfPathVector> subtreePathVecs = [&prefixes]() {
@@ -187,11 +195,9 @@ static void PartialSubtreeRemoveInsertTest(Metrics& metrics) {
 
     Hd_SortedIds ids = _GetPopulatedIds();
 
-    std::vector<int64_t> timings;
-
-    timings.reserve(subtreePathVecs.size());
-    for (SdfPathVector const& subtreePaths : subtreePathVecs) {
-        timings.push_back(ArchMeasureExecutionTime([&ids, &subtreePaths]() {
+    for (size_t i = 0; i != subtreePathVecs.size(); ++i) {
+        SdfPathVector const& subtreePaths = subtreePathVecs[i];
+        runner.Measure("add_del_partial_subtree_" + _PathToLabel(prefixes[i]), [&ids, &subtreePaths]() {
             for (SdfPath const& path : subtreePaths) {
                 ids.Remove(path);
             }
@@ -200,16 +206,11 @@ static void PartialSubtreeRemoveInsertTest(Metrics& metrics) {
                 ids.Insert(path);
             }
             ids.GetIds();  // force sort.
-        }));
-    }
-
-    for (size_t i = 0; i != timings.size(); ++i) {
-        metrics.emplace_back("add_del_partial_subtree_" + _PathToLabel(prefixes[i]),
-                             ArchTicksToNanoseconds(timings[i]));
+        });
     }
 }
 
-static void ScatteredRemoveInsertTest(Metrics& metrics, unsigned divisor, std::string const& lbl) {
+static void ScatteredRemoveInsertTest(Hd_UnitTestPerfRunner& runner, unsigned divisor, std::string const& lbl) {
     const SdfPathVector paths = [&]() {
         SdfPathVector ret;
         const SdfPathVector& initPaths = _GetInitPaths();
@@ -223,7 +224,7 @@ static void ScatteredRemoveInsertTest(Metrics& metrics, unsigned divisor, std::s
     }();
 
     Hd_SortedIds ids = _GetPopulatedIds();
-    int64_t ticks = ArchMeasureExecutionTime([&ids, &paths]() {
+    runner.Measure("add_del_" + lbl + "_scattered", [&ids, &paths]() {
         for (SdfPath const& path : paths) {
             ids.Remove(path);
         }
@@ -233,11 +234,45 @@ static void ScatteredRemoveInsertTest(Metrics& metrics, unsigned divisor, std::s
         }
         ids.GetIds();  // force sort.
     });
+}
 
-    metrics.emplace_back("add_del_" + lbl + "_scattered", ArchTicksToNanoseconds(ticks));
+static void BatchedScatteredRemoveInsertTest(Hd_UnitTestPerfRunner& runner,
+                                             unsigned divisor,
+                                             std::string const& lbl) {
+    const SdfPathVector paths = [&]() {
+        SdfPathVector ret;
+        const SdfPathVector& initPaths = _GetInitPaths();
+        // Same selection as ScatteredRemoveInsertTest, without the repeated
+        // paths, so every trial removes and inserts back the same ids.
+        std::mt19937 gen(5109223000);
+        std::uniform_int_distribution<> distrib(0, initPaths.size() - 1);
+        for (size_t i = 0; i != initPaths.size() / divisor; ++i) {
+            ret.push_back(initPaths[distrib(gen)]);
+        }
+        std::sort(ret.begin(), ret.end());
+        ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+        return ret;
+    }();
+
+    Hd_BatchedSortedIds populated;
+    populated.Populate(_GetInitPaths());
+
+    for (unsigned numThreads : Hd_UnitTestPerfRunner::GetThreadCounts()) {
+        WorkSetConcurrencyLimit(numThreads);
+        Hd_BatchedSortedIds ids = populated;
+        const std::string name = TfStringPrintf("add_del_%s_scattered_batched_%ut", lbl.c_str(), numThreads);
+        runner.Measure(name, [&ids, &paths]() {
+            ids.Remove(paths.begin(), paths.end());
+            ids.GetIds();  // force sort.
+            ids.Insert(paths.begin(), paths.end());
+            ids.GetIds();  // force sort.
+        });
+        ASSERT_TRUE(ids.GetIds() == populated.GetIds());
+    }
+    WorkSetMaximumConcurrencyLimit();
 }
 
-static void SpreadRemoveInsertTest(Metrics& metrics, size_t numElts) {
+static void SpreadRemoveInsertTest(Hd_UnitTestPerfRunner& runner, size_t numElts) {
     Hd_SortedIds ids = _GetPopulatedIds();
 
     // Determine which we'll remove/reinsert -- select evenly spread elements
@@ -248,7 +283,7 @@ static void SpreadRemoveInsertTest(Metrics& metrics, size_t numElts) {
         paths.push_back(ids.GetIds()[idx]);
     }
 
-    int64_t ticks = ArchMeasureExecutionTime([&ids, &paths]() {
+    runner.Measure(TfStringPrintf("add_del_%zu_spread", numElts), [&ids, &paths]() {
         for (SdfPath const& path : paths) {
             ids.Remove(path);
         }
@@ -258,11 +293,9 @@ static void SpreadRemoveInsertTest(Metrics& metrics, size_t numElts) {
         }
         ids.GetIds();  // force sort.
     });
-
-    metrics.emplace_back(TfStringPrintf("add_del_%zu_spread", numElts), ArchTicksToNanoseconds(ticks));
 }
 
-static void SubtreeRenameTest(Metrics& metrics, SdfPath const& oldPrefix, SdfPath const& newPrefix) {
+static void SubtreeRenameTest(Hd_UnitTestPerfRunner& runner, SdfPath const& oldPrefix, SdfPath const& newPrefix) {
     const std::vector<std::pair<SdfPath, SdfPath>> renames = [&]() {
         std::vector<std::pair<SdfPath, SdfPath>> ret;
         for (SdfPath const& path : _GetInitPaths()) {
@@ -275,7 +308,7 @@ static void SubtreeRenameTest(Metrics& metrics, SdfPath const& oldPrefix, SdfPat
 
     Hd_SortedIds ids = _GetPopulatedIds();
 
-    int64_t ticks = ArchMeasureExecutionTime([&ids, &renames]() {
+    runner.Measure("rename_" + _PathToLabel(oldPrefix) + "_to_" + _PathToLabel(newPrefix), [&ids, &renames]() {
         for (auto& names : renames) {
             ids.Remove(names.first);
             ids.Insert(names.second);
@@ -287,43 +320,195 @@ static void SubtreeRenameTest(Metrics& metrics, SdfPath const& oldPrefix, SdfPat
         }
         ids.GetIds();  // force sort.
     });
+}
 
-    metrics.emplace_back("rename_" + _PathToLabel(oldPrefix) + "_to_" + _PathToLabel(newPrefix),
-                         ArchTicksToNanoseconds(ticks));
+// Generates a skewed five level namespace of roughly \p numIds prims.
+static SdfPathVector _GetScaledPaths(size_t numIds) {
+    Hd_UnitTestPathGenerator::Options options;
+    options.fanout = {8, 16, 16, 16, std::max<size_t>(1, numIds / (8 * 16 * 16 * 16))};
+    options.zipfSkew = 0.8;
+    options.includeInteriorPrims = true;
+
+    SdfPathVector paths = Hd_UnitTestPathGenerator(options).Generate();
+
+    printf("Using %zu scaled paths\n", paths.size());
+
+    return paths;
 }
 
-TEST(TestHydra, test_sorted_ids_perf) {
-    Metrics metrics;
-
-    PopulateTest(metrics);
-    SingleRemoveInsertTest(metrics);
-    MultiRemoveInsertTest(metrics);
-    SubtreeRemoveInsertTest(metrics);
-    PartialSubtreeRemoveInsertTest(metrics);
-    ScatteredRemoveInsertTest(metrics, 10000, "0_01pct");
-    ScatteredRemoveInsertTest(metrics, 1000, "0_1pct");
-    ScatteredRemoveInsertTest(metrics, 100, "1pct");
-    ScatteredRemoveInsertTest(metrics, 20, "5pct");
-    ScatteredRemoveInsertTest(metrics, 10, "10pct");
-    ScatteredRemoveInsertTest(metrics, 5, "20pct");
-    ScatteredRemoveInsertTest(metrics, 2, "50pct");
-    SpreadRemoveInsertTest(metrics, 1);
-    SpreadRemoveInsertTest(metrics, 2);
-    SpreadRemoveInsertTest(metrics, 5);
-    SpreadRemoveInsertTest(metrics, 10);
-    SpreadRemoveInsertTest(metrics, 20);
-    SpreadRemoveInsertTest(metrics, 50);
-    SpreadRemoveInsertTest(metrics, 100);
-    SubtreeRenameTest(metrics, SdfPath("/A/B/C"), SdfPath("/A/B/_C"));
-    SubtreeRenameTest(metrics, SdfPath("/A/B"), SdfPath("/A/_B"));
-    SubtreeRenameTest(metrics, SdfPath("/Z/Z"), SdfPath("/A/B/_Z"));
-
-    FILE* statsFile = fopen("perfstats.raw", "w");
-    for (const auto& [metricName, ns] : metrics) {
-        fprintf(statsFile, "{'profile':'%s','metric':'time','value':%zd,'samples':1}\n", metricName.c_str(), ns);
-        printf("%s : %zd ns\n", metricName.c_str(), ns);
+// Compares per-path Remove/Insert on Hd_SortedIds against the subtree
+// operations of Hd_BatchedSortedIds on a namespace of \p numIds paths.
+static void ScaledSubtreeTest(Hd_UnitTestPerfRunner& runner,
+                              Hd_UnitTestPerfRunner::Options const& options,
+                              size_t numIds,
+                              std::string const& lbl) {
+    const SdfPathVector paths = _GetScaledPaths(numIds);
+
+    Hd_SortedIds sortedIds;
+    for (SdfPath const& p : paths) {
+        sortedIds.Insert(p);
     }
-    fclose(statsFile);
+    sortedIds.GetIds();  // Ensure it's sorted.
+
+    Hd_BatchedSortedIds batchedIds;
+    batchedIds.Populate(paths);
+
+    // Pick subtrees at the start and end of the namespace, a rename within
+    // a parent and a rename that moves a subtree across the namespace.
+    SdfPathVector deepPaths;
+    std::copy_if(batchedIds.GetIds().begin(), batchedIds.GetIds().end(), std::back_inserter(deepPaths),
+                 [](SdfPath const& p) { return p.GetPathElementCount() >= 3; });
+    const SdfPath first = deepPaths.front();
+    const SdfPath last = deepPaths.back();
+    const SdfPath middle = deepPaths[deepPaths.size() / 2];
+
+    const SdfPathVector prefixes = {first.GetPrefixes()[2], last.GetPrefixes()[2]};
+    for (SdfPath const& prefix : prefixes) {
+        SdfPathVector subtreePaths;
+        for (SdfPath const& path : paths) {
+            if (path.HasPrefix(prefix)) {
+                subtreePaths.push_back(path);
+            }
+        }
+
+        const std::string subtreeLbl = "add_del_subtree_" + _PathToLabel(prefix) + "_" + lbl;
+
+        runner.Measure(subtreeLbl, options, [&sortedIds, &subtreePaths]() {
+            for (SdfPath const& path : subtreePaths) {
+                sortedIds.Remove(path);
+            }
+            sortedIds.GetIds();  // force sort.
+            for (SdfPath const& path : subtreePaths) {
+                sortedIds.Insert(path);
+            }
+            sortedIds.GetIds();  // force sort.
+        });
+
+        runner.Measure(subtreeLbl + "_batched", options, [&batchedIds, &prefix, &subtreePaths]() {
+            batchedIds.RemoveSubtree(prefix);
+            batchedIds.Insert(subtreePaths.begin(), subtreePaths.end());
+            batchedIds.GetIds();  // force sort.
+        });
+    }
+
+    const SdfPath middlePrefix = middle.GetPrefixes()[2];
+    const SdfPath lastPrefix = last.GetPrefixes()[1];
+    const std::vector<std::pair<SdfPath, SdfPath>> renames = {
+            {middlePrefix, middlePrefix.ReplaceName(TfToken("_" + middlePrefix.GetName()))},
+            {lastPrefix, first.GetPrefixes()[1].AppendChild(TfToken("_" + lastPrefix.GetName()))}};
+    for (auto const& rename : renames) {
+        SdfPath const& oldPrefix = rename.first;
+        SdfPath const& newPrefix = rename.second;
+        std::vector<std::pair<SdfPath, SdfPath>> pathRenames;
+        for (SdfPath const& path : paths) {
+            if (path.HasPrefix(oldPrefix)) {
+                pathRenames.emplace_back(path, path.ReplacePrefix(oldPrefix, newPrefix));
+            }
+        }
+
+        const std::string renameLbl = "rename_" + _PathToLabel(oldPrefix) + "_to_" + _PathToLabel(newPrefix);
+
+        runner.Measure(renameLbl + "_" + lbl, options, [&sortedIds, &pathRenames]() {
+            for (auto& names : pathRenames) {
+                sortedIds.Remove(names.first);
+                sortedIds.Insert(names.second);
+            }
+            sortedIds.GetIds();  // force sort.
+            for (auto& names : pathRenames) {
+                sortedIds.Remove(names.second);
+                sortedIds.Insert(names.first);
+            }
+            sortedIds.GetIds();  // force sort.
+        });
+
+        runner.Measure(renameLbl + "_" + lbl + "_batched", options, [&batchedIds, &oldPrefix, &newPrefix]() {
+            batchedIds.RenameSubtree(oldPrefix, newPrefix);
+            batchedIds.RenameSubtree(newPrefix, oldPrefix);
+        });
+    }
+
+    // Both containers must have ended up back where they started.
+    ASSERT_TRUE(batchedIds.GetIds() == sortedIds.GetIds());
+}
+
+TEST(TestHydra, test_sorted_ids_perf) {
+    Hd_UnitTestPerfRunner runner;
+
+    PopulateTest(runner);
+    SingleRemoveInsertTest(runner);
+    MultiRemoveInsertTest(runner);
+    SubtreeRemoveInsertTest(runner);
+    PartialSubtreeRemoveInsertTest(runner);
+    ScatteredRemoveInsertTest(runner, 10000, "0_01pct");
+    ScatteredRemoveInsertTest(runner, 1000, "0_1pct");
+    ScatteredRemoveInsertTest(runner, 100, "1pct");
+    ScatteredRemoveInsertTest(runner, 20, "5pct");
+    ScatteredRemoveInsertTest(runner, 10, "10pct");
+    ScatteredRemoveInsertTest(runner, 5, "20pct");
+    ScatteredRemoveInsertTest(runner, 2, "50pct");
+    SpreadRemoveInsertTest(runner, 1);
+    SpreadRemoveInsertTest(runner, 2);
+    SpreadRemoveInsertTest(runner, 5);
+    SpreadRemoveInsertTest(runner, 10);
+    SpreadRemoveInsertTest(runner, 20);
+    SpreadRemoveInsertTest(runner, 50);
+    SpreadRemoveInsertTest(runner, 100);
+    SubtreeRenameTest(runner, SdfPath("/A/B/C"), SdfPath("/A/B/_C"));
+    SubtreeRenameTest(runner, SdfPath("/A/B"), SdfPath("/A/_B"));
+    SubtreeRenameTest(runner, SdfPath("/Z/Z"), SdfPath("/A/B/_Z"));
+    BatchedPopulateTest(runner);
+    BatchedScatteredRemoveInsertTest(runner, 100, "1pct");
+    BatchedScatteredRemoveInsertTest(runner, 10, "10pct");
+    BatchedScatteredRemoveInsertTest(runner, 2, "50pct");
+
+    // The scaled metrics are too slow to repeat as often as the rest.
+    Hd_UnitTestPerfRunner::Options scaledOptions = runner.GetOptions();
+    scaledOptions.warmup = 0;
+    scaledOptions.trials = std::min<size_t>(scaledOptions.trials, 3);
+    ScaledSubtreeTest(runner, scaledOptions, 1000000, "1M");
+
+    EXPECT_TRUE(runner.Finish("testHdSortedIdsPerf.json").empty());
 
     printf("OK\n");
 }
+
+TEST(TestHydra, test_sorted_ids_perf_large) {
+    if (!Hd_UnitTestPerfRunner::RunLargeMetrics()) {
+        GTEST_SKIP() << "Set HD_PERF_LARGE to run the 10M id metrics";
+    }
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+    ScaledSubtreeTest(runner, options, 10000000, "10M");
+
+    EXPECT_TRUE(runner.Finish("testHdSortedIdsPerfLarge.json", "perfstats_sorted_ids_large.raw").empty());
+}
+
+TEST(TestHydra, test_path_generator) {
+    // The default options give as many paths as the hardcoded initial
+    // namespace above, with the same 4x26x26x26 fan-out.
+    Hd_UnitTestPathGenerator::Options options;
+    SdfPathVector paths = Hd_UnitTestPathGenerator(options).Generate();
+    ASSERT_EQ(paths.size(), _GetInitPaths().size());
+
+    // Same options and seed give the same paths.
+    ASSERT_TRUE(paths == Hd_UnitTestPathGenerator(options).Generate());
+
+    // Paths are unique and all at the leaf level.
+    std::sort(paths.begin(), paths.end());
+    ASSERT_TRUE(std::adjacent_find(paths.begin(), paths.end()) == paths.end());
+    for (SdfPath const& p : paths) {
+        ASSERT_EQ(p.GetPathElementCount(), options.fanout.size());
+    }
+
+    // Skew reshapes the hierarchy but keeps roughly the same size.
+    options.zipfSkew = 1.0;
+    options.includeInteriorPrims = true;
+    options.nameLength = 6;
+    const SdfPathVector skewed = Hd_UnitTestPathGenerator(options).Generate();
+    ASSERT_GT(skewed.size(), paths.size() / 2);
+    ASSERT_LT(skewed.size(), paths.size() * 2);
+    ASSERT_EQ(skewed.front().GetName().size(), 6u);
+}
@@ -0,0 +1,351 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_TRIE_DATA_SOURCE_LOCATOR_SET_H
+#define PXR_IMAGING_HD_TRIE_DATA_SOURCE_LOCATOR_SET_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/dataSourceLocator.h"
+#include "pxr/base/tf/token.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_TrieLocatorSet
+///
+/// Prefix-trie alternative to HdDataSourceLocatorSet for large dirty
+/// batches, e.g. per-primvar dirties on crowds.
+///
+/// HdDataSourceLocatorSet keeps a sorted vector, so every insert that does
+/// not land at the end shifts the locators after it, and ReplacePrefix
+/// rebuilds and re-sorts the whole set.  Here each element of a locator is
+/// a node in a trie and members are marked nodes, which gives the same
+/// normalized contents (no member is a prefix of another) with costs that
+/// only depend on the length of the locator:
+///
+/// - insert walks the locator, stopping early if an ancestor is already a
+///   member, and drops the subtree below the new member.
+/// - Intersects and Contains walk the queried locator.
+/// - ReplacePrefixInPlace detaches the subtree at the old prefix and grafts
+///   it at the new one, only merging where the two overlap.
+///
+/// Nodes live in a single arena addressed by index, and children are kept
+/// sorted by token pointer.  Nodes dropped by subsumption are recycled.
+///
+class Hd_TrieLocatorSet {
+public:
+    Hd_TrieLocatorSet() : _nodes(1) {}
+
+    Hd_TrieLocatorSet(std::initializer_list<HdDataSourceLocator> locators) : _nodes(1) {
+        for (HdDataSourceLocator const& locator : locators) {
+            insert(locator);
+        }
+    }
+
+    explicit Hd_TrieLocatorSet(HdDataSourceLocatorSet const& locators) : _nodes(1) { insert(locators); }
+
+    /// Adds \p locator, unless a prefix of it is already a member.  Members
+    /// that have \p locator as a prefix are removed.
+    void insert(HdDataSourceLocator const& locator) {
+        _Index n = _root;
+        for (size_t i = 0; i != locator.GetElementCount(); ++i) {
+            if (_nodes[n].isMember) {
+                return;
+            }
+            n = _FindOrAddChild(n, locator.GetElement(i));
+        }
+        _MakeMember(n);
+    }
+
+    void insert(HdDataSourceLocatorSet const& locators) {
+        for (HdDataSourceLocator const& locator : locators) {
+            insert(locator);
+        }
+    }
+
+    bool IsEmpty() const { return _size == 0; }
+
+    /// Returns the number of members.
+    size_t GetSize() const { return _size; }
+
+    void Clear() {
+        _nodes.assign(1, _Node());
+        _free.clear();
+        _size = 0;
+    }
+
+    /// Returns true if \p locator is a prefix of a member or a member is a
+    /// prefix of \p locator.
+    bool Intersects(HdDataSourceLocator const& locator) const {
+        if (IsEmpty()) {
+            return false;
+        }
+        _Index n = _root;
+        for (size_t i = 0; i != locator.GetElementCount(); ++i) {
+            if (_nodes[n].isMember) {
+                return true;
+            }
+            n = _FindChild(n, locator.GetElement(i));
+            if (n == _invalid) {
+                return false;
+            }
+        }
+        // Every node that is not a member has a member below it.
+        return true;
+    }
+
+    bool Intersects(Hd_TrieLocatorSet const& other) const {
+        return !IsEmpty() && !other.IsEmpty() && _Intersects(_root, other, _root);
+    }
+
+    /// Returns true if a member is a prefix of \p locator.
+    bool Contains(HdDataSourceLocator const& locator) const {
+        _Index n = _root;
+        for (size_t i = 0; i != locator.GetElementCount(); ++i) {
+            if (_nodes[n].isMember) {
+                return true;
+            }
+            n = _FindChild(n, locator.GetElement(i));
+            if (n == _invalid) {
+                return false;
+            }
+        }
+        return _nodes[n].isMember;
+    }
+
+    /// Returns a copy of this set in which \p oldPrefix is replaced by
+    /// \p newPrefix in every member that has it, as with
+    /// HdDataSourceLocatorSet::ReplacePrefix.
+    Hd_TrieLocatorSet ReplacePrefix(HdDataSourceLocator const& oldPrefix,
+                                    HdDataSourceLocator const& newPrefix) const {
+        Hd_TrieLocatorSet result(*this);
+        result.ReplacePrefixInPlace(oldPrefix, newPrefix);
+        return result;
+    }
+
+    /// Replaces \p oldPrefix by \p newPrefix in every member that has it.
+    void ReplacePrefixInPlace(HdDataSourceLocator const& oldPrefix, HdDataSourceLocator const& newPrefix) {
+        if (oldPrefix == newPrefix || IsEmpty()) {
+            return;
+        }
+
+        // Find the subtree at oldPrefix, remembering the way down so that
+        // ancestors left without members can be pruned.
+        std::vector<_Index> path = {_root};
+        for (size_t i = 0; i != oldPrefix.GetElementCount(); ++i) {
+            // A member above oldPrefix does not have it as a prefix.
+            if (_nodes[path.back()].isMember) {
+                return;
+            }
+            const _Index child = _FindChild(path.back(), oldPrefix.GetElement(i));
+            if (child == _invalid) {
+                return;
+            }
+            path.push_back(child);
+        }
+
+        _Index subtree;
+        if (path.size() == 1) {
+            subtree = _NewNode(TfToken());
+            std::swap(_nodes[subtree].children, _nodes[_root].children);
+            std::swap(_nodes[subtree].isMember, _nodes[_root].isMember);
+        } else {
+            subtree = path.back();
+            path.pop_back();
+            _RemoveChild(path.back(), subtree);
+            while (path.size() > 1 && !_nodes[path.back()].isMember && _nodes[path.back()].children.empty()) {
+                const _Index empty = path.back();
+                path.pop_back();
+                _RemoveChild(path.back(), empty);
+                _free.push_back(empty);
+            }
+        }
+
+        // Graft it at newPrefix.
+        _Index n = _root;
+        for (size_t i = 0; i + 1 < newPrefix.GetElementCount(); ++i) {
+            if (_nodes[n].isMember) {
+                _Release(subtree);
+                return;
+            }
+            n = _FindOrAddChild(n, newPrefix.GetElement(i));
+        }
+        if (newPrefix.IsEmpty()) {
+            _Merge(_root, subtree);
+            return;
+        }
+        if (_nodes[n].isMember) {
+            _Release(subtree);
+            return;
+        }
+        TfToken const& last = newPrefix.GetLastElement();
+        const _Index existing = _FindChild(n, last);
+        if (existing == _invalid) {
+            _nodes[subtree].element = last;
+            _InsertChild(n, subtree);
+        } else {
+            _Merge(existing, subtree);
+        }
+    }
+
+    /// Returns the members as an HdDataSourceLocatorSet.
+    HdDataSourceLocatorSet GetLocators() const {
+        std::vector<HdDataSourceLocator> locators;
+        locators.reserve(_size);
+        TfTokenVector elements;
+        _CollectMembers(_root, &elements, &locators);
+        return HdDataSourceLocatorSet(locators.begin(), locators.end());
+    }
+
+private:
+    using _Index = uint32_t;
+    static constexpr _Index _root = 0;
+    static constexpr _Index _invalid = ~_Index(0);
+
+    struct _Node {
+        TfToken element;
+        // Sorted by element pointer.
+        std::vector<_Index> children;
+        bool isMember = false;
+    };
+
+    _Index _NewNode(TfToken const& element) {
+        if (!_free.empty()) {
+            const _Index n = _free.back();
+            _free.pop_back();
+            _nodes[n].element = element;
+            return n;
+        }
+        _nodes.emplace_back();
+        _nodes.back().element = element;
+        return static_cast<_Index>(_nodes.size() - 1);
+    }
+
+    std::vector<_Index>::const_iterator _LowerBound(_Index parent, TfToken const& element) const {
+        std::vector<_Index> const& children = _nodes[parent].children;
+        return std::lower_bound(children.begin(), children.end(), element, [this](_Index child, TfToken const& e) {
+            return TfTokenFastArbitraryLessThan()(_nodes[child].element, e);
+        });
+    }
+
+    _Index _FindChild(_Index parent, TfToken const& element) const {
+        const auto it = _LowerBound(parent, element);
+        return it != _nodes[parent].children.end() && _nodes[*it].element == element ? *it : _invalid;
+    }
+
+    // Returns the child of parent named element, adding it if needed.
+    _Index _FindOrAddChild(_Index parent, TfToken const& element) {
+        const _Index existing = _FindChild(parent, element);
+        if (existing != _invalid) {
+            return existing;
+        }
+        const _Index child = _NewNode(element);
+        _InsertChild(parent, child);
+        return child;
+    }
+
+    void _InsertChild(_Index parent, _Index child) {
+        const size_t pos = _LowerBound(parent, _nodes[child].element) - _nodes[parent].children.begin();
+        _nodes[parent].children.insert(_nodes[parent].children.begin() + pos, child);
+    }
+
+    void _RemoveChild(_Index parent, _Index child) {
+        std::vector<_Index>& children = _nodes[parent].children;
+        children.erase(std::find(children.begin(), children.end(), child));
+    }
+
+    // Makes n a member, dropping everything below it.
+    void _MakeMember(_Index n) {
+        if (_nodes[n].isMember) {
+            return;
+        }
+        _ReleaseChildren(n);
+        _nodes[n].isMember = true;
+        ++_size;
+    }
+
+    void _ReleaseChildren(_Index n) {
+        std::vector<_Index> children;
+        children.swap(_nodes[n].children);
+        for (_Index child : children) {
+            _Release(child);
+        }
+    }
+
+    // Frees the subtree at n, which must already be detached.
+    void _Release(_Index n) {
+        _ReleaseChildren(n);
+        if (_nodes[n].isMember) {
+            --_size;
+            _nodes[n].isMember = false;
+        }
+        _free.push_back(n);
+    }
+
+    // Merges the detached subtree src into dst and frees src.
+    void _Merge(_Index dst, _Index src) {
+        if (_nodes[dst].isMember) {
+            _Release(src);
+            return;
+        }
+        if (_nodes[src].isMember) {
+            // src's member moves to dst, so it is still counted once.
+            _ReleaseChildren(dst);
+            _nodes[dst].isMember = true;
+            _nodes[src].isMember = false;
+            _Release(src);
+            return;
+        }
+        std::vector<_Index> children;
+        children.swap(_nodes[src].children);
+        for (_Index child : children) {
+            const _Index existing = _FindChild(dst, _nodes[child].element);
+            if (existing == _invalid) {
+                _InsertChild(dst, child);
+            } else {
+                _Merge(existing, child);
+            }
+        }
+        _free.push_back(src);
+    }
+
+    bool _Intersects(_Index n, Hd_TrieLocatorSet const& other, _Index otherN) const {
+        if (_nodes[n].isMember || other._nodes[otherN].isMember) {
+            return true;
+        }
+        for (_Index child : _nodes[n].children) {
+            const _Index otherChild = other._FindChild(otherN, _nodes[child].element);
+            if (otherChild != _invalid && _Intersects(child, other, otherChild)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void _CollectMembers(_Index n, TfTokenVector* elements, std::vector<HdDataSourceLocator>* locators) const {
+        if (_nodes[n].isMember) {
+            locators->emplace_back(elements->size(), elements->data());
+            return;
+        }
+        for (_Index child : _nodes[n].children) {
+            elements->push_back(_nodes[child].element);
+            _CollectMembers(child, elements, locators);
+            elements->pop_back();
+        }
+    }
+
+    std::vector<_Node> _nodes;
+    std::vector<_Index> _free;
+    size_t _size = 0;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_TRIE_DATA_SOURCE_LOCATOR_SET_H
@@ -0,0 +1,146 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_UNIT_TEST_PATH_GENERATOR_H
+#define PXR_IMAGING_HD_UNIT_TEST_PATH_GENERATOR_H
+
+#include "pxr/pxr.h"
+#include "pxr/usd/sdf/path.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/tf/token.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_UnitTestPathGenerator
+///
+/// Generates synthetic prim namespaces for the Hydra perf tests.
+///
+/// The hierarchy is built level by level.  Each level has a budget of
+/// (number of parents * fan-out) children, which is distributed over the
+/// parents according to a Zipf law over a seeded random ranking of the
+/// parents.  A skew of zero gives every parent exactly the level's fan-out;
+/// larger skews give a few parents most of the children and leave others
+/// with few or none, like the uneven branches of production stages, while
+/// keeping the number of prims per level roughly the same.  Skew does not
+/// change the depth: every leaf is fanout.size() levels deep.
+///
+/// Names are a per-level letter followed by a zero-padded index, e.g.
+/// "B0042", so the same parameters and seed always give the same paths.
+///
+class Hd_UnitTestPathGenerator {
+public:
+    struct Options {
+        /// Average number of children per prim at each level; the number of
+        /// entries is the depth of the hierarchy.
+        std::vector<size_t> fanout = {4, 26, 26, 26};
+        /// Zipf exponent used to distribute children over parents.
+        double zipfSkew = 0.0;
+        /// Width the names are zero-padded to, including the level letter.
+        /// Names always have at least one digit, so widths below 2 give 2.
+        size_t nameLength = 1;
+        size_t seed = 5109223000;
+        /// Return interior prims as well as the leaves.
+        bool includeInteriorPrims = false;
+        /// Shuffle the result instead of returning it in traversal order.
+        bool shuffle = true;
+    };
+
+    /// Returns options for a uniform hierarchy of \p depth levels with
+    /// roughly \p numLeaves leaves.
+    static Options UniformOptions(size_t numLeaves, size_t depth) {
+        Options options;
+        const size_t fanout =
+                std::max<size_t>(1, std::llround(std::pow(static_cast<double>(numLeaves), 1.0 / depth)));
+        options.fanout.assign(depth, fanout);
+        return options;
+    }
+
+    explicit Hd_UnitTestPathGenerator(Options const& options) : _options(options) {}
+
+    Options const& GetOptions() const { return _options; }
+
+    SdfPathVector Generate() const {
+        std::mt19937 randomGen(_options.seed);
+
+        SdfPathVector result;
+        SdfPathVector parents = {SdfPath::AbsoluteRootPath()};
+        for (size_t level = 0; level != _options.fanout.size(); ++level) {
+            const std::vector<size_t> counts = _DistributeChildren(parents.size(), level, randomGen);
+            const std::vector<TfToken> names =
+                    _MakeNames(level, counts.empty() ? 0 : *std::max_element(counts.begin(), counts.end()));
+
+            SdfPathVector children;
+            children.reserve(std::accumulate(counts.begin(), counts.end(), size_t(0)));
+            for (size_t i = 0; i != parents.size(); ++i) {
+                for (size_t c = 0; c != counts[i]; ++c) {
+                    children.push_back(parents[i].AppendChild(names[c]));
+                }
+            }
+
+            const bool isLeafLevel = level + 1 == _options.fanout.size();
+            if (_options.includeInteriorPrims || isLeafLevel) {
+                result.insert(result.end(), children.begin(), children.end());
+            }
+            parents.swap(children);
+        }
+
+        if (_options.shuffle) {
+            std::shuffle(result.begin(), result.end(), randomGen);
+        }
+        return result;
+    }
+
+private:
+    // Splits numParents * fanout children over the parents with Zipf weights.
+    std::vector<size_t> _DistributeChildren(size_t numParents, size_t level, std::mt19937& randomGen) const {
+        const size_t fanout = _options.fanout[level];
+        std::vector<size_t> counts(numParents, fanout);
+        if (_options.zipfSkew <= 0.0 || numParents < 2) {
+            return counts;
+        }
+
+        std::vector<size_t> rank(numParents);
+        std::iota(rank.begin(), rank.end(), 0);
+        std::shuffle(rank.begin(), rank.end(), randomGen);
+
+        std::vector<double> weights(numParents);
+        double totalWeight = 0.0;
+        for (size_t i = 0; i != numParents; ++i) {
+            weights[i] = std::pow(static_cast<double>(rank[i] + 1), -_options.zipfSkew);
+            totalWeight += weights[i];
+        }
+
+        const double budget = static_cast<double>(numParents * fanout);
+        for (size_t i = 0; i != numParents; ++i) {
+            counts[i] = std::llround(budget * weights[i] / totalWeight);
+        }
+        return counts;
+    }
+
+    std::vector<TfToken> _MakeNames(size_t level, size_t count) const {
+        const char letter = static_cast<char>('A' + level % 26);
+        const int width = static_cast<int>(std::max<size_t>(_options.nameLength, 2) - 1);
+
+        std::vector<TfToken> names;
+        names.reserve(count);
+        for (size_t i = 0; i != count; ++i) {
+            names.emplace_back(TfStringPrintf("%c%0*zu", letter, width, i));
+        }
+        return names;
+    }
+
+    Options _options;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_UNIT_TEST_PATH_GENERATOR_H
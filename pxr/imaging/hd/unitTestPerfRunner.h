@@ -0,0 +1,430 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HD_UNIT_TEST_PERF_RUNNER_H
+#define PXR_IMAGING_HD_UNIT_TEST_PERF_RUNNER_H
+
+#include "pxr/pxr.h"
+#include "pxr/base/arch/defines.h"
+#include "pxr/base/arch/timing.h"
+#include "pxr/base/js/json.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/tf/getenv.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/threadLimits.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(ARCH_OS_LINUX)
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hd_UnitTestPerfRunner
+///
+/// Benchmark runner for the Hydra perf tests.
+///
+/// Each measurement runs a number of untimed warmup iterations followed by
+/// repeated timed trials.  Samples further than a configurable number of
+/// scaled median absolute deviations from the median are rejected as
+/// outliers, and min/median/mean/p95/stddev are computed from the rest.
+///
+/// Results can be written to perfstats.raw, to a JSON file, and compared
+/// against a JSON baseline written by a previous run.  The following
+/// environment variables override the defaults:
+///
+/// - HD_PERF_TRIALS: number of timed trials per metric.
+/// - HD_PERF_WARMUP: number of warmup iterations per metric.
+/// - HD_PERF_PIN_CPU: cpu index to pin the calling thread to, or -1.
+/// - HD_PERF_BASELINE: JSON baseline to compare against.
+/// - HD_PERF_REGRESSION_THRESHOLD: allowed relative slowdown of the median,
+///   e.g. 0.1 for 10%.
+/// - HD_PERF_LARGE: also run the metrics too slow for the default test run.
+///
+class Hd_UnitTestPerfRunner {
+public:
+    struct Options {
+        size_t warmup = std::max(TfGetenvInt("HD_PERF_WARMUP", 1), 0);
+        size_t trials = std::max(TfGetenvInt("HD_PERF_TRIALS", 9), 0);
+        /// Samples further than this many scaled MADs from the median are
+        /// rejected.  Zero disables outlier rejection.
+        double outlierThreshold = 3.5;
+        /// Cpu to pin the calling thread to while measuring, or -1.  Worker
+        /// threads spawned by the measured code are not affected.
+        int pinCpu = TfGetenvInt("HD_PERF_PIN_CPU", -1);
+    };
+
+    struct Result {
+        std::string name;
+        size_t samples = 0;
+        size_t rejected = 0;
+        double minNs = 0;
+        double medianNs = 0;
+        double meanNs = 0;
+        double p95Ns = 0;
+        double stddevNs = 0;
+    };
+
+    Hd_UnitTestPerfRunner() = default;
+
+    explicit Hd_UnitTestPerfRunner(Options const& options) : _options(options) {}
+
+    Options const& GetOptions() const { return _options; }
+
+    /// Measures \p fn with the runner's options.  \p fn must leave any
+    /// state it touches as it found it, since it is run repeatedly.
+    template <class Fn>
+    Result const& Measure(std::string const& name, Fn&& fn) {
+        return Measure(name, _options, std::forward<Fn>(fn));
+    }
+
+    /// Measures \p fn with \p options, e.g. to use fewer trials for a
+    /// particularly expensive metric.
+    template <class Fn>
+    Result const& Measure(std::string const& name, Options const& options, Fn&& fn) {
+        _ScopedCpuPin pin(options.pinCpu);
+
+        for (size_t i = 0; i != options.warmup; ++i) {
+            fn();
+        }
+
+        std::vector<double> samples;
+        samples.reserve(std::max<size_t>(options.trials, 1));
+        for (size_t i = 0; i != std::max<size_t>(options.trials, 1); ++i) {
+            ArchIntervalTimer timer;
+            fn();
+            samples.push_back(ArchTicksToNanoseconds(timer.GetElapsedTicks()));
+        }
+
+        return _AddResult(name, std::move(samples), options.outlierThreshold);
+    }
+
+    /// Measures \p fn with the runner's options, calling \p setup untimed
+    /// before every run, e.g. to restore the state \p fn changes or to let
+    /// background work finish.
+    template <class Setup, class Fn>
+    Result const& MeasureWithSetup(std::string const& name, Setup&& setup, Fn&& fn) {
+        _ScopedCpuPin pin(_options.pinCpu);
+
+        for (size_t i = 0; i != _options.warmup; ++i) {
+            setup();
+            fn();
+        }
+
+        std::vector<double> samples;
+        samples.reserve(std::max<size_t>(_options.trials, 1));
+        for (size_t i = 0; i != std::max<size_t>(_options.trials, 1); ++i) {
+            setup();
+            ArchIntervalTimer timer;
+            fn();
+            samples.push_back(ArchTicksToNanoseconds(timer.GetElapsedTicks()));
+        }
+
+        return _AddResult(name, std::move(samples), _options.outlierThreshold);
+    }
+
+    std::vector<Result> const& GetResults() const { return _results; }
+
+    /// Returns the thread counts to run scaling benchmarks at: powers of two
+    /// below the physical concurrency, then the physical concurrency, capped
+    /// at \p maxThreads.
+    static std::vector<unsigned> GetThreadCounts(unsigned maxThreads = ~0u) {
+        const unsigned limit = std::min(maxThreads, WorkGetPhysicalConcurrencyLimit());
+        std::vector<unsigned> counts;
+        for (unsigned n = 1; n < limit; n *= 2) {
+            counts.push_back(n);
+        }
+        counts.push_back(limit);
+        return counts;
+    }
+
+    /// Returns whether to run the metrics too slow for the default test run.
+    static bool RunLargeMetrics() { return TfGetenvBool("HD_PERF_LARGE", false); }
+
+    /// Returns the resident set size of the process in bytes, or 0 where it
+    /// is not available.
+    static size_t GetResidentBytes() {
+#if defined(ARCH_OS_LINUX)
+        FILE* statm = fopen("/proc/self/statm", "r");
+        if (!statm) {
+            return 0;
+        }
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        const int numRead = fscanf(statm, "%lu %lu", &size, &resident);
+        fclose(statm);
+        return numRead == 2 ? resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+#else
+        return 0;
+#endif
+    }
+
+    /// Returns the bytes allocated from malloc and not freed yet, in all
+    /// arenas and threads, or 0 where it is not available.
+    static size_t GetHeapBytesInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+        const struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+#else
+        return 0;
+#endif
+    }
+
+    /// Returns freed heap memory to the system where supported, so that the
+    /// resident set size of a measurement does not include what the previous
+    /// one freed.
+    static void ReleaseFreedMemory() {
+#if defined(__GLIBC__)
+        malloc_trim(0);
+#endif
+    }
+
+    /// Writes the median of each metric in perfstats.raw format.
+    void WritePerfStats(std::string const& filename) const {
+        FILE* statsFile = fopen(filename.c_str(), "w");
+        if (!statsFile) {
+            TF_RUNTIME_ERROR("Could not open '%s' for writing", filename.c_str());
+            return;
+        }
+        for (Result const& r : _results) {
+            fprintf(statsFile, "{'profile':'%s','metric':'time','value':%.0f,'samples':%zu}\n", r.name.c_str(),
+                    r.medianNs, r.samples);
+        }
+        fclose(statsFile);
+    }
+
+    /// Writes all statistics as a JSON object keyed by metric name.
+    void WriteJson(std::string const& filename) const {
+        JsObject metrics;
+        for (Result const& r : _results) {
+            metrics[r.name] = JsValue(JsObject{
+                    {"samples", JsValue(static_cast<int64_t>(r.samples))},
+                    {"rejected", JsValue(static_cast<int64_t>(r.rejected))},
+                    {"min_ns", JsValue(r.minNs)},
+                    {"median_ns", JsValue(r.medianNs)},
+                    {"mean_ns", JsValue(r.meanNs)},
+                    {"p95_ns", JsValue(r.p95Ns)},
+                    {"stddev_ns", JsValue(r.stddevNs)},
+            });
+        }
+        std::ofstream out(filename);
+        JsWriteToStream(JsValue(JsObject{{"metrics", JsValue(metrics)}}), out);
+    }
+
+    /// Compares medians against the JSON \p baselineFile and returns a
+    /// description of every metric that got slower by more than its
+    /// threshold.  \p thresholds overrides \p defaultThreshold per metric.
+    /// Metrics missing from either side are ignored.
+    std::vector<std::string> CompareToBaseline(std::string const& baselineFile,
+                                               double defaultThreshold,
+                                               std::map<std::string, double> const& thresholds = {}) const {
+        std::vector<std::string> regressions;
+
+        std::ifstream in(baselineFile);
+        JsParseError error;
+        const JsValue baseline = JsParseStream(in, &error);
+        if (!baseline.IsObject()) {
+            regressions.push_back(TfStringPrintf("Could not parse baseline '%s' (line %u): %s", baselineFile.c_str(),
+                                                 error.line, error.reason.c_str()));
+            return regressions;
+        }
+        const JsObject& root = baseline.GetJsObject();
+        const auto metricsIt = root.find("metrics");
+        if (metricsIt == root.end() || !metricsIt->second.IsObject()) {
+            return regressions;
+        }
+        const JsObject& metrics = metricsIt->second.GetJsObject();
+
+        for (Result const& r : _results) {
+            const auto it = metrics.find(r.name);
+            if (it == metrics.end() || !it->second.IsObject()) {
+                continue;
+            }
+            const JsObject& entry = it->second.GetJsObject();
+            const auto medianIt = entry.find("median_ns");
+            if (medianIt == entry.end()) {
+                continue;
+            }
+            const double baselineNs = _GetNumber(medianIt->second);
+            if (baselineNs <= 0) {
+                continue;
+            }
+
+            const auto thresholdIt = thresholds.find(r.name);
+            const double threshold = thresholdIt == thresholds.end() ? defaultThreshold : thresholdIt->second;
+            const double ratio = r.medianNs / baselineNs;
+            if (ratio > 1.0 + threshold) {
+                regressions.push_back(TfStringPrintf("%s: %.0f ns vs baseline %.0f ns (+%.1f%%, threshold %.1f%%)",
+                                                     r.name.c_str(), r.medianNs, baselineNs, (ratio - 1.0) * 100.0,
+                                                     threshold * 100.0));
+            }
+        }
+        return regressions;
+    }
+
+    /// Writes \p perfStatsFile and \p jsonFile, then compares against the
+    /// baseline named by HD_PERF_BASELINE, if set.  Returns the regressions.
+    std::vector<std::string> Finish(std::string const& jsonFile,
+                                    std::string const& perfStatsFile = "perfstats.raw") const {
+        WritePerfStats(perfStatsFile);
+        WriteJson(jsonFile);
+
+        const std::string baselineFile = TfGetenv("HD_PERF_BASELINE");
+        if (baselineFile.empty()) {
+            return {};
+        }
+        const double threshold = _GetRegressionThreshold();
+        std::vector<std::string> regressions = CompareToBaseline(baselineFile, threshold);
+        for (std::string const& regression : regressions) {
+            printf("REGRESSION %s\n", regression.c_str());
+        }
+        return regressions;
+    }
+
+private:
+    // Parses HD_PERF_REGRESSION_THRESHOLD, falling back to 10% with a
+    // warning if it is not a non-negative number.
+    static double _GetRegressionThreshold() {
+        constexpr double defaultThreshold = 0.1;
+        const std::string value = TfGetenv("HD_PERF_REGRESSION_THRESHOLD");
+        if (value.empty()) {
+            return defaultThreshold;
+        }
+        char* end = nullptr;
+        const double threshold = std::strtod(value.c_str(), &end);
+        if (end == value.c_str() || *end != '\0' || !std::isfinite(threshold) || threshold < 0) {
+            TF_WARN("Ignoring invalid HD_PERF_REGRESSION_THRESHOLD '%s', using %g", value.c_str(), defaultThreshold);
+            return defaultThreshold;
+        }
+        return threshold;
+    }
+
+    Result const& _AddResult(std::string const& name, std::vector<double> samples, double outlierThreshold) {
+        _results.push_back(_ComputeResult(name, std::move(samples), outlierThreshold));
+        Result const& r = _results.back();
+        printf("%s : %.0f ns (p95 %.0f, stddev %.0f, %zu samples, %zu rejected)\n", r.name.c_str(), r.medianNs,
+               r.p95Ns, r.stddevNs, r.samples, r.rejected);
+        return r;
+    }
+
+    // Pins the calling thread to a single cpu for its lifetime and restores
+    // the previous affinity afterwards.  A no-op off Linux or when cpu < 0.
+    class _ScopedCpuPin {
+    public:
+        explicit _ScopedCpuPin(int cpu) {
+#if defined(ARCH_OS_LINUX)
+            if (cpu < 0 || sched_getaffinity(0, sizeof(_saved), &_saved) != 0) {
+                return;
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            _pinned = sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+        }
+
+        ~_ScopedCpuPin() {
+#if defined(ARCH_OS_LINUX)
+            if (_pinned) {
+                sched_setaffinity(0, sizeof(_saved), &_saved);
+            }
+#endif
+        }
+
+        _ScopedCpuPin(_ScopedCpuPin const&) = delete;
+        _ScopedCpuPin& operator=(_ScopedCpuPin const&) = delete;
+
+    private:
+#if defined(ARCH_OS_LINUX)
+        cpu_set_t _saved;
+#endif
+        bool _pinned = false;
+    };
+
+    static double _GetNumber(JsValue const& value) {
+        if (value.IsReal()) {
+            return value.GetReal();
+        }
+        if (value.IsInt()) {
+            return static_cast<double>(value.GetInt64());
+        }
+        return 0;
+    }
+
+    static double _Median(std::vector<double> const& sorted) {
+        const size_t n = sorted.size();
+        return n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+    }
+
+    static Result _ComputeResult(std::string const& name, std::vector<double> samples, double outlierThreshold) {
+        Result r;
+        r.name = name;
+
+        std::sort(samples.begin(), samples.end());
+        const size_t numTaken = samples.size();
+
+        // Reject outliers using the median absolute deviation, scaled to
+        // be comparable to a standard deviation for normal data.
+        if (outlierThreshold > 0 && samples.size() > 2) {
+            const double median = _Median(samples);
+            std::vector<double> deviations;
+            deviations.reserve(samples.size());
+            for (double s : samples) {
+                deviations.push_back(std::abs(s - median));
+            }
+            std::sort(deviations.begin(), deviations.end());
+            const double mad = 1.4826 * _Median(deviations);
+            if (mad > 0) {
+                samples.erase(std::remove_if(samples.begin(), samples.end(),
+                                             [&](double s) { return std::abs(s - median) > outlierThreshold * mad; }),
+                              samples.end());
+            }
+        }
+
+        r.samples = samples.size();
+        r.rejected = numTaken - samples.size();
+        r.minNs = samples.front();
+        r.medianNs = _Median(samples);
+        // Nearest-rank percentile.
+        r.p95Ns = samples[std::min(samples.size() - 1,
+                                   static_cast<size_t>(std::ceil(0.95 * samples.size())) - 1)];
+
+        double sum = 0;
+        for (double s : samples) {
+            sum += s;
+        }
+        r.meanNs = sum / samples.size();
+
+        double sqSum = 0;
+        for (double s : samples) {
+            sqSum += (s - r.meanNs) * (s - r.meanNs);
+        }
+        r.stddevNs = samples.size() > 1 ? std::sqrt(sqSum / (samples.size() - 1)) : 0;
+
+        return r;
+    }
+
+    Options _options;
+    std::vector<Result> _results;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HD_UNIT_TEST_PERF_RUNNER_H
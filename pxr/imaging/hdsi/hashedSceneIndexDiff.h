@@ -0,0 +1,588 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HDSI_HASHED_SCENE_INDEX_DIFF_H
+#define PXR_IMAGING_HDSI_HASHED_SCENE_INDEX_DIFF_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/dataSource.h"
+#include "pxr/imaging/hd/dataSourceLocator.h"
+#include "pxr/imaging/hd/sceneIndex.h"
+#include "pxr/imaging/hd/sceneIndexObserver.h"
+#include "pxr/base/tf/hash.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// \class Hdsi_SceneIndexHashTree
+///
+/// Merkle tree of content hashes over the prims of a scene index.
+///
+/// Each prim has a hash of its type and of the values of its data source,
+/// and a subtree hash combining it with the names and subtree hashes of
+/// its children.  Subtree hashes do not depend on the path of the prim, so
+/// a subtree that moved keeps its hash.  The tree is built in parallel,
+/// one namespace level at a time, and is immutable afterwards.
+///
+/// Sampled data sources are hashed by their contributing sample times in
+/// [-1, 1] and their values at those times, or by their value at shutter
+/// offset zero if they do not vary; the values must be hashable.  Data
+/// sources that are neither containers, vectors nor sampled have no value
+/// to compare, so they are hashed and compared by identity; a rebuilt one
+/// looks changed.
+///
+class Hdsi_SceneIndexHashTree {
+public:
+    struct Node {
+        SdfPath path;
+        TfToken primType;
+        size_t primHash = 0;
+        size_t subtreeHash = 0;
+        // Children are nodes [firstChild, firstChild + numChildren), sorted
+        // by name token.
+        uint32_t firstChild = 0;
+        uint32_t numChildren = 0;
+    };
+
+    explicit Hdsi_SceneIndexHashTree(HdSceneIndexBase const& sceneIndex) : _nodes(1) {
+        _nodes[0].path = SdfPath::AbsoluteRootPath();
+
+        // Top down: read prims and children of one level in parallel, then
+        // append the next level in order.
+        std::vector<std::pair<size_t, size_t>> levels;
+        for (size_t begin = 0, end = 1; begin != end; begin = end, end = _nodes.size()) {
+            levels.emplace_back(begin, end);
+            std::vector<SdfPathVector> children(end - begin);
+            WorkParallelForN(end - begin, [&](size_t b, size_t e) {
+                for (size_t i = b; i != e; ++i) {
+                    Node& node = _nodes[begin + i];
+                    const HdSceneIndexPrim prim = sceneIndex.GetPrim(node.path);
+                    node.primType = prim.primType;
+                    node.primHash = TfHash::Combine(prim.primType, HashDataSource(prim.dataSource));
+                    children[i] = sceneIndex.GetChildPrimPaths(node.path);
+                    std::sort(children[i].begin(), children[i].end(), [](SdfPath const& a, SdfPath const& c) {
+                        return TfTokenFastArbitraryLessThan()(a.GetNameToken(), c.GetNameToken());
+                    });
+                }
+            });
+            for (size_t i = 0; i != children.size(); ++i) {
+                _nodes[begin + i].firstChild = static_cast<uint32_t>(_nodes.size());
+                _nodes[begin + i].numChildren = static_cast<uint32_t>(children[i].size());
+                for (SdfPath& child : children[i]) {
+                    _nodes.emplace_back();
+                    _nodes.back().path = std::move(child);
+                }
+            }
+        }
+
+        // Bottom up: children are hashed before their parents.
+        for (auto level = levels.rbegin(); level != levels.rend(); ++level) {
+            WorkParallelForN(level->second - level->first, [&](size_t b, size_t e) {
+                for (size_t i = level->first + b; i != level->first + e; ++i) {
+                    Node& node = _nodes[i];
+                    size_t hash = node.primHash;
+                    for (uint32_t c = node.firstChild; c != node.firstChild + node.numChildren; ++c) {
+                        hash = TfHash::Combine(hash, _nodes[c].path.GetNameToken(), _nodes[c].subtreeHash);
+                    }
+                    node.subtreeHash = hash;
+                }
+            });
+        }
+    }
+
+    /// Returns the nodes; the first one is the absolute root.
+    std::vector<Node> const& GetNodes() const { return _nodes; }
+
+    size_t GetSubtreeHash() const { return _nodes[0].subtreeHash; }
+
+    /// Returns a content hash of \p dataSource.
+    static size_t HashDataSource(HdDataSourceBaseHandle const& dataSource) {
+        if (!dataSource) {
+            return 0;
+        }
+        if (HdContainerDataSourceHandle container = HdContainerDataSource::Cast(dataSource)) {
+            TfTokenVector names = container->GetNames();
+            std::sort(names.begin(), names.end(), TfTokenFastArbitraryLessThan());
+            size_t hash = 1;
+            for (TfToken const& name : names) {
+                hash = TfHash::Combine(hash, name, HashDataSource(container->Get(name)));
+            }
+            return hash;
+        }
+        if (HdVectorDataSourceHandle vector = HdVectorDataSource::Cast(dataSource)) {
+            size_t hash = 2;
+            for (size_t i = 0; i != vector->GetNumElements(); ++i) {
+                hash = TfHash::Combine(hash, HashDataSource(vector->GetElement(i)));
+            }
+            return hash;
+        }
+        if (HdSampledDataSourceHandle sampled = HdSampledDataSource::Cast(dataSource)) {
+            size_t hash = 3;
+            for (HdSampledDataSource::Time time : _GetSampleTimes(sampled)) {
+                hash = TfHash::Combine(hash, time, sampled->GetValue(time).GetHash());
+            }
+            return hash;
+        }
+        return TfHash::Combine(4, get_pointer(dataSource));
+    }
+
+    /// Returns whether two data sources have the same content, by the same
+    /// rules as HashDataSource.
+    static bool AreEqual(HdDataSourceBaseHandle const& a, HdDataSourceBaseHandle const& b) {
+        if (!a || !b) {
+            return !a && !b;
+        }
+        if (HdContainerDataSourceHandle containerA = HdContainerDataSource::Cast(a)) {
+            HdContainerDataSourceHandle containerB = HdContainerDataSource::Cast(b);
+            if (!containerB) {
+                return false;
+            }
+            TfTokenVector namesA = containerA->GetNames();
+            TfTokenVector namesB = containerB->GetNames();
+            std::sort(namesA.begin(), namesA.end(), TfTokenFastArbitraryLessThan());
+            std::sort(namesB.begin(), namesB.end(), TfTokenFastArbitraryLessThan());
+            if (namesA != namesB) {
+                return false;
+            }
+            for (TfToken const& name : namesA) {
+                if (!AreEqual(containerA->Get(name), containerB->Get(name))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (HdVectorDataSourceHandle vectorA = HdVectorDataSource::Cast(a)) {
+            HdVectorDataSourceHandle vectorB = HdVectorDataSource::Cast(b);
+            if (!vectorB || vectorA->GetNumElements() != vectorB->GetNumElements()) {
+                return false;
+            }
+            for (size_t i = 0; i != vectorA->GetNumElements(); ++i) {
+                if (!AreEqual(vectorA->GetElement(i), vectorB->GetElement(i))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (HdSampledDataSourceHandle sampledA = HdSampledDataSource::Cast(a)) {
+            HdSampledDataSourceHandle sampledB = HdSampledDataSource::Cast(b);
+            if (!sampledB) {
+                return false;
+            }
+            const std::vector<HdSampledDataSource::Time> times = _GetSampleTimes(sampledA);
+            if (times != _GetSampleTimes(sampledB)) {
+                return false;
+            }
+            for (HdSampledDataSource::Time time : times) {
+                if (sampledA->GetValue(time) != sampledB->GetValue(time)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return a == b;
+    }
+
+private:
+    // Returns the times at which a sampled data source is compared: its
+    // contributing sample times in [-1, 1], or zero if it does not vary.
+    static std::vector<HdSampledDataSource::Time> _GetSampleTimes(HdSampledDataSourceHandle const& sampled) {
+        std::vector<HdSampledDataSource::Time> times;
+        if (!sampled->GetContributingSampleTimesForInterval(-1.0f, 1.0f, &times) || times.empty()) {
+            times.assign(1, 0.0f);
+        }
+        return times;
+    }
+
+    std::vector<Node> _nodes;
+};
+
+/// \class Hdsi_HashedSceneIndexDiff
+///
+/// Computes the notices that turn one scene index into another, like
+/// HdsiComputeSceneIndexDiffDelta, by comparing Merkle hash trees.
+///
+/// HdsiComputeSceneIndexDiffDelta traverses both scene indices completely
+/// on every call.  Here, the hash trees of both scene indices are walked in
+/// lockstep, skipping subtrees whose hashes match, so once the trees exist
+/// a diff costs time proportional to the changes.  The trees are cached per
+/// scene index and dropped when the scene index sends any notice, which
+/// suits inputs that change rarely, e.g. variants or cached snapshots.
+/// Entries of expired scene indices are erased as new ones are added.
+///
+/// The entries follow HdsiComputeSceneIndexDiffDelta: prims only in the
+/// first scene index are removed, prims only in the second one and prims
+/// whose type changed are added, and prims whose data source changed are
+/// dirtied at the top-level locators that differ.  In addition, a removed
+/// subtree and an added subtree with the same subtree hash, where no other
+/// removed or added subtree has that hash, are reported as a rename.
+///
+/// Subtrees with matching hashes are skipped without reading them, so the
+/// diff is probabilistic: a 64-bit hash collision between a subtree and its
+/// changed counterpart drops the change.  The prims on the way to a
+/// difference are compared by value before they are dirtied, and subtrees
+/// are compared by value before they are reported as a rename, so a
+/// collision never produces a spurious entry.
+///
+/// Instances can be copied, e.g. into an HdsiComputeSceneIndexDiff, and
+/// copies share the cache.  The cache may be used from several threads.
+///
+class Hdsi_HashedSceneIndexDiff {
+public:
+    using HashTreeConstPtr = std::shared_ptr<const Hdsi_SceneIndexHashTree>;
+
+    Hdsi_HashedSceneIndexDiff() : _cache(std::make_shared<_Cache>()) {}
+
+    void operator()(HdSceneIndexBaseRefPtr const& siA,
+                    HdSceneIndexBaseRefPtr const& siB,
+                    HdSceneIndexObserver::RemovedPrimEntries* removedEntries,
+                    HdSceneIndexObserver::AddedPrimEntries* addedEntries,
+                    HdSceneIndexObserver::RenamedPrimEntries* renamedEntries,
+                    HdSceneIndexObserver::DirtiedPrimEntries* dirtiedEntries) const {
+        if (!siA && !siB) {
+            return;
+        }
+        if (!siA || !siB) {
+            // Everything is added or removed.
+            Hdsi_SceneIndexHashTree const& tree = *GetHashTree(siA ? siA : siB);
+            for (Hdsi_SceneIndexHashTree::Node const& node : tree.GetNodes()) {
+                if (siA) {
+                    removedEntries->emplace_back(node.path);
+                    break;
+                }
+                addedEntries->emplace_back(node.path, node.primType);
+            }
+            return;
+        }
+        Compute(*siA, *GetHashTree(siA), *siB, *GetHashTree(siB), removedEntries, addedEntries, renamedEntries,
+                dirtiedEntries);
+    }
+
+    /// Returns the hash tree of \p sceneIndex, building it if it is not
+    /// cached.
+    HashTreeConstPtr GetHashTree(HdSceneIndexBaseRefPtr const& sceneIndex) const {
+        size_t generation;
+        {
+            std::lock_guard<std::mutex> lock(_cache->mutex);
+            _Entry& entry = _cache->GetEntry(sceneIndex);
+            if (entry.tree) {
+                return entry.tree;
+            }
+            generation = entry.observer->generation;
+        }
+
+        // Build without holding the lock, so that other scene indices can
+        // be built at the same time.
+        HashTreeConstPtr tree = std::make_shared<const Hdsi_SceneIndexHashTree>(*sceneIndex);
+        std::lock_guard<std::mutex> lock(_cache->mutex);
+        _Entry& entry = _cache->GetEntry(sceneIndex);
+        if (entry.observer->generation == generation) {
+            entry.tree = tree;
+        }
+        return tree;
+    }
+
+    /// Returns the number of scene indices in the cache, after erasing the
+    /// ones that expired.
+    size_t GetNumCachedSceneIndices() const {
+        std::lock_guard<std::mutex> lock(_cache->mutex);
+        _cache->PruneExpired();
+        return _cache->entries.size();
+    }
+
+    /// Computes the diff between two scene indices with the given hash
+    /// trees.
+    static void Compute(HdSceneIndexBase const& siA,
+                        Hdsi_SceneIndexHashTree const& treeA,
+                        HdSceneIndexBase const& siB,
+                        Hdsi_SceneIndexHashTree const& treeB,
+                        HdSceneIndexObserver::RemovedPrimEntries* removedEntries,
+                        HdSceneIndexObserver::AddedPrimEntries* addedEntries,
+                        HdSceneIndexObserver::RenamedPrimEntries* renamedEntries,
+                        HdSceneIndexObserver::DirtiedPrimEntries* dirtiedEntries) {
+        using _Node = Hdsi_SceneIndexHashTree::Node;
+        std::vector<_Node> const& nodesA = treeA.GetNodes();
+        std::vector<_Node> const& nodesB = treeB.GetNodes();
+
+        struct _Local {
+            std::vector<uint32_t> removedRoots;
+            std::vector<uint32_t> addedRoots;
+            HdSceneIndexObserver::AddedPrimEntries added;
+            HdSceneIndexObserver::DirtiedPrimEntries dirtied;
+        };
+        tbb::enumerable_thread_specific<_Local> locals;
+
+        // Walk pairs of nodes with the same path whose subtrees differ, one
+        // level at a time.
+        std::vector<std::pair<uint32_t, uint32_t>> frontier;
+        if (nodesA[0].subtreeHash != nodesB[0].subtreeHash) {
+            frontier.emplace_back(0, 0);
+        }
+        while (!frontier.empty()) {
+            tbb::enumerable_thread_specific<std::vector<std::pair<uint32_t, uint32_t>>> nextLocals;
+            WorkParallelForN(frontier.size(), [&](size_t begin, size_t end) {
+                _Local& local = locals.local();
+                std::vector<std::pair<uint32_t, uint32_t>>& next = nextLocals.local();
+                for (size_t i = begin; i != end; ++i) {
+                    _Node const& a = nodesA[frontier[i].first];
+                    _Node const& b = nodesB[frontier[i].second];
+                    // The prims' hashes may match by collision, so compare
+                    // their values.
+                    if (a.primType != b.primType) {
+                        local.added.emplace_back(b.path, b.primType);
+                    } else {
+                        HdDataSourceLocatorSet locators =
+                                _DiffLocators(siA.GetPrim(a.path).dataSource, siB.GetPrim(b.path).dataSource);
+                        if (!locators.IsEmpty()) {
+                            local.dirtied.emplace_back(b.path, std::move(locators));
+                        }
+                    }
+
+                    // Merge the children, which are sorted by name.
+                    uint32_t ca = a.firstChild;
+                    uint32_t cb = b.firstChild;
+                    const uint32_t endA = a.firstChild + a.numChildren;
+                    const uint32_t endB = b.firstChild + b.numChildren;
+                    while (ca != endA || cb != endB) {
+                        if (cb == endB || (ca != endA && TfTokenFastArbitraryLessThan()(
+                                                                 nodesA[ca].path.GetNameToken(),
+                                                                 nodesB[cb].path.GetNameToken()))) {
+                            local.removedRoots.push_back(ca++);
+                        } else if (ca == endA || nodesA[ca].path.GetNameToken() != nodesB[cb].path.GetNameToken()) {
+                            local.addedRoots.push_back(cb++);
+                        } else {
+                            if (nodesA[ca].subtreeHash != nodesB[cb].subtreeHash) {
+                                next.emplace_back(ca, cb);
+                            }
+                            ++ca;
+                            ++cb;
+                        }
+                    }
+                }
+            });
+            frontier.clear();
+            for (auto const& next : nextLocals) {
+                frontier.insert(frontier.end(), next.begin(), next.end());
+            }
+        }
+
+        std::vector<uint32_t> removedRoots;
+        std::vector<uint32_t> addedRoots;
+        for (_Local& local : locals) {
+            removedRoots.insert(removedRoots.end(), local.removedRoots.begin(), local.removedRoots.end());
+            addedRoots.insert(addedRoots.end(), local.addedRoots.begin(), local.addedRoots.end());
+            addedEntries->insert(addedEntries->end(), local.added.begin(), local.added.end());
+            dirtiedEntries->insert(dirtiedEntries->end(), local.dirtied.begin(), local.dirtied.end());
+        }
+
+        // Pair removed and added subtrees whose hash is unique on both
+        // sides.
+        std::unordered_map<size_t, std::pair<size_t, uint32_t>> removedByHash;
+        for (uint32_t r : removedRoots) {
+            auto& match = removedByHash[nodesA[r].subtreeHash];
+            ++match.first;
+            match.second = r;
+        }
+        std::unordered_map<size_t, std::pair<size_t, uint32_t>> addedByHash;
+        for (uint32_t a : addedRoots) {
+            auto& match = addedByHash[nodesB[a].subtreeHash];
+            ++match.first;
+            match.second = a;
+        }
+        std::vector<bool> isRenamedFrom(removedRoots.empty() ? 0 : nodesA.size());
+        for (uint32_t a : addedRoots) {
+            const size_t hash = nodesB[a].subtreeHash;
+            const auto removed = removedByHash.find(hash);
+            if (removed != removedByHash.end() && removed->second.first == 1 && addedByHash[hash].first == 1 &&
+                _AreSubtreesEqual(siA, treeA, removed->second.second, siB, treeB, a)) {
+                renamedEntries->emplace_back(nodesA[removed->second.second].path, nodesB[a].path);
+                isRenamedFrom[removed->second.second] = true;
+            } else {
+                // Add the whole subtree.
+                std::vector<uint32_t> stack = {a};
+                while (!stack.empty()) {
+                    _Node const& node = nodesB[stack.back()];
+                    stack.pop_back();
+                    addedEntries->emplace_back(node.path, node.primType);
+                    for (uint32_t c = node.firstChild; c != node.firstChild + node.numChildren; ++c) {
+                        stack.push_back(c);
+                    }
+                }
+            }
+        }
+        for (uint32_t r : removedRoots) {
+            if (!isRenamedFrom[r]) {
+                removedEntries->emplace_back(nodesA[r].path);
+            }
+        }
+    }
+
+private:
+    // Returns the top-level locators at which two data sources differ.
+    static HdDataSourceLocatorSet _DiffLocators(HdContainerDataSourceHandle const& a,
+                                                HdContainerDataSourceHandle const& b) {
+        if (!a || !b) {
+            return a || b ? HdDataSourceLocatorSet::UniversalSet() : HdDataSourceLocatorSet();
+        }
+        TfTokenVector names = a->GetNames();
+        TfTokenVector namesB = b->GetNames();
+        names.insert(names.end(), namesB.begin(), namesB.end());
+        std::sort(names.begin(), names.end(), TfTokenFastArbitraryLessThan());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+
+        HdDataSourceLocatorSet locators;
+        for (TfToken const& name : names) {
+            if (!Hdsi_SceneIndexHashTree::AreEqual(a->Get(name), b->Get(name))) {
+                locators.insert(HdDataSourceLocator(name));
+            }
+        }
+        return locators;
+    }
+
+    // Returns whether the subtrees at two nodes have the same types, data
+    // sources and child names, ignoring the names of the nodes themselves.
+    static bool _AreSubtreesEqual(HdSceneIndexBase const& siA,
+                                  Hdsi_SceneIndexHashTree const& treeA,
+                                  uint32_t rootA,
+                                  HdSceneIndexBase const& siB,
+                                  Hdsi_SceneIndexHashTree const& treeB,
+                                  uint32_t rootB) {
+        using _Node = Hdsi_SceneIndexHashTree::Node;
+        std::vector<std::pair<uint32_t, uint32_t>> stack = {{rootA, rootB}};
+        while (!stack.empty()) {
+            _Node const& a = treeA.GetNodes()[stack.back().first];
+            _Node const& b = treeB.GetNodes()[stack.back().second];
+            stack.pop_back();
+            if (a.primType != b.primType || a.numChildren != b.numChildren ||
+                !Hdsi_SceneIndexHashTree::AreEqual(siA.GetPrim(a.path).dataSource, siB.GetPrim(b.path).dataSource)) {
+                return false;
+            }
+            // Children are sorted by name on both sides.
+            for (uint32_t i = 0; i != a.numChildren; ++i) {
+                if (treeA.GetNodes()[a.firstChild + i].path.GetNameToken() !=
+                    treeB.GetNodes()[b.firstChild + i].path.GetNameToken()) {
+                    return false;
+                }
+                stack.emplace_back(a.firstChild + i, b.firstChild + i);
+            }
+        }
+        return true;
+    }
+
+    struct _Cache;
+
+    // Counts notices from a cached scene index, which invalidate its tree.
+    struct _InvalidatingObserver : public HdSceneIndexObserver {
+        explicit _InvalidatingObserver(_Cache* cache_, HdSceneIndexBase const* sceneIndex_)
+            : cache(cache_), sceneIndex(sceneIndex_) {}
+
+        void PrimsAdded(HdSceneIndexBase const&, AddedPrimEntries const&) override { _Invalidate(); }
+        void PrimsRemoved(HdSceneIndexBase const&, RemovedPrimEntries const&) override { _Invalidate(); }
+        void PrimsDirtied(HdSceneIndexBase const&, DirtiedPrimEntries const&) override { _Invalidate(); }
+        void PrimsRenamed(HdSceneIndexBase const&, RenamedPrimEntries const&) override { _Invalidate(); }
+
+        void _Invalidate();
+
+        _Cache* const cache;
+        HdSceneIndexBase const* const sceneIndex;
+        size_t generation = 0;
+    };
+
+    struct _Entry {
+        HdSceneIndexBasePtr sceneIndex;
+        std::unique_ptr<_InvalidatingObserver> observer;
+        HashTreeConstPtr tree;
+    };
+
+    struct _Cache {
+        ~_Cache() {
+            for (auto& entry : entries) {
+                if (entry.second.sceneIndex) {
+                    entry.second.sceneIndex->RemoveObserver(HdSceneIndexObserverPtr(entry.second.observer.get()));
+                }
+            }
+        }
+
+        // Returns the entry of sceneIndex, adding it if needed.  The mutex
+        // must be held.
+        _Entry& GetEntry(HdSceneIndexBaseRefPtr const& sceneIndex) {
+            auto it = entries.find(get_pointer(sceneIndex));
+            if (it == entries.end()) {
+                // Drop the entries of expired scene indices whenever the
+                // table has doubled, so that adding entries stays amortized
+                // constant time.
+                if (entries.size() >= pruneSize) {
+                    PruneExpired();
+                    pruneSize = std::max<size_t>(16, 2 * entries.size());
+                }
+                it = entries.emplace(get_pointer(sceneIndex), _Entry()).first;
+            }
+            _Entry& entry = it->second;
+            // A new scene index may reuse the address of an expired one.
+            if (!entry.sceneIndex) {
+                entry.tree.reset();
+                entry.sceneIndex = HdSceneIndexBasePtr(sceneIndex);
+                entry.observer = std::make_unique<_InvalidatingObserver>(this, get_pointer(sceneIndex));
+                sceneIndex->AddObserver(HdSceneIndexObserverPtr(entry.observer.get()));
+            }
+            return entry;
+        }
+
+        // Erases the entries of expired scene indices, whose observers can
+        // no longer be called.  The mutex must be held.
+        void PruneExpired() {
+            for (auto it = entries.begin(); it != entries.end();) {
+                it = it->second.sceneIndex ? std::next(it) : entries.erase(it);
+            }
+        }
+
+        std::mutex mutex;
+        std::unordered_map<HdSceneIndexBase const*, _Entry> entries;
+        size_t pruneSize = 16;
+    };
+
+    std::shared_ptr<_Cache> _cache;
+};
+
+inline void Hdsi_HashedSceneIndexDiff::_InvalidatingObserver::_Invalidate() {
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    ++generation;
+    const auto it = cache->entries.find(sceneIndex);
+    if (it != cache->entries.end()) {
+        it->second.tree.reset();
+    }
+}
+
+/// Computes the diff between two scene indices with uncached hash trees.
+/// Has the signature of HdsiComputeSceneIndexDiffDelta.
+inline void Hdsi_ComputeHashedSceneIndexDiff(HdSceneIndexBaseRefPtr const& siA,
+                                             HdSceneIndexBaseRefPtr const& siB,
+                                             HdSceneIndexObserver::RemovedPrimEntries* removedEntries,
+                                             HdSceneIndexObserver::AddedPrimEntries* addedEntries,
+                                             HdSceneIndexObserver::RenamedPrimEntries* renamedEntries,
+                                             HdSceneIndexObserver::DirtiedPrimEntries* dirtiedEntries) {
+    if (!siA || !siB) {
+        Hdsi_HashedSceneIndexDiff()(siA, siB, removedEntries, addedEntries, renamedEntries, dirtiedEntries);
+        return;
+    }
+    Hdsi_HashedSceneIndexDiff::Compute(*siA, Hdsi_SceneIndexHashTree(*siA), *siB, Hdsi_SceneIndexHashTree(*siB),
+                                       removedEntries, addedEntries, renamedEntries, dirtiedEntries);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HDSI_HASHED_SCENE_INDEX_DIFF_H
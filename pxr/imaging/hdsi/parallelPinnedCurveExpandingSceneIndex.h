@@ -0,0 +1,502 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HDSI_PARALLEL_PINNED_CURVE_EXPANDING_SCENE_INDEX_H
+#define PXR_IMAGING_HDSI_PARALLEL_PINNED_CURVE_EXPANDING_SCENE_INDEX_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/basisCurvesSchema.h"
+#include "pxr/imaging/hd/basisCurvesTopologySchema.h"
+#include "pxr/imaging/hd/filteringSceneIndex.h"
+#include "pxr/imaging/hd/primvarSchema.h"
+#include "pxr/imaging/hd/primvarsSchema.h"
+#include "pxr/imaging/hd/retainedDataSource.h"
+#include "pxr/imaging/hd/tokens.h"
+#include "pxr/base/gf/half.h"
+#include "pxr/base/gf/matrix4d.h"
+#include "pxr/base/gf/vec2d.h"
+#include "pxr/base/gf/vec2f.h"
+#include "pxr/base/gf/vec2i.h"
+#include "pxr/base/gf/vec3d.h"
+#include "pxr/base/gf/vec3f.h"
+#include "pxr/base/gf/vec3i.h"
+#include "pxr/base/gf/vec4d.h"
+#include "pxr/base/gf/vec4f.h"
+#include "pxr/base/gf/vec4i.h"
+#include "pxr/base/vt/array.h"
+#include "pxr/base/work/loops.h"
+#include "pxr/usd/sdf/path.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DECLARE_REF_PTRS(Hdsi_ParallelPinnedCurveExpandingSceneIndex);
+
+/// \class Hdsi_ParallelPinnedCurveExpandingSceneIndex
+///
+/// Expands pinned cubic bspline and catmullRom curves to nonperiodic ones,
+/// like HdsiPinnedCurveExpandingSceneIndex, for scenes with millions of
+/// curves.
+///
+/// The first time a prim's topology or primvars are pulled, the expansion
+/// computes two remapping tables, in parallel over curves: the authored
+/// vertex and the authored varying element that each expanded element
+/// repeats.  Points, curve indices, primvar indices and every vertex and
+/// varying primvar value are then expanded by a single gather through the
+/// matching table, chunked across threads, whatever their element type.
+/// Values are only expanded when their data source is pulled, so primvars
+/// nobody reads cost nothing.
+///
+/// As with HdsiPinnedCurveExpandingSceneIndex, bspline curves repeat each
+/// end vertex twice and catmullRom curves once, varying primvars repeat
+/// their end values to match the new segment count, and with authored
+/// curve indices only the indices are expanded, not non-indexed vertex
+/// primvars.  Values whose size does not match the topology, and element
+/// types the gather does not know, are passed through unchanged.
+///
+/// The tables and the expanded topology are cached per prim across
+/// GetPrim calls, since topology rarely animates while points do.  Dirtying
+/// a prim's topology, re-adding it or removing it drops its cache entry;
+/// other dirties, e.g. of points, reuse it.
+///
+class Hdsi_ParallelPinnedCurveExpandingSceneIndex : public HdSingleInputFilteringSceneIndexBase {
+public:
+    static Hdsi_ParallelPinnedCurveExpandingSceneIndexRefPtr New(HdSceneIndexBaseRefPtr const& inputSceneIndex) {
+        return TfCreateRefPtr(new Hdsi_ParallelPinnedCurveExpandingSceneIndex(inputSceneIndex));
+    }
+
+    HdSceneIndexPrim GetPrim(SdfPath const& primPath) const override {
+        HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+        if (prim.primType == HdPrimTypeTokens->basisCurves && prim.dataSource) {
+            prim.dataSource = _PrimDataSource::New(prim.dataSource, _GetCacheEntry(primPath));
+        }
+        return prim;
+    }
+
+    SdfPathVector GetChildPrimPaths(SdfPath const& primPath) const override {
+        return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+    }
+
+    /// Returns how many times the remapping tables of a prim were computed,
+    /// which only happens again after its cache entry was dropped.
+    size_t GetNumComputedExpansions() const { return _stats->numComputedExpansions; }
+
+protected:
+    explicit Hdsi_ParallelPinnedCurveExpandingSceneIndex(HdSceneIndexBaseRefPtr const& inputSceneIndex)
+        : HdSingleInputFilteringSceneIndexBase(inputSceneIndex), _stats(std::make_shared<_Stats>()) {}
+
+    void _PrimsAdded(HdSceneIndexBase const& sender, HdSceneIndexObserver::AddedPrimEntries const& entries) override {
+        {
+            std::lock_guard<std::mutex> lock(_cacheMutex);
+            for (HdSceneIndexObserver::AddedPrimEntry const& entry : entries) {
+                _cache.erase(entry.primPath);
+            }
+        }
+        _SendPrimsAdded(entries);
+    }
+
+    void _PrimsRemoved(HdSceneIndexBase const& sender,
+                       HdSceneIndexObserver::RemovedPrimEntries const& entries) override {
+        {
+            std::lock_guard<std::mutex> lock(_cacheMutex);
+            for (HdSceneIndexObserver::RemovedPrimEntry const& entry : entries) {
+                // Paths sort after their ancestors, so a subtree is a range.
+                auto it = _cache.lower_bound(entry.primPath);
+                while (it != _cache.end() && it->first.HasPrefix(entry.primPath)) {
+                    it = _cache.erase(it);
+                }
+            }
+        }
+        _SendPrimsRemoved(entries);
+    }
+
+    void _PrimsDirtied(HdSceneIndexBase const& sender,
+                       HdSceneIndexObserver::DirtiedPrimEntries const& entries) override {
+        // The expansion of every primvar depends on the topology.
+        static const HdDataSourceLocator topologyLocator = HdBasisCurvesTopologySchema::GetDefaultLocator();
+        HdSceneIndexObserver::DirtiedPrimEntries dirtied;
+        for (size_t i = 0; i != entries.size(); ++i) {
+            if (!entries[i].dirtyLocators.Intersects(topologyLocator)) {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_cacheMutex);
+                _cache.erase(entries[i].primPath);
+            }
+            if (!entries[i].dirtyLocators.Intersects(HdPrimvarsSchema::GetDefaultLocator())) {
+                if (dirtied.empty()) {
+                    dirtied.assign(entries.begin(), entries.end());
+                }
+                dirtied[i].dirtyLocators.insert(HdPrimvarsSchema::GetDefaultLocator());
+            }
+        }
+        _SendPrimsDirtied(dirtied.empty() ? entries : dirtied);
+    }
+
+private:
+    // Remapping tables and expanded topology of one prim.
+    struct _Expansion {
+        bool hasCurveIndices = false;
+        VtIntArray curveVertexCounts;
+        HdDataSourceBaseHandle curveVertexCountsDataSource;
+        // Only set with authored curve indices.
+        HdDataSourceBaseHandle curveIndicesDataSource;
+        // Authored element repeated by each expanded vertex or varying
+        // element.
+        std::vector<int> vertexSources;
+        std::vector<int> varyingSources;
+        size_t numAuthoredVertices = 0;
+        size_t numAuthoredVarying = 0;
+    };
+    using _ExpansionSharedPtr = std::shared_ptr<const _Expansion>;
+
+    struct _Stats {
+        std::atomic<size_t> numComputedExpansions{0};
+    };
+
+    // Expansion of one prim, computed by the first of its data sources that
+    // needs it.
+    struct _CacheEntry {
+        std::shared_ptr<_Stats> stats;
+        std::once_flag once;
+        _ExpansionSharedPtr expansion;
+    };
+    using _CacheEntrySharedPtr = std::shared_ptr<_CacheEntry>;
+
+    _CacheEntrySharedPtr _GetCacheEntry(SdfPath const& primPath) const {
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        _CacheEntrySharedPtr& entry = _cache[primPath];
+        if (!entry) {
+            entry = std::make_shared<_CacheEntry>();
+            entry->stats = _stats;
+        }
+        return entry;
+    }
+
+    // Number of varying values of a cubic nonperiodic curve with vstep 1.
+    // Curves with fewer than four vertices are authored as one segment.
+    static int _GetNumVarying(int numVertices) { return std::max(numVertices - 3, 1) + 1; }
+
+    static TfToken _GetToken(HdTokenDataSourceHandle const& dataSource) {
+        return dataSource ? dataSource->GetTypedValue(0.0f) : TfToken();
+    }
+
+    // Returns the tables for a prim, or null if it is not a pinned curve
+    // that needs expanding.
+    static _ExpansionSharedPtr _ComputeExpansion(HdContainerDataSourceHandle const& primDataSource) {
+        HdBasisCurvesTopologySchema topology = HdBasisCurvesSchema::GetFromParent(primDataSource).GetTopology();
+        if (!topology || _GetToken(topology.GetWrap()) != HdTokens->pinned ||
+            _GetToken(topology.GetType()) != HdTokens->cubic) {
+            return nullptr;
+        }
+        const TfToken basis = _GetToken(topology.GetBasis());
+        const int numExtraEnds = basis == HdTokens->bspline ? 2 : basis == HdTokens->catmullRom ? 1 : 0;
+        HdIntArrayDataSourceHandle countsDataSource = topology.GetCurveVertexCounts();
+        if (numExtraEnds == 0 || !countsDataSource) {
+            return nullptr;
+        }
+        const VtIntArray counts = countsDataSource->GetTypedValue(0.0f);
+        if (counts.empty() || *std::min_element(counts.cbegin(), counts.cend()) < 1) {
+            return nullptr;
+        }
+
+        auto expansion = std::make_shared<_Expansion>();
+        VtIntArray curveIndices;
+        if (HdIntArrayDataSourceHandle indices = topology.GetCurveIndices()) {
+            curveIndices = indices->GetTypedValue(0.0f);
+            expansion->hasCurveIndices = !curveIndices.empty();
+        }
+
+        // Offsets of each curve's authored and expanded elements.
+        const size_t numCurves = counts.size();
+        std::vector<size_t> vertexOffsets(numCurves + 1, 0);
+        std::vector<size_t> expandedVertexOffsets(numCurves + 1, 0);
+        std::vector<size_t> varyingOffsets(numCurves + 1, 0);
+        std::vector<size_t> expandedVaryingOffsets(numCurves + 1, 0);
+        expansion->curveVertexCounts.resize(numCurves);
+        int* expandedCounts = expansion->curveVertexCounts.data();
+        for (size_t k = 0; k != numCurves; ++k) {
+            const int count = counts[k];
+            expandedCounts[k] = count + 2 * numExtraEnds;
+            vertexOffsets[k + 1] = vertexOffsets[k] + count;
+            expandedVertexOffsets[k + 1] = expandedVertexOffsets[k] + expandedCounts[k];
+            varyingOffsets[k + 1] = varyingOffsets[k] + _GetNumVarying(count);
+            expandedVaryingOffsets[k + 1] = expandedVaryingOffsets[k] + _GetNumVarying(expandedCounts[k]);
+        }
+        expansion->numAuthoredVertices = vertexOffsets.back();
+        expansion->numAuthoredVarying = varyingOffsets.back();
+        expansion->vertexSources.resize(expandedVertexOffsets.back());
+        expansion->varyingSources.resize(expandedVaryingOffsets.back());
+
+        // Each expanded element repeats the authored element at its offset
+        // from the first added one, clamped to the curve.
+        WorkParallelForN(numCurves, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k != end; ++k) {
+                const int count = counts[k];
+                const int first = static_cast<int>(vertexOffsets[k]);
+                int* out = expansion->vertexSources.data() + expandedVertexOffsets[k];
+                for (int j = 0; j != expandedCounts[k]; ++j) {
+                    out[j] = first + std::min(std::max(j - numExtraEnds, 0), count - 1);
+                }
+
+                const int numVarying = _GetNumVarying(count);
+                const int numExpandedVarying = _GetNumVarying(expandedCounts[k]);
+                const int numFront = (numExpandedVarying - numVarying) / 2;
+                const int firstVarying = static_cast<int>(varyingOffsets[k]);
+                out = expansion->varyingSources.data() + expandedVaryingOffsets[k];
+                for (int j = 0; j != numExpandedVarying; ++j) {
+                    out[j] = firstVarying + std::min(std::max(j - numFront, 0), numVarying - 1);
+                }
+            }
+        });
+
+        expansion->curveVertexCountsDataSource =
+                HdRetainedTypedSampledDataSource<VtIntArray>::New(expansion->curveVertexCounts);
+        if (expansion->hasCurveIndices && curveIndices.size() == expansion->numAuthoredVertices) {
+            expansion->curveIndicesDataSource =
+                    HdRetainedTypedSampledDataSource<VtIntArray>::New(_Gather(curveIndices, expansion->vertexSources));
+        }
+        return expansion;
+    }
+
+    template <class... Ts>
+    struct _TypeList {};
+
+    // Element types that expanded values may have.
+    using _GatherTypes = _TypeList<float, int, double, GfHalf, GfVec2f, GfVec3f, GfVec4f, GfVec2d, GfVec3d,
+                                   GfVec4d, GfVec2i, GfVec3i, GfVec4i, GfMatrix4d, TfToken>;
+
+    template <class T>
+    static VtArray<T> _Gather(VtArray<T> const& values, std::vector<int> const& sources) {
+        VtArray<T> result(sources.size());
+        T* const out = result.data();
+        T const* const in = values.cdata();
+        int const* const indices = sources.data();
+        WorkParallelForN(
+                sources.size(),
+                [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i != end; ++i) {
+                        out[i] = in[indices[i]];
+                    }
+                },
+                4096);
+        return result;
+    }
+
+    static bool _GatherValue(VtValue const&, size_t, std::vector<int> const&, VtValue*, _TypeList<>) {
+        return false;
+    }
+
+    template <class T, class... Ts>
+    static bool _GatherValue(VtValue const& value,
+                             size_t numAuthored,
+                             std::vector<int> const& sources,
+                             VtValue* result,
+                             _TypeList<T, Ts...>) {
+        if (!value.IsHolding<VtArray<T>>()) {
+            return _GatherValue(value, numAuthored, sources, result, _TypeList<Ts...>());
+        }
+        VtArray<T> const& values = value.UncheckedGet<VtArray<T>>();
+        if (values.size() != numAuthored) {
+            return false;
+        }
+        *result = VtValue(_Gather(values, sources));
+        return true;
+    }
+
+    // Expands the values of a sampled data source through one of the
+    // tables of an expansion.
+    class _ExpandedDataSource : public HdSampledDataSource {
+    public:
+        HD_DECLARE_DATASOURCE(_ExpandedDataSource);
+
+        VtValue GetValue(Time shutterOffset) override {
+            VtValue value = _input->GetValue(shutterOffset);
+            VtValue result;
+            return _GatherValue(value, _varying ? _expansion->numAuthoredVarying : _expansion->numAuthoredVertices,
+                                _varying ? _expansion->varyingSources : _expansion->vertexSources, &result,
+                                _GatherTypes())
+                           ? result
+                           : value;
+        }
+
+        bool GetContributingSampleTimesForInterval(Time startTime,
+                                                   Time endTime,
+                                                   std::vector<Time>* outSampleTimes) override {
+            return _input->GetContributingSampleTimesForInterval(startTime, endTime, outSampleTimes);
+        }
+
+    private:
+        _ExpandedDataSource(HdSampledDataSourceHandle const& input, _ExpansionSharedPtr const& expansion, bool varying)
+            : _input(input), _expansion(expansion), _varying(varying) {}
+
+        HdSampledDataSourceHandle const _input;
+        _ExpansionSharedPtr const _expansion;
+        const bool _varying;
+    };
+
+    class _PrimvarDataSource : public HdContainerDataSource {
+    public:
+        HD_DECLARE_DATASOURCE(_PrimvarDataSource);
+
+        TfTokenVector GetNames() override { return _input->GetNames(); }
+
+        HdDataSourceBaseHandle Get(TfToken const& name) override {
+            HdDataSourceBaseHandle result = _input->Get(name);
+            if (name != HdPrimvarSchemaTokens->primvarValue && name != HdPrimvarSchemaTokens->indices) {
+                return result;
+            }
+            HdSampledDataSourceHandle sampled = HdSampledDataSource::Cast(result);
+            if (!sampled) {
+                return result;
+            }
+            const TfToken interpolation = _GetToken(HdPrimvarSchema(_input).GetInterpolation());
+            const bool varying = interpolation == HdPrimvarSchemaTokens->varying;
+            if (!varying && interpolation != HdPrimvarSchemaTokens->vertex) {
+                return result;
+            }
+            // With curve indices, authored vertex values are addressed
+            // through the expanded indices.
+            if (!varying && name == HdPrimvarSchemaTokens->primvarValue && _expansion->hasCurveIndices) {
+                return result;
+            }
+            return _ExpandedDataSource::New(sampled, _expansion, varying);
+        }
+
+    private:
+        _PrimvarDataSource(HdContainerDataSourceHandle const& input, _ExpansionSharedPtr const& expansion)
+            : _input(input), _expansion(expansion) {}
+
+        HdContainerDataSourceHandle const _input;
+        _ExpansionSharedPtr const _expansion;
+    };
+
+    class _PrimvarsDataSource : public HdContainerDataSource {
+    public:
+        HD_DECLARE_DATASOURCE(_PrimvarsDataSource);
+
+        TfTokenVector GetNames() override { return _input->GetNames(); }
+
+        HdDataSourceBaseHandle Get(TfToken const& name) override {
+            HdDataSourceBaseHandle result = _input->Get(name);
+            if (HdContainerDataSourceHandle primvar = HdContainerDataSource::Cast(result)) {
+                return _PrimvarDataSource::New(primvar, _expansion);
+            }
+            return result;
+        }
+
+    private:
+        _PrimvarsDataSource(HdContainerDataSourceHandle const& input, _ExpansionSharedPtr const& expansion)
+            : _input(input), _expansion(expansion) {}
+
+        HdContainerDataSourceHandle const _input;
+        _ExpansionSharedPtr const _expansion;
+    };
+
+    class _TopologyDataSource : public HdContainerDataSource {
+    public:
+        HD_DECLARE_DATASOURCE(_TopologyDataSource);
+
+        TfTokenVector GetNames() override { return _input->GetNames(); }
+
+        HdDataSourceBaseHandle Get(TfToken const& name) override {
+            if (name == HdBasisCurvesTopologySchemaTokens->curveVertexCounts) {
+                return _expansion->curveVertexCountsDataSource;
+            }
+            if (name == HdBasisCurvesTopologySchemaTokens->curveIndices && _expansion->curveIndicesDataSource) {
+                return _expansion->curveIndicesDataSource;
+            }
+            if (name == HdBasisCurvesTopologySchemaTokens->wrap) {
+                static const HdDataSourceBaseHandle nonperiodic =
+                        HdRetainedTypedSampledDataSource<TfToken>::New(HdTokens->nonperiodic);
+                return nonperiodic;
+            }
+            return _input->Get(name);
+        }
+
+    private:
+        _TopologyDataSource(HdContainerDataSourceHandle const& input, _ExpansionSharedPtr const& expansion)
+            : _input(input), _expansion(expansion) {}
+
+        HdContainerDataSourceHandle const _input;
+        _ExpansionSharedPtr const _expansion;
+    };
+
+    class _BasisCurvesDataSource : public HdContainerDataSource {
+    public:
+        HD_DECLARE_DATASOURCE(_BasisCurvesDataSource);
+
+        TfTokenVector GetNames() override { return _input->GetNames(); }
+
+        HdDataSourceBaseHandle Get(TfToken const& name) override {
+            HdDataSourceBaseHandle result = _input->Get(name);
+            if (name == HdBasisCurvesSchemaTokens->topology) {
+                if (HdContainerDataSourceHandle topology = HdContainerDataSource::Cast(result)) {
+                    return _TopologyDataSource::New(topology, _expansion);
+                }
+            }
+            return result;
+        }
+
+    private:
+        _BasisCurvesDataSource(HdContainerDataSourceHandle const& input, _ExpansionSharedPtr const& expansion)
+            : _input(input), _expansion(expansion) {}
+
+        HdContainerDataSourceHandle const _input;
+        _ExpansionSharedPtr const _expansion;
+    };
+
+    class _PrimDataSource : public HdContainerDataSource {
+    public:
+        HD_DECLARE_DATASOURCE(_PrimDataSource);
+
+        TfTokenVector GetNames() override { return _input->GetNames(); }
+
+        HdDataSourceBaseHandle Get(TfToken const& name) override {
+            HdDataSourceBaseHandle result = _input->Get(name);
+            if (name != HdBasisCurvesSchemaTokens->basisCurves && name != HdPrimvarsSchemaTokens->primvars) {
+                return result;
+            }
+            HdContainerDataSourceHandle container = HdContainerDataSource::Cast(result);
+            if (!container) {
+                return result;
+            }
+            _CacheEntry& entry = *_entry;
+            std::call_once(entry.once, [this, &entry]() {
+                entry.expansion = _ComputeExpansion(_input);
+                ++entry.stats->numComputedExpansions;
+            });
+            if (!entry.expansion) {
+                return result;
+            }
+            if (name == HdBasisCurvesSchemaTokens->basisCurves) {
+                return _BasisCurvesDataSource::New(container, entry.expansion);
+            }
+            return _PrimvarsDataSource::New(container, entry.expansion);
+        }
+
+    private:
+        _PrimDataSource(HdContainerDataSourceHandle const& input, _CacheEntrySharedPtr const& entry)
+            : _input(input), _entry(entry) {}
+
+        HdContainerDataSourceHandle const _input;
+        _CacheEntrySharedPtr const _entry;
+    };
+
+    mutable std::mutex _cacheMutex;
+    mutable std::map<SdfPath, _CacheEntrySharedPtr> _cache;
+    std::shared_ptr<_Stats> const _stats;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HDSI_PARALLEL_PINNED_CURVE_EXPANDING_SCENE_INDEX_H
@@ -0,0 +1,237 @@
+//  Copyright (c) 2024 Feng Yang
+//
+//  I am making my contributions/submissions to this project solely in my
+//  personal capacity and am not conveying any rights to any intellectual
+//  property of any third parties.
+
+#ifndef PXR_IMAGING_HDSI_PREWARMED_SWITCHING_SCENE_INDEX_H
+#define PXR_IMAGING_HDSI_PREWARMED_SWITCHING_SCENE_INDEX_H
+
+#include "pxr/pxr.h"
+#include "pxr/imaging/hd/filteringSceneIndex.h"
+#include "pxr/imaging/hd/sceneIndexObserver.h"
+#include "pxr/base/tf/diagnostic.h"
+#include "pxr/base/work/dispatcher.h"
+#include "hashedSceneIndexDiff.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DECLARE_REF_PTRS(Hdsi_PrewarmedSwitchingSceneIndex);
+
+/// \class Hdsi_PrewarmedSwitchingSceneIndex
+///
+/// Switching scene index that can compute the notices for a switch ahead of
+/// time.
+///
+/// HdsiSwitchingSceneIndex computes the diff between the active input and
+/// the new one when SetIndex is called, so the frame after a switch pays
+/// for traversing both inputs before its observers can start pulling.
+/// Calling Prewarm() with the index of the next input computes the diff
+/// from the active input to it in the background, using
+/// Hdsi_HashedSceneIndexDiff.  SetIndex then only waits for the background
+/// work, if it is still running, and sends the diff: removed, renamed,
+/// added and dirtied prims, in that order.  Without Prewarm(), SetIndex
+/// computes the diff itself, reusing the cached hash trees of unchanged
+/// inputs.
+///
+/// Pre-warming reads the active input and the target input from worker
+/// threads, so the caller must not edit any input between Prewarm() and
+/// the following WaitForPrewarm() or SetIndex().  A notice from any input
+/// cancels and waits for the background work before it is forwarded, and
+/// drops the pre-computed diffs.
+///
+class Hdsi_PrewarmedSwitchingSceneIndex : public HdFilteringSceneIndexBase {
+public:
+    static Hdsi_PrewarmedSwitchingSceneIndexRefPtr New(std::vector<HdSceneIndexBaseRefPtr> const& inputs,
+                                                       size_t initialIndex = 0) {
+        return TfCreateRefPtr(new Hdsi_PrewarmedSwitchingSceneIndex(inputs, initialIndex));
+    }
+
+    ~Hdsi_PrewarmedSwitchingSceneIndex() override {
+        _dispatcher.Cancel();
+        _dispatcher.Wait();
+        for (HdSceneIndexBaseRefPtr const& input : _inputs) {
+            input->RemoveObserver(HdSceneIndexObserverPtr(&_observer));
+        }
+    }
+
+    HdSceneIndexPrim GetPrim(SdfPath const& primPath) const override {
+        return _GetActiveInput() ? _GetActiveInput()->GetPrim(primPath) : HdSceneIndexPrim();
+    }
+
+    SdfPathVector GetChildPrimPaths(SdfPath const& primPath) const override {
+        return _GetActiveInput() ? _GetActiveInput()->GetChildPrimPaths(primPath) : SdfPathVector();
+    }
+
+    std::vector<HdSceneIndexBaseRefPtr> GetInputScenes() const override { return _inputs; }
+
+    size_t GetIndex() const { return _index; }
+
+    /// Makes input \p index active, sending the pre-computed diff if
+    /// Prewarm(index) was called since the last switch or notice.
+    void SetIndex(size_t index) {
+        if (index >= _inputs.size()) {
+            TF_CODING_ERROR("Invalid switching index %zu for %zu inputs", index, _inputs.size());
+            return;
+        }
+        if (index == _index) {
+            return;
+        }
+
+        WaitForPrewarm();
+        _Delta delta;
+        if (_slots[index]->state == _Ready) {
+            delta = std::move(_slots[index]->delta);
+        } else {
+            delta = _ComputeDelta(_index, index);
+        }
+        // The other diffs start from the input that was active.
+        _ResetSlots();
+        _index = index;
+
+        if (_IsObserved()) {
+            if (!delta.removed.empty()) {
+                _SendPrimsRemoved(delta.removed);
+            }
+            if (!delta.renamed.empty()) {
+                _SendPrimsRenamed(delta.renamed);
+            }
+            if (!delta.added.empty()) {
+                _SendPrimsAdded(delta.added);
+            }
+            if (!delta.dirtied.empty()) {
+                _SendPrimsDirtied(delta.dirtied);
+            }
+        }
+    }
+
+    /// Starts computing the diff from the active input to input \p index
+    /// on worker threads, unless it is already computed or running.  No
+    /// input may be edited until WaitForPrewarm() or SetIndex() is called.
+    void Prewarm(size_t index) {
+        if (index >= _inputs.size()) {
+            TF_CODING_ERROR("Invalid switching index %zu for %zu inputs", index, _inputs.size());
+            return;
+        }
+        _Slot& slot = *_slots[index];
+        if (index == _index || slot.state != _None) {
+            return;
+        }
+        slot.state = _Running;
+        const size_t from = _index;
+        _dispatcher.Run([this, &slot, from, index]() {
+            slot.delta = _ComputeDelta(from, index);
+            slot.state = _Ready;
+        });
+    }
+
+    /// Waits for the background work started by Prewarm() to finish.
+    void WaitForPrewarm() { _dispatcher.Wait(); }
+
+    /// Returns whether switching to \p index would send a pre-computed
+    /// diff without waiting.
+    bool IsPrewarmed(size_t index) const { return index < _slots.size() && _slots[index]->state == _Ready; }
+
+protected:
+    Hdsi_PrewarmedSwitchingSceneIndex(std::vector<HdSceneIndexBaseRefPtr> const& inputs, size_t initialIndex)
+        : _inputs(inputs), _index(initialIndex < inputs.size() ? initialIndex : 0), _observer(this) {
+        for (size_t i = 0; i != _inputs.size(); ++i) {
+            _slots.push_back(std::make_unique<_Slot>());
+        }
+        for (HdSceneIndexBaseRefPtr const& input : _inputs) {
+            input->AddObserver(HdSceneIndexObserverPtr(&_observer));
+        }
+    }
+
+private:
+    struct _Delta {
+        HdSceneIndexObserver::RemovedPrimEntries removed;
+        HdSceneIndexObserver::AddedPrimEntries added;
+        HdSceneIndexObserver::RenamedPrimEntries renamed;
+        HdSceneIndexObserver::DirtiedPrimEntries dirtied;
+    };
+
+    enum _State { _None, _Running, _Ready };
+
+    // The diff from the active input to one input.  The delta is written
+    // by the worker that computes it, before the state becomes ready.
+    struct _Slot {
+        _Delta delta;
+        std::atomic<_State> state{_None};
+    };
+
+    class _Observer : public HdSceneIndexObserver {
+    public:
+        explicit _Observer(Hdsi_PrewarmedSwitchingSceneIndex* owner) : _owner(owner) {}
+
+        void PrimsAdded(HdSceneIndexBase const& sender, AddedPrimEntries const& entries) override {
+            if (_owner->_Invalidate(sender)) {
+                _owner->_SendPrimsAdded(entries);
+            }
+        }
+        void PrimsRemoved(HdSceneIndexBase const& sender, RemovedPrimEntries const& entries) override {
+            if (_owner->_Invalidate(sender)) {
+                _owner->_SendPrimsRemoved(entries);
+            }
+        }
+        void PrimsDirtied(HdSceneIndexBase const& sender, DirtiedPrimEntries const& entries) override {
+            if (_owner->_Invalidate(sender)) {
+                _owner->_SendPrimsDirtied(entries);
+            }
+        }
+        void PrimsRenamed(HdSceneIndexBase const& sender, RenamedPrimEntries const& entries) override {
+            if (_owner->_Invalidate(sender)) {
+                _owner->_SendPrimsRenamed(entries);
+            }
+        }
+
+    private:
+        Hdsi_PrewarmedSwitchingSceneIndex* const _owner;
+    };
+
+    HdSceneIndexBaseRefPtr const& _GetActiveInput() const {
+        static const HdSceneIndexBaseRefPtr empty;
+        return _index < _inputs.size() ? _inputs[_index] : empty;
+    }
+
+    // Stops the background work, drops the pre-computed diffs and returns
+    // whether sender is the active input.  Cancelled diffs may be
+    // incomplete, so they are dropped too; the notice also drops any hash
+    // tree of sender they left in the diff's cache.
+    bool _Invalidate(HdSceneIndexBase const& sender) {
+        _dispatcher.Cancel();
+        _dispatcher.Wait();
+        _ResetSlots();
+        return _GetActiveInput() && &sender == get_pointer(_GetActiveInput());
+    }
+
+    // Must only be called while no work is running.
+    void _ResetSlots() {
+        for (std::unique_ptr<_Slot> const& slot : _slots) {
+            slot->delta = _Delta();
+            slot->state = _None;
+        }
+    }
+
+    _Delta _ComputeDelta(size_t from, size_t to) const {
+        _Delta delta;
+        _diff(_inputs[from], _inputs[to], &delta.removed, &delta.added, &delta.renamed, &delta.dirtied);
+        return delta;
+    }
+
+    const std::vector<HdSceneIndexBaseRefPtr> _inputs;
+    size_t _index;
+    Hdsi_HashedSceneIndexDiff _diff;
+    // Diffs from the active input, by input index.
+    std::vector<std::unique_ptr<_Slot>> _slots;
+    WorkDispatcher _dispatcher;
+    _Observer _observer;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif  // PXR_IMAGING_HDSI_PREWARMED_SWITCHING_SCENE_INDEX_H
@@ -9,8 +9,16 @@
 #include "pxr/imaging/hd/tokens.h"
 
 #include "pxr/imaging/hdsi/computeSceneIndexDiff.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/threadLimits.h"
+#include "hashedSceneIndexDiff.h"
+#include "bulkRetainedSceneIndex.h"
+#include "unitTestPathGenerator.h"
+#include "unitTestPerfRunner.h"
 
+#include <algorithm>
 #include <iostream>
+#include <set>
 #include <gtest/gtest.h>
 
 PXR_NAMESPACE_USING_DIRECTIVE
@@ -40,3 +48,239 @@ TEST(TestHydraSceneIndex, test_compute_scene_index_diff_delta) {
     ASSERT_TRUE(addedEntries.size() == 1 && addedEntries[0].primPath == SdfPath("/Prim"));
     ASSERT_TRUE(removedEntries.size() == 1 && removedEntries[0].primPath == SdfPath("/Removed"));
 }
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+template <class Entries>
+SdfPathVector _SortedPaths(Entries const& entries) {
+    SdfPathVector paths;
+    for (auto const& entry : entries) {
+        paths.push_back(entry.primPath);
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+HdContainerDataSourceHandle _IntContainer(std::initializer_list<std::pair<const char*, int>> values) {
+    TfTokenVector names;
+    std::vector<HdDataSourceBaseHandle> dataSources;
+    for (auto const& value : values) {
+        names.emplace_back(value.first);
+        dataSources.push_back(HdRetainedTypedSampledDataSource<int>::New(value.second));
+    }
+    return HdRetainedContainerDataSource::New(names.size(), names.data(), dataSources.data());
+}
+
+}  // namespace
+
+TEST(TestHydraSceneIndex, test_hashed_scene_index_diff) {
+    HdRetainedSceneIndexRefPtr siA = HdRetainedSceneIndex::New();
+    siA->AddPrims({
+            {SdfPath("/Prim"), TfToken("A"), nullptr},
+            {SdfPath("/Unchanged"), TfToken("A"), nullptr},
+            {SdfPath("/Removed"), TfToken("A"), nullptr},
+            {SdfPath("/Group/X"), TfToken("A"), _IntContainer({{"x", 1}})},
+            {SdfPath("/Group/Y"), TfToken("A"), _IntContainer({{"y", 2}})},
+            {SdfPath("/Dirty"), TfToken("A"), _IntContainer({{"a", 1}, {"b", 2}})},
+    });
+
+    HdRetainedSceneIndexRefPtr siB = HdRetainedSceneIndex::New();
+    siB->AddPrims({
+            {SdfPath("/Prim"), TfToken("B"), nullptr},
+            {SdfPath("/Unchanged"), TfToken("A"), nullptr},
+            {SdfPath("/Renamed/X"), TfToken("A"), _IntContainer({{"x", 1}})},
+            {SdfPath("/Renamed/Y"), TfToken("A"), _IntContainer({{"y", 2}})},
+            {SdfPath("/Dirty"), TfToken("A"), _IntContainer({{"a", 1}, {"b", 3}})},
+            {SdfPath("/New"), TfToken("N"), nullptr},
+    });
+
+    Hdsi_HashedSceneIndexDiff diff;
+    {
+        HdSceneIndexObserver::RemovedPrimEntries removedEntries;
+        HdSceneIndexObserver::AddedPrimEntries addedEntries;
+        HdSceneIndexObserver::RenamedPrimEntries renamedEntries;
+        HdSceneIndexObserver::DirtiedPrimEntries dirtiedEntries;
+        diff(siA, siB, &removedEntries, &addedEntries, &renamedEntries, &dirtiedEntries);
+
+        EXPECT_EQ(_SortedPaths(addedEntries), SdfPathVector({SdfPath("/New"), SdfPath("/Prim")}));
+        EXPECT_EQ(_SortedPaths(removedEntries), SdfPathVector({SdfPath("/Removed")}));
+        ASSERT_EQ(renamedEntries.size(), size_t(1));
+        EXPECT_EQ(renamedEntries[0].oldPrimPath, SdfPath("/Group"));
+        EXPECT_EQ(renamedEntries[0].newPrimPath, SdfPath("/Renamed"));
+        ASSERT_EQ(dirtiedEntries.size(), size_t(1));
+        EXPECT_EQ(dirtiedEntries[0].primPath, SdfPath("/Dirty"));
+        EXPECT_EQ(dirtiedEntries[0].dirtyLocators, HdDataSourceLocatorSet{HdDataSourceLocator(TfToken("b"))});
+    }
+
+    // Hash trees are cached until their scene index changes.
+    EXPECT_EQ(diff.GetHashTree(siA), diff.GetHashTree(siA));
+    const Hdsi_HashedSceneIndexDiff::HashTreeConstPtr treeB = diff.GetHashTree(siB);
+    siB->AddPrims({{SdfPath("/Late"), TfToken("A"), nullptr}});
+    EXPECT_NE(diff.GetHashTree(siB), treeB);
+    {
+        HdSceneIndexObserver::RemovedPrimEntries removedEntries;
+        HdSceneIndexObserver::AddedPrimEntries addedEntries;
+        HdSceneIndexObserver::RenamedPrimEntries renamedEntries;
+        HdSceneIndexObserver::DirtiedPrimEntries dirtiedEntries;
+        diff(siA, siB, &removedEntries, &addedEntries, &renamedEntries, &dirtiedEntries);
+        EXPECT_EQ(_SortedPaths(addedEntries), SdfPathVector({SdfPath("/Late"), SdfPath("/New"), SdfPath("/Prim")}));
+    }
+
+    // Identical scene indices give no entries.
+    {
+        HdSceneIndexObserver::RemovedPrimEntries removedEntries;
+        HdSceneIndexObserver::AddedPrimEntries addedEntries;
+        HdSceneIndexObserver::RenamedPrimEntries renamedEntries;
+        HdSceneIndexObserver::DirtiedPrimEntries dirtiedEntries;
+        Hdsi_ComputeHashedSceneIndexDiff(siB, siB, &removedEntries, &addedEntries, &renamedEntries,
+                                         &dirtiedEntries);
+        EXPECT_TRUE(removedEntries.empty() && addedEntries.empty() && renamedEntries.empty() &&
+                    dirtiedEntries.empty());
+    }
+
+    // Data sources without a value are compared by identity, so separately
+    // built ones differ.
+    {
+        const HdDataSourceBaseHandle blockA = HdBlockDataSource::New();
+        const HdDataSourceBaseHandle blockB = HdBlockDataSource::New();
+        EXPECT_EQ(Hdsi_SceneIndexHashTree::HashDataSource(blockA), Hdsi_SceneIndexHashTree::HashDataSource(blockA));
+        EXPECT_TRUE(Hdsi_SceneIndexHashTree::AreEqual(blockA, blockA));
+        EXPECT_FALSE(Hdsi_SceneIndexHashTree::AreEqual(blockA, blockB));
+        EXPECT_FALSE(Hdsi_SceneIndexHashTree::AreEqual(blockA, HdRetainedTypedSampledDataSource<int>::New(1)));
+        EXPECT_FALSE(Hdsi_SceneIndexHashTree::AreEqual(blockA, nullptr));
+    }
+
+    // Sampled data sources are compared at all their sample times, not
+    // only at zero.
+    {
+        HdSampledDataSource::Time times[] = {0.0f, 0.5f};
+        HdSampledDataSource::Time otherTimes[] = {0.0f, 0.25f};
+        int values[] = {1, 2};
+        int otherValues[] = {1, 3};
+        const HdDataSourceBaseHandle sampled = HdRetainedTypedMultisampledDataSource<int>::New(2, times, values);
+        const HdDataSourceBaseHandle same = HdRetainedTypedMultisampledDataSource<int>::New(2, times, values);
+        const HdDataSourceBaseHandle otherValue =
+                HdRetainedTypedMultisampledDataSource<int>::New(2, times, otherValues);
+        const HdDataSourceBaseHandle otherTime = HdRetainedTypedMultisampledDataSource<int>::New(2, otherTimes, values);
+        EXPECT_EQ(Hdsi_SceneIndexHashTree::HashDataSource(sampled), Hdsi_SceneIndexHashTree::HashDataSource(same));
+        EXPECT_TRUE(Hdsi_SceneIndexHashTree::AreEqual(sampled, same));
+        EXPECT_FALSE(Hdsi_SceneIndexHashTree::AreEqual(sampled, otherValue));
+        EXPECT_FALSE(Hdsi_SceneIndexHashTree::AreEqual(sampled, otherTime));
+        EXPECT_FALSE(Hdsi_SceneIndexHashTree::AreEqual(sampled, HdRetainedTypedSampledDataSource<int>::New(1)));
+    }
+
+    // The entries of expired scene indices are erased.
+    {
+        HdRetainedSceneIndexRefPtr siC = HdRetainedSceneIndex::New();
+        diff.GetHashTree(siC);
+        EXPECT_EQ(diff.GetNumCachedSceneIndices(), size_t(3));
+        siC.Reset();
+        EXPECT_EQ(diff.GetNumCachedSceneIndices(), size_t(2));
+    }
+}
+
+TEST(TestHydraSceneIndex, test_hashed_scene_index_diff_perf) {
+    static const TfToken valueToken("value");
+    const SdfPathVector leafPaths =
+            Hd_UnitTestPathGenerator(Hd_UnitTestPathGenerator::UniformOptions(1000000, 4)).Generate();
+
+    // Rename ten level-three groups as a whole.
+    std::set<SdfPath> renamedGroups;
+    for (size_t i = 0; renamedGroups.size() != 10; ++i) {
+        renamedGroups.insert(leafPaths[i].GetParentPath());
+    }
+    auto renamedPath = [&renamedGroups](SdfPath const& path) {
+        const auto group = renamedGroups.find(path.GetParentPath());
+        if (group == renamedGroups.end()) {
+            return path;
+        }
+        const TfToken newName(TfStringPrintf("Moved_%zu", size_t(std::distance(renamedGroups.begin(), group))));
+        return path.ReplacePrefix(*group, group->GetParentPath().AppendChild(newName));
+    };
+
+    // Change the data of 0.5% of the leaves, remove 0.25% and add 0.25%.
+    HdRetainedSceneIndex::AddedPrimEntries entriesA;
+    HdRetainedSceneIndex::AddedPrimEntries entriesB;
+    size_t numDirtied = 0;
+    size_t numRemoved = 0;
+    size_t numAdded = 0;
+    for (size_t i = 0; i != leafPaths.size(); ++i) {
+        SdfPath const& path = leafPaths[i];
+        entriesA.push_back({path, TfToken("leaf"),
+                            HdRetainedContainerDataSource::New(
+                                    valueToken, HdRetainedTypedSampledDataSource<int>::New(int(i)))});
+        const SdfPath pathB = renamedPath(path);
+        if (pathB != path) {
+            entriesB.push_back({pathB, entriesA.back().primType, entriesA.back().dataSource});
+        } else if (i % 400 == 3) {
+            ++numRemoved;
+        } else if (i % 200 == 1) {
+            entriesB.push_back({path, TfToken("leaf"),
+                                HdRetainedContainerDataSource::New(
+                                        valueToken, HdRetainedTypedSampledDataSource<int>::New(-int(i)))});
+            ++numDirtied;
+        } else {
+            entriesB.push_back(entriesA.back());
+            if (i % 400 == 5) {
+                entriesB.push_back({path.GetParentPath().AppendChild(TfToken(TfStringPrintf("New_%zu", i))),
+                                    TfToken("leaf"), entriesA.back().dataSource});
+                ++numAdded;
+            }
+        }
+    }
+    Hd_BulkRetainedSceneIndexRefPtr siA = Hd_BulkRetainedSceneIndex::New();
+    siA->AddPrims({entriesA});
+    Hd_BulkRetainedSceneIndexRefPtr siB = Hd_BulkRetainedSceneIndex::New();
+    siB->AddPrims({entriesB});
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    runner.Measure("diff_stock_1M", [&]() {
+        HdSceneIndexObserver::RemovedPrimEntries removedEntries;
+        HdSceneIndexObserver::AddedPrimEntries addedEntries;
+        HdSceneIndexObserver::RenamedPrimEntries renamedEntries;
+        HdSceneIndexObserver::DirtiedPrimEntries dirtiedEntries;
+        HdsiComputeSceneIndexDiffDelta(siA, siB, &removedEntries, &addedEntries, &renamedEntries, &dirtiedEntries);
+    });
+
+    for (unsigned numThreads : Hd_UnitTestPerfRunner::GetThreadCounts()) {
+        WorkSetConcurrencyLimit(numThreads);
+
+        HdSceneIndexObserver::RemovedPrimEntries removedEntries;
+        HdSceneIndexObserver::AddedPrimEntries addedEntries;
+        HdSceneIndexObserver::RenamedPrimEntries renamedEntries;
+        HdSceneIndexObserver::DirtiedPrimEntries dirtiedEntries;
+        auto clearEntries = [&]() {
+            removedEntries.clear();
+            addedEntries.clear();
+            renamedEntries.clear();
+            dirtiedEntries.clear();
+        };
+        runner.Measure(TfStringPrintf("diff_hashed_build_1M_%ut", numThreads), [&]() {
+            clearEntries();
+            Hdsi_ComputeHashedSceneIndexDiff(siA, siB, &removedEntries, &addedEntries, &renamedEntries,
+                                             &dirtiedEntries);
+        });
+
+        Hdsi_HashedSceneIndexDiff diff;
+        diff.GetHashTree(siA);
+        diff.GetHashTree(siB);
+        runner.Measure(TfStringPrintf("diff_hashed_cached_1M_%ut", numThreads), [&]() {
+            clearEntries();
+            diff(siA, siB, &removedEntries, &addedEntries, &renamedEntries, &dirtiedEntries);
+        });
+
+        EXPECT_EQ(removedEntries.size(), numRemoved);
+        EXPECT_EQ(addedEntries.size(), numAdded);
+        EXPECT_EQ(renamedEntries.size(), renamedGroups.size());
+        EXPECT_EQ(dirtiedEntries.size(), numDirtied);
+    }
+    WorkSetMaximumConcurrencyLimit();
+
+    EXPECT_TRUE(runner.Finish("testHdsiComputeSceneIndexDiff.json", "perfstats_compute_scene_index_diff.raw").empty());
+}
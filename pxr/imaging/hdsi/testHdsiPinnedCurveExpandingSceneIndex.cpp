@@ -6,6 +6,7 @@
 
 #include "pxr/imaging/hd/basisCurvesSchema.h"
 #include "pxr/imaging/hd/basisCurvesTopologySchema.h"
+#include "pxr/imaging/hd/containerDataSourceEditor.h"
 #include "pxr/imaging/hd/primvarSchema.h"
 #include "pxr/imaging/hd/primvarsSchema.h"
 #include "pxr/imaging/hd/retainedDataSource.h"
@@ -15,8 +16,14 @@
 #include "pxr/imaging/hdsi/pinnedCurveExpandingSceneIndex.h"
 
 #include "pxr/base/tf/errorMark.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "pxr/base/work/threadLimits.h"
+#include "parallelPinnedCurveExpandingSceneIndex.h"
+#include "unitTestPerfRunner.h"
 
+#include <functional>
 #include <iostream>
+#include <random>
 #include <sstream>
 #include <utility>
 #include <vector>
@@ -59,7 +66,7 @@ struct _Curve {
 // Returns a typed sampled data source for a small number of VtArray types.
 HdSampledDataSourceHandle _GetRetainedDataSource(VtValue const& val) {
     // Support just the types used for this test:
-    //  int, VtIntArray, VtFloatArray, VtVec3fArray
+    //  int, VtIntArray, VtFloatArray, VtVec2fArray, VtVec3fArray
     if (val.IsHolding<int>()) {
         return HdRetainedTypedSampledDataSource<int>::New(val.UncheckedGet<int>());
     }
@@ -69,6 +76,9 @@ HdSampledDataSourceHandle _GetRetainedDataSource(VtValue const& val) {
     if (val.IsHolding<VtFloatArray>()) {
         return HdRetainedTypedSampledDataSource<VtFloatArray>::New(val.UncheckedGet<VtFloatArray>());
     }
+    if (val.IsHolding<VtVec2fArray>()) {
+        return HdRetainedTypedSampledDataSource<VtVec2fArray>::New(val.UncheckedGet<VtVec2fArray>());
+    }
     if (val.IsHolding<VtVec3fArray>()) {
         return HdRetainedTypedSampledDataSource<VtVec3fArray>::New(val.UncheckedGet<VtVec3fArray>());
     }
@@ -366,7 +376,15 @@ void _Compare(const HdContainerDataSourceHandle& baseline, const HdContainerData
     GTEST_FAIL();
 }
 
-void TestPinnedCurves(bool hasCurveIndices, bool hasIndexedPrimvar) {
+using _ExpandingSceneFactory = std::function<HdSceneIndexBaseRefPtr(HdSceneIndexBaseRefPtr const&)>;
+
+HdSceneIndexBaseRefPtr _NewPinnedCurveExpandingSceneIndex(HdSceneIndexBaseRefPtr const& inputScene) {
+    return HdsiPinnedCurveExpandingSceneIndex::New(inputScene);
+}
+
+void TestPinnedCurves(bool hasCurveIndices,
+                      bool hasIndexedPrimvar,
+                      _ExpandingSceneFactory const& newExpandingScene = _NewPinnedCurveExpandingSceneIndex) {
     {
         // 1. Pinned bspline
         const auto curves = _GetAuthoredAndExpectedTestCurves(HdTokens->bspline, hasCurveIndices, hasIndexedPrimvar);
@@ -378,7 +396,7 @@ void TestPinnedCurves(bool hasCurveIndices, bool hasIndexedPrimvar) {
                 _BuildCurveDataSource(curves.first),
         }});
 
-        HdSceneIndexBaseRefPtr expandingScene = HdsiPinnedCurveExpandingSceneIndex::New(retainedScene);
+        HdSceneIndexBaseRefPtr expandingScene = newExpandingScene(retainedScene);
 
         _Compare(_BuildCurveDataSource(curves.second), expandingScene->GetPrim(SdfPath("/simpleCurve")).dataSource);
     }
@@ -394,7 +412,7 @@ void TestPinnedCurves(bool hasCurveIndices, bool hasIndexedPrimvar) {
                 _BuildCurveDataSource(curves.first),
         }});
 
-        HdSceneIndexBaseRefPtr expandingScene = HdsiPinnedCurveExpandingSceneIndex::New(retainedScene);
+        HdSceneIndexBaseRefPtr expandingScene = newExpandingScene(retainedScene);
 
         _Compare(_BuildCurveDataSource(curves.second), expandingScene->GetPrim(SdfPath("/simpleCurve")).dataSource);
     }
@@ -421,3 +439,243 @@ TEST(TestHydraSceneIndex, test_pinned_curves_with_curve_indices_and_indexed_prim
     TestPinnedCurves(/* hasCurveIndices   */ true,
                      /* hasIndexedPrimvar */ true);
 }
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+HdSceneIndexBaseRefPtr _NewParallelPinnedCurveExpandingSceneIndex(HdSceneIndexBaseRefPtr const& inputScene) {
+    return Hdsi_ParallelPinnedCurveExpandingSceneIndex::New(inputScene);
+}
+
+// Pulls the topology and the given primvars of a curves prim and returns the
+// total number of elements.
+size_t _PullCurves(HdContainerDataSourceHandle const& primDataSource, TfTokenVector const& primvarNames) {
+    size_t numElements = 0;
+    HdBasisCurvesTopologySchema topology = HdBasisCurvesSchema::GetFromParent(primDataSource).GetTopology();
+    numElements += topology.GetCurveVertexCounts()->GetTypedValue(0.0f).size();
+    numElements += topology.GetCurveIndices()->GetTypedValue(0.0f).size();
+    HdPrimvarsSchema primvars = HdPrimvarsSchema::GetFromParent(primDataSource);
+    for (TfToken const& name : primvarNames) {
+        HdPrimvarSchema primvar = primvars.GetPrimvar(name);
+        if (HdSampledDataSourceHandle value = primvar.GetPrimvarValue()) {
+            numElements += value->GetValue(0.0f).GetArraySize();
+        }
+        if (HdIntArrayDataSourceHandle indices = primvar.GetIndices()) {
+            numElements += indices->GetTypedValue(0.0f).size();
+        }
+    }
+    return numElements;
+}
+
+// Returns a pinned bspline groom with numCurves curves of 4 to 12 vertices
+// and eight primvars.
+_Curve _BuildGroom(size_t numCurves) {
+    std::mt19937 randomGen(0);
+    std::uniform_int_distribution<int> countDist(4, 12);
+
+    _Curve curve;
+    curve.type = HdTokens->cubic;
+    curve.basis = HdTokens->bspline;
+    curve.wrap = HdTokens->pinned;
+    curve.curveVertexCounts.resize(numCurves);
+    size_t numVertices = 0;
+    size_t numVarying = 0;
+    for (int& count : curve.curveVertexCounts) {
+        count = countDist(randomGen);
+        numVertices += count;
+        numVarying += std::max(count - 3, 1) + 1;
+    }
+
+    VtVec3fArray points(numVertices);
+    VtVec3fArray normals(numVertices);
+    VtFloatArray widths(numVertices);
+    VtVec2fArray uvs(numVertices);
+    VtIntArray idIndices(numVertices);
+    for (size_t i = 0; i != numVertices; ++i) {
+        points[i] = GfVec3f(float(i), 0.0f, 1.0f);
+        normals[i] = GfVec3f(0.0f, 1.0f, 0.0f);
+        widths[i] = 0.01f;
+        uvs[i] = GfVec2f(float(i % 1024), float(i / 1024));
+        idIndices[i] = int(i % 16);
+    }
+    VtVec3fArray colors(numVarying, GfVec3f(0.5f));
+    VtFloatArray opacities(numVarying, 1.0f);
+    VtFloatArray ids(16, 0.0f);
+    VtIntArray clumps(numCurves, 0);
+
+    _Primvars& primvars = curve.primvars;
+    primvars.emplace_back(HdTokens->points, VtValue(points), HdPrimvarSchemaTokens->vertex,
+                          HdPrimvarSchemaTokens->point);
+    primvars.emplace_back(HdTokens->normals, VtValue(normals), HdPrimvarSchemaTokens->vertex,
+                          HdPrimvarRoleTokens->normal);
+    primvars.emplace_back(HdTokens->widths, VtValue(widths), HdPrimvarSchemaTokens->vertex);
+    primvars.emplace_back(TfToken("uv"), VtValue(uvs), HdPrimvarSchemaTokens->vertex);
+    primvars.emplace_back(HdTokens->displayColor, VtValue(colors), HdPrimvarSchemaTokens->varying,
+                          HdPrimvarRoleTokens->color);
+    primvars.emplace_back(HdTokens->displayOpacity, VtValue(opacities), HdPrimvarSchemaTokens->varying);
+    primvars.emplace_back(TfToken("id"), VtValue(ids), HdPrimvarSchemaTokens->vertex, TfToken(), idIndices);
+    primvars.emplace_back(TfToken("clump"), VtValue(clumps), HdPrimvarSchemaTokens->uniform);
+    return curve;
+}
+
+}  // namespace
+
+TEST(TestHydraSceneIndex, test_parallel_pinned_curves) {
+    for (bool hasCurveIndices : {false, true}) {
+        for (bool hasIndexedPrimvar : {false, true}) {
+            TestPinnedCurves(hasCurveIndices, hasIndexedPrimvar, _NewParallelPinnedCurveExpandingSceneIndex);
+        }
+    }
+}
+
+TEST(TestHydraSceneIndex, test_parallel_pinned_curves_perf) {
+    const _Curve groom = _BuildGroom(1000000);
+    TfTokenVector primvarNames;
+    for (_Primvar const& primvar : groom.primvars) {
+        primvarNames.push_back(primvar.name);
+    }
+
+    HdRetainedSceneIndexRefPtr retainedScene = HdRetainedSceneIndex::New();
+    retainedScene->AddPrims({{SdfPath("/Groom"), HdPrimTypeTokens->basisCurves, _BuildCurveDataSource(groom)}});
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    size_t expectedNumElements = 0;
+    HdSceneIndexBaseRefPtr stockScene = HdsiPinnedCurveExpandingSceneIndex::New(retainedScene);
+    runner.Measure("pinned_curves_expand_stock_1M", [&]() {
+        expectedNumElements = _PullCurves(stockScene->GetPrim(SdfPath("/Groom")).dataSource, primvarNames);
+    });
+
+    for (unsigned numThreads : Hd_UnitTestPerfRunner::GetThreadCounts()) {
+        WorkSetConcurrencyLimit(numThreads);
+        HdSceneIndexBaseRefPtr parallelScene = Hdsi_ParallelPinnedCurveExpandingSceneIndex::New(retainedScene);
+        size_t numElements = 0;
+        runner.Measure(TfStringPrintf("pinned_curves_expand_parallel_1M_%ut", numThreads), [&]() {
+            numElements = _PullCurves(parallelScene->GetPrim(SdfPath("/Groom")).dataSource, primvarNames);
+        });
+        EXPECT_EQ(numElements, expectedNumElements);
+
+        // Primvars that are not pulled are not expanded.
+        runner.Measure(TfStringPrintf("pinned_curves_expand_points_only_1M_%ut", numThreads), [&]() {
+            _PullCurves(parallelScene->GetPrim(SdfPath("/Groom")).dataSource, {HdTokens->points});
+        });
+    }
+    WorkSetMaximumConcurrencyLimit();
+
+    EXPECT_TRUE(runner.Finish("testHdsiPinnedCurveExpanding.json", "perfstats_pinned_curve_expanding.raw").empty());
+}
+
+namespace {
+
+// Points that return the array of the current frame.
+class _AnimatedPointsDataSource : public HdTypedSampledDataSource<VtVec3fArray> {
+public:
+    HD_DECLARE_DATASOURCE(_AnimatedPointsDataSource);
+
+    VtValue GetValue(Time shutterOffset) override { return VtValue(GetTypedValue(shutterOffset)); }
+
+    VtVec3fArray GetTypedValue(Time shutterOffset) override { return *_currentPoints; }
+
+    bool GetContributingSampleTimesForInterval(Time startTime,
+                                               Time endTime,
+                                               std::vector<Time>* outSampleTimes) override {
+        return false;
+    }
+
+private:
+    explicit _AnimatedPointsDataSource(VtVec3fArray const* const* currentPoints) : _currentPoints(currentPoints) {}
+
+    VtVec3fArray const* const* const _currentPoints;
+};
+
+}  // namespace
+
+TEST(TestHydraSceneIndex, test_parallel_pinned_curves_topology_cache) {
+    const auto curves = _GetAuthoredAndExpectedTestCurves(HdTokens->bspline, true, true);
+    const SdfPath primPath("/simpleCurve");
+
+    HdRetainedSceneIndexRefPtr retainedScene = HdRetainedSceneIndex::New();
+    retainedScene->AddPrims({{primPath, HdBasisCurvesSchemaTokens->basisCurves, _BuildCurveDataSource(curves.first)}});
+    Hdsi_ParallelPinnedCurveExpandingSceneIndexRefPtr expandingScene =
+            Hdsi_ParallelPinnedCurveExpandingSceneIndex::New(retainedScene);
+    EXPECT_EQ(expandingScene->GetNumComputedExpansions(), size_t(0));
+
+    _Compare(_BuildCurveDataSource(curves.second), expandingScene->GetPrim(primPath).dataSource);
+    _Compare(_BuildCurveDataSource(curves.second), expandingScene->GetPrim(primPath).dataSource);
+    EXPECT_EQ(expandingScene->GetNumComputedExpansions(), size_t(1));
+
+    // Primvar dirties reuse the cached expansion.
+    retainedScene->DirtyPrims({{primPath, HdDataSourceLocatorSet{HdPrimvarsSchema::GetPointsLocator()}}});
+    _Compare(_BuildCurveDataSource(curves.second), expandingScene->GetPrim(primPath).dataSource);
+    EXPECT_EQ(expandingScene->GetNumComputedExpansions(), size_t(1));
+
+    // Topology dirties drop it.
+    retainedScene->DirtyPrims({{primPath, HdDataSourceLocatorSet{HdBasisCurvesTopologySchema::GetDefaultLocator()}}});
+    _Compare(_BuildCurveDataSource(curves.second), expandingScene->GetPrim(primPath).dataSource);
+    EXPECT_EQ(expandingScene->GetNumComputedExpansions(), size_t(2));
+
+    // So does re-adding the prim, here with a different basis.
+    const auto catmullRomCurves = _GetAuthoredAndExpectedTestCurves(HdTokens->catmullRom, true, true);
+    retainedScene->AddPrims(
+            {{primPath, HdBasisCurvesSchemaTokens->basisCurves, _BuildCurveDataSource(catmullRomCurves.first)}});
+    _Compare(_BuildCurveDataSource(catmullRomCurves.second), expandingScene->GetPrim(primPath).dataSource);
+    EXPECT_EQ(expandingScene->GetNumComputedExpansions(), size_t(3));
+}
+
+TEST(TestHydraSceneIndex, test_parallel_pinned_curves_animated_points_perf) {
+    constexpr size_t numFrames = 240;
+    const SdfPath groomPath("/Groom");
+    const _Curve groom = _BuildGroom(100000);
+
+    // Frames alternate between two sets of points over a static topology.
+    VtVec3fArray framePoints[2] = {groom.primvars[0].value.UncheckedGet<VtVec3fArray>(), VtVec3fArray()};
+    framePoints[1] = framePoints[0];
+    for (GfVec3f& point : framePoints[1]) {
+        point[1] += 1.0f;
+    }
+    VtVec3fArray const* currentPoints = &framePoints[0];
+
+    HdRetainedSceneIndexRefPtr retainedScene = HdRetainedSceneIndex::New();
+    retainedScene->AddPrims({{groomPath, HdPrimTypeTokens->basisCurves,
+                              HdContainerDataSourceEditor(_BuildCurveDataSource(groom))
+                                      .Set(HdPrimvarsSchema::GetPointsLocator().Append(
+                                                   HdPrimvarSchemaTokens->primvarValue),
+                                           _AnimatedPointsDataSource::New(&currentPoints))
+                                      .Finish()}});
+    const HdSceneIndexObserver::DirtiedPrimEntries pointsDirty = {
+            {groomPath, HdDataSourceLocatorSet{HdPrimvarsSchema::GetPointsLocator()}}};
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    // Each frame dirties the points, then pulls the topology and points.
+    auto playFrames = [&](HdSceneIndexBaseRefPtr const& expandingScene) {
+        size_t numElements = 0;
+        for (size_t frame = 0; frame != numFrames; ++frame) {
+            currentPoints = &framePoints[frame % 2];
+            retainedScene->DirtyPrims(pointsDirty);
+            numElements += _PullCurves(expandingScene->GetPrim(groomPath).dataSource, {HdTokens->points});
+        }
+        return numElements;
+    };
+
+    size_t expectedNumElements = 0;
+    HdSceneIndexBaseRefPtr stockScene = HdsiPinnedCurveExpandingSceneIndex::New(retainedScene);
+    runner.Measure("pinned_curves_240_frames_stock_100k",
+                   [&]() { expectedNumElements = playFrames(stockScene); });
+
+    Hdsi_ParallelPinnedCurveExpandingSceneIndexRefPtr cachedScene =
+            Hdsi_ParallelPinnedCurveExpandingSceneIndex::New(retainedScene);
+    size_t numElements = 0;
+    runner.Measure("pinned_curves_240_frames_cached_100k", [&]() { numElements = playFrames(cachedScene); });
+    EXPECT_EQ(numElements, expectedNumElements);
+    EXPECT_EQ(cachedScene->GetNumComputedExpansions(), size_t(1));
+
+    EXPECT_TRUE(runner.Finish("testHdsiPinnedCurveAnimation.json", "perfstats_pinned_curve_animation.raw").empty());
+}
@@ -9,7 +9,13 @@
 #include "pxr/imaging/hd/tokens.h"
 
 #include "pxr/imaging/hdsi/switchingSceneIndex.h"
+#include "pxr/base/tf/stringUtils.h"
+#include "prewarmedSwitchingSceneIndex.h"
+#include "bulkRetainedSceneIndex.h"
+#include "unitTestPathGenerator.h"
+#include "unitTestPerfRunner.h"
 
+#include <algorithm>
 #include <iostream>
 #include <gtest/gtest.h>
 
@@ -33,3 +39,179 @@ TEST(TestHydraSceneIndex, test_switching_scene_index) {
     switchingSi->SetIndex(1);
     ASSERT_TRUE(switchingSi->GetPrim(SdfPath("/Prim")).primType == TfToken("B"));
 }
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+// Records the paths of the notices it receives, like a render index that
+// pulls those prims on the next frame.
+class _FrameObserver : public HdSceneIndexObserver {
+public:
+    void PrimsAdded(HdSceneIndexBase const& sender, AddedPrimEntries const& entries) override {
+        for (AddedPrimEntry const& entry : entries) {
+            added.push_back(entry.primPath);
+        }
+    }
+    void PrimsRemoved(HdSceneIndexBase const& sender, RemovedPrimEntries const& entries) override {
+        for (RemovedPrimEntry const& entry : entries) {
+            removed.push_back(entry.primPath);
+        }
+    }
+    void PrimsDirtied(HdSceneIndexBase const& sender, DirtiedPrimEntries const& entries) override {
+        for (DirtiedPrimEntry const& entry : entries) {
+            dirtied.push_back(entry.primPath);
+        }
+    }
+    void PrimsRenamed(HdSceneIndexBase const& sender, RenamedPrimEntries const& entries) override {
+        ConvertPrimsRenamedToRemovedAndAdded(sender, entries, this);
+    }
+
+    void Clear() {
+        added.clear();
+        removed.clear();
+        dirtied.clear();
+    }
+
+    // Pulls the data sources of the added and dirtied prims, then clears.
+    void Pull(HdSceneIndexBase const& sceneIndex) {
+        for (SdfPathVector const* paths : {&added, &dirtied}) {
+            for (SdfPath const& path : *paths) {
+                if (HdContainerDataSourceHandle dataSource = sceneIndex.GetPrim(path).dataSource) {
+                    for (TfToken const& name : dataSource->GetNames()) {
+                        dataSource->Get(name);
+                    }
+                }
+            }
+        }
+        Clear();
+    }
+
+    SdfPathVector added;
+    SdfPathVector removed;
+    SdfPathVector dirtied;
+};
+
+}  // namespace
+
+TEST(TestHydraSceneIndex, test_prewarmed_switching_scene_index) {
+    HdRetainedSceneIndexRefPtr siA = HdRetainedSceneIndex::New();
+    siA->AddPrims({
+            {SdfPath("/Prim"), TfToken("A"), nullptr},
+            {SdfPath("/OnlyA"), TfToken("A"), nullptr},
+    });
+
+    HdRetainedSceneIndexRefPtr siB = HdRetainedSceneIndex::New();
+    siB->AddPrims({
+            {SdfPath("/Prim"), TfToken("B"), nullptr},
+    });
+
+    auto switchingSi = Hdsi_PrewarmedSwitchingSceneIndex::New({siA, siB});
+    _FrameObserver observer;
+    switchingSi->AddObserver(HdSceneIndexObserverPtr(&observer));
+    ASSERT_TRUE(switchingSi->GetPrim(SdfPath("/Prim")).primType == TfToken("A"));
+
+    // Pre-warming is opt-in.
+    EXPECT_FALSE(switchingSi->IsPrewarmed(1));
+    switchingSi->Prewarm(1);
+    switchingSi->WaitForPrewarm();
+    EXPECT_TRUE(switchingSi->IsPrewarmed(1));
+    switchingSi->SetIndex(1);
+    ASSERT_TRUE(switchingSi->GetPrim(SdfPath("/Prim")).primType == TfToken("B"));
+    EXPECT_EQ(observer.removed, SdfPathVector({SdfPath("/OnlyA")}));
+    EXPECT_EQ(observer.added, SdfPathVector({SdfPath("/Prim")}));
+    observer.Clear();
+
+    // Notices from the active input are forwarded and drop the diff back.
+    EXPECT_FALSE(switchingSi->IsPrewarmed(0));
+    switchingSi->Prewarm(0);
+    switchingSi->WaitForPrewarm();
+    EXPECT_TRUE(switchingSi->IsPrewarmed(0));
+    siB->AddPrims({{SdfPath("/OnlyB"), TfToken("B"), nullptr}});
+    EXPECT_EQ(observer.added, SdfPathVector({SdfPath("/OnlyB")}));
+    EXPECT_FALSE(switchingSi->IsPrewarmed(0));
+    switchingSi->Prewarm(0);
+    switchingSi->WaitForPrewarm();
+    EXPECT_TRUE(switchingSi->IsPrewarmed(0));
+    observer.Clear();
+
+    switchingSi->SetIndex(0);
+    ASSERT_TRUE(switchingSi->GetPrim(SdfPath("/Prim")).primType == TfToken("A"));
+    EXPECT_EQ(observer.removed, SdfPathVector({SdfPath("/OnlyB")}));
+    std::sort(observer.added.begin(), observer.added.end());
+    EXPECT_EQ(observer.added, SdfPathVector({SdfPath("/OnlyA"), SdfPath("/Prim")}));
+}
+
+TEST(TestHydraSceneIndex, test_prewarmed_switching_scene_index_perf) {
+    static const TfToken valueToken("value");
+    const SdfPathVector leafPaths =
+            Hd_UnitTestPathGenerator(Hd_UnitTestPathGenerator::UniformOptions(1000000, 4)).Generate();
+
+    // The second input swaps 1% of the leaves for another level of detail.
+    HdRetainedSceneIndex::AddedPrimEntries entriesA;
+    HdRetainedSceneIndex::AddedPrimEntries entriesB;
+    for (size_t i = 0; i != leafPaths.size(); ++i) {
+        entriesA.push_back({leafPaths[i], TfToken("leaf"),
+                            HdRetainedContainerDataSource::New(
+                                    valueToken, HdRetainedTypedSampledDataSource<int>::New(int(i)))});
+        if (i % 100 == 7) {
+            entriesB.push_back({leafPaths[i], TfToken("leaf"),
+                                HdRetainedContainerDataSource::New(
+                                        valueToken, HdRetainedTypedSampledDataSource<int>::New(-int(i)))});
+        } else {
+            entriesB.push_back(entriesA.back());
+        }
+    }
+    Hd_BulkRetainedSceneIndexRefPtr siA = Hd_BulkRetainedSceneIndex::New();
+    siA->AddPrims({entriesA});
+    Hd_BulkRetainedSceneIndexRefPtr siB = Hd_BulkRetainedSceneIndex::New();
+    siB->AddPrims({entriesB});
+
+    Hd_UnitTestPerfRunner::Options options;
+    options.warmup = 0;
+    options.trials = std::min<size_t>(options.trials, 3);
+    Hd_UnitTestPerfRunner runner(options);
+
+    // Time to first frame: the switch plus pulling the prims it notified.
+    _FrameObserver observer;
+    {
+        auto switchingSi = HdsiSwitchingSceneIndex::New({siA, siB});
+        switchingSi->AddObserver(HdSceneIndexObserverPtr(&observer));
+        runner.MeasureWithSetup(
+                "switch_first_frame_stock_1M",
+                [&]() {
+                    switchingSi->SetIndex(0);
+                    observer.Clear();
+                },
+                [&]() {
+                    switchingSi->SetIndex(1);
+                    observer.Pull(*switchingSi);
+                });
+        switchingSi->RemoveObserver(HdSceneIndexObserverPtr(&observer));
+    }
+
+    for (bool prewarm : {false, true}) {
+        auto switchingSi = Hdsi_PrewarmedSwitchingSceneIndex::New({siA, siB});
+        switchingSi->AddObserver(HdSceneIndexObserverPtr(&observer));
+        size_t numNotices = 0;
+        runner.MeasureWithSetup(
+                prewarm ? "switch_first_frame_prewarmed_1M" : "switch_first_frame_hashed_1M",
+                [&]() {
+                    switchingSi->SetIndex(0);
+                    if (prewarm) {
+                        switchingSi->Prewarm(1);
+                        switchingSi->WaitForPrewarm();
+                    }
+                    observer.Clear();
+                },
+                [&]() {
+                    switchingSi->SetIndex(1);
+                    numNotices = observer.added.size() + observer.removed.size() + observer.dirtied.size();
+                    observer.Pull(*switchingSi);
+                });
+        EXPECT_EQ(numNotices, (leafPaths.size() + 92) / 100);
+        switchingSi->RemoveObserver(HdSceneIndexObserverPtr(&observer));
+    }
+
+    EXPECT_TRUE(runner.Finish("testHdsiSwitchingSceneIndex.json", "perfstats_switching_scene_index.raw").empty());
+}